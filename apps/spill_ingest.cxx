@@ -0,0 +1,82 @@
+/**
+ * @file spill_ingest.cxx
+ *
+ * Ingests the spill files written by the TriggerRecordBuilder at stop (when
+ * its output was full and the records could not be handed over to a
+ * DataWriter) into raw data files.  The data store is configured with the same
+ * JSON object as the data_store_parameters of a DataWriter; "_spill" is
+ * appended to the writer identifier so that the files written by the
+ * DataWriter during the run are never overwritten.
+ *
+ * Usage: dfmodules_spill_ingest <data_store_parameters.json> <spill_file> [<spill_file> ...]
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/DataStore.hpp"
+#include "dfmodules/TriggerRecordSpill.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+using namespace dunedaq;
+using namespace dunedaq::dfmodules;
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <data_store_parameters.json> <spill_file> [<spill_file> ...]" << std::endl;
+    return 1;
+  }
+
+  nlohmann::json data_store_parameters;
+  std::ifstream config_file(argv[1]);
+  if (!config_file.is_open()) {
+    std::cerr << "Unable to open " << argv[1] << std::endl;
+    return 1;
+  }
+  config_file >> data_store_parameters;
+  auto& filename_parameters = data_store_parameters["filename_parameters"];
+  filename_parameters["writer_identifier"] = filename_parameters.value("writer_identifier", "") + "_spill";
+
+  int status = 0;
+  for (int i = 2; i < argc; ++i) {
+    std::string spill_file = argv[i];
+    size_t records = 0;
+    try {
+      auto data_store = make_data_store(data_store_parameters);
+      TriggerRecordSpillReader reader(spill_file);
+      std::optional<daqdataformats::run_number_t> run_number;
+
+      while (auto record = reader.next()) {
+        auto record_run = record->get_header_ref().get_run_number();
+        if (run_number != record_run) {
+          if (run_number) {
+            data_store->finish_with_run(*run_number);
+          }
+          data_store->prepare_for_run(record_run);
+          run_number = record_run;
+        }
+        data_store->write(*record);
+        ++records;
+      }
+      if (run_number) {
+        data_store->finish_with_run(*run_number);
+      }
+      std::cout << spill_file << ": " << records << " records ingested" << std::endl;
+    } catch (const std::exception& excpt) {
+      std::cerr << spill_file << ": ingestion failed after " << records << " records: " << excpt.what() << std::endl;
+      status = 2;
+    }
+  }
+
+  return status;
+}
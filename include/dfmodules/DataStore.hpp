@@ -24,6 +24,7 @@
 #include "logging/Logging.hpp"
 
 #include "nlohmann/json.hpp"
+#include "opmonlib/InfoCollector.hpp"
 
 #include <chrono>
 #include <cstddef>
@@ -130,6 +131,24 @@ public:
    */
   virtual void finish_with_run(daqdataformats::run_number_t run_number) = 0;
 
+  /**
+   * @brief Pushes what the DataStore buffers into its output, so that the
+   * data blocks written so far survive the end of the application.
+   */
+  virtual void flush() {}
+
+  /**
+   * @brief Whether two instances may be used from different threads at the
+   * same time, e.g. one finishing a run while the other writes the next.
+   */
+  virtual bool allows_concurrent_instances() const { return true; }
+
+  /**
+   * @brief Adds the operational monitoring information of the DataStore,
+   * if it has any, to that of the module that owns it.
+   */
+  virtual void get_info(opmonlib::InfoCollector& /*ci*/, int /*level*/) {}
+
 private:
   DataStore(const DataStore&) = delete;
   DataStore& operator=(const DataStore&) = delete;
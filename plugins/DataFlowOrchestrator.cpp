@@ -8,6 +8,7 @@
 
 #include "DataFlowOrchestrator.hpp"
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/RunSummary.hpp"
 
 #include "dfmodules/datafloworchestrator/Nljs.hpp"
 #include "dfmodules/datafloworchestratorinfo/InfoNljs.hpp"
@@ -17,6 +18,7 @@
 #include "iomanager/IOManager.hpp"
 #include "logging/Logging.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <future>
@@ -49,11 +51,13 @@ DataFlowOrchestrator::DataFlowOrchestrator(const std::string& name)
   : dunedaq::appfwk::DAQModule(name)
   , m_queue_timeout(100)
   , m_run_number(0)
+  , m_trace_source(EventTrace::get().register_source(name))
 {
   register_command("conf", &DataFlowOrchestrator::do_conf);
   register_command("start", &DataFlowOrchestrator::do_start);
   register_command("drain_dataflow", &DataFlowOrchestrator::do_stop);
   register_command("scrap", &DataFlowOrchestrator::do_scrap);
+  register_command("dump_event_trace", &DataFlowOrchestrator::do_dump_event_trace);
 }
 
 void
@@ -74,6 +78,18 @@ DataFlowOrchestrator::init(const data_t& init_data)
   iom->get_receiver<dfmessages::TriggerDecision>(m_td_connection);
   m_busy_sender = iom->get_sender<dfmessages::TriggerInhibit>(busy_connection);
 
+  // the load reports and the token batches of the dataflow applications are optional
+  auto ini = init_data.get<appfwk::app::ModInit>();
+  for (const auto& ref : ini.conn_refs) {
+    if (ref.name == "load_report_connection") {
+      m_load_report_connection = ref;
+      iom->get_receiver<DataflowLoadReport>(m_load_report_connection);
+    } else if (ref.name == "token_batch_connection") {
+      m_token_batch_connection = ref;
+      iom->get_receiver<TriggerDecisionTokenBatch>(m_token_batch_connection);
+    }
+  }
+
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
 }
 
@@ -89,12 +105,15 @@ DataFlowOrchestrator::do_conf(const data_t& payload)
                             << ", busy threshold " << app.thresholds.busy << ", free threshold " << app.thresholds.free;
     m_dataflow_availability[app.connection_uid] =
       TriggerRecordBuilderData(app.connection_uid, app.thresholds.busy, app.thresholds.free);
+    m_dataflow_availability[app.connection_uid].set_bytes_thresholds(app.thresholds.busy_bytes,
+                                                                     app.thresholds.free_bytes);
   }
 
   m_queue_timeout = std::chrono::milliseconds(parsed_conf.general_queue_timeout);
   m_stop_timeout = std::chrono::microseconds(parsed_conf.stop_timeout * 1000);
 
   m_td_send_retries = parsed_conf.td_send_retries;
+  m_bandwidth_weighting = parsed_conf.bandwidth_weighting;
 
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method, there are "
                                       << m_dataflow_availability.size() << " TRB apps defined";
@@ -106,13 +125,25 @@ DataFlowOrchestrator::do_start(const data_t& payload)
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_start() method";
 
   m_received_tokens = 0;
+  m_run_received_decisions = 0;
+  m_run_sent_decisions = 0;
+  m_run_received_tokens = 0;
+  m_dispatch_retries = 0;
+  m_load_reports = 0;
+  m_token_batches = 0;
+  m_busy_transitions = 0;
+  m_busy_time = 0;
+  m_decision_handling_time.reset();
+  m_token_latency.reset();
+  m_batch_token_latency.reset();
+  m_run_start = std::chrono::steady_clock::now();
   m_run_number = payload.value<dunedaq::daqdataformats::run_number_t>("run", 0);
 
   m_running_status.store(true);
   m_last_notified_busy.store(false);
   m_last_assignement_it = m_dataflow_availability.end();
 
-  m_last_token_received = m_last_td_received = std::chrono::steady_clock::now();
+  m_last_token_received = m_last_td_received = m_last_token_batch_received = std::chrono::steady_clock::now();
 
   auto iom = iomanager::IOManager::get();
   iom->add_callback<dfmessages::TriggerDecisionToken>(
@@ -121,6 +152,15 @@ DataFlowOrchestrator::do_start(const data_t& payload)
   iom->add_callback<dfmessages::TriggerDecision>(
     m_td_connection, std::bind(&DataFlowOrchestrator::receive_trigger_decision, this, std::placeholders::_1));
 
+  if (!m_load_report_connection.uid.empty()) {
+    iom->add_callback<DataflowLoadReport>(
+      m_load_report_connection, std::bind(&DataFlowOrchestrator::receive_load_report, this, std::placeholders::_1));
+  }
+  if (!m_token_batch_connection.uid.empty()) {
+    iom->add_callback<TriggerDecisionTokenBatch>(
+      m_token_batch_connection, std::bind(&DataFlowOrchestrator::receive_token_batch, this, std::placeholders::_1));
+  }
+
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_start() method";
 }
 
@@ -144,6 +184,12 @@ DataFlowOrchestrator::do_stop(const data_t& /*args*/)
   }
 
   iom->remove_callback<dfmessages::TriggerDecisionToken>(m_token_connection);
+  if (!m_load_report_connection.uid.empty()) {
+    iom->remove_callback<DataflowLoadReport>(m_load_report_connection);
+  }
+  if (!m_token_batch_connection.uid.empty()) {
+    iom->remove_callback<TriggerDecisionTokenBatch>(m_token_batch_connection);
+  }
 
   std::list<std::shared_ptr<AssignedTriggerDecision>> remnants;
   for (auto& app : m_dataflow_availability) {
@@ -157,10 +203,19 @@ DataFlowOrchestrator::do_stop(const data_t& /*args*/)
     ers::error(IncompleteTriggerDecision(ERS_HERE, r->decision.trigger_number, m_run_number));
   }
 
+  EventTrace::get().dump(m_trace_source, get_name() + "_run" + std::to_string(m_run_number));
+  write_run_summary(remnants.size());
+
   TLOG() << get_name() << " successfully stopped";
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
 }
 
+void
+DataFlowOrchestrator::do_dump_event_trace(const data_t& /*args*/)
+{
+  EventTrace::get().dump(m_trace_source, get_name());
+}
+
 void
 DataFlowOrchestrator::do_scrap(const data_t& /*args*/)
 {
@@ -185,6 +240,8 @@ DataFlowOrchestrator::receive_trigger_decision(const dfmessages::TriggerDecision
   }
 
   ++m_received_decisions;
+  ++m_run_received_decisions;
+  EventTrace::record(TraceEventType::kReceive, m_trace_source, decision.trigger_number);
   auto decision_received = std::chrono::steady_clock::now();
 
   std::chrono::steady_clock::time_point decision_assigned;
@@ -226,6 +283,7 @@ DataFlowOrchestrator::receive_trigger_decision(const dfmessages::TriggerDecision
     std::chrono::duration_cast<std::chrono::microseconds>(decision_assigned - decision_received).count();
   m_forwarding_decision +=
     std::chrono::duration_cast<std::chrono::microseconds>(m_last_td_received - decision_assigned).count();
+  m_decision_handling_time.record(m_last_td_received - decision_received);
 }
 
 std::shared_ptr<AssignedTriggerDecision>
@@ -237,13 +295,15 @@ DataFlowOrchestrator::find_slot(const dfmessages::TriggerDecision& decision)
   // Applications in error are skipped.
   // we only probe the applications once.
   // if they are all unavailable the assignment is set to
-  // the application with the lowest used slots
+  // the application with the lowest used slots, preferring
+  // those whose writer is not stalled on the storage
   // returning a nullptr will be considered as an error
   // from the upper level code
 
   std::shared_ptr<AssignedTriggerDecision> output = nullptr;
   auto minimum_occupied = m_dataflow_availability.end();
   size_t minimum = std::numeric_limits<size_t>::max();
+  bool minimum_stalled = true;
   unsigned int counter = 0;
 
   auto candidate_it = m_last_assignement_it;
@@ -264,8 +324,10 @@ DataFlowOrchestrator::find_slot(const dfmessages::TriggerDecision& decision)
 
     // monitor
     auto slots = candidate_it->second.used_slots();
-    if (slots < minimum) {
+    auto stalled = candidate_it->second.is_write_stalled();
+    if ((!stalled && minimum_stalled) || (stalled == minimum_stalled && slots < minimum)) {
       minimum = slots;
+      minimum_stalled = stalled;
       minimum_occupied = candidate_it;
     }
 
@@ -313,6 +375,7 @@ DataFlowOrchestrator::get_info(opmonlib::InfoCollector& ci, int level)
   info.forwarding_decision = m_forwarding_decision.exchange(0);
   info.waiting_for_token = m_waiting_for_token.exchange(0);
   info.processing_token = m_processing_token.exchange(0);
+  info.load_reports_received = m_received_load_reports.exchange(0);
   ci.add(info);
 }
 
@@ -338,10 +401,13 @@ DataFlowOrchestrator::receive_trigger_complete_token(const dfmessages::TriggerDe
   }
 
   ++m_received_tokens;
+  ++m_run_received_tokens;
+  EventTrace::record(TraceEventType::kReceive, m_trace_source, token.trigger_number, 1);
   auto callback_start = std::chrono::steady_clock::now();
 
   try {
     auto dec_ptr = app_it->second.complete_assignment(token.trigger_number, m_metadata_function);
+    m_token_latency.record(callback_start - dec_ptr->assigned_time);
   } catch (AssignedTriggerDecisionNotFound const& err) {
     ers::error(err);
   }
@@ -362,6 +428,117 @@ DataFlowOrchestrator::receive_trigger_complete_token(const dfmessages::TriggerDe
     std::chrono::duration_cast<std::chrono::microseconds>(m_last_token_received - callback_start).count();
 }
 
+void
+DataFlowOrchestrator::receive_token_batch(const TriggerDecisionTokenBatch& batch)
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << " Received a batch of " << batch.trigger_numbers.size()
+                              << " tokens from " << batch.decision_destination << " for run " << batch.run_number
+                              << " (current run is " << m_run_number << ")";
+
+  if (batch.trigger_numbers.empty())
+    return;
+
+  if (batch.run_number != m_run_number) {
+    std::ostringstream oss_source;
+    oss_source << "TRB at connection " << batch.decision_destination;
+    ers::error(DataFlowOrchestratorRunNumberMismatch(
+      ERS_HERE, batch.run_number, m_run_number, oss_source.str(), batch.trigger_numbers.front()));
+    return;
+  }
+
+  auto app_it = m_dataflow_availability.find(batch.decision_destination);
+  if (app_it == m_dataflow_availability.end()) {
+    ers::error(UnknownTokenSource(ERS_HERE, batch.decision_destination));
+    return;
+  }
+
+  m_received_tokens += batch.trigger_numbers.size();
+  m_run_received_tokens += batch.trigger_numbers.size();
+  ++m_token_batches;
+  auto callback_start = std::chrono::steady_clock::now();
+  for (auto trigger_number : batch.trigger_numbers) {
+    EventTrace::record(TraceEventType::kReceive, m_trace_source, trigger_number, 1);
+  }
+
+  // all the decisions of the batch are completed in a single pass
+  std::vector<daqdataformats::trigger_number_t> missing;
+  auto completed = app_it->second.complete_assignments(batch.trigger_numbers, missing, m_metadata_function);
+  for (const auto& dec_ptr : completed) {
+    m_batch_token_latency.record(callback_start - dec_ptr->assigned_time);
+  }
+  for (auto trigger_number : missing) {
+    ers::error(AssignedTriggerDecisionNotFound(ERS_HERE, trigger_number, batch.decision_destination));
+  }
+
+  if (app_it->second.is_in_error()) {
+    TLOG() << TriggerRecordBuilderAppUpdate(ERS_HERE, batch.decision_destination, "Has reconnected");
+    app_it->second.set_in_error(false);
+  }
+
+  if (!app_it->second.is_busy()) {
+    notify_trigger(false);
+  }
+
+  m_waiting_for_token +=
+    std::chrono::duration_cast<std::chrono::microseconds>(callback_start - m_last_token_batch_received).count();
+  m_last_token_batch_received = std::chrono::steady_clock::now();
+  m_processing_token +=
+    std::chrono::duration_cast<std::chrono::microseconds>(m_last_token_batch_received - callback_start).count();
+}
+
+void
+DataFlowOrchestrator::receive_load_report(const DataflowLoadReport& report)
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << " Received load report from " << report.reporter << " of "
+                              << report.decision_destination << ": " << report.pending_records << " records, "
+                              << report.pending_bytes << " bytes pending";
+
+  // reports of a previous run can still come from a background drain
+  if (report.run_number != m_run_number)
+    return;
+
+  auto app_it = m_dataflow_availability.find(report.decision_destination);
+  if (app_it == m_dataflow_availability.end()) {
+    ers::error(UnknownTokenSource(ERS_HERE, report.decision_destination));
+    return;
+  }
+
+  ++m_load_reports;
+  ++m_received_load_reports;
+  app_it->second.update_load(report);
+  if (m_bandwidth_weighting && report.storage_bandwidth > 0)
+    update_bandwidth_weights();
+
+  // a report can make an application busy or free, without a token
+  notify_trigger(is_busy());
+}
+
+void
+DataFlowOrchestrator::update_bandwidth_weights()
+{
+  // the fastest storage keeps the configured thresholds, the others get
+  // thresholds in proportion of their bandwidth; applications whose
+  // bandwidth is unknown are left alone
+  uint64_t fastest = 0; // NOLINT(build/unsigned)
+  for (const auto& [name, app] : m_dataflow_availability) {
+    fastest = std::max(fastest, app.storage_bandwidth());
+  }
+  if (fastest == 0)
+    return;
+
+  for (auto& [name, app] : m_dataflow_availability) {
+    auto bandwidth = app.storage_bandwidth();
+    if (bandwidth == 0)
+      continue;
+    auto weight = static_cast<double>(bandwidth) / fastest;
+    if (weight != app.weight()) {
+      TLOG_DEBUG(TLVL_CONFIG) << get_name() << " Storage of " << name << " writes " << bandwidth / 1e6
+                              << " MB/s, weight " << weight;
+      app.set_weight(weight);
+    }
+  }
+}
+
 bool
 DataFlowOrchestrator::is_busy() const
 {
@@ -417,6 +594,14 @@ DataFlowOrchestrator::notify_trigger(bool busy) const
   } while (!wasSentSuccessfully && m_running_status.load());
 
   m_last_notified_busy.store(busy);
+
+  auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+  if (busy) {
+    ++m_busy_transitions;
+    m_busy_since.store(now);
+  } else if (m_busy_since.load() != 0) {
+    m_busy_time += now - m_busy_since.exchange(0);
+  }
 }
 
 bool
@@ -437,11 +622,15 @@ DataFlowOrchestrator::dispatch(const std::shared_ptr<AssignedTriggerDecision>& a
         ->send(std::move(decision_copy), m_queue_timeout);
       wasSentSuccessfully = true;
       ++m_sent_decisions;
+      ++m_run_sent_decisions;
+      EventTrace::record(TraceEventType::kSend, m_trace_source, assignment->decision.trigger_number);
       TLOG_DEBUG(TLVL_DISPATCH_TO_TRB) << get_name() << " Sent TriggerDecision for trigger_number "
                                        << decision_copy.trigger_number << " to TRB at connection "
                                        << assignment->connection_name << " for run number " << decision_copy.run_number;
     } catch (const ers::Issue& excpt) {
       std::ostringstream oss_warn;
+      EventTrace::record(TraceEventType::kRetry, m_trace_source, assignment->decision.trigger_number);
+      ++m_dispatch_retries;
       oss_warn << "Send to connection \"" << assignment->connection_name << "\" failed";
       ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
     }
@@ -454,6 +643,37 @@ DataFlowOrchestrator::dispatch(const std::shared_ptr<AssignedTriggerDecision>& a
   return wasSentSuccessfully;
 }
 
+void
+DataFlowOrchestrator::write_run_summary(size_t incomplete_decisions)
+{
+  auto now = std::chrono::steady_clock::now();
+  auto run_time = now - m_run_start;
+  // a run that stops while the trigger is inhibited is busy until the end
+  auto busy_time = std::chrono::steady_clock::duration(m_busy_time.load());
+  if (m_busy_since.load() != 0) {
+    busy_time += now.time_since_epoch() - std::chrono::steady_clock::duration(m_busy_since.load());
+  }
+
+  nlohmann::json summary;
+  summary["run_duration_s"] = std::chrono::duration<double>(run_time).count();
+  summary["received_decisions"] = m_run_received_decisions.load();
+  summary["sent_decisions"] = m_run_sent_decisions.load();
+  summary["received_tokens"] = m_run_received_tokens.load();
+  summary["incomplete_decisions"] = incomplete_decisions;
+  summary["decision_rate_Hz"] = RunSummary::rate(m_run_received_decisions.load(), run_time);
+  summary["decision_handling_time"] = RunSummary::summarise(m_decision_handling_time);
+  auto token_latency = m_token_latency;
+  token_latency += m_batch_token_latency;
+  summary["decision_to_token_latency"] = RunSummary::summarise(token_latency);
+  summary["dispatch_retries"] = m_dispatch_retries.load();
+  summary["busy_transitions"] = m_busy_transitions.load();
+  summary["busy_time_s"] = std::chrono::duration<double>(busy_time).count();
+  summary["load_reports"] = m_load_reports.load();
+  summary["token_batches"] = m_token_batches.load();
+
+  RunSummary::get().add_section(m_run_number, get_name(), summary);
+}
+
 void
 DataFlowOrchestrator::assign_trigger_decision(const std::shared_ptr<AssignedTriggerDecision>& assignment)
 {
@@ -11,6 +11,10 @@
 
 #include "dfmodules/datafloworchestrator/Structs.hpp"
 
+#include "dfmodules/DataflowLoadReport.hpp"
+#include "dfmodules/EventTrace.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/TriggerDecisionTokenBatch.hpp"
 #include "dfmodules/TriggerRecordBuilderData.hpp"
 
 #include "daqdataformats/TriggerRecord.hpp"
@@ -102,15 +106,20 @@ private:
   void do_start(const data_t&);
   void do_stop(const data_t&);
   void do_scrap(const data_t&);
+  void do_dump_event_trace(const data_t&);
 
   void get_info(opmonlib::InfoCollector& ci, int level) override;
 
   virtual void receive_trigger_complete_token(const dfmessages::TriggerDecisionToken&);
+  void receive_load_report(const DataflowLoadReport&);
+  void update_bandwidth_weights();
+  void receive_token_batch(const TriggerDecisionTokenBatch&);
   void receive_trigger_decision(const dfmessages::TriggerDecision&);
   virtual bool is_busy() const;
   bool is_empty() const;
   size_t used_slots() const;
   void notify_trigger(bool busy) const;
+  void write_run_summary(size_t incomplete_decisions);
   bool dispatch(const std::shared_ptr<AssignedTriggerDecision>& assignment);
   virtual void assign_trigger_decision(const std::shared_ptr<AssignedTriggerDecision>& assignment);
 
@@ -123,12 +132,16 @@ private:
   std::shared_ptr<iomanager::SenderConcept<dfmessages::TriggerInhibit>> m_busy_sender;
   iomanager::connection::ConnectionRef m_token_connection;
   iomanager::connection::ConnectionRef m_td_connection;
+  iomanager::connection::ConnectionRef m_load_report_connection; ///< optional, empty uid if absent
+  iomanager::connection::ConnectionRef m_token_batch_connection;  ///< optional, empty uid if absent
   size_t m_td_send_retries;
+  bool m_bandwidth_weighting{ false };
 
   // Coordination
   std::atomic<bool> m_running_status{ false };
   mutable std::atomic<bool> m_last_notified_busy{ false };
   std::chrono::steady_clock::time_point m_last_token_received;
+  std::chrono::steady_clock::time_point m_last_token_batch_received;
   std::chrono::steady_clock::time_point m_last_td_received;
 
   // Statistics
@@ -140,6 +153,25 @@ private:
   std::atomic<uint64_t> m_forwarding_decision{ 0 };  // NOLINT (build/unsigned)
   std::atomic<uint64_t> m_waiting_for_token{ 0 };    // NOLINT (build/unsigned)
   std::atomic<uint64_t> m_processing_token{ 0 };     // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_received_load_reports{ 0 }; // NOLINT (build/unsigned)
+
+  // end of run statistics; each histogram is filled by a single callback thread
+  std::chrono::steady_clock::time_point m_run_start;
+  LatencyHistogram m_decision_handling_time;
+  LatencyHistogram m_token_latency;
+  LatencyHistogram m_batch_token_latency;
+  std::atomic<uint64_t> m_run_received_decisions{ 0 }; // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_run_sent_decisions{ 0 };     // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_run_received_tokens{ 0 };    // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_dispatch_retries{ 0 };       // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_load_reports{ 0 };           // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_token_batches{ 0 };          // NOLINT (build/unsigned)
+  mutable std::atomic<uint64_t> m_busy_transitions{ 0 }; // NOLINT (build/unsigned)
+  mutable std::atomic<int64_t> m_busy_since{ 0 };         // steady_clock ticks
+  mutable std::atomic<int64_t> m_busy_time{ 0 };          // steady_clock ticks
+
+  // Event trace
+  uint16_t m_trace_source;
 };
 } // namespace dfmodules
 } // namespace dunedaq
@@ -8,10 +8,14 @@
 
 #include "DataWriter.hpp"
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/RunSummary.hpp"
 #include "dfmodules/datawriter/Nljs.hpp"
 #include "dfmodules/datawriterinfo/InfoNljs.hpp"
+#include "dfmodules/sheddinginfo/InfoNljs.hpp"
+#include "dfmodules/storageselectioninfo/InfoNljs.hpp"
 
 #include "appfwk/DAQModuleHelper.hpp"
+#include "appfwk/app/Nljs.hpp"
 #include "daqdataformats/Fragment.hpp"
 #include "dfmessages/TriggerDecision.hpp"
 #include "logging/Logging.hpp"
@@ -20,6 +24,7 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
@@ -59,11 +64,22 @@ DataWriter::DataWriter(const std::string& name)
   , m_queue_timeout(100)
   , m_data_storage_is_enabled(true)
   , m_thread(std::bind(&DataWriter::do_work, this, std::placeholders::_1))
+  , m_trace_source(EventTrace::get().register_source(name))
 {
   register_command("conf", &DataWriter::do_conf);
   register_command("start", &DataWriter::do_start);
   register_command("stop", &DataWriter::do_stop);
   register_command("scrap", &DataWriter::do_scrap);
+  register_command("dump_event_trace", &DataWriter::do_dump_event_trace);
+}
+
+DataWriter::~DataWriter()
+{
+  if (m_write_thread.joinable()) {
+    m_write_queue.close();
+    m_write_thread.join();
+  }
+  wait_for_finalisation();
 }
 
 void
@@ -76,12 +92,22 @@ DataWriter::init(const data_t& init_data)
   // try to create the receiver to see test the connection anyway
   m_tr_receiver = iom -> get_receiver<std::unique_ptr<daqdataformats::TriggerRecord>>(m_trigger_record_connection);
   m_token_output = iom-> get_sender<dfmessages::TriggerDecisionToken>(qi["token_output"]);
+
+  // the load reports to the DFO are optional
+  auto ini = init_data.get<appfwk::app::ModInit>();
+  for (const auto& ref : ini.conn_refs) {
+    if (ref.name == "load_report_output") {
+      m_load_report_output = iom->get_sender<DataflowLoadReport>(ref);
+    } else if (ref.name == "token_batch_output") {
+      m_token_batch_output = iom->get_sender<TriggerDecisionTokenBatch>(ref);
+    }
+  }
   
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
 }
 
 void
-DataWriter::get_info(opmonlib::InfoCollector& ci, int /*level*/)
+DataWriter::get_info(opmonlib::InfoCollector& ci, int level)
 {
   datawriterinfo::Info dwi;
 
@@ -91,8 +117,51 @@ DataWriter::get_info(opmonlib::InfoCollector& ci, int /*level*/)
   dwi.new_records_written = m_records_written.exchange(0);
   dwi.bytes_output = m_bytes_output_tot.load();
   dwi.new_bytes_output = m_bytes_output.exchange(0);
+  dwi.finalisations_in_progress = m_finalisations_in_progress.load();
+  dwi.late_records_written = m_late_records_written.load();
+  dwi.write_queue_depth = m_write_queue.size();
+  daqdataformats::trigger_number_t checkpoint = 0;
+  dwi.durable_trigger_number = m_write_queue.last_checkpoint(checkpoint) ? checkpoint : 0;
+  dwi.records_lost_after_token = m_records_lost_after_token.load();
+  dwi.storage_bandwidth = m_storage_probe.bandwidth();
+  dwi.storage_probe_record_time =
+    std::chrono::duration_cast<std::chrono::microseconds>(m_storage_probe.mean_record_time()).count();
+
+  // one object per trigger type with a rule, holding the information of each of its rules
+  std::map<daqdataformats::trigger_type_t, opmonlib::InfoCollector> type_collectors;
+  m_selection.for_each([&](daqdataformats::trigger_type_t trigger_type, const StorageSelection::Counters& counters) {
+    storageselectioninfo::Info info;
+    info.records_stored = counters.records_stored.load();
+    info.records_prescaled = counters.records_prescaled.load();
+    info.fragments_removed = counters.fragments_removed.load();
+    info.bytes_removed = counters.bytes_removed.load();
+    type_collectors[trigger_type].add(info);
+  });
+  m_shedding.for_each([&](daqdataformats::trigger_type_t trigger_type, const LoadSheddingPolicy::Counters& counters) {
+    sheddinginfo::Info info;
+    info.dropped_records = counters.dropped.load();
+    info.header_only_records = counters.header_only.load();
+    info.abandoned_retries = counters.abandoned_retries.load();
+    dwi.shed_records += info.dropped_records + info.header_only_records;
+    type_collectors[trigger_type].add(info);
+  });
 
   ci.add(dwi);
+
+  for (auto& [trigger_type, tmp_ic] : type_collectors) {
+    ci.add("trigger_type_" + std::to_string(trigger_type), tmp_ic);
+  }
+
+  opmonlib::InfoCollector store_ic;
+  {
+    auto lk = std::lock_guard<std::mutex>(m_data_store_mutex);
+    if (m_data_writer) {
+      m_data_writer->get_info(store_ic, level);
+    }
+  }
+  if (!store_ic.is_empty()) {
+    ci.add("data_store", store_ic);
+  }
 }
 void
 DataWriter::do_conf(const data_t& payload)
@@ -101,6 +170,9 @@ DataWriter::do_conf(const data_t& payload)
 
   datawriter::ConfParams conf_params = payload.get<datawriter::ConfParams>();
   m_data_storage_prescale = conf_params.data_storage_prescale;
+  if (conf_params.data_store_parameters.contains("directory_path")) {
+    RunSummary::get().set_output_directory(conf_params.data_store_parameters["directory_path"].get<std::string>());
+  }
   TLOG_DEBUG(TLVL_CONFIG) << get_name() << ": data_storage_prescale is " << m_data_storage_prescale;
   TLOG_DEBUG(TLVL_CONFIG) << get_name() << ": data_store_parameters are " << conf_params.data_store_parameters;
   m_min_write_retry_time_usec = conf_params.min_write_retry_time_usec;
@@ -110,10 +182,63 @@ DataWriter::do_conf(const data_t& payload)
   m_max_write_retry_time_usec = conf_params.max_write_retry_time_usec;
   m_write_retry_time_increase_factor = conf_params.write_retry_time_increase_factor;
   m_trigger_decision_connection = conf_params.decision_connection;
+  try {
+    m_thread_placement = ThreadPlacement(conf_params.thread_cpu_list, conf_params.thread_numa_node);
+  } catch (const InvalidCPUList& excpt) {
+    throw UnableToConfigure(ERS_HERE, get_name(), excpt);
+  }
+  m_background_finalisation = conf_params.background_finalisation;
+  m_finalisation_grace = std::chrono::milliseconds(conf_params.finalisation_grace_ms);
+  m_write_queue_size = conf_params.early_token_queue_size > 0 ? conf_params.early_token_queue_size : 0;
+  m_checkpoint_interval = std::chrono::milliseconds(conf_params.durability_checkpoint_interval_ms);
+  m_stop_drain_timeout = std::chrono::milliseconds(conf_params.stop_drain_timeout_ms);
+  m_selection.clear();
+  for (const auto& entry : conf_params.storage_rules) {
+    StorageRule rule;
+    rule.prescale = entry.prescale > 0 ? entry.prescale : 0;
+    for (const auto& system : entry.subsystems) {
+      auto subsystem = daqdataformats::SourceID::string_to_subsystem(system);
+      if (subsystem == daqdataformats::SourceID::Subsystem::kUnknown) {
+        throw InvalidSystemType(ERS_HERE, system);
+      }
+      rule.subsystems.insert(subsystem);
+    }
+    for (const auto& source : entry.source_ids) {
+      auto subsystem = daqdataformats::SourceID::string_to_subsystem(source.system);
+      if (subsystem == daqdataformats::SourceID::Subsystem::kUnknown) {
+        throw InvalidSystemType(ERS_HERE, source.system);
+      }
+      rule.source_ids.emplace(subsystem, source.source_id);
+    }
+    TLOG_DEBUG(TLVL_CONFIG) << get_name() << ": trigger type " << entry.trigger_type << " stored with prescale "
+                            << rule.prescale << (rule.keeps_all() ? "" : ", thinned to an allowlist");
+    m_selection.add_rule(entry.trigger_type, std::move(rule));
+  }
+  m_shedding.clear();
+  for (const auto& rule : conf_params.shedding_rules) {
+    m_shedding.add_rule(rule.trigger_type, rule.prescale > 0 ? rule.prescale : 0, rule.header_only);
+  }
+  m_shedding_threshold =
+    conf_params.shedding_backlog_threshold > 0 && !m_shedding.empty() ? conf_params.shedding_backlog_threshold : 0;
+  m_shedding_hold_time = std::chrono::milliseconds(conf_params.shedding_hold_ms);
+  if (m_write_queue_size > 0) {
+    TLOG() << get_name() << ": tokens released once the records are queued for writing, up to "
+           << m_write_queue_size << " records";
+  }
+  m_load_report_interval = std::chrono::milliseconds(conf_params.load_report_interval_ms);
+  m_token_batch_size = m_token_batch_output && conf_params.token_batch_size > 1 ? conf_params.token_batch_size : 0;
+  m_token_batch_timeout = std::chrono::milliseconds(conf_params.token_batch_timeout_ms);
+  if (m_token_batch_size > 0) {
+    TLOG() << get_name() << ": tokens sent in batches of up to " << m_token_batch_size << ", or every "
+           << m_token_batch_timeout.count() << " ms";
+  }
+  m_data_store_parameters = payload["data_store_parameters"];
 
   // create the DataStore instance here
   try {
-    m_data_writer = make_data_store(payload["data_store_parameters"]);
+    auto data_store = make_data_store(m_data_store_parameters);
+    auto lk = std::lock_guard<std::mutex>(m_data_store_mutex);
+    m_data_writer = std::move(data_store);
   } catch (const ers::Issue& excpt) {
     throw UnableToConfigure(ERS_HERE, get_name(), excpt);
   }
@@ -123,6 +248,18 @@ DataWriter::do_conf(const data_t& payload)
     throw InvalidDataWriter(ERS_HERE, get_name());
   }
 
+  // background finalisation closes the files of a run while the DataStore
+  // of the next run writes, which the DataStore must allow
+  if (m_background_finalisation && !m_data_writer->allows_concurrent_instances()) {
+    ers::warning(BackgroundFinalisationUnavailable(ERS_HERE, get_name()));
+    m_background_finalisation = false;
+  }
+
+  m_storage_probe = StorageProbeResult();
+  if (conf_params.storage_probe_bytes > 0) {
+    probe_storage(conf_params.storage_probe_bytes, conf_params.storage_probe_record_bytes);
+  }
+
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
 }
 
@@ -165,11 +302,30 @@ DataWriter::do_start(const data_t& payload)
   m_bytes_output = 0;
   m_bytes_output_tot = 0;
   m_tokens_sent = 0;
+  m_token_batches_sent = 0;
+  m_token_batch.run_number = m_run_number;
+  m_token_batch.decision_destination = m_trigger_decision_connection;
+  m_token_batch.trigger_numbers.clear();
+
+  m_run_stats = RunStatistics();
+  m_run_stats.start = std::chrono::steady_clock::now();
+  m_last_start_time = m_run_stats.start;
+  m_last_load_report = m_run_stats.start;
+  m_bytes_at_last_report = 0;
 
-  writing_time_tot = 0;
+  m_records_lost_after_token = 0;
+  m_selection.reset();
+  m_shedding.reset();
+  m_write_stalled = false;
+  m_last_write_refusal = std::chrono::steady_clock::time_point();
 
   m_running.store(true);
 
+  m_early_tokens = m_data_storage_is_enabled && m_write_queue_size > 0;
+  if (m_early_tokens) {
+    m_write_queue.open(m_write_queue_size);
+    m_write_thread = std::thread(&DataWriter::do_write, this);
+  }
   m_thread.start_working_thread(get_name());
   //iomanager::IOManager::get()->add_callback<std::unique_ptr<daqdataformats::TriggerRecord>>( m_trigger_record_connection,
   //											     bind( &DataWriter::receive_trigger_record, this, std::placeholders::_1) );
@@ -183,32 +339,61 @@ DataWriter::do_stop(const data_t& /*args*/)
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_stop() method";
 
+  m_drain_deadline = std::chrono::steady_clock::now() + m_stop_drain_timeout;
   m_running.store(false);
   m_thread.stop_working_thread(); 
+
+  // the records still queued, whose token is gone, are retried until the
+  // drain deadline, after which each gets a single write attempt
+  if (m_write_thread.joinable()) {
+    m_write_queue.close();
+    m_write_thread.join();
+  }
   //iomanager::IOManager::get()->remove_callback<std::unique_ptr<daqdataformats::TriggerRecord>>( m_trigger_record_connection );
 
   // 04-Feb-2021, KAB: added this call to allow DataStore to finish up with this run.
   // I've put this call fairly late in this method so that any draining of queues
   // (or whatever) can take place before we finalize things in the DataStore.
-  if (m_data_storage_is_enabled) {
+  if (m_data_storage_is_enabled && m_background_finalisation) {
+    hand_over_to_finalisation();
+  } else if (m_data_storage_is_enabled) {
+    auto finish_start = std::chrono::steady_clock::now();
     try {
       m_data_writer->finish_with_run(m_run_number);
     } catch (const std::exception& excpt) {
       ers::error(ProblemDuringStop(ERS_HERE, get_name(), m_run_number, excpt));
     }
+    m_run_stats.finish_time = std::chrono::steady_clock::now() - finish_start;
   }
 
+  EventTrace::get().dump(m_trace_source, get_name() + "_run" + std::to_string(m_run_number));
+  write_run_summary();
+
   TLOG() << get_name() << ": Successfully stopped for run number " << m_run_number;
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
 }
 
+void
+DataWriter::do_dump_event_trace(const data_t& /*args*/)
+{
+  EventTrace::get().dump(m_trace_source, get_name());
+}
+
 void
 DataWriter::do_scrap(const data_t& /*payload*/)
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_scrap() method";
 
+  wait_for_finalisation();
+  m_previous_run.reset();
+
   // clear/reset the DataStore instance here
-  m_data_writer.reset();
+  std::unique_ptr<DataStore> data_store;
+  {
+    auto lk = std::lock_guard<std::mutex>(m_data_store_mutex);
+    data_store = std::move(m_data_writer);
+  }
+  data_store.reset();
 
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_scrap() method";
 }
@@ -220,6 +405,10 @@ DataWriter::receive_trigger_record(std::unique_ptr<daqdataformats::TriggerRecord
 
   ++m_records_received;
   ++m_records_received_tot;
+  EventTrace::record(TraceEventType::kReceive,
+                     m_trace_source,
+                     trigger_record_ptr->get_header_ref().get_trigger_number(),
+                     trigger_record_ptr->get_header_ref().get_sequence_number());
   TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Obtained the TriggerRecord for trigger number "
 			      << trigger_record_ptr->get_header_ref().get_trigger_number() << "."
 			      << trigger_record_ptr->get_header_ref().get_sequence_number()
@@ -227,75 +416,74 @@ DataWriter::receive_trigger_record(std::unique_ptr<daqdataformats::TriggerRecord
 			      << " off the input connection";
 
   if (trigger_record_ptr->get_header_ref().get_run_number() != m_run_number) {
+    // records of a run being finalised in the background are still written,
+    // but no token is sent for them since the DFO has moved on to the new run
+    if (write_to_previous_run(*trigger_record_ptr)) {
+      return;
+    }
     ers::error(InvalidRunNumber(ERS_HERE, get_name(), "TriggerRecord", trigger_record_ptr->get_header_ref().get_run_number(),
                                 m_run_number, trigger_record_ptr->get_header_ref().get_trigger_number(),
                                 trigger_record_ptr->get_header_ref().get_sequence_number()));
     return;
   }
 
-  // 03-Feb-2021, KAB: adding support for a data-storage prescale.
-  // In this "if" statement, I deliberately compare the result of (N mod prescale) to 1
-  // instead of zero, since I think that it would be nice to always get the first event
-  // written out.
-  if (m_data_storage_prescale <= 1 || ((m_records_received_tot.load() % m_data_storage_prescale) == 1)) {
-    
-    if (m_data_storage_is_enabled) {
-      
-      bool should_retry = true;
-      size_t retry_wait_usec = m_min_write_retry_time_usec;
-      do {
-	should_retry = false;
-	try {
-TLOG() << get_name() << ": Writing started for trigger record number: " << m_records_received_tot;
-double_t start_writing_timestamp = std::chrono::duration_cast<std::chrono::microseconds>(system_clock::now().time_since_epoch()).count();
-	  m_data_writer->write(*trigger_record_ptr);
-double_t stop_writing_timestamp = std::chrono::duration_cast<std::chrono::microseconds>(system_clock::now().time_since_epoch()).count();
-TLOG() << get_name() << ": Writing stopped for trigger record number: " << m_records_received_tot;
-	  ++m_records_written;
-	  ++m_records_written_tot;
-TLOG() << get_name() << ": Number of written trigger records: " << m_records_written_tot;
-    m_bytes_for_one_tr = 0;
-    m_bytes_for_one_tr += trigger_record_ptr->get_total_size_bytes();
-	  m_bytes_output += trigger_record_ptr->get_total_size_bytes();
-	  m_bytes_output_tot += trigger_record_ptr->get_total_size_bytes();
-
-double_t writing_time = stop_writing_timestamp - start_writing_timestamp;
-TLOG() << get_name() << ": Writing time is: " << writing_time << " microseconds";
-writing_time_tot += writing_time;
-
-double_t writing_rate = m_bytes_for_one_tr/writing_time;
-TLOG() << get_name() << ": Writing rate is: " << writing_rate << " MB/s";
-average_writing_rate =  m_bytes_output_tot/writing_time_tot;
-
-	} catch (const RetryableDataStoreProblem& excpt) {
-	  should_retry = true;
-	  ers::error(DataWritingProblem(ERS_HERE,
-					get_name(),
-					trigger_record_ptr->get_header_ref().get_trigger_number(),
-					trigger_record_ptr->get_header_ref().get_sequence_number(),
-					trigger_record_ptr->get_header_ref().get_run_number(),
-					excpt));
-	  if (retry_wait_usec > m_max_write_retry_time_usec) {
-	    retry_wait_usec = m_max_write_retry_time_usec;
-	  }
-	  usleep(retry_wait_usec);
-	  retry_wait_usec *= m_write_retry_time_increase_factor;
-	} catch (const std::exception& excpt) {
-	  ers::error(DataWritingProblem(ERS_HERE,
-					get_name(),
-					trigger_record_ptr->get_header_ref().get_trigger_number(),
-					trigger_record_ptr->get_header_ref().get_sequence_number(),
-					trigger_record_ptr->get_header_ref().get_run_number(),
-					excpt));
-	}
-      } while (should_retry && m_running.load());
+  // the record may be handed over to the write thread below
+  daqdataformats::trigger_number_t trigger_number = trigger_record_ptr->get_header_ref().get_trigger_number();
+  auto max_sequence_number = trigger_record_ptr->get_header_ref().get_max_sequence_number();
+
+  bool selected = false;
+  auto trigger_type = trigger_record_ptr->get_header_ref().get_trigger_type();
+  if (m_selection.has_rule(trigger_type)) {
+    // the prescale of the trigger type, and the thinning of the record to
+    // its allowlisted components, in place
+    selected = m_selection.select(trigger_type, *trigger_record_ptr);
+  } else {
+    // 03-Feb-2021, KAB: adding support for a data-storage prescale.
+    // In this "if" statement, I deliberately compare the result of (N mod prescale) to 1
+    // instead of zero, since I think that it would be nice to always get the first event
+    // written out.
+    selected = m_data_storage_prescale <= 1 || ((m_records_received_tot.load() % m_data_storage_prescale) == 1);
+  }
+  if (selected) {
+
+    bool to_be_written = m_data_storage_is_enabled;
+    if (to_be_written && under_backlog()) {
+      // the token is sent for shed records too, so they do not hold the trigger back
+      switch (m_shedding.decide(trigger_type)) {
+        case SheddingAction::kDrop:
+          TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Dropping trigger record " << trigger_number
+                                      << " to catch up with the backlog";
+          to_be_written = false;
+          break;
+        case SheddingAction::kHeaderOnly:
+          trigger_record_ptr->get_fragments_ref().clear();
+          trigger_record_ptr->get_header_ref().set_error_bit(daqdataformats::TriggerRecordErrorBits::kIncomplete, true);
+          break;
+        case SheddingAction::kKeep:
+          break;
+      }
+    }
+
+    if (to_be_written && m_early_tokens) {
+      // the token is released as soon as the write thread has accepted the
+      // record; a full queue holds the token back like a slow write would
+      auto wait_start = std::chrono::steady_clock::now();
+      if (!m_write_queue.push(trigger_record_ptr)) {
+        write_trigger_record(*trigger_record_ptr);
+      }
+      auto waited = std::chrono::steady_clock::now() - wait_start;
+      if (waited > m_queue_timeout) {
+        m_run_stats.stalled_time += waited;
+      }
+    } else if (to_be_written) {
+      write_trigger_record(*trigger_record_ptr);
     }
   }
   
   bool send_trigger_complete_message = true;
-  if (trigger_record_ptr->get_header_ref().get_max_sequence_number() > 0) {
+  if (max_sequence_number > 0) {
     send_trigger_complete_message = false;
-    daqdataformats::trigger_number_t trigno = trigger_record_ptr->get_header_ref().get_trigger_number();
+    daqdataformats::trigger_number_t trigno = trigger_number;
     if (m_seqno_counts.count(trigno) > 0) {
       ++m_seqno_counts[trigno];
     } else {
@@ -303,7 +491,7 @@ average_writing_rate =  m_bytes_output_tot/writing_time_tot;
     }
     // in the following comparison GT (>) is used since the counts are one-based and the
     // max sequence number is zero-based.
-    if (m_seqno_counts[trigno] > trigger_record_ptr->get_header_ref().get_max_sequence_number()) {
+    if (m_seqno_counts[trigno] > max_sequence_number) {
       send_trigger_complete_message = true;
       m_seqno_counts.erase(trigno);
     } else {
@@ -315,36 +503,172 @@ average_writing_rate =  m_bytes_output_tot/writing_time_tot;
 					  << "in the seqno map is " << m_seqno_counts.size() << ").";
     }
   }
-  if (send_trigger_complete_message) {
-    TLOG() << get_name() << ": Pushing the TriggerDecisionToken for trigger number "
-				<< trigger_record_ptr->get_header_ref().get_trigger_number()
+  if (send_trigger_complete_message && m_token_batch_size > 0) {
+    if (m_token_batch.trigger_numbers.empty()) {
+      m_token_batch_start = std::chrono::steady_clock::now();
+    }
+    m_token_batch.trigger_numbers.push_back(trigger_number);
+    flush_token_batch(false);
+    send_load_report(false, 0);
+  } else if (send_trigger_complete_message) {
+    TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Pushing the TriggerDecisionToken for trigger number "
+				<< trigger_number
 				<< " onto the relevant output queue";
     dfmessages::TriggerDecisionToken token;
     token.run_number = m_run_number;
-    token.trigger_number = trigger_record_ptr->get_header_ref().get_trigger_number();
+    token.trigger_number = trigger_number;
     token.decision_destination = m_trigger_decision_connection;
 
     bool wasSentSuccessfully = false;
+    auto send_start = std::chrono::steady_clock::now();
     do { 
       try {
 	m_token_output -> send( std::move(token), m_queue_timeout );
+	EventTrace::record(TraceEventType::kSend, m_trace_source, trigger_number);
 	wasSentSuccessfully = true;
-  ++m_tokens_sent;
-  TLOG() << get_name() << ": Token number: " << m_tokens_sent << " has been sent.";
+	++m_tokens_sent;
       } catch (const ers::Issue& excpt) {
+	EventTrace::record(TraceEventType::kRetry, m_trace_source, trigger_number);
+	++m_run_stats.token_send_retries;
 	std::ostringstream oss_warn;
 	oss_warn << "Send with sender \"" << m_token_output -> get_name() << "\" failed";
 	ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
       }
     } while (!wasSentSuccessfully && m_running.load());
 
+    auto send_time = std::chrono::steady_clock::now() - send_start;
+    m_run_stats.token_send_time.record(send_time);
+    if (send_time > m_queue_timeout) {
+      m_run_stats.stalled_time += send_time;
+    }
+
+    send_load_report(false, 0);
   }
   
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Operations completed for TR";
 } // NOLINT(readability/fn_size)
 
+void
+DataWriter::hand_over_to_finalisation()
+{
+  // only one run is finalised in the background at any time
+  wait_for_finalisation();
+
+  auto previous = std::make_shared<PreviousRun>();
+  previous->run_number = m_run_number;
+  {
+    auto lk = std::lock_guard<std::mutex>(m_data_store_mutex);
+    previous->data_store = std::move(m_data_writer);
+  }
+  previous->grace = m_finalisation_grace;
+  previous->stop = previous->last_record = std::chrono::steady_clock::now();
+
+  // the next run writes with a fresh DataStore
+  try {
+    auto data_store = make_data_store(m_data_store_parameters);
+    auto lk = std::lock_guard<std::mutex>(m_data_store_mutex);
+    m_data_writer = std::move(data_store);
+  } catch (const ers::Issue& excpt) {
+    ers::error(ProblemDuringStop(ERS_HERE, get_name(), m_run_number, excpt));
+  }
+
+  m_previous_run = previous;
+  ++m_finalisations_in_progress;
+  m_finalisation_thread = std::thread(&DataWriter::finalise_previous_run, this, previous);
+  TLOG() << get_name() << ": Files of run " << m_run_number << " are being finalised in the background";
+}
+
+void
+DataWriter::finalise_previous_run(std::shared_ptr<PreviousRun> previous)
+{
+  // wait until the records of the run that were still on their way have arrived
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lk(previous->mutex);
+      if (std::chrono::steady_clock::now() - previous->last_record >= previous->grace) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::chrono::steady_clock::duration finish_time{ 0 };
+  size_t late_records = 0;
+  {
+    std::lock_guard<std::mutex> lk(previous->mutex);
+    auto finish_start = std::chrono::steady_clock::now();
+    try {
+      previous->data_store->finish_with_run(previous->run_number);
+    } catch (const std::exception& excpt) {
+      ers::error(ProblemDuringStop(ERS_HERE, get_name(), previous->run_number, excpt));
+    }
+    previous->data_store.reset();
+    previous->finished = true;
+    finish_time = std::chrono::steady_clock::now() - finish_start;
+    late_records = previous->late_records;
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point next_start = m_last_start_time;
+  std::chrono::steady_clock::duration overlap{ 0 };
+  if (next_start > previous->stop) {
+    overlap = end - next_start;
+  }
+
+  nlohmann::json summary;
+  summary["finalisation_time_s"] = std::chrono::duration<double>(end - previous->stop).count();
+  summary["finish_time_s"] = std::chrono::duration<double>(finish_time).count();
+  summary["overlap_with_next_run_s"] = std::chrono::duration<double>(overlap).count();
+  summary["late_records_written"] = late_records;
+  RunSummary::get().add_section(previous->run_number, get_name() + "_finalisation", summary);
+
+  --m_finalisations_in_progress;
+  TLOG() << get_name() << ": Files of run " << previous->run_number << " finalised in the background, "
+         << late_records << " late records written";
+}
+
+void
+DataWriter::wait_for_finalisation()
+{
+  if (m_finalisation_thread.joinable()) {
+    m_finalisation_thread.join();
+  }
+}
+
+bool
+DataWriter::write_to_previous_run(daqdataformats::TriggerRecord& record)
+{
+  auto previous = m_previous_run;
+  if (!previous || previous->run_number != record.get_header_ref().get_run_number()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lk(previous->mutex);
+  if (previous->finished) {
+    return false;
+  }
+
+  try {
+    previous->data_store->write(record);
+    ++previous->late_records;
+    ++m_late_records_written;
+    m_bytes_output += record.get_total_size_bytes();
+    m_bytes_output_tot += record.get_total_size_bytes();
+  } catch (const std::exception& excpt) {
+    ers::error(DataWritingProblem(ERS_HERE,
+                                  get_name(),
+                                  record.get_header_ref().get_trigger_number(),
+                                  record.get_header_ref().get_sequence_number(),
+                                  record.get_header_ref().get_run_number(),
+                                  excpt));
+  }
+  previous->last_record = std::chrono::steady_clock::now();
+  return true;
+}
+
 void
 DataWriter::do_work(std::atomic<bool>& running_flag) {
+  m_thread_placement.apply_to_current_thread(get_name());
   while (running_flag.load()) {
 	  try {
 		std::unique_ptr<daqdataformats::TriggerRecord> tr = m_tr_receiver-> receive(std::chrono::milliseconds(10));   
@@ -352,13 +676,354 @@ DataWriter::do_work(std::atomic<bool>& running_flag) {
     TLOG_DEBUG(TLVL_RECEIVE_TR) << get_name() << ": Received a new TR";
 	  }
 	  catch(const iomanager::TimeoutExpired& excpt) {
+		flush_token_batch(false);
+		send_load_report(false, 0);
 	  }
 	  catch(const ers::Issue & excpt) {
 		ers::warning(excpt);
 	  }
   }
-//TLOG() << get_name() << ": A hdf5 file of size: " << m_bytes_output_tot << " bytes has been created with the average writing rate: "
-//    	 << average_writing_rate << " The file contains " << m_records_written_tot;  
+  flush_token_batch(true);
+  m_run_stats.stop = std::chrono::steady_clock::now();
+}
+
+DataWriter::WriteOutcome
+DataWriter::write_trigger_record(daqdataformats::TriggerRecord& record, bool token_sent)
+{
+  auto& header = record.get_header_ref();
+  auto outcome = WriteOutcome::kFailed;
+  bool should_retry = true;
+  bool stalled = false;
+  size_t retry_wait_usec = m_min_write_retry_time_usec;
+  do {
+    should_retry = false;
+    try {
+      EventTrace::record(
+        TraceEventType::kWriteBegin, m_trace_source, header.get_trigger_number(), header.get_sequence_number());
+      auto write_start = std::chrono::steady_clock::now();
+      m_data_writer->write(record);
+      m_run_stats.write_time.record(std::chrono::steady_clock::now() - write_start);
+      EventTrace::record(
+        TraceEventType::kWriteEnd, m_trace_source, header.get_trigger_number(), record.get_total_size_bytes() >> 10);
+      ++m_records_written;
+      ++m_records_written_tot;
+      m_bytes_output += record.get_total_size_bytes();
+      m_bytes_output_tot += record.get_total_size_bytes();
+      outcome = WriteOutcome::kWritten;
+      TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Wrote trigger record " << header.get_trigger_number() << "."
+                                  << header.get_sequence_number() << ", " << m_records_written_tot
+                                  << " records written so far";
+
+    } catch (const RetryableDataStoreProblem& excpt) {
+      should_retry = true;
+      stalled = true;
+      m_write_stalled = true;
+      m_last_write_refusal = std::chrono::steady_clock::now();
+      ++m_run_stats.write_retries;
+      EventTrace::record(TraceEventType::kWriteEnd, m_trace_source, header.get_trigger_number());
+      EventTrace::record(TraceEventType::kRetry, m_trace_source, header.get_trigger_number());
+      ers::error(DataWritingProblem(ERS_HERE,
+                                    get_name(),
+                                    header.get_trigger_number(),
+                                    header.get_sequence_number(),
+                                    header.get_run_number(),
+                                    excpt));
+      // a record that may be shed is not worth blocking the others for
+      if (m_shedding_threshold > 0 && m_shedding.sheddable(header.get_trigger_type())) {
+        m_shedding.count_abandoned_retry(header.get_trigger_type());
+        outcome = WriteOutcome::kShed;
+        should_retry = false;
+        break;
+      }
+      if (retry_wait_usec > m_max_write_retry_time_usec) {
+        retry_wait_usec = m_max_write_retry_time_usec;
+      }
+      // no token leaves while the storage refuses the data, tell the DFO why
+      send_load_report(true, record.get_total_size_bytes());
+      usleep(retry_wait_usec);
+      m_run_stats.write_stalled_time += std::chrono::microseconds(retry_wait_usec);
+      retry_wait_usec *= m_write_retry_time_increase_factor;
+    } catch (const std::exception& excpt) {
+      EventTrace::record(TraceEventType::kWriteEnd, m_trace_source, header.get_trigger_number());
+      ++m_run_stats.write_failures;
+      ers::error(DataWritingProblem(ERS_HERE,
+                                    get_name(),
+                                    header.get_trigger_number(),
+                                    header.get_sequence_number(),
+                                    header.get_run_number(),
+                                    excpt));
+    }
+  } while (should_retry &&
+           (m_running.load() || (token_sent && std::chrono::steady_clock::now() < m_drain_deadline.load())));
+
+  if (stalled) {
+    m_write_stalled = false;
+    send_load_report(false, 0, true);
+  }
+
+  return outcome;
+}
+
+bool
+DataWriter::under_backlog() const
+{
+  if (m_shedding_threshold == 0) {
+    return false;
+  }
+  if (m_write_stalled.load() || (m_early_tokens && m_write_queue.size() >= m_shedding_threshold)) {
+    return true;
+  }
+  // without early tokens the retries are over by the time the next record
+  // arrives, a recent refusal is what tells that the storage is struggling
+  auto last_refusal = m_last_write_refusal.load();
+  return last_refusal != std::chrono::steady_clock::time_point() &&
+         std::chrono::steady_clock::now() - last_refusal < m_shedding_hold_time;
+}
+
+void
+DataWriter::do_write()
+{
+  m_thread_placement.apply_to_current_thread(get_name() + "-write");
+
+  // the data store may buffer what it is given: the records written since
+  // the last flush only reach the checkpoint once the data store is flushed
+  auto last_checkpoint = std::chrono::steady_clock::now();
+  bool unflushed = false;
+  daqdataformats::trigger_number_t last_written = 0;
+  RecordWriteQueue::record_ptr_t record;
+  while (m_write_queue.pop(record)) {
+    switch (write_trigger_record(*record, true)) {
+      case WriteOutcome::kWritten:
+        unflushed = true;
+        last_written = record->get_header_ref().get_trigger_number();
+        break;
+      case WriteOutcome::kShed:
+        // given up on purpose, and counted as such: the checkpoint moves on
+        // with the next record written
+        break;
+      case WriteOutcome::kFailed:
+        // the token of this record is already gone
+        flush_to_checkpoint(unflushed, last_written);
+        m_write_queue.break_checkpoint();
+        ++m_records_lost_after_token;
+        break;
+    }
+    record.reset();
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_checkpoint >= m_checkpoint_interval) {
+      last_checkpoint = now;
+      flush_to_checkpoint(unflushed, last_written);
+      report_checkpoint();
+    }
+  }
+  flush_to_checkpoint(unflushed, last_written);
+  report_checkpoint();
+}
+
+void
+DataWriter::flush_to_checkpoint(bool& unflushed, daqdataformats::trigger_number_t last_written)
+{
+  if (!unflushed) {
+    return;
+  }
+  unflushed = false;
+  try {
+    m_data_writer->flush();
+    m_write_queue.checkpoint(last_written);
+  } catch (const std::exception& excpt) {
+    // what the data store held may be lost: the checkpoint stays where it is
+    ers::error(DataStoreFlushProblem(ERS_HERE, get_name(), m_run_number, excpt));
+    m_write_queue.break_checkpoint();
+  }
+}
+
+void
+DataWriter::report_checkpoint() const
+{
+  daqdataformats::trigger_number_t checkpoint = 0;
+  if (!m_write_queue.last_checkpoint(checkpoint)) {
+    return;
+  }
+  TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Durability checkpoint for run " << m_run_number
+                              << ": every record up to trigger number " << checkpoint << " written, "
+                              << m_write_queue.size()
+                              << " records queued, " << m_records_lost_after_token.load()
+                              << " lost after their token";
+}
+
+void
+DataWriter::flush_token_batch(bool force)
+{
+  auto size = m_token_batch.trigger_numbers.size();
+  if (size == 0) {
+    return;
+  }
+  auto send_start = std::chrono::steady_clock::now();
+  if (!force && size < m_token_batch_size && send_start - m_token_batch_start < m_token_batch_timeout) {
+    return;
+  }
+
+  TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Pushing a batch of " << size << " tokens, from trigger number "
+                              << m_token_batch.trigger_numbers.front() << " to "
+                              << m_token_batch.trigger_numbers.back();
+
+  bool wasSentSuccessfully = false;
+  do {
+    try {
+      // a failed send may have consumed the batch, so each attempt sends a copy
+      auto batch = m_token_batch;
+      m_token_batch_output->send(std::move(batch), m_queue_timeout);
+      wasSentSuccessfully = true;
+    } catch (const ers::Issue& excpt) {
+      ++m_run_stats.token_send_retries;
+      std::ostringstream oss_warn;
+      oss_warn << "Send with sender \"" << m_token_batch_output->get_name() << "\" failed";
+      ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
+    }
+  } while (!wasSentSuccessfully && m_running.load());
+
+  if (wasSentSuccessfully) {
+    for (auto trigger_number : m_token_batch.trigger_numbers) {
+      EventTrace::record(TraceEventType::kSend, m_trace_source, trigger_number);
+    }
+    m_tokens_sent += size;
+    ++m_token_batches_sent;
+  }
+  m_token_batch.trigger_numbers.clear();
+
+  auto send_time = std::chrono::steady_clock::now() - send_start;
+  m_run_stats.token_send_time.record(send_time);
+  if (send_time > m_queue_timeout) {
+    m_run_stats.stalled_time += send_time;
+  }
+}
+
+void
+DataWriter::send_load_report(bool write_stalled, uint64_t pending_bytes, bool force) // NOLINT(build/unsigned)
+{
+  if (!m_load_report_output) {
+    return;
+  }
+
+  // with early tokens, both the working and the write thread report
+  auto lk = std::lock_guard<std::mutex>(m_load_report_mutex);
+
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed = now - m_last_load_report;
+  if (!force && elapsed < m_load_report_interval) {
+    return;
+  }
+
+  auto bytes = m_bytes_output_tot.load();
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+
+  DataflowLoadReport report;
+  report.run_number = m_run_number;
+  report.decision_destination = m_trigger_decision_connection;
+  report.reporter = get_name();
+  report.pending_records = (pending_bytes > 0 ? 1 : 0) + m_write_queue.size();
+  report.pending_bytes = pending_bytes + m_write_queue.bytes();
+  report.write_throughput = seconds > 0 ? (bytes - m_bytes_at_last_report) / seconds : 0;
+  report.write_stalled = write_stalled;
+  report.storage_bandwidth = m_storage_probe.bandwidth();
+
+  m_last_load_report = now;
+  m_bytes_at_last_report = bytes;
+
+  // the report is only advisory, it is never worth delaying the writing for it
+  try {
+    m_load_report_output->send(std::move(report), iomanager::Sender::s_no_block);
+  } catch (const ers::Issue& excpt) {
+    ers::warning(excpt);
+  }
+}
+
+void
+DataWriter::probe_storage(uint64_t total_bytes, uint64_t record_bytes) // NOLINT(build/unsigned)
+{
+  std::string directory = ".";
+  if (m_data_store_parameters.contains("directory_path")) {
+    directory = m_data_store_parameters["directory_path"].get<std::string>();
+  }
+
+  // a failed probe leaves the bandwidth unknown, it does not prevent writing
+  try {
+    m_storage_probe = StorageProbe(directory, total_bytes, record_bytes).run();
+  } catch (const StorageProbeFailed& excpt) {
+    ers::warning(excpt);
+    return;
+  }
+
+  TLOG() << get_name() << ": storage in " << directory << " writes " << m_storage_probe.bandwidth() / 1e6
+         << " MB/s, " << std::chrono::duration<double, std::micro>(m_storage_probe.mean_record_time()).count()
+         << " us per record of " << record_bytes << " bytes on average";
+}
+
+void
+DataWriter::write_run_summary() const
+{
+  auto run_time = m_run_stats.stop - m_run_stats.start;
+
+  nlohmann::json summary;
+  summary["run_duration_s"] = std::chrono::duration<double>(run_time).count();
+  summary["finish_with_run_time_s"] = std::chrono::duration<double>(m_run_stats.finish_time).count();
+  summary["data_storage_enabled"] = m_data_storage_is_enabled;
+  summary["records_received"] = m_records_received_tot.load();
+  summary["records_written"] = m_records_written_tot.load();
+  summary["bytes_written"] = m_bytes_output_tot.load();
+  summary["tokens_sent"] = m_tokens_sent.load();
+  summary["token_batches_sent"] = m_token_batches_sent.load();
+  summary["record_rate_Hz"] = RunSummary::rate(m_records_written_tot.load(), run_time);
+  summary["write_throughput_MBps"] = RunSummary::rate(m_bytes_output_tot.load() / 1e6, run_time);
+  auto busy_time = m_run_stats.write_time.total();
+  summary["write_busy_fraction"] = run_time.count() > 0 ? std::chrono::duration<double>(busy_time).count() /
+                                                             std::chrono::duration<double>(run_time).count()
+                                                         : 0.;
+  summary["throughput_while_writing_MBps"] = RunSummary::rate(m_bytes_output_tot.load() / 1e6, busy_time);
+  summary["write_time"] = RunSummary::summarise(m_run_stats.write_time);
+  summary["token_send_time"] = RunSummary::summarise(m_run_stats.token_send_time);
+  summary["write_retries"] = m_run_stats.write_retries;
+  summary["write_failures"] = m_run_stats.write_failures;
+  summary["token_send_retries"] = m_run_stats.token_send_retries;
+  summary["stalled_time_s"] =
+    std::chrono::duration<double>(m_run_stats.stalled_time + m_run_stats.write_stalled_time).count();
+  if (m_storage_probe.records_written > 0) {
+    summary["storage_probe_MBps"] = m_storage_probe.bandwidth() / 1e6;
+    summary["storage_probe_record_time_us"] =
+      std::chrono::duration<double, std::micro>(m_storage_probe.mean_record_time()).count();
+  }
+  if (!m_selection.empty()) {
+    nlohmann::json selection;
+    m_selection.for_each([&](daqdataformats::trigger_type_t trigger_type, const StorageSelection::Counters& counters) {
+      auto& entry = selection[std::to_string(trigger_type)];
+      entry["records_stored"] = counters.records_stored.load();
+      entry["records_prescaled"] = counters.records_prescaled.load();
+      entry["fragments_removed"] = counters.fragments_removed.load();
+      entry["bytes_removed"] = counters.bytes_removed.load();
+    });
+    summary["storage_selection"] = selection;
+  }
+  if (m_shedding_threshold > 0) {
+    nlohmann::json shedding;
+    m_shedding.for_each([&](daqdataformats::trigger_type_t trigger_type, const LoadSheddingPolicy::Counters& counters) {
+      auto& entry = shedding[std::to_string(trigger_type)];
+      entry["dropped_records"] = counters.dropped.load();
+      entry["header_only_records"] = counters.header_only.load();
+      entry["abandoned_retries"] = counters.abandoned_retries.load();
+    });
+    summary["shedding"] = shedding;
+  }
+  if (m_early_tokens) {
+    daqdataformats::trigger_number_t checkpoint = 0;
+    summary["early_tokens"] = true;
+    summary["records_lost_after_token"] = m_records_lost_after_token.load();
+    if (m_write_queue.last_checkpoint(checkpoint)) {
+      summary["durable_trigger_number"] = checkpoint;
+    }
+  }
+
+  RunSummary::get().add_section(m_run_number, get_name(), summary);
 }
 
 } // namespace dfmodules
@@ -10,6 +10,15 @@
 #define DFMODULES_PLUGINS_DATAWRITER_HPP_
 
 #include "dfmodules/DataStore.hpp"
+#include "dfmodules/DataflowLoadReport.hpp"
+#include "dfmodules/EventTrace.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/LoadSheddingPolicy.hpp"
+#include "dfmodules/RecordWriteQueue.hpp"
+#include "dfmodules/StorageProbe.hpp"
+#include "dfmodules/StorageSelection.hpp"
+#include "dfmodules/ThreadPlacement.hpp"
+#include "dfmodules/TriggerDecisionTokenBatch.hpp"
 
 #include "appfwk/DAQModule.hpp"
 #include "daqdataformats/TriggerRecord.hpp"
@@ -18,10 +27,13 @@
 #include "iomanager/Sender.hpp"
 #include "utilities/WorkerThread.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace dunedaq {
@@ -43,6 +55,7 @@ public:
   DataWriter& operator=(const DataWriter&) = delete; ///< DataWriter is not copy-assignable
   DataWriter(DataWriter&&) = delete;                 ///< DataWriter is not move-constructible
   DataWriter& operator=(DataWriter&&) = delete;      ///< DataWriter is not move-assignable
+  ~DataWriter();
 
   void init(const data_t&) override;
   void get_info(opmonlib::InfoCollector& ci, int level) override;
@@ -53,6 +66,7 @@ private:
   void do_start(const data_t&);
   void do_stop(const data_t&);
   void do_scrap(const data_t&);
+  void do_dump_event_trace(const data_t&);
 
   // Callback
   void receive_trigger_record(std::unique_ptr<daqdataformats::TriggerRecord>&);
@@ -67,6 +81,7 @@ private:
   size_t m_min_write_retry_time_usec;
   size_t m_max_write_retry_time_usec;
   int m_write_retry_time_increase_factor;
+  ThreadPlacement m_thread_placement;
 
   // Connections
   iomanager::connection::ConnectionRef m_trigger_record_connection;
@@ -77,11 +92,90 @@ private:
   std::shared_ptr<token_sender_t> m_token_output;
   std::string m_trigger_decision_connection;
 
+  // optional batching of the tokens, flushed by count or age
+  std::shared_ptr<iomanager::SenderConcept<TriggerDecisionTokenBatch>> m_token_batch_output;
+  size_t m_token_batch_size = 0; ///< 0 when the tokens are sent one by one
+  std::chrono::milliseconds m_token_batch_timeout;
+  TriggerDecisionTokenBatch m_token_batch;
+  std::chrono::steady_clock::time_point m_token_batch_start;
+  void flush_token_batch(bool force);
+
+  // optional load feedback to the DFO, sent next to the tokens
+  std::shared_ptr<iomanager::SenderConcept<DataflowLoadReport>> m_load_report_output;
+  std::chrono::milliseconds m_load_report_interval;
+  std::chrono::steady_clock::time_point m_last_load_report;
+  uint64_t m_bytes_at_last_report = 0; // NOLINT(build/unsigned)
+  std::mutex m_load_report_mutex;
+  void send_load_report(bool write_stalled, uint64_t pending_bytes, bool force = false); // NOLINT(build/unsigned)
+
+  // write bandwidth of the storage, measured at configuration
+  StorageProbeResult m_storage_probe;
+  void probe_storage(uint64_t total_bytes, uint64_t record_bytes); // NOLINT(build/unsigned)
+
+  // early tokens: the records are written by a separate thread, from a
+  // bounded queue, and their token is sent once they are queued
+  size_t m_write_queue_size = 0; ///< 0 when the token waits for the write
+  std::chrono::milliseconds m_checkpoint_interval;
+  // at stop, the queued records keep being retried until this deadline
+  std::chrono::milliseconds m_stop_drain_timeout{ 10000 };
+  std::atomic<std::chrono::steady_clock::time_point> m_drain_deadline{ std::chrono::steady_clock::time_point() };
+  bool m_early_tokens = false;
+  RecordWriteQueue m_write_queue;
+  std::thread m_write_thread;
+  void do_write();
+  void report_checkpoint() const;
+  void flush_to_checkpoint(bool& unflushed, daqdataformats::trigger_number_t last_written);
+  enum class WriteOutcome
+  {
+    kWritten,
+    kShed,  ///< refused by the storage and given up on purpose, as the record may be shed
+    kFailed
+  };
+  WriteOutcome write_trigger_record(daqdataformats::TriggerRecord& record, bool token_sent = false);
+
+  // prescales and component allowlists, by trigger type
+  StorageSelection m_selection;
+
+  // load shedding, by trigger type, while the writer is behind
+  size_t m_shedding_threshold = 0; ///< 0 when shedding is disabled
+  LoadSheddingPolicy m_shedding;
+  std::atomic<bool> m_write_stalled{ false };
+  // the write of a record ends before the next record is received, so the
+  // writer stays behind for a while after the storage last refused a write
+  std::chrono::milliseconds m_shedding_hold_time{ 1000 };
+  std::atomic<std::chrono::steady_clock::time_point> m_last_write_refusal{ std::chrono::steady_clock::time_point() };
+  bool under_backlog() const;
+
   // Worker(s)
   dunedaq::utilities::WorkerThread m_thread;
   void do_work(std::atomic<bool>&);
 
   std::unique_ptr<DataStore> m_data_writer;
+  std::mutex m_data_store_mutex; ///< protects the m_data_writer pointer against get_info
+  nlohmann::json m_data_store_parameters;
+
+  // Background finalisation: at stop, the DataStore of the run is handed over
+  // to a thread that finalises it, and a new one is created for the next run
+  struct PreviousRun
+  {
+    daqdataformats::run_number_t run_number;
+    std::unique_ptr<DataStore> data_store;
+    std::chrono::milliseconds grace;
+    std::chrono::steady_clock::time_point stop;
+    std::mutex mutex; ///< protects the members below and the data_store
+    std::chrono::steady_clock::time_point last_record;
+    size_t late_records = 0;
+    bool finished = false;
+  };
+  bool m_background_finalisation = false;
+  std::chrono::milliseconds m_finalisation_grace;
+  std::shared_ptr<PreviousRun> m_previous_run;
+  std::thread m_finalisation_thread;
+  std::atomic<std::chrono::steady_clock::time_point> m_last_start_time{ std::chrono::steady_clock::time_point() };
+  void hand_over_to_finalisation();
+  void finalise_previous_run(std::shared_ptr<PreviousRun> previous);
+  void wait_for_finalisation();
+  bool write_to_previous_run(daqdataformats::TriggerRecord& record);
 
   // Metrics
   std::atomic<uint64_t> m_records_received = { 0 };     // NOLINT(build/unsigned)
@@ -91,13 +185,32 @@ private:
   std::atomic<uint64_t> m_bytes_output = { 0 };         // NOLINT(build/unsigned)
   std::atomic<uint64_t> m_bytes_output_tot = { 0 };     // NOLINT(build/unsigned)
   std::atomic<uint64_t> m_tokens_sent = { 0 };     // NOLINT(build/unsigned)
-  std::atomic<uint64_t> m_bytes_for_one_tr = { 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_token_batches_sent = { 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_finalisations_in_progress = { 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_late_records_written = { 0 };      // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_records_lost_after_token = { 0 };  // NOLINT(build/unsigned)
 
-  double_t writing_time_tot;
-  double_t average_writing_rate;
+  // end of run statistics, only updated by the working thread, except the
+  // write_* members which the write thread updates with early tokens
+  struct RunStatistics
+  {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point stop;
+    std::chrono::steady_clock::duration stalled_time{ 0 };
+    std::chrono::steady_clock::duration write_stalled_time{ 0 };
+    std::chrono::steady_clock::duration finish_time{ 0 };
+    uint64_t write_retries = 0;      // NOLINT(build/unsigned)
+    uint64_t write_failures = 0;     // NOLINT(build/unsigned)
+    uint64_t token_send_retries = 0; // NOLINT(build/unsigned)
+    LatencyHistogram write_time;
+    LatencyHistogram token_send_time;
+  };
+  RunStatistics m_run_stats;
+  void write_run_summary() const;
 
   // Other
   std::map<daqdataformats::trigger_number_t, size_t> m_seqno_counts;
+  uint16_t m_trace_source;
 
   inline double elapsed_seconds(std::chrono::steady_clock::time_point then,
                                 std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const
@@ -123,6 +236,21 @@ ERS_DECLARE_ISSUE_BASE(dfmodules,
                        ((std::string)name),
                        ((size_t)trnum)((size_t)seqnum)((size_t)runnum))
 
+ERS_DECLARE_ISSUE_BASE(dfmodules,
+                       BackgroundFinalisationUnavailable,
+                       appfwk::GeneralDAQModuleIssue,
+                       "The DataStore cannot be used from two threads at once (for HDF5, the library is not built "
+                       "thread-safe): the files of each run are finalised at Stop instead of in the background",
+                       ((std::string)name),
+                       ERS_EMPTY)
+
+ERS_DECLARE_ISSUE_BASE(dfmodules,
+                       DataStoreFlushProblem,
+                       appfwk::GeneralDAQModuleIssue,
+                       "A problem was encountered when flushing the data store in run " << runnum,
+                       ((std::string)name),
+                       ((size_t)runnum))
+
 ERS_DECLARE_ISSUE_BASE(dfmodules,
                        InvalidRunNumber,
                        appfwk::GeneralDAQModuleIssue,
@@ -8,6 +8,8 @@
 
 #include "FakeDataProd.hpp"
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/EventTrace.hpp"
+#include "dfmodules/RunSummary.hpp"
 #include "dfmodules/fakedataprod/Nljs.hpp"
 #include "dfmodules/fakedataprodinfo/InfoNljs.hpp"
 
@@ -45,10 +47,12 @@ FakeDataProd::FakeDataProd(const std::string& name)
   , m_timesync_thread(std::bind(&FakeDataProd::do_timesync, this, std::placeholders::_1))
   , m_queue_timeout(100)
   , m_run_number(0)
+  , m_trace_source(EventTrace::get().register_source(name))
 {
   register_command("conf", &FakeDataProd::do_conf);
   register_command("start", &FakeDataProd::do_start);
   register_command("stop", &FakeDataProd::do_stop);
+  register_command("dump_event_trace", &FakeDataProd::do_dump_event_trace);
 
   m_pid_of_current_process = getpid();
 }
@@ -78,6 +82,11 @@ FakeDataProd::do_conf(const data_t& payload)
   m_response_delay = tmpConfig.response_delay;
   m_fragment_type = daqdataformats::string_to_fragment_type(tmpConfig.fragment_type);
   m_timesync_topic_name = tmpConfig.timesync_topic_name;
+  try {
+    m_thread_placement = ThreadPlacement(tmpConfig.thread_cpu_list, tmpConfig.thread_numa_node);
+  } catch (const InvalidCPUList& excpt) {
+    throw UnableToConfigure(ERS_HERE, get_name(), excpt);
+  }
 
   TLOG_DEBUG(TLVL_CONFIG) << get_name() << ": configured for link number " << m_sourceid.id;
 
@@ -90,6 +99,11 @@ FakeDataProd::do_start(const data_t& payload)
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_start() method";
   m_sent_fragments = 0;
   m_received_requests = 0;
+  m_failed_fragments = 0;
+  m_sent_bytes = 0;
+  m_sent_timesyncs = 0;
+  m_request_processing_time.reset();
+  m_run_start = std::chrono::steady_clock::now();
   m_run_number = payload.value<dunedaq::daqdataformats::run_number_t>("run", 0);
 
   m_timesync_thread.start_working_thread();
@@ -108,9 +122,18 @@ FakeDataProd::do_stop(const data_t& /*args*/)
 
   auto iom = iomanager::IOManager::get();
   iom->remove_callback<dfmessages::DataRequest>(m_data_request_ref);
+
+  EventTrace::get().dump(m_trace_source, get_name() + "_run" + std::to_string(m_run_number));
+  write_run_summary();
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
 }
 
+void
+FakeDataProd::do_dump_event_trace(const data_t& /*args*/)
+{
+  EventTrace::get().dump(m_trace_source, get_name());
+}
+
 void
 FakeDataProd::get_info(opmonlib::InfoCollector& ci, int /*level*/)
 {
@@ -123,6 +146,7 @@ FakeDataProd::get_info(opmonlib::InfoCollector& ci, int /*level*/)
 void
 FakeDataProd::do_timesync(std::atomic<bool>& running_flag)
 {
+  m_thread_placement.apply_to_current_thread(get_name() + " timesync");
 
   auto iom = iomanager::IOManager::get();
   auto sender_ptr = iom->get_sender<dfmessages::TimeSync>(m_timesync_ref);
@@ -144,6 +168,7 @@ FakeDataProd::do_timesync(std::atomic<bool>& running_flag)
     try {
       sender_ptr->send(std::move(timesyncmsg), std::chrono::milliseconds(500), m_timesync_topic_name);
       ++sent_count;
+      ++m_sent_timesyncs;
     } catch (ers::Issue& excpt) {
       ers::warning(TimeSyncTransmissionFailed(ERS_HERE, get_name(), m_timesync_ref.uid, excpt));
     }
@@ -152,13 +177,35 @@ FakeDataProd::do_timesync(std::atomic<bool>& running_flag)
   TLOG() << get_name() << ": sent " << sent_count << " TimeSync messages.";
 }
 
+void
+FakeDataProd::write_run_summary()
+{
+  auto run_time = std::chrono::steady_clock::now() - m_run_start;
+
+  nlohmann::json summary;
+  summary["run_duration_s"] = std::chrono::duration<double>(run_time).count();
+  summary["received_requests"] = m_received_requests.load();
+  summary["sent_fragments"] = m_sent_fragments.load();
+  summary["failed_fragments"] = m_failed_fragments.load();
+  summary["sent_bytes"] = m_sent_bytes.load();
+  summary["request_rate_Hz"] = RunSummary::rate(m_received_requests.load(), run_time);
+  summary["throughput_MB_s"] = RunSummary::rate(m_sent_bytes.load(), run_time) / 1.e6;
+  summary["request_processing_time"] = RunSummary::summarise(m_request_processing_time);
+  summary["sent_timesyncs"] = m_sent_timesyncs.load();
+
+  RunSummary::get().add_section(m_run_number, get_name(), summary);
+}
+
 void
 FakeDataProd::process_data_request(dfmessages::DataRequest& data_request)
 {
 
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": processsing request " << data_request.request_number;
 
+  auto processing_start = std::chrono::steady_clock::now();
   m_received_requests++;
+  EventTrace::record(
+    TraceEventType::kReceive, m_trace_source, data_request.trigger_number, data_request.sequence_number);
 
   // num_frames_to_send = ⌈window_size / tick_diff⌉
   size_t num_frames_to_send = (data_request.request_information.window_end -
@@ -195,9 +242,17 @@ FakeDataProd::process_data_request(dfmessages::DataRequest& data_request)
     auto iom = iomanager::IOManager::get();
     iom->get_sender<daqdataformats::Fragment>(data_request.data_destination)
       ->send(std::move(*data_fragment_ptr), std::chrono::milliseconds(1000));
+    EventTrace::record(
+      TraceEventType::kSend, m_trace_source, data_request.trigger_number, data_request.sequence_number);
+    ++m_sent_fragments;
+    m_sent_bytes += num_bytes_to_send;
   } catch (ers::Issue& e) {
+    ++m_failed_fragments;
+    EventTrace::record(
+      TraceEventType::kTimeout, m_trace_source, data_request.trigger_number, data_request.sequence_number);
     ers::warning(FragmentTransmissionFailed(ERS_HERE, get_name(), data_request.trigger_number, e));
   }
+  m_request_processing_time.record(std::chrono::steady_clock::now() - processing_start);
 
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": finishing processing request " << data_request.request_number;
 }
@@ -9,6 +9,9 @@
 #ifndef DFMODULES_PLUGINS_FAKEDATAPROD_HPP_
 #define DFMODULES_PLUGINS_FAKEDATAPROD_HPP_
 
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/ThreadPlacement.hpp"
+
 #include "daqdataformats/Fragment.hpp"
 #include "dfmessages/DataRequest.hpp"
 
@@ -16,6 +19,7 @@
 #include "iomanager/ConnectionId.hpp"
 #include "utilities/WorkerThread.hpp"
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
@@ -67,6 +71,7 @@ private:
   void do_conf(const data_t&);
   void do_start(const data_t&);
   void do_stop(const data_t&);
+  void do_dump_event_trace(const data_t&);
 
   void get_info(opmonlib::InfoCollector& ci, int level) override;
 
@@ -74,6 +79,7 @@ private:
   dunedaq::utilities::WorkerThread m_timesync_thread;
   void process_data_request(dfmessages::DataRequest&);
   void do_timesync(std::atomic<bool>&);
+  void write_run_summary();
 
   // Configuration
   // size_t m_sleep_msec_while_running;
@@ -86,12 +92,22 @@ private:
   daqdataformats::FragmentType m_fragment_type;
   std::string m_timesync_topic_name;
   uint32_t m_pid_of_current_process; // NOLINT (build/unsigned)
+  ThreadPlacement m_thread_placement;
 
   iomanager::connection::ConnectionRef m_data_request_ref;
   iomanager::connection::ConnectionRef m_timesync_ref;
 
   std::atomic<uint64_t> m_received_requests{ 0 }; // NOLINT (build/unsigned)
   std::atomic<uint64_t> m_sent_fragments{ 0 };    // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_failed_fragments{ 0 };  // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_sent_bytes{ 0 };        // NOLINT (build/unsigned)
+  std::atomic<uint64_t> m_sent_timesyncs{ 0 };    // NOLINT (build/unsigned)
+
+  // end of run statistics; the histogram is only filled by the data request callback
+  std::chrono::steady_clock::time_point m_run_start;
+  LatencyHistogram m_request_processing_time;
+
+  uint16_t m_trace_source;
 };
 } // namespace dfmodules
 } // namespace dunedaq
@@ -14,8 +14,16 @@
 
 #include "HDF5FileUtils.hpp"
 #include "dfmodules/DataStore.hpp"
+#include "dfmodules/FileImageWriter.hpp"
+#include "dfmodules/FileMigrator.hpp"
+#include "dfmodules/PackedFragments.hpp"
+#include "dfmodules/RecordHeaderTable.hpp"
+#include "dfmodules/SourceStreams.hpp"
+#include "dfmodules/WritebackPolicy.hpp"
 #include "dfmodules/hdf5datastore/Nljs.hpp"
 #include "dfmodules/hdf5datastore/Structs.hpp"
+#include "dfmodules/migrationinfo/InfoNljs.hpp"
+#include "dfmodules/writebackinfo/InfoNljs.hpp"
 
 #include "hdf5libs/HDF5RawDataFile.hpp"
 #include "hdf5libs/hdf5filelayout/Nljs.hpp"
@@ -27,9 +35,14 @@
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include "boost/lexical_cast.hpp"
 
+#include <H5public.h>
+
+#include <chrono>
 #include <cstdlib>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <set>
 #include <string>
 #include <sys/statvfs.h>
 #include <utility>
@@ -49,6 +62,30 @@ ERS_DECLARE_ISSUE_BASE(dfmodules,
                        ((std::string)name),
                        ((std::string)selected_operation))
 
+ERS_DECLARE_ISSUE_BASE(dfmodules,
+                       InvalidRecordHeaderLayout,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Selected record header layout \"" << selected_layout
+                                                          << "\" is NOT supported. Please update the configuration file.",
+                       ((std::string)name),
+                       ((std::string)selected_layout))
+
+ERS_DECLARE_ISSUE_BASE(dfmodules,
+                       InvalidDurabilityPolicy,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Selected durability policy \"" << selected_policy
+                                                        << "\" is NOT supported. Please update the configuration file.",
+                       ((std::string)name),
+                       ((std::string)selected_policy))
+
+ERS_DECLARE_ISSUE_BASE(dfmodules,
+                       InvalidLayoutSubsystem,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Subsystem \"" << subsystem << "\" selected for the " << layout << " layout is "
+                                       << reason << ".",
+                       ((std::string)name),
+                       ((std::string)subsystem)((std::string)layout)((std::string)reason))
+
 ERS_DECLARE_ISSUE_BASE(dfmodules,
                        FileOperationProblem,
                        appfwk::GeneralDAQModuleIssue,
@@ -142,6 +179,37 @@ public:
       throw InvalidOperationMode(ERS_HERE, get_name(), m_operation_mode);
     }
 
+    if (m_config_params.record_header_layout != "per-record" && m_config_params.record_header_layout != "table") {
+      throw InvalidRecordHeaderLayout(ERS_HERE, get_name(), m_config_params.record_header_layout);
+    }
+    m_packed_subsystems.clear();
+    for (auto const& system : m_config_params.packed_subsystems) {
+      auto subsystem = daqdataformats::SourceID::string_to_subsystem(system);
+      if (subsystem == daqdataformats::SourceID::Subsystem::kUnknown) {
+        throw InvalidLayoutSubsystem(ERS_HERE, get_name(), system, "packed", "unknown");
+      }
+      m_packed_subsystems.insert(subsystem);
+    }
+    DurabilityMode durability_mode = DurabilityMode::kNone;
+    if (!WritebackPolicy::parse_mode(m_config_params.durability_policy, durability_mode)) {
+      throw InvalidDurabilityPolicy(ERS_HERE, get_name(), m_config_params.durability_policy);
+    }
+    m_writeback = std::make_unique<WritebackPolicy>(durability_mode,
+                                                    m_config_params.fsync_interval_bytes,
+                                                    m_config_params.writeback_interval_bytes,
+                                                    m_config_params.drop_written_pages);
+    m_stream_subsystems.clear();
+    for (auto const& system : m_config_params.stream_subsystems) {
+      auto subsystem = daqdataformats::SourceID::string_to_subsystem(system);
+      if (subsystem == daqdataformats::SourceID::Subsystem::kUnknown) {
+        throw InvalidLayoutSubsystem(ERS_HERE, get_name(), system, "source stream", "unknown");
+      }
+      if (m_packed_subsystems.count(subsystem)) {
+        throw InvalidLayoutSubsystem(ERS_HERE, get_name(), system, "source stream", "also packed");
+      }
+      m_stream_subsystems.insert(subsystem);
+    }
+
     // 05-Apr-2022, KAB: added warning message when the output destination
     // is not a valid directory.
     struct statvfs vfs_results;
@@ -149,6 +217,33 @@ public:
     if (retval != 0) {
       ers::warning(InvalidOutputPath(ERS_HERE, get_name(), m_path));
     }
+
+    // in one-event-per-file mode, the files may be built in a memory-backed
+    // staging directory and put on the output storage as whole images
+    m_file_image_writer.reset();
+    m_staging_path.clear();
+    if (m_operation_mode == "one-event-per-file" && !m_config_params.file_image_staging_path.empty()) {
+      m_staging_path = m_config_params.file_image_staging_path;
+      if (statvfs(m_staging_path.c_str(), &vfs_results) != 0) {
+        throw InvalidOutputPath(ERS_HERE, get_name(), m_staging_path);
+      }
+      m_file_image_writer = std::make_unique<FileImageWriter>(
+        m_config_params.file_image_background_writes ? m_config_params.file_image_queue_depth : 0,
+        durability_mode != DurabilityMode::kNone);
+    }
+
+    // with a bulk directory, directory_path is the fast staging tier, and the
+    // finished files are moved to the bulk tier in the background
+    m_migrator.reset();
+    if (!m_config_params.bulk_directory_path.empty()) {
+      if (statvfs(m_config_params.bulk_directory_path.c_str(), &vfs_results) != 0) {
+        throw InvalidOutputPath(ERS_HERE, get_name(), m_config_params.bulk_directory_path);
+      }
+      m_migrator = std::make_unique<FileMigrator>(m_path,
+                                                  m_config_params.bulk_directory_path,
+                                                  m_config_params.migration_bandwidth_bytes,
+                                                  m_config_params.staging_min_free_bytes);
+    }
   }
 
   /**
@@ -176,6 +271,7 @@ public:
       std::string msg = "writing a trigger record to file " + m_file_handle->get_file_name();
       throw RetryableDataStoreProblem(ERS_HERE, get_name(), msg, issue);
     }
+    check_staging_space(current_free_space, tr_size, "writing a trigger record");
 
     // check if a new file should be opened for this data block
     increment_file_index_if_needed(tr_size);
@@ -193,9 +289,45 @@ public:
       throw FileOperationProblem(ERS_HERE, get_name(), full_filename);
     }
 
-    // write the data block
-    m_file_handle->write(tr);
-    m_recorded_size = m_file_handle->get_recorded_size();
+    // write the data block; the fragments of the packed subsystems go to a
+    // single dataset of the record, those of the stream subsystems are
+    // appended to the stream of their source, and with the table layout the
+    // header goes to the table of the file instead of a dataset of its own
+    if (m_layout_file) {
+      std::vector<const daqdataformats::Fragment*> packed_fragments;
+      for (auto const& frag_ptr : tr.get_fragments_ref()) {
+        auto subsystem = frag_ptr->get_element_id().subsystem;
+        if (m_packed_subsystems.count(subsystem)) {
+          packed_fragments.push_back(frag_ptr.get());
+        } else if (m_stream_subsystems.count(subsystem)) {
+          m_layout_recorded_size += m_source_streams->append(tr.get_header_ref().get_trigger_number(),
+                                                             tr.get_header_ref().get_sequence_number(),
+                                                             *frag_ptr);
+        } else {
+          m_file_handle->write(*frag_ptr);
+        }
+      }
+      if (m_header_table) {
+        m_header_table->append(tr.get_header_ref(), tr.get_fragments_ref().size());
+      } else {
+        m_file_handle->write(tr.get_header_ref());
+      }
+      if (!packed_fragments.empty()) {
+        m_layout_recorded_size += PackedFragmentWriter::write(*m_layout_file,
+                                                              tr.get_header_ref().get_trigger_number(),
+                                                              tr.get_header_ref().get_sequence_number(),
+                                                              packed_fragments);
+      }
+      // with a durability policy, the record is not left in the buffers of
+      // the data store once write() returns
+      if (m_writeback->mode() != DurabilityMode::kNone) {
+        flush_layout_buffers();
+      }
+    } else {
+      m_file_handle->write(tr);
+    }
+    m_recorded_size = m_file_handle->get_recorded_size() + m_layout_recorded_size;
+    follow_writeback();
   }
 
   /**
@@ -223,6 +355,7 @@ public:
       std::string msg = "writing a time slice to file " + m_file_handle->get_file_name();
       throw RetryableDataStoreProblem(ERS_HERE, get_name(), msg, issue);
     }
+    check_staging_space(current_free_space, ts_size, "writing a time slice");
 
     // check if a new file should be opened for this data block
     increment_file_index_if_needed(ts_size);
@@ -242,6 +375,7 @@ public:
     // write the data block
     m_file_handle->write(ts);
     m_recorded_size = m_file_handle->get_recorded_size();
+    follow_writeback();
   }
 
   /**
@@ -277,6 +411,15 @@ public:
 
     m_file_index = 0;
     m_recorded_size = 0;
+
+    // the files left in the staging directory by a previous DataStore of this writer
+    if (m_migrator) {
+      auto leftovers = m_migrator->submit_existing(m_config_params.filename_parameters.writer_identifier);
+      if (leftovers > 0) {
+        TLOG() << get_name() << ": " << leftovers << " files of " << m_path << " queued to be moved to "
+               << m_config_params.bulk_directory_path;
+      }
+    }
   }
 
   /**
@@ -291,7 +434,10 @@ public:
     if (m_file_handle.get() != nullptr) {
       std::string open_filename = m_file_handle->get_file_name();
       try {
-        m_file_handle.reset();
+        close_open_file();
+        if (m_file_image_writer) {
+          m_file_image_writer->drain();
+        }
         m_run_number = 0;
       } catch (std::exception const& excpt) {
         m_run_number = 0;
@@ -302,6 +448,73 @@ public:
         throw FileOperationProblem(ERS_HERE, get_name(), open_filename);
       }
     }
+
+    // the DataStore of a run may be destroyed right after this, with its
+    // migrator: give the files of the run the time to reach the bulk tier
+    if (m_migrator &&
+        !m_migrator->wait_until_idle(std::chrono::milliseconds(m_config_params.migration_drain_timeout_ms))) {
+      ers::warning(FilesLeftInStaging(ERS_HERE, m_path, m_config_params.bulk_directory_path, m_migrator->pending()));
+    }
+  }
+
+  /**
+   * @brief Push the buffered header rows and streams, and the HDF5
+   * metadata, into the open file
+   */
+  void flush() override
+  {
+    if (m_file_handle.get() == nullptr || m_open_flags_of_open_file == HighFive::File::ReadOnly) {
+      return;
+    }
+    std::string open_filename = m_file_handle->get_file_name();
+    try {
+      flush_open_file();
+    } catch (std::exception const& excpt) {
+      throw FileOperationProblem(ERS_HERE, get_name(), open_filename, excpt);
+    }
+  }
+
+  /**
+   * @brief All the instances go through the same HDF5 library, which only
+   * serialises its calls when it is built thread-safe
+   */
+  bool allows_concurrent_instances() const override
+  {
+    hbool_t thread_safe = false;
+    return H5is_library_threadsafe(&thread_safe) >= 0 && thread_safe;
+  }
+
+  void get_info(opmonlib::InfoCollector& ci, int /*level*/) override
+  {
+    writebackinfo::Info info;
+    const auto& counters = m_writeback->get_counters();
+    info.fsyncs = counters.fsyncs.load();
+    info.fsync_time = counters.fsync_time_us.load();
+    info.max_fsync_time = counters.max_fsync_time_us.load();
+    info.writebacks = counters.writebacks.load();
+    info.writeback_time = counters.writeback_time_us.load();
+    info.bytes_dropped = counters.bytes_dropped.load();
+    if (m_file_image_writer) {
+      const auto& image_counters = m_file_image_writer->get_counters();
+      info.file_images_written = image_counters.images_written.load();
+      info.max_file_image_write_time = image_counters.max_write_time_us.load();
+      info.staged_files_kept = image_counters.staged_files_kept.load();
+    }
+    ci.add(info);
+
+    if (m_migrator) {
+      migrationinfo::Info migration_info;
+      const auto& migration_counters = m_migrator->get_counters();
+      migration_info.files_migrated = migration_counters.files_migrated.load();
+      migration_info.bytes_migrated = migration_counters.bytes_migrated.load();
+      migration_info.failures = migration_counters.failures.load();
+      migration_info.pending_files = m_migrator->pending();
+      migration_info.migration_time = migration_counters.migration_time_us.load();
+      migration_info.throttled_time = migration_counters.throttled_time_us.load();
+      migration_info.urgent_files = migration_counters.urgent_files.load();
+      migration_info.staging_free_bytes = m_migrator->staging_free_bytes();
+      ci.add(migration_info);
+    }
   }
 
 private:
@@ -311,6 +524,26 @@ private:
   HDF5DataStore& operator=(HDF5DataStore&&) = delete;
 
   std::unique_ptr<hdf5libs::HDF5RawDataFile> m_file_handle;
+  // with the table, packed or source stream layouts, a second handle on the
+  // open file, for the objects that hdf5libs does not know about; declared
+  // after m_file_handle so that the table and the streams are written before
+  // the file is closed
+  std::unique_ptr<HighFive::File> m_layout_file;
+  std::unique_ptr<RecordHeaderTable> m_header_table;
+  std::unique_ptr<SourceStreamWriter> m_source_streams;
+  std::set<daqdataformats::SourceID::Subsystem> m_packed_subsystems;
+  std::set<daqdataformats::SourceID::Subsystem> m_stream_subsystems;
+  size_t m_layout_recorded_size = 0; ///< bytes written through m_layout_file in the open file
+  // with a staging directory, the FileImageWriter puts the closed files on
+  // the output storage
+  std::unique_ptr<FileImageWriter> m_file_image_writer;
+  std::unique_ptr<WritebackPolicy> m_writeback;
+  // with a bulk directory, moves the closed files out of directory_path
+  std::unique_ptr<FileMigrator> m_migrator;
+  std::string m_finished_file_name; ///< name of the open file once closed, in directory_path
+  std::string m_staging_path;
+  std::string m_staged_file_name;  ///< the open file, in the staging directory
+  std::string m_image_destination; ///< where the image of the open file goes
   hdf5libs::hdf5filelayout::FileLayoutParams m_file_layout_params;
   std::string m_basic_name_of_open_file;
   unsigned m_open_flags_of_open_file;
@@ -339,33 +572,7 @@ private:
   std::string get_file_name(uint64_t record_number, // NOLINT(build/unsigned)
                             daqdataformats::run_number_t run_number)
   {
-    std::ostringstream work_oss;
-    work_oss << m_config_params.directory_path;
-    if (work_oss.str().length() > 0) {
-      work_oss << "/";
-    }
-    work_oss << m_config_params.filename_parameters.overall_prefix;
-    if (work_oss.str().length() > 0) {
-      work_oss << "_";
-    }
-
-    work_oss << m_config_params.filename_parameters.run_number_prefix;
-    work_oss << std::setw(m_config_params.filename_parameters.digits_for_run_number) << std::setfill('0') << run_number;
-    work_oss << "_";
-    if (m_config_params.mode == "one-event-per-file") {
-
-      work_oss << m_config_params.filename_parameters.trigger_number_prefix;
-      work_oss << std::setw(m_config_params.filename_parameters.digits_for_trigger_number) << std::setfill('0')
-               << record_number;
-    } else if (m_config_params.mode == "all-per-file") {
-
-      work_oss << m_config_params.filename_parameters.file_index_prefix;
-      work_oss << std::setw(m_config_params.filename_parameters.digits_for_file_index) << std::setfill('0')
-               << m_file_index;
-    }
-    work_oss << "_" << m_config_params.filename_parameters.writer_identifier;
-    work_oss << ".hdf5";
-    return work_oss.str();
+    return HDF5FileUtils::get_file_name(m_config_params, record_number, run_number, m_file_index);
   }
 
   void increment_file_index_if_needed(size_t size_of_next_write)
@@ -396,11 +603,20 @@ private:
         }
       }
 
+      // with a staging directory, the file is built there and its image is
+      // written to the output directory once the file is closed
+      std::string destination_filename;
+      if (m_file_image_writer && open_flags != HighFive::File::ReadOnly) {
+        destination_filename = unique_filename;
+        unique_filename =
+          (std::filesystem::path(m_staging_path) / std::filesystem::path(unique_filename).filename()).string();
+      }
+
       // close an existing open file
       if (m_file_handle.get() != nullptr) {
         std::string open_filename = m_file_handle->get_file_name();
         try {
-          m_file_handle.reset();
+          close_open_file();
         } catch (std::exception const& excpt) {
           throw FileOperationProblem(ERS_HERE, get_name(), open_filename, excpt);
         } catch (...) { // NOLINT(runtime/exceptions)
@@ -414,6 +630,11 @@ private:
                              << std::to_string(open_flags);
       m_basic_name_of_open_file = file_name;
       m_open_flags_of_open_file = open_flags;
+      m_staged_file_name = destination_filename.empty() ? "" : unique_filename;
+      if (open_flags != HighFive::File::ReadOnly) {
+        m_finished_file_name = destination_filename.empty() ? unique_filename : destination_filename;
+      }
+      m_image_destination = destination_filename;
       try {
         std::shared_ptr<detchannelmaps::HardwareMapService> hw_map_svc(
           new detchannelmaps::HardwareMapService(m_hardware_map_file));
@@ -441,6 +662,21 @@ private:
         // write attributes that aren't being handled by the HDF5RawDataFile right now
         // m_file_handle->write_attribute("data_format_version",(int)m_key_translator_ptr->get_current_version());
         m_file_handle->write_attribute("operational_environment", (std::string)m_config_params.operational_environment);
+
+        if (m_config_params.record_header_layout == "table" || !m_packed_subsystems.empty() ||
+            !m_stream_subsystems.empty()) {
+          open_layout_file();
+        }
+
+        // the staged files are on memory-backed storage, the writeback
+        // policy applies to their images instead
+        if (m_writeback->active() && !m_file_image_writer) {
+          try {
+            m_writeback->open(m_file_handle->get_file_name());
+          } catch (WritebackFailed const& excpt) {
+            throw FileOperationProblem(ERS_HERE, get_name(), m_file_handle->get_file_name(), excpt);
+          }
+        }
       }
     } else {
       TLOG_DEBUG(TLVL_BASIC) << get_name() << ": Pointer file to  " << m_basic_name_of_open_file
@@ -448,6 +684,160 @@ private:
     }
   }
 
+  void open_layout_file()
+  {
+    std::string open_filename = m_file_handle->get_file_name();
+    try {
+      // HDF5 shares the underlying file between the handles of a process
+      m_layout_file = std::make_unique<HighFive::File>(open_filename, HighFive::File::ReadWrite);
+      if (m_config_params.record_header_layout == "table") {
+        m_header_table =
+          std::make_unique<RecordHeaderTable>(*m_layout_file, m_config_params.record_header_table_flush_rows);
+      }
+      if (!m_stream_subsystems.empty()) {
+        m_source_streams = std::make_unique<SourceStreamWriter>(
+          *m_layout_file, m_config_params.stream_chunk_bytes, m_config_params.stream_buffer_bytes);
+      }
+    } catch (std::exception const& excpt) {
+      close_layout_file();
+      throw FileOperationProblem(ERS_HERE, get_name(), open_filename, excpt);
+    }
+    m_layout_recorded_size = 0;
+    m_file_handle->write_attribute("record_header_layout", (std::string)m_config_params.record_header_layout);
+    if (!m_packed_subsystems.empty()) {
+      std::string packed_subsystems;
+      for (auto const& system : m_config_params.packed_subsystems) {
+        packed_subsystems += (packed_subsystems.empty() ? "" : ",") + system;
+      }
+      m_file_handle->write_attribute("packed_subsystems", packed_subsystems);
+    }
+    if (!m_stream_subsystems.empty()) {
+      std::string stream_subsystems;
+      for (auto const& system : m_config_params.stream_subsystems) {
+        stream_subsystems += (stream_subsystems.empty() ? "" : ",") + system;
+      }
+      m_file_handle->write_attribute("stream_subsystems", stream_subsystems);
+    }
+  }
+
+  /**
+   * @brief With a bulk directory, refuse the writes that would leave less
+   * than the minimum free space in the staging directory, until the
+   * migrator catches up
+   */
+  void check_staging_space(size_t current_free_space, size_t data_size, const std::string& what)
+  {
+    size_t needed_space = m_config_params.staging_min_free_bytes + data_size;
+    if (!m_migrator || current_free_space >= needed_space) {
+      return;
+    }
+    InsufficientDiskSpace issue(ERS_HERE,
+                                get_name(),
+                                m_path,
+                                current_free_space,
+                                needed_space,
+                                "the minimum free space of the staging directory");
+    throw RetryableDataStoreProblem(ERS_HERE, get_name(), what + " to the staging directory " + m_path, issue);
+  }
+
+  /**
+   * @brief Hand the file that was just closed to the migrator
+   */
+  void submit_finished_file()
+  {
+    if (m_migrator && !m_finished_file_name.empty()) {
+      m_migrator->submit(m_finished_file_name);
+    }
+    m_finished_file_name.clear();
+  }
+
+  /**
+   * @brief Start the writeback and the fsyncs of the open file that are due
+   */
+  void follow_writeback()
+  {
+    try {
+      if (m_writeback->written()) {
+        flush_open_file();
+        m_writeback->sync();
+      }
+    } catch (WritebackFailed const& excpt) {
+      throw FileOperationProblem(ERS_HERE, get_name(), m_file_handle->get_file_name(), excpt);
+    }
+  }
+
+  void flush_layout_buffers()
+  {
+    if (m_header_table) {
+      m_header_table->flush();
+    }
+    if (m_source_streams) {
+      m_source_streams->flush();
+    }
+  }
+
+  /**
+   * @brief Push the rows, the streams and the HDF5 metadata held in memory
+   * into the open file, so that an fsync leaves a readable file
+   */
+  void flush_open_file()
+  {
+    flush_layout_buffers();
+    if (m_layout_file) {
+      m_layout_file->flush();
+    } else {
+      // a second handle shares the file of the HDF5RawDataFile, and flushes it
+      HighFive::File(m_file_handle->get_file_name(), HighFive::File::ReadWrite).flush();
+    }
+  }
+
+  /**
+   * @brief Close the open file, which hdf5libs renames from its ".writing"
+   * name.  With a durability policy, the file is made durable before the
+   * rename, so that a file with its final name is always complete, and its
+   * directory after.
+   */
+  void close_open_file()
+  {
+    if (m_writeback->following() && m_writeback->mode() != DurabilityMode::kNone) {
+      flush_open_file();
+      m_writeback->sync();
+    }
+    close_layout_file();
+    m_file_handle.reset();
+    publish_file_image();
+    m_writeback->close();
+    submit_finished_file();
+  }
+
+  /**
+   * @brief Hand the image of the staged file that was just closed to the
+   * FileImageWriter, and remove the staged file
+   */
+  void publish_file_image()
+  {
+    if (!m_file_image_writer || m_image_destination.empty()) {
+      return;
+    }
+    auto staged_file_name = std::move(m_staged_file_name);
+    auto destination = std::move(m_image_destination);
+    m_staged_file_name.clear();
+    m_image_destination.clear();
+
+    // the staged file is removed by the writer, once the image is in place
+    auto image = FileImageWriter::load(staged_file_name);
+    TLOG_DEBUG(TLVL_BASIC) << get_name() << ": writing the image of " << staged_file_name << ", " << image.size()
+                           << " bytes, to " << destination;
+    m_file_image_writer->submit(std::move(destination), std::move(image), std::move(staged_file_name));
+  }
+
+  void close_layout_file()
+  {
+    m_header_table.reset();
+    m_source_streams.reset();
+    m_layout_file.reset();
+  }
+
   size_t get_free_space(const std::string& the_path)
   {
     struct statvfs vfs_results;
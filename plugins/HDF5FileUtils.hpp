@@ -13,12 +13,17 @@
 #define DFMODULES_PLUGINS_HDF5FILEUTILS_HPP_
 
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/hdf5datastore/Structs.hpp"
+
+#include "daqdataformats/Types.hpp"
 
 #include "highfive/H5File.hpp"
 
 #include <filesystem>
+#include <iomanip>
 #include <memory>
 #include <regex>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -141,6 +146,45 @@ get_files_matching_pattern(const std::string& directory_path, const std::string&
   return file_list;
 }
 
+/**
+ * @brief Translates the data store configuration, record number, run number
+ * and file index into the full name of the file that the record goes to.
+ */
+inline std::string
+get_file_name(const hdf5datastore::ConfParams& config_params,
+              uint64_t record_number, // NOLINT(build/unsigned)
+              daqdataformats::run_number_t run_number,
+              size_t file_index)
+{
+  std::ostringstream work_oss;
+  work_oss << config_params.directory_path;
+  if (work_oss.str().length() > 0) {
+    work_oss << "/";
+  }
+  work_oss << config_params.filename_parameters.overall_prefix;
+  if (work_oss.str().length() > 0) {
+    work_oss << "_";
+  }
+
+  work_oss << config_params.filename_parameters.run_number_prefix;
+  work_oss << std::setw(config_params.filename_parameters.digits_for_run_number) << std::setfill('0') << run_number;
+  work_oss << "_";
+  if (config_params.mode == "one-event-per-file") {
+
+    work_oss << config_params.filename_parameters.trigger_number_prefix;
+    work_oss << std::setw(config_params.filename_parameters.digits_for_trigger_number) << std::setfill('0')
+             << record_number;
+  } else if (config_params.mode == "all-per-file") {
+
+    work_oss << config_params.filename_parameters.file_index_prefix;
+    work_oss << std::setw(config_params.filename_parameters.digits_for_file_index) << std::setfill('0')
+             << file_index;
+  }
+  work_oss << "_" << config_params.filename_parameters.writer_identifier;
+  work_oss << ".hdf5";
+  return work_oss.str();
+}
+
 } // namespace HDF5FileUtils
 
 } // namespace dfmodules
@@ -8,6 +8,7 @@
 
 #include "TPStreamWriter.hpp"
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/RunSummary.hpp"
 #include "dfmodules/TPBundleHandler.hpp"
 #include "dfmodules/tpstreamwriter/Nljs.hpp"
 #include "dfmodules/tpstreamwriterinfo/InfoNljs.hpp"
@@ -41,11 +42,13 @@ TPStreamWriter::TPStreamWriter(const std::string& name)
   : dunedaq::appfwk::DAQModule(name)
   , m_thread(std::bind(&TPStreamWriter::do_work, this, std::placeholders::_1))
   , m_queue_timeout(100)
+  , m_trace_source(EventTrace::get().register_source(name))
 {
   register_command("conf", &TPStreamWriter::do_conf);
   register_command("start", &TPStreamWriter::do_start);
   register_command("stop", &TPStreamWriter::do_stop);
   register_command("scrap", &TPStreamWriter::do_scrap);
+  register_command("dump_event_trace", &TPStreamWriter::do_dump_event_trace);
 }
 
 void
@@ -75,6 +78,14 @@ TPStreamWriter::do_conf(const data_t& payload)
   tpstreamwriter::ConfParams conf_params = payload.get<tpstreamwriter::ConfParams>();
   m_accumulation_interval_ticks = conf_params.tp_accumulation_interval_ticks;
   m_source_id = conf_params.source_id;
+  if (conf_params.data_store_parameters.contains("directory_path")) {
+    RunSummary::get().set_output_directory(conf_params.data_store_parameters["directory_path"].get<std::string>());
+  }
+  try {
+    m_thread_placement = ThreadPlacement(conf_params.thread_cpu_list, conf_params.thread_numa_node);
+  } catch (const InvalidCPUList& excpt) {
+    throw UnableToConfigure(ERS_HERE, get_name(), excpt);
+  }
 
   // create the DataStore instance here
   try {
@@ -129,10 +140,19 @@ TPStreamWriter::do_stop(const nlohmann::json& /*payload*/)
     ers::error(ProblemDuringStop(ERS_HERE, get_name(), m_run_number, excpt));
   }
 
+  EventTrace::get().dump(m_trace_source, get_name() + "_run" + std::to_string(m_run_number));
+  write_run_summary();
+
   TLOG() << get_name() << " successfully stopped for run number " << m_run_number;
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
 }
 
+void
+TPStreamWriter::do_dump_event_trace(const data_t& /*payload*/)
+{
+  EventTrace::get().dump(m_trace_source, get_name());
+}
+
 void
 TPStreamWriter::do_scrap(const data_t& /*payload*/)
 {
@@ -148,8 +168,10 @@ void
 TPStreamWriter::do_work(std::atomic<bool>& running_flag)
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
+  m_thread_placement.apply_to_current_thread(get_name());
 
   using namespace std::chrono;
+  m_run_stats = RunStatistics();
   size_t n_tpset_received = 0;
   auto start_time = steady_clock::now();
   daqdataformats::timestamp_t first_timestamp = 0;
@@ -163,6 +185,7 @@ TPStreamWriter::do_work(std::atomic<bool>& running_flag)
       tpset = m_tpset_source->receive(m_queue_timeout);
       ++n_tpset_received;
       ++m_tpset_received;
+      EventTrace::record(TraceEventType::kReceive, m_trace_source, tpset.seqno);
     } catch (iomanager::TimeoutExpired&) {
       continue;
     }
@@ -177,6 +200,7 @@ TPStreamWriter::do_work(std::atomic<bool>& running_flag)
     if (tpset.run_number != m_run_number) {
       TLOG_DEBUG(22) << "Discarding TPSet with invalid run number " << tpset.run_number << " (current is "
                      << m_run_number << "),  Source ID is " << tpset.origin << ", seqno is " << tpset.seqno;
+      ++m_run_stats.tpsets_discarded;
       continue;
     }
 
@@ -194,11 +218,25 @@ TPStreamWriter::do_work(std::atomic<bool>& running_flag)
       do {
         should_retry = false;
         try {
+          EventTrace::record(
+            TraceEventType::kWriteBegin, m_trace_source, timeslice_ptr->get_header().timeslice_number);
+          auto write_start = steady_clock::now();
           m_data_writer->write(*timeslice_ptr);
+          m_run_stats.write_time.record(steady_clock::now() - write_start);
+          EventTrace::record(TraceEventType::kWriteEnd,
+                             m_trace_source,
+                             timeslice_ptr->get_header().timeslice_number,
+                             timeslice_ptr->get_total_size_bytes() >> 10);
 	  ++m_tpset_written;
 	  m_bytes_output += timeslice_ptr->get_total_size_bytes();
+          ++m_run_stats.timeslices_written;
+          m_run_stats.bytes_written += timeslice_ptr->get_total_size_bytes();
         } catch (const RetryableDataStoreProblem& excpt) {
           should_retry = true;
+          EventTrace::record(
+            TraceEventType::kWriteEnd, m_trace_source, timeslice_ptr->get_header().timeslice_number);
+          EventTrace::record(TraceEventType::kRetry, m_trace_source, timeslice_ptr->get_header().timeslice_number);
+          ++m_run_stats.write_retries;
           ers::error(DataWritingProblem(ERS_HERE,
                                         get_name(),
                                         timeslice_ptr->get_header().timeslice_number,
@@ -208,8 +246,12 @@ TPStreamWriter::do_work(std::atomic<bool>& running_flag)
             retry_wait_usec = 1000000;
           }
           usleep(retry_wait_usec);
+          m_run_stats.stalled_time += microseconds(retry_wait_usec);
           retry_wait_usec *= 2;
         } catch (const std::exception& excpt) {
+          EventTrace::record(
+            TraceEventType::kWriteEnd, m_trace_source, timeslice_ptr->get_header().timeslice_number);
+          ++m_run_stats.write_failures;
           ers::error(DataWritingProblem(ERS_HERE,
                                         get_name(),
                                         timeslice_ptr->get_header().timeslice_number,
@@ -230,11 +272,35 @@ TPStreamWriter::do_work(std::atomic<bool>& running_flag)
   float rate_hz = 1e3 * static_cast<float>(n_tpset_received) / time_ms;
   float inferred_clock_frequency = 1e3 * (last_timestamp - first_timestamp) / time_ms;
 
+  m_run_stats.run_time = end_time - start_time;
+  m_run_stats.tpsets_received = n_tpset_received;
+  m_run_stats.inferred_clock_frequency = inferred_clock_frequency;
+
   TLOG() << "Received " << n_tpset_received << " TPSets in " << time_ms << "ms. " << rate_hz
          << " TPSet/s. Inferred clock frequency " << inferred_clock_frequency << "Hz";
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_work() method";
 } // NOLINT Function length
 
+void
+TPStreamWriter::write_run_summary() const
+{
+  nlohmann::json summary;
+  summary["run_duration_s"] = std::chrono::duration<double>(m_run_stats.run_time).count();
+  summary["tpsets_received"] = m_run_stats.tpsets_received;
+  summary["tpsets_discarded"] = m_run_stats.tpsets_discarded;
+  summary["tpset_rate_Hz"] = RunSummary::rate(m_run_stats.tpsets_received, m_run_stats.run_time);
+  summary["inferred_clock_frequency_Hz"] = m_run_stats.inferred_clock_frequency;
+  summary["timeslices_written"] = m_run_stats.timeslices_written;
+  summary["bytes_written"] = m_run_stats.bytes_written;
+  summary["write_throughput_MBps"] = RunSummary::rate(m_run_stats.bytes_written / 1e6, m_run_stats.run_time);
+  summary["write_time"] = RunSummary::summarise(m_run_stats.write_time);
+  summary["write_retries"] = m_run_stats.write_retries;
+  summary["write_failures"] = m_run_stats.write_failures;
+  summary["stalled_time_s"] = std::chrono::duration<double>(m_run_stats.stalled_time).count();
+
+  RunSummary::get().add_section(m_run_number, get_name(), summary);
+}
+
 } // namespace dfmodules
 } // namespace dunedaq
 
@@ -12,6 +12,9 @@
 #define DFMODULES_PLUGINS_TPSTREAMWRITER_HPP_
 
 #include "dfmodules/DataStore.hpp"
+#include "dfmodules/EventTrace.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/ThreadPlacement.hpp"
 
 #include "appfwk/DAQModule.hpp"
 #include "iomanager/Receiver.hpp"
@@ -51,6 +54,7 @@ private:
   void do_start(const data_t&);
   void do_stop(const data_t&);
   void do_scrap(const data_t&);
+  void do_dump_event_trace(const data_t&);
 
   // Threading
   dunedaq::utilities::WorkerThread m_thread;
@@ -61,6 +65,7 @@ private:
   size_t m_accumulation_interval_ticks;
   daqdataformats::run_number_t m_run_number;
   uint32_t m_source_id; // NOLINT(build/unsigned)
+  ThreadPlacement m_thread_placement;
 
   // Queue sources and sinks
   using incoming_t = trigger::TPSet;
@@ -75,6 +80,26 @@ private:
   std::atomic<uint64_t> m_tpset_written  = { 0 };         // NOLINT(build/unsigned)
   std::atomic<uint64_t> m_bytes_output   = { 0 };         // NOLINT(build/unsigned)
 
+  // Event trace
+  uint16_t m_trace_source;
+
+  // end of run statistics, only updated by the working thread
+  struct RunStatistics
+  {
+    std::chrono::steady_clock::duration run_time{ 0 };
+    std::chrono::steady_clock::duration stalled_time{ 0 };
+    uint64_t tpsets_received = 0;     // NOLINT(build/unsigned)
+    uint64_t tpsets_discarded = 0;    // NOLINT(build/unsigned)
+    uint64_t timeslices_written = 0;  // NOLINT(build/unsigned)
+    uint64_t bytes_written = 0;       // NOLINT(build/unsigned)
+    uint64_t write_retries = 0;       // NOLINT(build/unsigned)
+    uint64_t write_failures = 0;      // NOLINT(build/unsigned)
+    double inferred_clock_frequency = 0.;
+    LatencyHistogram write_time;
+  };
+  RunStatistics m_run_stats;
+  void write_run_summary() const;
+
 };
 } // namespace dfmodules
 
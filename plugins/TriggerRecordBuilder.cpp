@@ -8,6 +8,7 @@
 
 #include "TriggerRecordBuilder.hpp"
 #include "dfmodules/CommonIssues.hpp"
+#include "dfmodules/RunSummary.hpp"
 
 #include "appfwk/DAQModuleHelper.hpp"
 #include "appfwk/app/Nljs.hpp"
@@ -18,6 +19,8 @@
 
 #include "iomanager/IOManager.hpp"
 
+#include <time.h>
+
 #include <algorithm>
 #include <chrono>
 #include <cmath>
@@ -47,16 +50,37 @@ namespace dfmodules {
 
 using daqdataformats::TriggerRecordErrorBits;
 
+namespace {
+
+std::chrono::nanoseconds
+thread_cpu_time()
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // namespace
+
 TriggerRecordBuilder::TriggerRecordBuilder(const std::string& name)
   : dunedaq::appfwk::DAQModule(name)
   , m_thread(std::bind(&TriggerRecordBuilder::do_work, this, std::placeholders::_1))
   , m_queue_timeout(100)
+  , m_trace_source(EventTrace::get().register_source(name))
 {
 
   register_command("conf", &TriggerRecordBuilder::do_conf);
   register_command("scrap", &TriggerRecordBuilder::do_scrap);
   register_command("start", &TriggerRecordBuilder::do_start);
   register_command("stop", &TriggerRecordBuilder::do_stop);
+  register_command("dump_event_trace", &TriggerRecordBuilder::do_dump_event_trace);
+}
+
+TriggerRecordBuilder::~TriggerRecordBuilder()
+{
+  wait_for_drain();
 }
 
 void
@@ -70,6 +94,7 @@ TriggerRecordBuilder::init(const data_t& init_data)
   //---------------------------------
 
   auto ci = appfwk::connection_index(init_data, { "trigger_decision_input", "trigger_record_output" });
+  m_decision_destination = ci["trigger_decision_input"].uid;
 
   auto iom = iomanager::IOManager::get();
   m_trigger_decision_input = iom->get_receiver<dfmessages::TriggerDecision>( ci["trigger_decision_input"] );
@@ -91,10 +116,14 @@ TriggerRecordBuilder::init(const data_t& init_data)
   for (const auto& ref : ini.conn_refs) {
     if (ref.name.rfind("data_fragment_") == 0) {
       m_fragment_inputs.push_back(iom->get_receiver<std::unique_ptr<daqdataformats::Fragment>>( ref ) );
+      m_fragment_input_stats.push_back(std::make_unique<FragmentInputStatistics>());
     }
     else if ( ref.name == "mon_connection" ) {
       m_mon_receiver = iom->get_receiver<dfmessages::TRMonRequest>( ref );
     }
+    else if ( ref.name == "load_report_output" ) {
+      m_load_report_output = iom->get_sender<DataflowLoadReport>( ref );
+    }
   }
       
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting init() method";
@@ -110,11 +139,14 @@ TriggerRecordBuilder::get_info(opmonlib::InfoCollector& ci, int /*level*/)
   i.pending_trigger_decisions = m_trigger_decisions_counter.load();
   i.fragments_in_the_book = m_fragment_counter.load();
   i.pending_fragments = m_pending_fragment_counter.load();
+  i.draining_trigger_records = m_draining_trigger_records.load();
 
   // error counters
   i.timed_out_trigger_records = m_timed_out_trigger_records.load();
   i.abandoned_trigger_records = m_abandoned_trigger_records.load();
+  i.spilled_trigger_records = m_spilled_trigger_records.load();
   i.unexpected_fragments = m_unexpected_fragments.load();
+  i.late_fragments = m_late_fragments.load();
   i.unexpected_trigger_decisions = m_unexpected_trigger_decisions.load();
   i.lost_fragments = m_lost_fragments.load();
   i.invalid_requests = m_invalid_requests.load();
@@ -129,10 +161,26 @@ TriggerRecordBuilder::get_info(opmonlib::InfoCollector& ci, int /*level*/)
   i.data_waiting_time = m_data_waiting_time.exchange(0);
   i.data_request_width = m_data_request_width.exchange(0);
   i.trigger_decision_width = m_trigger_decision_width.exchange(0);
+  i.trimmed_components = m_trimmed_components_counter.exchange(0);
+  i.skipped_components = m_skipped_components_counter.exchange(0);
+  i.saved_request_width = m_saved_request_width.exchange(0);
   i.received_trmon_requests = m_trmon_request_counter.exchange(0);
   i.sent_trmon = m_trmon_sent_counter.exchange(0);
+  i.sent_trmon_fragments = m_trmon_fragment_counter.exchange(0);
+  i.pending_trmon_requests = m_mon_requests.pending();
 
   ci.add(i);
+
+  for (size_t j = 0; j < m_fragment_inputs.size(); ++j) {
+    fragmentinputinfo::Info input_info;
+    input_info.drained_fragments = m_fragment_input_stats[j]->drained_fragments.exchange(0);
+    input_info.max_backlog = m_fragment_input_stats[j]->max_backlog.exchange(0);
+    input_info.budget_exhausted_passes = m_fragment_input_stats[j]->budget_exhausted_passes.exchange(0);
+
+    opmonlib::InfoCollector tmp_ic;
+    tmp_ic.add(input_info);
+    ci.add(m_fragment_inputs[j]->get_name(), tmp_ic);
+  }
 }
 
 void
@@ -160,6 +208,20 @@ TriggerRecordBuilder::do_conf(const data_t& payload)
     m_map_sourceid_connections[key] = iom->get_sender<dfmessages::DataRequest> ( entry.connection_uid ) ;
   }
 
+  m_mon_requests.clear_selections();
+  for (auto const& entry : parsed_conf.monitoring_selections) {
+    MonitoringSelection selection;
+    for (auto const& source : entry.source_ids) {
+      daqdataformats::SourceID::Subsystem type = daqdataformats::SourceID::string_to_subsystem(source.system);
+      if (type == daqdataformats::SourceID::Subsystem::kUnknown) {
+        throw InvalidSystemType(ERS_HERE, source.system);
+      }
+      selection.source_ids.emplace(type, source.source_id);
+    }
+    selection.sampling_fraction = entry.sampling_fraction;
+    m_mon_requests.set_selection(entry.destination, std::move(selection));
+  }
+
   m_trigger_timeout = duration_type(parsed_conf.trigger_record_timeout_ms);
 
   m_loop_sleep = m_queue_timeout = std::chrono::milliseconds(parsed_conf.general_queue_timeout);
@@ -172,12 +234,39 @@ TriggerRecordBuilder::do_conf(const data_t& payload)
 
   TLOG() << get_name() << ": timeouts (ms): queue = " << m_queue_timeout.count() << ", loop = " << m_loop_sleep.count();
   m_max_time_window = parsed_conf.max_time_window;
+  m_fragment_read_budget = parsed_conf.fragment_read_budget;
+  m_trim_overlapping_windows = parsed_conf.trim_overlapping_windows;
+  m_max_shared_window = parsed_conf.max_shared_window;
+  m_sharing_trigger_types.clear();
+  m_sharing_trigger_types.insert(parsed_conf.sharing_trigger_types.begin(), parsed_conf.sharing_trigger_types.end());
+  if (m_trim_overlapping_windows && m_sharing_trigger_types.empty()) {
+    TLOG() << get_name() << ": trim_overlapping_windows is set but no sharing_trigger_types are configured, "
+           << "no window will be trimmed";
+  }
+
+  m_recent_trigger_ids.set_capacity(parsed_conf.recent_trigger_ids);
+  auto summary_interval = std::chrono::milliseconds(parsed_conf.issue_summary_interval_ms);
+  m_unexpected_fragment_issues = IssueRateLimiter(parsed_conf.issue_reports_per_interval, summary_interval);
+  m_late_fragment_issues = IssueRateLimiter(parsed_conf.issue_reports_per_interval, summary_interval);
+  m_timed_out_trigger_issues = IssueRateLimiter(parsed_conf.issue_reports_per_interval, summary_interval);
 
   m_reply_connection = parsed_conf.reply_connection_name;
 
   m_this_trb_source_id.subsystem = daqdataformats::SourceID::Subsystem::kTRBuilder;
   m_this_trb_source_id.id = parsed_conf.source_id;
 
+  try {
+    m_thread_placement = ThreadPlacement(parsed_conf.thread_cpu_list, parsed_conf.thread_numa_node);
+  } catch (const InvalidCPUList& excpt) {
+    throw UnableToConfigure(ERS_HERE, get_name(), excpt);
+  }
+  m_background_drain = parsed_conf.background_drain;
+  m_drain_timeout = std::chrono::milliseconds(parsed_conf.drain_timeout_ms);
+  m_spill_directory = parsed_conf.spill_directory;
+  m_arrival_trace_directory = parsed_conf.arrival_trace_directory;
+  m_arrival_trace_payload_sizes = parsed_conf.arrival_trace_payload_sizes;
+  m_load_report_interval = std::chrono::milliseconds(parsed_conf.load_report_interval_ms);
+
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_conf() method";
 }
 
@@ -186,6 +275,7 @@ TriggerRecordBuilder::do_scrap(const data_t& /*args*/)
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_scrap() method";
 
+  wait_for_drain();
   m_map_sourceid_connections.clear();
 
   TLOG() << get_name() << " successfully scrapped";
@@ -205,6 +295,7 @@ TriggerRecordBuilder::do_start(const data_t& args)
     m_mon_receiver->add_callback( std::bind(&TriggerRecordBuilder::tr_requested, this, std::placeholders::_1) );
   }
 
+  m_last_start_time = std::chrono::steady_clock::now();
   m_thread.start_working_thread(get_name());
   TLOG() << get_name() << " successfully started";
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_start() method";
@@ -221,10 +312,19 @@ TriggerRecordBuilder::do_stop(const data_t& /*args*/)
   }
 
   m_thread.stop_working_thread();
+  EventTrace::get().dump(m_trace_source, get_name() + "_run" + std::to_string(*m_run_number));
+  write_run_summary();
+
   TLOG() << get_name() << " successfully stopped";
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Exiting do_stop() method";
 }
 
+void
+TriggerRecordBuilder::do_dump_event_trace(const data_t& /*args*/)
+{
+  EventTrace::get().dump(m_trace_source, get_name());
+}
+
 void
 TriggerRecordBuilder::tr_requested(const dfmessages::TRMonRequest & req) 
 {
@@ -235,9 +335,7 @@ TriggerRecordBuilder::tr_requested(const dfmessages::TRMonRequest & req)
     return;
   
   // Add requests to pending requests
-  // To be done: choose a concurrent container implementation.
-  const std::lock_guard<std::mutex> lock(m_mon_mutex);
-  m_mon_requests.push_back(req);
+  m_mon_requests.add(req);
 }
 
 void
@@ -245,19 +343,44 @@ TriggerRecordBuilder::do_work(std::atomic<bool>& running_flag)
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << get_name() << ": Entering do_work() method";
 
+  // done before anything is allocated on this thread, so that the book and
+  // the received fragments live on the configured NUMA node
+  m_thread_placement.apply_to_current_thread(get_name());
+
   // clean books from possible previous memory
   m_trigger_records.clear();
+  m_recent_trigger_ids.clear();
+  m_requested_windows.clear();
+  m_unexpected_fragment_issues.reset();
+  m_late_fragment_issues.reset();
+  m_timed_out_trigger_issues.reset();
   m_trigger_decisions_counter.store(0);
   m_unexpected_trigger_decisions.store(0);
   m_pending_fragment_counter.store(0);
   m_generated_trigger_records.store(0);
   m_fragment_counter.store(0);
+  m_book_bytes.store(0);
   m_timed_out_trigger_records.store(0);
   m_abandoned_trigger_records.store(0);
+  m_spilled_trigger_records.store(0);
   m_unexpected_fragments.store(0);
+  m_late_fragments.store(0);
   m_lost_fragments.store(0);
   m_invalid_requests.store(0);
   m_duplicated_trigger_ids.store(0);
+  m_run_stats = RunStatistics();
+  m_run_stats.start = std::chrono::steady_clock::now();
+  auto cpu_start = thread_cpu_time();
+
+  if (!m_arrival_trace_directory.empty()) {
+    try {
+      m_arrival_trace = std::make_unique<ArrivalTraceWriter>(
+        ArrivalTraceWriter::file_name(m_arrival_trace_directory, get_name(), *m_run_number),
+        m_arrival_trace_payload_sizes);
+    } catch (const ArrivalTraceError& excpt) {
+      ers::error(excpt);
+    }
+  }
 
   bool run_again = false;
 
@@ -286,7 +409,7 @@ TriggerRecordBuilder::do_work(std::atomic<bool>& running_flag)
       for (const auto& tr : m_trigger_records) {
 
         auto comp_size = tr.second.second->get_fragments_ref().size();
-        auto requ_size = tr.second.second->get_header_ref().get_num_requested_components();
+        auto requ_size = expected_fragments(tr.second.second->get_header_ref());
         std::ostringstream message;
         message << tr.first << " with " << comp_size << '/' << requ_size << " components";
 
@@ -317,6 +440,10 @@ TriggerRecordBuilder::do_work(std::atomic<bool>& running_flag)
     //--------------------------------------------------
     book_updates |= check_stale_requests(running_flag);
 
+    report_suppressed_issues();
+
+    send_load_report();
+
     run_again = book_updates || new_fragments;
 
     if (!run_again) {
@@ -343,12 +470,36 @@ TriggerRecordBuilder::do_work(std::atomic<bool>& running_flag)
     triggers.push_back(entry.first);
   }
 
-  // create the trigger record and send it
-  for (const auto& t : triggers) {
-    send_trigger_record(t, running_flag);
+  if (m_background_drain) {
+    // the records are taken out of the book here, only sending them is left
+    // to the drain thread, so that the next run can start meanwhile
+    std::vector<trigger_record_ptr_t> records;
+    for (const auto& t : triggers) {
+      records.push_back(extract_trigger_record(t));
+      send_to_monitoring(records.back(), running_flag);
+    }
+    wait_for_drain();
+    m_draining_trigger_records = records.size();
+    m_drain_thread = std::thread(&TriggerRecordBuilder::drain_in_background, this, std::move(records), *m_run_number, t1);
+  } else {
+    // create the trigger record and send it
+    for (const auto& t : triggers) {
+      send_trigger_record(t, running_flag);
+    }
+    close_spill(m_spill_writer);
   }
 
+  close_arrival_trace();
+
+  // the book is empty now, let the DFO know straight away
+  send_load_report(true);
+
   std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  m_run_stats.draining_time = t2 - t1;
+  m_run_stats.stop = t2;
+  m_run_stats.worker_cpu_time = thread_cpu_time() - cpu_start;
+
+  report_suppressed_issues(true);
 
   std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
 
@@ -368,66 +519,113 @@ TriggerRecordBuilder::read_fragments()
   bool new_fragments = false;
 
   //-------------------------------------------------
-  // Try to get Fragments from every queue
+  // Drain the queues in round-robin: every round takes one fragment from
+  // each queue that is neither empty nor out of budget, so that a burst
+  // on one connection is absorbed in a single pass without starving the others
   //--------------------------------------------------
 
-  for (unsigned int j = 0; j < m_fragment_inputs.size(); ++j) {
-    
-    std::optional<std::unique_ptr<daqdataformats::Fragment>> temp_fragment;
-    
-    try {
-      temp_fragment = m_fragment_inputs[j] -> try_receive( iomanager::Receiver::s_no_block );
-    } catch ( const ers::Issue & e)  {
-      ers::error(e);
-      continue ;
-    }
+  const size_t n_inputs = m_fragment_inputs.size();
+  m_fragments_read_in_pass.assign(n_inputs, 0);
+  m_input_drained_in_pass.assign(n_inputs, false);
+  size_t active_inputs = n_inputs;
 
-    if ( ! temp_fragment ) continue ;
-    
-    new_fragments = true;
-    TLOG_DEBUG(TLVL_FRAGMENT_RECEIVE) << get_name() << " Received fragment for trigger/sequence_number "
-                                      << temp_fragment.value()->get_trigger_number() << "."
-                                      << temp_fragment.value()->get_sequence_number()
-                                      << " from " << temp_fragment.value()->get_element_id();
-    
-    TriggerId temp_id(*temp_fragment.value());
-    bool requested = false;
-    
-    auto it = m_trigger_records.find(temp_id);
-    
-    if (it != m_trigger_records.end()) {
-      
-      // check if the fragment has a Source Id that was desired
-      daqdataformats::TriggerRecordHeader& header = it->second.second->get_header_ref();
-      
-      for (size_t i = 0; i < header.get_num_requested_components(); ++i) {
-	
-	const daqdataformats::ComponentRequest& request = header[i];
-	if (request.component == temp_fragment.value()->get_element_id()) {
-	  requested = true;
-	  break;
-	}
-	
-      } // request loop
+  while (active_inputs > 0) {
+    for (size_t j = 0; j < n_inputs; ++j) {
 
-    } // if there is a corresponding trigger ID entry in the boook
+      if (m_input_drained_in_pass[j])
+        continue;
 
-    if (requested) {
-      it->second.second->add_fragment(std::move(*temp_fragment));
-      ++m_fragment_counter;
-      --m_pending_fragment_counter;
-    } else {
-      ers::error(UnexpectedFragment(
-				    ERS_HERE, temp_id, temp_fragment.value()->get_fragment_type_code(), temp_fragment.value()->get_element_id()));
-      ++m_unexpected_fragments;
+      std::optional<std::unique_ptr<daqdataformats::Fragment>> temp_fragment;
+
+      try {
+        temp_fragment = m_fragment_inputs[j]->try_receive(iomanager::Receiver::s_no_block);
+      } catch (const ers::Issue& e) {
+        ers::error(e);
+      }
+
+      if (!temp_fragment) {
+        m_input_drained_in_pass[j] = true;
+        --active_inputs;
+        continue;
+      }
+
+      new_fragments = true;
+      if (++m_fragments_read_in_pass[j] == m_fragment_read_budget) {
+        m_input_drained_in_pass[j] = true;
+        --active_inputs;
+        ++m_fragment_input_stats[j]->budget_exhausted_passes;
+      }
+
+      add_fragment_to_book(std::move(*temp_fragment));
+
+    } // queue loop
+  }   // round loop
+
+  for (size_t j = 0; j < n_inputs; ++j) {
+    auto& stats = *m_fragment_input_stats[j];
+    stats.drained_fragments += m_fragments_read_in_pass[j];
+    if (m_fragments_read_in_pass[j] > stats.max_backlog.load()) {
+      stats.max_backlog = m_fragments_read_in_pass[j];
     }
-    
-  } // queue loop
-  
+  }
+
   return new_fragments;
   
 }
 
+void
+TriggerRecordBuilder::add_fragment_to_book(std::unique_ptr<daqdataformats::Fragment> fragment)
+{
+  TLOG_DEBUG(TLVL_FRAGMENT_RECEIVE) << get_name() << " Received fragment for trigger/sequence_number "
+                                    << fragment->get_trigger_number() << "." << fragment->get_sequence_number()
+                                    << " from " << fragment->get_element_id();
+
+  TriggerId temp_id(*fragment);
+  EventTrace::record(TraceEventType::kReceive, m_trace_source, temp_id.trigger_number, temp_id.sequence_number);
+  record_arrival(*fragment);
+  bool requested = false;
+
+  auto it = m_trigger_records.find(temp_id);
+
+  if (it != m_trigger_records.end()) {
+
+    // check if the fragment has a Source Id that was desired
+    daqdataformats::TriggerRecordHeader& header = it->second.second->get_header_ref();
+
+    for (size_t i = 0; i < header.get_num_requested_components(); ++i) {
+
+      const daqdataformats::ComponentRequest& request = header[i];
+      if (request.component == fragment->get_element_id() && !is_shared_reference(request)) {
+        requested = true;
+        break;
+      }
+
+    } // request loop
+
+  } // if there is a corresponding trigger ID entry in the boook
+
+  if (requested) {
+    m_book_bytes += fragment->get_size();
+    it->second.second->add_fragment(std::move(fragment));
+    ++m_run_stats.fragments;
+    ++m_fragment_counter;
+    --m_pending_fragment_counter;
+  } else if (it == m_trigger_records.end() && m_recent_trigger_ids.contains(temp_id)) {
+    // the record was already sent: the fragment is dropped, and counted both
+    // as late and as unexpected
+    ++m_late_fragments;
+    ++m_unexpected_fragments;
+    if (m_late_fragment_issues.count()) {
+      ers::warning(LateFragment(ERS_HERE, temp_id, fragment->get_fragment_type_code(), fragment->get_element_id()));
+    }
+  } else {
+    ++m_unexpected_fragments;
+    if (m_unexpected_fragment_issues.count()) {
+      ers::error(UnexpectedFragment(ERS_HERE, temp_id, fragment->get_fragment_type_code(), fragment->get_element_id()));
+    }
+  }
+}
+
 bool
 TriggerRecordBuilder::read_and_process_trigger_decision(iomanager::Receiver::timeout_t timeout,
 							std::atomic<bool>& running)
@@ -444,7 +642,10 @@ TriggerRecordBuilder::read_and_process_trigger_decision(iomanager::Receiver::tim
   }
 
   if ( ! temp_dec ) return false ;
-  
+
+  EventTrace::record(TraceEventType::kReceive, m_trace_source, temp_dec->trigger_number);
+  record_arrival(*temp_dec);
+
   if (temp_dec->run_number != *m_run_number) {
     ers::error(UnexpectedTriggerDecision(ERS_HERE, temp_dec->trigger_number, temp_dec->run_number, *m_run_number));
     ++m_unexpected_trigger_decisions;
@@ -452,6 +653,7 @@ TriggerRecordBuilder::read_and_process_trigger_decision(iomanager::Receiver::tim
   }
   
   ++m_received_trigger_decisions;
+  ++m_run_stats.trigger_decisions;
 
   bool book_updates = create_trigger_records_and_dispatch(*temp_dec, running) > 0;
   
@@ -470,13 +672,19 @@ TriggerRecordBuilder::extract_trigger_record(const TriggerId& id)
   auto duration = time - it->second.first;
 
   m_data_waiting_time += std::chrono::duration_cast<duration_type>(duration).count();
+  m_run_stats.completion_latency.record(duration);
 
   m_trigger_records.erase(it);
+  m_recent_trigger_ids.insert(id);
 
   --m_trigger_decisions_counter;
   m_fragment_counter -= temp->get_fragments_ref().size();
+  for (const auto& fragment : temp->get_fragments_ref()) {
+    m_book_bytes -= fragment->get_size();
+  }
 
-  auto missing_fragments = temp->get_header_ref().get_num_requested_components() - temp->get_fragments_ref().size();
+  auto expected = expected_fragments(temp->get_header_ref());
+  auto missing_fragments = expected - temp->get_fragments_ref().size();
 
   if (missing_fragments > 0) {
 
@@ -486,7 +694,7 @@ TriggerRecordBuilder::extract_trigger_record(const TriggerId& id)
 
     TLOG() << get_name() << " sending incomplete TriggerRecord downstream at Stop time "
            << "(trigger/run_number=" << id << ", " << temp->get_fragments_ref().size() << " of "
-           << temp->get_header_ref().get_num_requested_components() << " fragments included)";
+           << expected << " fragments included)";
   }
 
   return temp;
@@ -499,20 +707,13 @@ TriggerRecordBuilder::create_trigger_records_and_dispatch(const dfmessages::Trig
 
   unsigned int new_tr_counter = 0;
 
-  // check the whole time window
-  daqdataformats::timestamp_t begin = std::numeric_limits<daqdataformats::timestamp_t>::max();
-  daqdataformats::timestamp_t end = 0;
+  // check the whole time window and prepare the slicing
+  m_shared_references.clear();
+  m_window_slicer.reset(m_trim_overlapping_windows ? trim_overlapping_components(td) : td.components,
+                        m_max_time_window);
 
-  for (const auto& component : td.components) {
-    if (component.window_begin < begin)
-      begin = component.window_begin;
-    if (component.window_end > end)
-      end = component.window_end;
-  }
-
-  daqdataformats::timestamp_diff_t tot_width = end - begin;
-  daqdataformats::sequence_number_t max_sequence_number =
-    (m_max_time_window > 0 && tot_width > 0) ? ((tot_width - 1) / m_max_time_window) : 0;
+  daqdataformats::timestamp_diff_t tot_width = m_window_slicer.total_width();
+  daqdataformats::sequence_number_t max_sequence_number = m_window_slicer.max_sequence_number();
 
   TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": trig_number " << td.trigger_number << ": run_number " << td.run_number
                               << ": trig_timestamp " << td.trigger_timestamp << " will have " << max_sequence_number + 1
@@ -523,28 +724,11 @@ TriggerRecordBuilder::create_trigger_records_and_dispatch(const dfmessages::Trig
   // create the trigger records
   for (daqdataformats::sequence_number_t sequence = 0; sequence <= max_sequence_number; ++sequence) {
 
-    daqdataformats::timestamp_t slice_begin = begin + sequence * m_max_time_window;
-    daqdataformats::timestamp_t slice_end =
-      m_max_time_window > 0 ? std::min(slice_begin + m_max_time_window, end) : end;
-
-    // create the components cropped in time
-    decltype(td.components) slice_components;
-    for (const auto& component : td.components) {
-
-      if (component.window_begin >= slice_end)
-        continue;
-      if (component.window_end <= slice_begin)
-        continue;
-
-      daqdataformats::timestamp_t new_begin = std::max(slice_begin, component.window_begin);
-      daqdataformats::timestamp_t new_end = std::min(slice_end, component.window_end);
-
-      daqdataformats::ComponentRequest temp(component.component, new_begin, new_end);
-      slice_components.push_back(temp);
-
-      m_data_request_width += new_end - new_begin;
-
-    } // loop over component in trigger decision
+    // the components cropped in time, only those overlapping the slice are visited
+    const auto& slice_components = m_window_slicer.next_slice();
+    for (const auto& component : slice_components) {
+      m_data_request_width += component.window_end - component.window_begin;
+    }
 
     // Pleae note that the system could generate empty sequences
     // The code keeps them.
@@ -563,7 +747,14 @@ TriggerRecordBuilder::create_trigger_records_and_dispatch(const dfmessages::Trig
     auto& entry = m_trigger_records[slice_id] = std::make_pair(clock_type::now(), trigger_record_ptr_t());
     ;
     trigger_record_ptr_t& trp = entry.second;
-    trp.reset(new daqdataformats::TriggerRecord(slice_components));
+    if (sequence == 0 && !m_shared_references.empty()) {
+      // the references to the shared windows are listed once, in the first slice
+      m_record_components.assign(slice_components.begin(), slice_components.end());
+      m_record_components.insert(m_record_components.end(), m_shared_references.begin(), m_shared_references.end());
+      trp.reset(new daqdataformats::TriggerRecord(m_record_components));
+    } else {
+      trp.reset(new daqdataformats::TriggerRecord(slice_components));
+    }
     daqdataformats::TriggerRecord& tr = *trp;
 
     tr.get_header_ref().set_trigger_number(td.trigger_number);
@@ -574,9 +765,14 @@ TriggerRecordBuilder::create_trigger_records_and_dispatch(const dfmessages::Trig
     tr.get_header_ref().set_trigger_type(td.trigger_type);
     tr.get_header_ref().set_element_id(m_this_trb_source_id);
 
+    if (m_trim_overlapping_windows && m_sharing_trigger_types.count(td.trigger_type) > 0) {
+      update_requested_windows(slice_components, slice_id);
+    }
+
     m_trigger_decisions_counter++;
     m_pending_fragment_counter += slice_components.size();
     ++new_tr_counter;
+    m_run_stats.max_book_size = std::max(m_run_stats.max_book_size, m_trigger_records.size());
 
     // create and send the requests
     TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Trigger Decision components: " << td.components.size();
@@ -605,6 +801,93 @@ TriggerRecordBuilder::create_trigger_records_and_dispatch(const dfmessages::Trig
   return new_tr_counter;
 }
 
+const std::vector<daqdataformats::ComponentRequest>&
+TriggerRecordBuilder::trim_overlapping_components(const dfmessages::TriggerDecision& td)
+{
+  m_trimmed_components.clear();
+
+  for (const auto& component : td.components) {
+
+    auto it = m_requested_windows.find(component.component);
+
+    // only windows starting inside the window already requested by a record
+    // still in the book are trimmed: the data is then guaranteed to be in
+    // that record, or in the records it was itself trimmed against. Only the
+    // records of the sharing trigger types cover windows, so none of them is
+    // prescaled or shed by the writers
+    bool overlaps = it != m_requested_windows.end() && component.window_begin >= it->second.begin &&
+                    component.window_begin < it->second.end && m_trigger_records.count(it->second.id) > 0;
+    if (overlaps && m_max_shared_window > 0) {
+      overlaps = static_cast<daqdataformats::timestamp_diff_t>(component.window_end - it->second.begin) <=
+                 m_max_shared_window;
+    }
+
+    if (!overlaps) {
+      m_trimmed_components.push_back(component);
+      continue;
+    }
+
+    if (component.window_end <= it->second.end) {
+      TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": trig_number " << td.trigger_number << ": SourceID "
+                                  << component.component << " already requested by " << it->second.id;
+      ++m_skipped_components_counter;
+      ++m_run_stats.skipped_components;
+      m_saved_request_width += component.window_end - component.window_begin;
+      m_run_stats.saved_request_width += component.window_end - component.window_begin;
+      m_shared_references.emplace_back(component.component, component.window_begin, component.window_begin);
+      continue;
+    }
+
+    ++m_trimmed_components_counter;
+    ++m_run_stats.trimmed_components;
+    m_saved_request_width += it->second.end - component.window_begin;
+    m_run_stats.saved_request_width += it->second.end - component.window_begin;
+    TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": trig_number " << td.trigger_number << ": SourceID "
+                                << component.component << " shares [" << component.window_begin << ", "
+                                << it->second.end << ") with " << it->second.id;
+    m_trimmed_components.emplace_back(component.component, it->second.end, component.window_end);
+    m_shared_references.emplace_back(component.component, component.window_begin, component.window_begin);
+  }
+
+  return m_trimmed_components;
+}
+
+void
+TriggerRecordBuilder::update_requested_windows(const std::vector<daqdataformats::ComponentRequest>& components,
+                                               const TriggerId& id)
+{
+  for (const auto& component : components) {
+    auto it = m_requested_windows.find(component.component);
+    if (it != m_requested_windows.end() && component.window_begin == it->second.end) {
+      // a trimmed window or the next slice of a window: the covered window grows
+      it->second.end = component.window_end;
+      it->second.id = id;
+    } else {
+      m_requested_windows[component.component] = RequestedWindow{ component.window_begin, component.window_end, id };
+    }
+  }
+}
+
+bool
+TriggerRecordBuilder::is_shared_reference(const daqdataformats::ComponentRequest& request) const
+{
+  return m_trim_overlapping_windows && request.window_begin == request.window_end;
+}
+
+size_t
+TriggerRecordBuilder::expected_fragments(const daqdataformats::TriggerRecordHeader& header) const
+{
+  size_t expected = header.get_num_requested_components();
+  if (m_trim_overlapping_windows) {
+    for (size_t i = 0; i < header.get_num_requested_components(); ++i) {
+      if (is_shared_reference(header[i])) {
+        --expected;
+      }
+    }
+  }
+  return expected;
+}
+
 bool
 TriggerRecordBuilder::dispatch_data_requests(dfmessages::DataRequest dr,
                                              const daqdataformats::SourceID& sid,
@@ -625,6 +908,7 @@ TriggerRecordBuilder::dispatch_data_requests(dfmessages::DataRequest dr,
   auto sender = it_req->second;
 
   bool wasSentSuccessfully = false;
+  auto send_start = std::chrono::steady_clock::now();
   do {
     TLOG_DEBUG(TLVL_DISPATCH_DATAREQ) << get_name() << ": Pushing the DataRequest from trigger/sequence number "
                                       << dr.trigger_number << "." << dr.sequence_number
@@ -632,16 +916,27 @@ TriggerRecordBuilder::dispatch_data_requests(dfmessages::DataRequest dr,
 
     // send data request into the corresponding connection
     try {
+      auto trigger_number = dr.trigger_number;
+      auto sequence_number = dr.sequence_number;
       sender->send(std::move(dr), m_queue_timeout );
+      EventTrace::record(TraceEventType::kSend, m_trace_source, trigger_number, sequence_number);
       wasSentSuccessfully = true;
       ++m_generated_data_requests;
+      ++m_run_stats.data_requests;
     } catch (const ers::Issue& excpt) {
+      EventTrace::record(TraceEventType::kRetry, m_trace_source, dr.trigger_number, dr.sequence_number);
+      ++m_run_stats.send_retries;
       std::ostringstream oss_warn;
       oss_warn << "Send to connection \"" << sender -> get_name() << "\" failed";
       ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
     }
   } while (!wasSentSuccessfully && running.load());
 
+  auto send_time = std::chrono::steady_clock::now() - send_start;
+  if (send_time > m_queue_timeout) {
+    m_run_stats.stalled_time += send_time;
+  }
+
   return wasSentSuccessfully;
 }
 
@@ -651,57 +946,117 @@ TriggerRecordBuilder::send_trigger_record(const TriggerId& id, std::atomic<bool>
 
   trigger_record_ptr_t temp_record(extract_trigger_record(id));
 
-  // Send to monitoring, if needed
+  send_to_monitoring(temp_record, running);
 
-  if (m_mon_receiver) {
-    const std::lock_guard<std::mutex> lock(m_mon_mutex);
-    auto it = m_mon_requests.begin();
-    while (it != m_mon_requests.end()) {
-      // send TR to mon if correct trigger type
-      if (it->trigger_type == temp_record->get_header_data().trigger_type) {
-	auto iom = iomanager::IOManager::get();
-	bool wasSentSuccessfully = false;
-	do {
-	  try {
-          // HACK to copy the trigger record so we can send it off to monitoring
-          auto trigger_record_bytes = serialization::serialize(temp_record, serialization::SerializationType::kMsgPack);
-          trigger_record_ptr_t record_copy = serialization::deserialize<trigger_record_ptr_t>(trigger_record_bytes);
-	    iom->get_sender<trigger_record_ptr_t>( it->data_destination )->send(std::move(record_copy), m_queue_timeout);
-	    ++m_trmon_sent_counter;
-	    wasSentSuccessfully = true;
-	  } catch (const ers::Issue& excpt) {
-	    std::ostringstream oss_warn;
-	    oss_warn << "Sending TR to connection \"" << it->data_destination << "\" failed";
-	    ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
-	  }
-	} while ( running.load() && !wasSentSuccessfully ) ;
-        it = m_mon_requests.erase(it);
-      } else {
-        ++it;
-      }
-    }
-  }  // if m_mon_receiver
-  
   bool wasSentSuccessfully = false;
+  auto send_start = std::chrono::steady_clock::now();
   do {
     try {
       m_trigger_record_output->send( std::move(temp_record), m_queue_timeout);
+      EventTrace::record(TraceEventType::kSend, m_trace_source, id.trigger_number, id.sequence_number);
       wasSentSuccessfully = true;
       ++m_generated_trigger_records;
+      ++m_run_stats.trigger_records;
     } catch (const ers::Issue& excpt) {
+      EventTrace::record(TraceEventType::kRetry, m_trace_source, id.trigger_number, id.sequence_number);
+      ++m_run_stats.send_retries;
       ers::warning( excpt );
     }
   } while ( running.load() && !wasSentSuccessfully ) ; // push while loop
+
+  auto send_time = std::chrono::steady_clock::now() - send_start;
+  m_run_stats.trigger_record_send_time.record(send_time);
+  if (send_time > m_queue_timeout) {
+    m_run_stats.stalled_time += send_time;
+  }
   
   if (!wasSentSuccessfully) {
-    ++m_abandoned_trigger_records;
-    m_lost_fragments += temp_record->get_fragments_ref().size();
-    ers::error(dunedaq::dfmodules::AbandonedTriggerDecision(ERS_HERE, id));
+    if (spill_trigger_record(*temp_record, m_spill_writer, id.run_number)) {
+      ++m_spilled_trigger_records;
+    } else {
+      ++m_abandoned_trigger_records;
+      m_lost_fragments += temp_record->get_fragments_ref().size();
+      ers::error(dunedaq::dfmodules::AbandonedTriggerDecision(ERS_HERE, id));
+    }
   }
   
   return wasSentSuccessfully;
 }
 
+void
+TriggerRecordBuilder::send_to_monitoring(const trigger_record_ptr_t& temp_record, std::atomic<bool>& running)
+{
+  // Send to monitoring, if needed
+  // Only the requests for the trigger type of the record are looked at,
+  // and nothing is locked when there are no pending requests
+
+  if (!m_mon_receiver || m_mon_requests.empty())
+    return;
+
+  m_mon_requests.take(temp_record->get_header_data().trigger_type, m_served_mon_requests);
+
+  auto iom = iomanager::IOManager::get();
+  for (auto& served : m_served_mon_requests) {
+    bool wasSentSuccessfully = false;
+    do {
+      try {
+        // copy only the fragments the destination asked for
+        trigger_record_ptr_t record_copy = MonitoringRequestBook::select_fragments(*temp_record, served.selection);
+        auto n_fragments = record_copy->get_fragments_ref().size();
+        iom->get_sender<trigger_record_ptr_t>(served.request.data_destination)
+          ->send(std::move(record_copy), m_queue_timeout);
+        ++m_trmon_sent_counter;
+        m_trmon_fragment_counter += n_fragments;
+        wasSentSuccessfully = true;
+      } catch (const ers::Issue& excpt) {
+        std::ostringstream oss_warn;
+        oss_warn << "Sending TR to connection \"" << served.request.data_destination << "\" failed";
+        ers::warning(iomanager::OperationFailed(ERS_HERE, oss_warn.str(), excpt));
+      }
+    } while (running.load() && !wasSentSuccessfully);
+  }
+  m_served_mon_requests.clear();
+}
+
+void
+TriggerRecordBuilder::write_run_summary() const
+{
+  auto run_time = m_run_stats.stop - m_run_stats.start;
+
+  nlohmann::json summary;
+  summary["run_duration_s"] = std::chrono::duration<double>(run_time).count();
+  summary["draining_time_s"] = std::chrono::duration<double>(m_run_stats.draining_time).count();
+  summary["received_trigger_decisions"] = m_run_stats.trigger_decisions;
+  summary["generated_trigger_records"] = m_run_stats.trigger_records;
+  summary["generated_data_requests"] = m_run_stats.data_requests;
+  summary["received_fragments"] = m_run_stats.fragments;
+  summary["trigger_decision_rate_Hz"] = RunSummary::rate(m_run_stats.trigger_decisions, run_time);
+  summary["trigger_record_rate_Hz"] = RunSummary::rate(m_run_stats.trigger_records, run_time);
+  summary["fragment_rate_Hz"] = RunSummary::rate(m_run_stats.fragments, run_time);
+  summary["max_book_size"] = m_run_stats.max_book_size;
+  summary["completion_latency"] = RunSummary::summarise(m_run_stats.completion_latency);
+  summary["trigger_record_send_time"] = RunSummary::summarise(m_run_stats.trigger_record_send_time);
+  summary["send_retries"] = m_run_stats.send_retries;
+  if (m_trim_overlapping_windows) {
+    summary["trimmed_components"] = m_run_stats.trimmed_components;
+    summary["skipped_components"] = m_run_stats.skipped_components;
+    summary["saved_request_width"] = m_run_stats.saved_request_width;
+  }
+  summary["stalled_time_s"] = std::chrono::duration<double>(m_run_stats.stalled_time).count();
+  summary["worker_cpu_s"] = std::chrono::duration<double>(m_run_stats.worker_cpu_time).count();
+  summary["timed_out_trigger_records"] = m_timed_out_trigger_records.load();
+  summary["abandoned_trigger_records"] = m_abandoned_trigger_records.load();
+  summary["spilled_trigger_records"] = m_spilled_trigger_records.load();
+  summary["unexpected_fragments"] = m_unexpected_fragments.load();
+  summary["late_fragments"] = m_late_fragments.load();
+  summary["unexpected_trigger_decisions"] = m_unexpected_trigger_decisions.load();
+  summary["lost_fragments"] = m_lost_fragments.load();
+  summary["invalid_requests"] = m_invalid_requests.load();
+  summary["duplicated_trigger_ids"] = m_duplicated_trigger_ids.load();
+
+  RunSummary::get().add_section(*m_run_number, get_name(), summary);
+}
+
 bool
 TriggerRecordBuilder::check_stale_requests(std::atomic<bool>& running)
 {
@@ -724,7 +1079,10 @@ TriggerRecordBuilder::check_stale_requests(std::atomic<bool>& running)
       
       if (tr_time > m_trigger_timeout) {
 	
-        ers::error(TimedOutTriggerDecision(ERS_HERE, it->first, tr.get_header_ref().get_trigger_timestamp()));
+        if (m_timed_out_trigger_issues.count()) {
+          ers::error(TimedOutTriggerDecision(ERS_HERE, it->first, tr.get_header_ref().get_trigger_timestamp()));
+        }
+        EventTrace::record(TraceEventType::kTimeout, m_trace_source, it->first.trigger_number, it->first.sequence_number);
 	
         // mark trigger record for seding
         stale_triggers.push_back(it->first);
@@ -745,6 +1103,204 @@ TriggerRecordBuilder::check_stale_requests(std::atomic<bool>& running)
   return book_updates;
 }
 
+void
+TriggerRecordBuilder::drain_in_background(std::vector<trigger_record_ptr_t> records,
+                                          daqdataformats::run_number_t run_number,
+                                          std::chrono::steady_clock::time_point drain_start)
+{
+  auto deadline = std::chrono::steady_clock::now() + m_drain_timeout;
+  size_t n_records = records.size();
+  size_t sent = 0;
+  size_t spilled = 0;
+  size_t abandoned = 0;
+  std::unique_ptr<TriggerRecordSpillWriter> spill_writer;
+  size_t lost_fragments = 0;
+
+  for (auto& record : records) {
+
+    TriggerId id;
+    id.trigger_number = record->get_header_ref().get_trigger_number();
+    id.sequence_number = record->get_header_ref().get_sequence_number();
+    id.run_number = run_number;
+    auto n_fragments = record->get_fragments_ref().size();
+
+    // unlike during the run, the output is retried until the drain times out
+    bool wasSentSuccessfully = false;
+    do {
+      try {
+        m_trigger_record_output->send(std::move(record), m_queue_timeout);
+        EventTrace::record(TraceEventType::kSend, m_trace_source, id.trigger_number, id.sequence_number);
+        wasSentSuccessfully = true;
+      } catch (const ers::Issue&) {
+        EventTrace::record(TraceEventType::kRetry, m_trace_source, id.trigger_number, id.sequence_number);
+      }
+    } while (!wasSentSuccessfully && std::chrono::steady_clock::now() < deadline);
+
+    --m_draining_trigger_records;
+    if (wasSentSuccessfully) {
+      ++sent;
+    } else if (spill_trigger_record(*record, spill_writer, run_number)) {
+      ++spilled;
+    } else {
+      ++abandoned;
+      lost_fragments += n_fragments;
+      ers::error(dunedaq::dfmodules::AbandonedTriggerDecision(ERS_HERE, id));
+    }
+  }
+
+  close_spill(spill_writer);
+
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point next_start = m_last_start_time;
+  std::chrono::steady_clock::duration overlap{ 0 };
+  if (next_start > drain_start) {
+    overlap = end - next_start;
+  }
+
+  nlohmann::json summary;
+  summary["drained_trigger_records"] = n_records;
+  summary["sent_trigger_records"] = sent;
+  summary["spilled_trigger_records"] = spilled;
+  summary["abandoned_trigger_records"] = abandoned;
+  summary["lost_fragments"] = lost_fragments;
+  summary["drain_time_s"] = std::chrono::duration<double>(end - drain_start).count();
+  summary["overlap_with_next_run_s"] = std::chrono::duration<double>(overlap).count();
+  RunSummary::get().add_section(run_number, get_name() + "_drain", summary);
+
+  std::ostringstream oss_summ;
+  oss_summ << ": Background drain of run " << run_number << " completed, " << sent << '/' << n_records
+           << " Trigger Records sent";
+  TLOG() << ProgressUpdate(ERS_HERE, get_name(), oss_summ.str());
+}
+
+bool
+TriggerRecordBuilder::spill_trigger_record(const daqdataformats::TriggerRecord& record,
+                                           std::unique_ptr<TriggerRecordSpillWriter>& writer,
+                                           daqdataformats::run_number_t run_number)
+{
+  if (m_spill_directory.empty()) {
+    return false;
+  }
+
+  try {
+    if (!writer) {
+      writer = std::make_unique<TriggerRecordSpillWriter>(
+        TriggerRecordSpillWriter::file_name(m_spill_directory, get_name(), run_number));
+    }
+    writer->write(record);
+  } catch (const SpillFileError& excpt) {
+    ers::error(excpt);
+    return false;
+  }
+
+  TLOG_DEBUG(TLVL_WORK_STEPS) << get_name() << ": Trigger record " << record.get_header_ref().get_trigger_number()
+                              << '.' << record.get_header_ref().get_sequence_number() << " spilled to "
+                              << writer->filename();
+  return true;
+}
+
+void
+TriggerRecordBuilder::close_spill(std::unique_ptr<TriggerRecordSpillWriter>& writer)
+{
+  if (!writer) {
+    return;
+  }
+
+  try {
+    writer->close();
+    TLOG() << get_name() << ": " << writer->records() << " Trigger Records spilled to " << writer->filename();
+  } catch (const SpillFileError& excpt) {
+    ers::error(excpt);
+  }
+  writer.reset();
+}
+
+template<typename T>
+void
+TriggerRecordBuilder::record_arrival(const T& arrival)
+{
+  if (!m_arrival_trace) {
+    return;
+  }
+
+  try {
+    m_arrival_trace->record(arrival);
+  } catch (const ArrivalTraceError& excpt) {
+    // a trace with holes is useless, recording stops for this run
+    ers::error(excpt);
+    m_arrival_trace.reset();
+  }
+}
+
+void
+TriggerRecordBuilder::close_arrival_trace()
+{
+  if (!m_arrival_trace) {
+    return;
+  }
+
+  try {
+    m_arrival_trace->close();
+    TLOG() << get_name() << ": " << m_arrival_trace->entries() << " arrivals recorded in "
+           << m_arrival_trace->filename();
+  } catch (const ArrivalTraceError& excpt) {
+    ers::error(excpt);
+  }
+  m_arrival_trace.reset();
+}
+
+void
+TriggerRecordBuilder::send_load_report(bool force)
+{
+  if (!m_load_report_output) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!force && now - m_last_load_report < m_load_report_interval) {
+    return;
+  }
+  m_last_load_report = now;
+
+  DataflowLoadReport report;
+  report.run_number = *m_run_number;
+  report.decision_destination = m_decision_destination;
+  report.reporter = get_name();
+  report.pending_records = m_trigger_records.size();
+  report.pending_bytes = m_book_bytes.load();
+
+  // the report is only advisory, it is never worth blocking the builder for it
+  try {
+    m_load_report_output->send(std::move(report), iomanager::Sender::s_no_block);
+  } catch (const ers::Issue& excpt) {
+    ers::warning(excpt);
+  }
+}
+
+void
+TriggerRecordBuilder::wait_for_drain()
+{
+  if (m_drain_thread.joinable()) {
+    m_drain_thread.join();
+  }
+}
+
+void
+TriggerRecordBuilder::report_suppressed_issues(bool force)
+{
+  auto now = IssueRateLimiter::clock_type::now();
+
+  if (auto n = m_unexpected_fragment_issues.take_suppressed(now, force); n > 0) {
+    ers::error(SuppressedIssues(ERS_HERE, "UnexpectedFragment", n));
+  }
+  if (auto n = m_late_fragment_issues.take_suppressed(now, force); n > 0) {
+    ers::warning(SuppressedIssues(ERS_HERE, "LateFragment", n));
+  }
+  if (auto n = m_timed_out_trigger_issues.take_suppressed(now, force); n > 0) {
+    ers::error(SuppressedIssues(ERS_HERE, "TimedOutTriggerDecision", n));
+  }
+}
+
 } // namespace dfmodules
 } // namespace dunedaq
 
@@ -9,7 +9,19 @@
 #ifndef DFMODULES_PLUGINS_TRIGGERRECORDBUILDER_HPP_
 #define DFMODULES_PLUGINS_TRIGGERRECORDBUILDER_HPP_
 
+#include "dfmodules/ArrivalTrace.hpp"
+#include "dfmodules/DataflowLoadReport.hpp"
+#include "dfmodules/EventTrace.hpp"
+#include "dfmodules/IssueRateLimiter.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/MonitoringRequestBook.hpp"
+#include "dfmodules/RecentTriggerIds.hpp"
+#include "dfmodules/ThreadPlacement.hpp"
+#include "dfmodules/TriggerId.hpp"
+#include "dfmodules/TriggerRecordSpill.hpp"
 #include "dfmodules/TriggerDecisionForwarder.hpp"
+#include "dfmodules/WindowSlicer.hpp"
+#include "dfmodules/fragmentinputinfo/InfoNljs.hpp"
 #include "dfmodules/triggerrecordbuilderinfo/InfoNljs.hpp"
 
 #include "daqdataformats/Fragment.hpp"
@@ -28,76 +40,18 @@
 #include "iomanager/Receiver.hpp"
 
 #include <chrono>
-#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 namespace dunedaq {
 
-namespace dfmodules {
-
-/**
- * @brief TriggerId is a little class that defines a unique identifier for a
- * trigger decision/record It also provides an operator < to be used by map to
- * optimise bookkeeping
- */
-struct TriggerId
-{
-
-  TriggerId() = default;
-
-  explicit TriggerId(const dfmessages::TriggerDecision& td,
-                     daqdataformats::sequence_number_t s = daqdataformats::TypeDefaults::s_invalid_sequence_number)
-    : trigger_number(td.trigger_number)
-    , sequence_number(s)
-    , run_number(td.run_number)
-  {
-    ;
-  }
-  explicit TriggerId(daqdataformats::Fragment& f)
-    : trigger_number(f.get_trigger_number())
-    , sequence_number(f.get_sequence_number())
-    , run_number(f.get_run_number())
-  {
-    ;
-  }
-
-  daqdataformats::trigger_number_t trigger_number;
-  daqdataformats::sequence_number_t sequence_number;
-  daqdataformats::run_number_t run_number;
-
-  bool operator<(const TriggerId& other) const noexcept
-  {
-    return std::tuple(trigger_number, sequence_number, run_number) <
-           std::tuple(other.trigger_number, other.sequence_number, other.run_number);
-  }
-
-  friend std::ostream& operator<<(std::ostream& out, const TriggerId& id) noexcept
-  {
-    out << id.trigger_number << '-' << id.sequence_number << '/' << id.run_number;
-    return out;
-  }
-
-  friend TraceStreamer& operator<<(TraceStreamer& out, const TriggerId& id) noexcept
-  {
-    return out << id.trigger_number << '.' << id.sequence_number << "/" << id.run_number;
-  }
-
-  friend std::istream& operator>>(std::istream& in, TriggerId& id)
-  {
-    char t1, t2;
-    in >> id.trigger_number >> t1 >> id.sequence_number >> t2 >> id.run_number;
-    return in;
-  }
-};
-
-} // namespace dfmodules
-
 /**
  * @brief Unexpected trigger decision
  */
@@ -130,6 +84,28 @@ ERS_DECLARE_ISSUE(dfmodules,          ///< Namespace
                   ((daqdataformats::SourceID)source_id)                  ///< Message parameters
 )
 
+/**
+ * @brief Fragment for a trigger record that was already sent
+ */
+ERS_DECLARE_ISSUE(dfmodules,    ///< Namespace
+                  LateFragment, ///< Issue class name
+                  "Late Fragment for triggerID " << trigger_id << ", type " << fragment_type << ", " << source_id
+                                                 << ": the trigger record was already sent",
+                  ((dfmodules::TriggerId)trigger_id)               ///< Message parameters
+                  ((daqdataformats::fragment_type_t)fragment_type) ///< Message parameters
+                  ((daqdataformats::SourceID)source_id)            ///< Message parameters
+)
+
+/**
+ * @brief Summary of the issues that were not reported individually
+ */
+ERS_DECLARE_ISSUE(dfmodules,        ///< Namespace
+                  SuppressedIssues, ///< Issue class name
+                  count << " further " << issue_name << " issues were suppressed since the last report",
+                  ((std::string)issue_name) ///< Message parameters
+                  ((size_t)count)           ///< Message parameters
+)
+
 /**
  * @brief Duplicate trigger decision
  */
@@ -170,6 +146,7 @@ public:
     delete;                                                         ///< TriggerRecordBuilder is not copy-assignable
   TriggerRecordBuilder(TriggerRecordBuilder&&) = delete;            ///< TriggerRecordBuilder is not move-constructible
   TriggerRecordBuilder& operator=(TriggerRecordBuilder&&) = delete; ///< TriggerRecordBuilder is not move-assignable
+  ~TriggerRecordBuilder();
 
   void init(const data_t&) override;
   void get_info(opmonlib::InfoCollector& ci, int level) override;
@@ -184,6 +161,7 @@ protected:
   using trigger_record_sender_t = iomanager::SenderConcept<trigger_record_ptr_t>;
 
   bool read_fragments();
+  void add_fragment_to_book(std::unique_ptr<daqdataformats::Fragment> fragment);
 
   bool read_and_process_trigger_decision(iomanager::Receiver::timeout_t, std::atomic<bool>& running);
 
@@ -199,17 +177,51 @@ protected:
                               std::atomic<bool>& running) const;
 
   bool send_trigger_record(const TriggerId&, std::atomic<bool>& running);
+  void send_to_monitoring(const trigger_record_ptr_t& record, std::atomic<bool>& running);
   // this creates a trigger record and send it
 
   bool check_stale_requests(std::atomic<bool>& running);
   // it returns true when there are changes in the book = a TR timed out
 
+  const std::vector<daqdataformats::ComponentRequest>& trim_overlapping_components(
+    const dfmessages::TriggerDecision& td);
+  void update_requested_windows(const std::vector<daqdataformats::ComponentRequest>& components, const TriggerId& id);
+  // with trimming, a zero-width component refers to a window held by an earlier TR
+  bool is_shared_reference(const daqdataformats::ComponentRequest& request) const;
+  // number of fragments a TR waits for: the shared references are not requested
+  size_t expected_fragments(const daqdataformats::TriggerRecordHeader& header) const;
+
+  void report_suppressed_issues(bool force = false);
+
+  // background drain of the records left at stop
+  void drain_in_background(std::vector<trigger_record_ptr_t> records,
+                           daqdataformats::run_number_t run_number,
+                           std::chrono::steady_clock::time_point drain_start);
+  void wait_for_drain();
+
+  // spill of the records that cannot be sent at stop, the writer is opened on first use
+  bool spill_trigger_record(const daqdataformats::TriggerRecord& record,
+                            std::unique_ptr<TriggerRecordSpillWriter>& writer,
+                            daqdataformats::run_number_t run_number);
+  void close_spill(std::unique_ptr<TriggerRecordSpillWriter>& writer);
+
+  // recording of the arrivals, for offline replay
+  template<typename T>
+  void record_arrival(const T& arrival);
+  void close_arrival_trace();
+
+  // load feedback to the DFO, sent at most once per interval unless forced
+  void send_load_report(bool force = false);
+
+  void write_run_summary() const;
+
 private:
   // Commands
   void do_conf(const data_t&);
   void do_scrap(const data_t&);
   void do_start(const data_t&);
   void do_stop(const data_t&);
+  void do_dump_event_trace(const data_t&);
 
   // Monitoring callback
   void tr_requested(const dfmessages::TRMonRequest &);
@@ -223,43 +235,101 @@ private:
   std::chrono::milliseconds m_loop_sleep;
   std::string m_reply_connection;
   daqdataformats::SourceID m_this_trb_source_id;
+  ThreadPlacement m_thread_placement;
+  bool m_background_drain = false;
+  std::chrono::milliseconds m_drain_timeout;
+  std::thread m_drain_thread;
+  std::string m_spill_directory;
+  std::unique_ptr<TriggerRecordSpillWriter> m_spill_writer;
+  std::string m_arrival_trace_directory;
+  bool m_arrival_trace_payload_sizes = false;
+  std::unique_ptr<ArrivalTraceWriter> m_arrival_trace;
+  std::chrono::milliseconds m_load_report_interval;
+  std::chrono::steady_clock::time_point m_last_load_report;
+  std::atomic<std::chrono::steady_clock::time_point> m_last_start_time{ std::chrono::steady_clock::time_point() };
 
   // Input Connections
   std::shared_ptr<trigger_decision_receiver_t> m_trigger_decision_input;
   fragment_receivers_t m_fragment_inputs;
+  size_t m_fragment_read_budget;
+
+  // per fragment input metrics (in between calls) and working buffers of read_fragments
+  struct FragmentInputStatistics
+  {
+    using counter_type = decltype(fragmentinputinfo::Info::drained_fragments);
+    std::atomic<counter_type> drained_fragments = { 0 };
+    std::atomic<counter_type> max_backlog = { 0 };
+    std::atomic<counter_type> budget_exhausted_passes = { 0 };
+  };
+  std::vector<std::unique_ptr<FragmentInputStatistics>> m_fragment_input_stats;
+  std::vector<size_t> m_fragments_read_in_pass;
+  std::vector<bool> m_input_drained_in_pass;
 
   // Output connections
   std::shared_ptr<trigger_record_sender_t> m_trigger_record_output;
+  std::shared_ptr<iomanager::SenderConcept<DataflowLoadReport>> m_load_report_output; ///< optional, to the DFO
+  std::string m_decision_destination; ///< how the DFO names this application
   std::map<daqdataformats::SourceID, std::shared_ptr<data_req_sender_t>> m_map_sourceid_connections; ///< Mappinng between SourceID and connections
 
   // bookeeping
   using clock_type = std::chrono::high_resolution_clock;
   std::map<TriggerId, std::pair<clock_type::time_point, trigger_record_ptr_t>> m_trigger_records;
 
+  // IDs of the trigger records that recently left the book, to recognise late fragments
+  RecentTriggerIds m_recent_trigger_ids;
+
+  // rate limiting of the issues that come in storms
+  IssueRateLimiter m_unexpected_fragment_issues;
+  IssueRateLimiter m_late_fragment_issues;
+  IssueRateLimiter m_timed_out_trigger_issues;
+
   // Data request properties
   daqdataformats::timestamp_diff_t m_max_time_window;
+  WindowSlicer m_window_slicer;
+
+  // overlap trimming: per SourceID, the window covered by the last requests
+  // and the record that requested its end. Only the records of the sharing
+  // trigger types, which the writers keep whole, cover windows
+  bool m_trim_overlapping_windows = false;
+  daqdataformats::timestamp_diff_t m_max_shared_window = 0;
+  std::set<daqdataformats::trigger_type_t> m_sharing_trigger_types;
+  struct RequestedWindow
+  {
+    daqdataformats::timestamp_t begin;
+    daqdataformats::timestamp_t end;
+    TriggerId id;
+  };
+  std::map<daqdataformats::SourceID, RequestedWindow> m_requested_windows;
+  std::vector<daqdataformats::ComponentRequest> m_trimmed_components;
+  // zero-width references to the shared windows, listed in the header of the first slice
+  std::vector<daqdataformats::ComponentRequest> m_shared_references;
+  std::vector<daqdataformats::ComponentRequest> m_record_components;
 
   // Run information
   std::unique_ptr<const daqdataformats::run_number_t> m_run_number = nullptr;
 
   // Monitoring related variables
-  std::mutex m_mon_mutex;
   std::shared_ptr<iomanager::ReceiverConcept<dfmessages::TRMonRequest>> m_mon_receiver;
-  std::list<dfmessages::TRMonRequest> m_mon_requests;
+  MonitoringRequestBook m_mon_requests;
+  std::vector<MonitoringRequestBook::ServedRequest> m_served_mon_requests;
 
   // book related metrics
   using metric_counter_type = decltype(triggerrecordbuilderinfo::Info::pending_trigger_decisions);
   mutable std::atomic<metric_counter_type> m_trigger_decisions_counter = { 0 }; // currently
   mutable std::atomic<metric_counter_type> m_fragment_counter = { 0 };          // currently
   mutable std::atomic<metric_counter_type> m_pending_fragment_counter = { 0 };  // currently
+  mutable std::atomic<metric_counter_type> m_draining_trigger_records = { 0 };  // currently
+  mutable std::atomic<uint64_t> m_book_bytes = { 0 };  // currently NOLINT(build/unsigned)
 
   mutable std::atomic<metric_counter_type> m_timed_out_trigger_records = { 0 };    // in the run
   mutable std::atomic<metric_counter_type> m_unexpected_fragments = { 0 };         // in the run
+  mutable std::atomic<metric_counter_type> m_late_fragments = { 0 };               // in the run
   mutable std::atomic<metric_counter_type> m_unexpected_trigger_decisions = { 0 }; // in the run
   mutable std::atomic<metric_counter_type> m_lost_fragments = { 0 };               // in the run
   mutable std::atomic<metric_counter_type> m_invalid_requests = { 0 };             // in the run
   mutable std::atomic<metric_counter_type> m_duplicated_trigger_ids = { 0 };       // in the run
   mutable std::atomic<metric_counter_type> m_abandoned_trigger_records = { 0 };    // in the run
+  mutable std::atomic<metric_counter_type> m_spilled_trigger_records = { 0 };      // in the run
 
   mutable std::atomic<metric_counter_type> m_received_trigger_decisions = { 0 }; // in between calls
   mutable std::atomic<metric_counter_type> m_generated_trigger_records = { 0 };  // in between calls
@@ -269,14 +339,43 @@ private:
   mutable std::atomic<metric_counter_type> m_data_waiting_time = { 0 };          // in between calls
   mutable std::atomic<metric_counter_type> m_trigger_decision_width = { 0 };     // in between calls
   mutable std::atomic<metric_counter_type> m_data_request_width = { 0 };         // in between calls
+  mutable std::atomic<metric_counter_type> m_trimmed_components_counter = { 0 }; // in between calls
+  mutable std::atomic<metric_counter_type> m_skipped_components_counter = { 0 }; // in between calls
+  mutable std::atomic<metric_counter_type> m_saved_request_width = { 0 };        // in between calls
 
   mutable std::atomic<metric_counter_type> m_trmon_request_counter = { 0 };
   mutable std::atomic<metric_counter_type> m_trmon_sent_counter = { 0 };
+  mutable std::atomic<metric_counter_type> m_trmon_fragment_counter = { 0 };
 
   // time thresholds
   using duration_type = std::chrono::milliseconds;
   duration_type m_old_trigger_threshold;
   duration_type m_trigger_timeout;
+
+  // event trace
+  uint16_t m_trace_source;
+
+  // end of run statistics, only updated by the working thread
+  struct RunStatistics
+  {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point stop;
+    std::chrono::steady_clock::duration draining_time{ 0 };
+    std::chrono::steady_clock::duration stalled_time{ 0 };
+    std::chrono::nanoseconds worker_cpu_time{ 0 };
+    uint64_t trigger_decisions = 0;   // NOLINT(build/unsigned)
+    uint64_t trigger_records = 0;     // NOLINT(build/unsigned)
+    uint64_t data_requests = 0;       // NOLINT(build/unsigned)
+    uint64_t fragments = 0;           // NOLINT(build/unsigned)
+    uint64_t send_retries = 0;        // NOLINT(build/unsigned)
+    uint64_t trimmed_components = 0;  // NOLINT(build/unsigned)
+    uint64_t skipped_components = 0;  // NOLINT(build/unsigned)
+    uint64_t saved_request_width = 0; // NOLINT(build/unsigned)
+    size_t max_book_size = 0;
+    LatencyHistogram completion_latency;
+    LatencyHistogram trigger_record_send_time;
+  };
+  mutable RunStatistics m_run_stats;
 };
 } // namespace dfmodules
 } // namespace dunedaq
@@ -0,0 +1,237 @@
+/**
+ * @file ArrivalTrace.cpp ArrivalTraceWriter and ArrivalTraceReader Classes Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ArrivalTrace.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+const size_t s_io_buffer_size = 1 << 20;
+
+struct DecisionPreamble
+{
+  uint64_t trigger_number;    // NOLINT(build/unsigned)
+  uint64_t trigger_timestamp; // NOLINT(build/unsigned)
+  uint32_t run_number;        // NOLINT(build/unsigned)
+  uint16_t trigger_type;      // NOLINT(build/unsigned)
+  uint16_t readout_type;      // NOLINT(build/unsigned)
+  uint64_t n_components;      // NOLINT(build/unsigned)
+};
+
+uint64_t // NOLINT(build/unsigned)
+now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+} // namespace
+
+std::string
+ArrivalTraceWriter::file_name(const std::string& directory,
+                              const std::string& module_name,
+                              daqdataformats::run_number_t run_number)
+{
+  std::ostringstream filename;
+  filename << directory << "/" << module_name << "_run" << std::setw(6) << std::setfill('0') << run_number
+           << ".arrivals";
+  return filename.str();
+}
+
+ArrivalTraceWriter::ArrivalTraceWriter(const std::string& filename, bool payload_sizes)
+  : m_filename(filename)
+  , m_payload_sizes(payload_sizes)
+  , m_buffer(s_io_buffer_size)
+{
+  m_file = std::fopen(filename.c_str(), "wb");
+  if (m_file == nullptr) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+  std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+
+  uint32_t magic = s_magic;     // NOLINT(build/unsigned)
+  uint32_t version = s_version; // NOLINT(build/unsigned)
+  write_bytes(&magic, sizeof(magic));
+  write_bytes(&version, sizeof(version));
+}
+
+ArrivalTraceWriter::~ArrivalTraceWriter()
+{
+  try {
+    close();
+  } catch (const ArrivalTraceError& excpt) {
+    ers::error(excpt);
+  }
+}
+
+void
+ArrivalTraceWriter::write_bytes(const void* data, size_t size)
+{
+  if (std::fwrite(data, 1, size, m_file) != size) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+}
+
+void
+ArrivalTraceWriter::write_entry_header(ArrivalType type, size_t body_size)
+{
+  if (m_file == nullptr) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, "the file is closed");
+  }
+  uint32_t type_value = static_cast<uint32_t>(type); // NOLINT(build/unsigned)
+  uint32_t size_value = body_size;                   // NOLINT(build/unsigned)
+  uint64_t time = now_ns();                          // NOLINT(build/unsigned)
+  write_bytes(&type_value, sizeof(type_value));
+  write_bytes(&size_value, sizeof(size_value));
+  write_bytes(&time, sizeof(time));
+  ++m_entries;
+}
+
+void
+ArrivalTraceWriter::record(const dfmessages::TriggerDecision& decision)
+{
+  DecisionPreamble preamble;
+  preamble.trigger_number = decision.trigger_number;
+  preamble.trigger_timestamp = decision.trigger_timestamp;
+  preamble.run_number = decision.run_number;
+  preamble.trigger_type = decision.trigger_type;
+  preamble.readout_type = static_cast<uint16_t>(decision.readout_type); // NOLINT(build/unsigned)
+  preamble.n_components = decision.components.size();
+
+  auto components_size = decision.components.size() * sizeof(daqdataformats::ComponentRequest);
+  write_entry_header(ArrivalType::kTriggerDecision, sizeof(preamble) + components_size);
+  write_bytes(&preamble, sizeof(preamble));
+  write_bytes(decision.components.data(), components_size);
+}
+
+void
+ArrivalTraceWriter::record(const daqdataformats::Fragment& fragment)
+{
+  auto header = fragment.get_header();
+  if (!m_payload_sizes) {
+    header.size = sizeof(header);
+  }
+  write_entry_header(ArrivalType::kFragment, sizeof(header));
+  write_bytes(&header, sizeof(header));
+}
+
+void
+ArrivalTraceWriter::close()
+{
+  if (m_file == nullptr) {
+    return;
+  }
+  auto file = std::exchange(m_file, nullptr);
+  bool flushed = std::fflush(file) == 0;
+  auto error = errno;
+  std::fclose(file);
+  if (!flushed) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, std::strerror(error));
+  }
+  TLOG_DEBUG(5) << "Arrival trace " << m_filename << " closed with " << m_entries << " entries";
+}
+
+ArrivalTraceReader::ArrivalTraceReader(const std::string& filename)
+  : m_filename(filename)
+  , m_buffer(s_io_buffer_size)
+{
+  m_file = std::fopen(filename.c_str(), "rb");
+  if (m_file == nullptr) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+  std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+
+  uint32_t magic = 0;   // NOLINT(build/unsigned)
+  uint32_t version = 0; // NOLINT(build/unsigned)
+  if (!read_bytes(&magic, sizeof(magic)) || magic != ArrivalTraceWriter::s_magic ||
+      !read_bytes(&version, sizeof(version)) || version != ArrivalTraceWriter::s_version) {
+    std::fclose(m_file);
+    throw ArrivalTraceError(ERS_HERE, m_filename, "not an arrival trace, or an unsupported version");
+  }
+}
+
+ArrivalTraceReader::~ArrivalTraceReader()
+{
+  std::fclose(m_file);
+}
+
+bool
+ArrivalTraceReader::read_bytes(void* data, size_t size)
+{
+  return std::fread(data, 1, size, m_file) == size;
+}
+
+bool
+ArrivalTraceReader::next(ArrivalTraceEntry& entry)
+{
+  uint32_t type = 0; // NOLINT(build/unsigned)
+  auto n_read = std::fread(&type, 1, sizeof(type), m_file);
+  if (n_read == 0 && std::feof(m_file)) {
+    return false;
+  }
+
+  uint32_t body_size = 0; // NOLINT(build/unsigned)
+  if (n_read != sizeof(type) || !read_bytes(&body_size, sizeof(body_size)) ||
+      !read_bytes(&entry.arrival_time_ns, sizeof(entry.arrival_time_ns))) {
+    throw ArrivalTraceError(ERS_HERE, m_filename, "truncated entry");
+  }
+
+  entry.type = static_cast<ArrivalType>(type);
+  switch (entry.type) {
+    case ArrivalType::kTriggerDecision: {
+      DecisionPreamble preamble;
+      if (body_size < sizeof(preamble) || !read_bytes(&preamble, sizeof(preamble)) ||
+          body_size != sizeof(preamble) + preamble.n_components * sizeof(daqdataformats::ComponentRequest)) {
+        throw ArrivalTraceError(ERS_HERE, m_filename, "invalid trigger decision");
+      }
+      auto& decision = entry.decision;
+      decision.trigger_number = preamble.trigger_number;
+      decision.trigger_timestamp = preamble.trigger_timestamp;
+      decision.run_number = preamble.run_number;
+      decision.trigger_type = preamble.trigger_type;
+      decision.readout_type = static_cast<dfmessages::ReadoutType>(preamble.readout_type);
+      decision.components.resize(preamble.n_components);
+      if (!read_bytes(decision.components.data(), body_size - sizeof(preamble))) {
+        throw ArrivalTraceError(ERS_HERE, m_filename, "truncated trigger decision");
+      }
+      break;
+    }
+    case ArrivalType::kFragment:
+      if (body_size != sizeof(entry.fragment) || !read_bytes(&entry.fragment, sizeof(entry.fragment))) {
+        throw ArrivalTraceError(ERS_HERE, m_filename, "invalid fragment header");
+      }
+      break;
+    default:
+      throw ArrivalTraceError(ERS_HERE, m_filename, "unknown entry type " + std::to_string(type));
+  }
+  return true;
+}
+
+std::unique_ptr<daqdataformats::Fragment>
+ArrivalTraceReader::make_fragment(const daqdataformats::FragmentHeader& header)
+{
+  size_t payload_size = header.size > sizeof(header) ? header.size - sizeof(header) : 0;
+  std::vector<char> payload(payload_size, 0);
+  auto fragment = std::make_unique<daqdataformats::Fragment>(payload.data(), payload.size());
+  fragment->set_header_fields(header);
+  return fragment;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
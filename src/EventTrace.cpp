@@ -0,0 +1,368 @@
+/**
+ * @file EventTrace.cpp EventTrace Class Implementation
+ *
+ * See EventTrace.hpp for a description of the trace and of its configuration.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/EventTrace.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+// Buffers of threads that have exited are kept until their events have been
+// dumped, but only up to this much memory, oldest dropped first
+constexpr size_t s_max_retired_bytes = 64 * 1024 * 1024;
+
+constexpr size_t s_default_events_per_thread = 65536;
+
+constexpr char s_file_magic[8] = { 'D', 'F', 'T', 'R', 'A', 'C', 'E', '1' };
+
+std::string
+current_thread_name()
+{
+  char name[32] = { 0 };
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) != 0) {
+    return "";
+  }
+  return name;
+}
+
+size_t
+round_up_to_power_of_two(size_t value)
+{
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+struct ThreadBufferHandle
+{
+  std::shared_ptr<EventTraceBuffer> buffer;
+  bool failed = false;
+
+  ~ThreadBufferHandle()
+  {
+    if (buffer) {
+      buffer->retire(current_thread_name());
+    }
+  }
+};
+
+thread_local ThreadBufferHandle tl_handle;
+
+template<typename T>
+void
+write_value(std::ofstream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T)); // NOLINT
+}
+
+void
+write_string(std::ofstream& out, const std::string& value)
+{
+  write_value(out, static_cast<uint32_t>(value.size()));
+  out.write(value.data(), value.size());
+}
+
+} // namespace
+
+std::atomic<bool> EventTrace::s_enabled{ false };
+
+EventTraceBuffer::EventTraceBuffer(size_t capacity, uint64_t thread_id)
+  : m_slots(new Slot[round_up_to_power_of_two(capacity)])
+  , m_capacity(round_up_to_power_of_two(capacity))
+  , m_mask(m_capacity - 1)
+  , m_thread_id(thread_id)
+  , m_thread_name(current_thread_name())
+{}
+
+std::vector<TraceEvent>
+EventTraceBuffer::snapshot(uint16_t source, uint64_t after, uint64_t until) const
+{
+  auto end = m_next.load(std::memory_order_acquire);
+  auto begin = end > m_capacity ? end - m_capacity : 0;
+
+  std::vector<TraceEvent> events;
+  for (auto index = begin; index < end; ++index) {
+    const auto& slot = m_slots[index & m_mask];
+    auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != index + 1) {
+      // already overwritten by a newer event
+      continue;
+    }
+    TraceEvent event;
+    event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    event.argument = slot.argument.load(std::memory_order_relaxed);
+    event.extra = slot.extra.load(std::memory_order_relaxed);
+    event.type = slot.type.load(std::memory_order_relaxed);
+    event.source = slot.source.load(std::memory_order_relaxed);
+
+    // if the owning thread started rewriting the slot while it was copied,
+    // the copy may mix two events and is dropped
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    if (event.source == source && event.timestamp > after && event.timestamp <= until) {
+      events.push_back(event);
+    }
+  }
+
+  return events;
+}
+
+bool
+EventTraceBuffer::is_dumped(const std::vector<uint64_t>& dump_marks) const
+{
+  auto end = m_next.load(std::memory_order_acquire);
+  auto begin = end > m_capacity ? end - m_capacity : 0;
+
+  for (auto index = begin; index < end; ++index) {
+    const auto& slot = m_slots[index & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+      continue;
+    }
+    auto source = slot.source.load(std::memory_order_relaxed);
+    if (source >= dump_marks.size() || slot.timestamp.load(std::memory_order_relaxed) > dump_marks[source]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string
+EventTraceBuffer::get_thread_name() const
+{
+  std::lock_guard<std::mutex> lk(m_name_mutex);
+  return m_thread_name;
+}
+
+void
+EventTraceBuffer::retire(const std::string& thread_name)
+{
+  {
+    std::lock_guard<std::mutex> lk(m_name_mutex);
+    if (!thread_name.empty()) {
+      m_thread_name = thread_name;
+    }
+  }
+  m_retired.store(true, std::memory_order_release);
+}
+
+EventTrace&
+EventTrace::get()
+{
+  static EventTrace s_instance;
+  return s_instance;
+}
+
+EventTrace::EventTrace()
+  : m_events_per_thread(s_default_events_per_thread)
+{
+  const char* directory = std::getenv("DFMODULES_EVENT_TRACE_DIR");
+  if (directory == nullptr || std::strlen(directory) == 0) {
+    return;
+  }
+
+  size_t events_per_thread = s_default_events_per_thread;
+  const char* events = std::getenv("DFMODULES_EVENT_TRACE_EVENTS");
+  if (events != nullptr) {
+    auto requested = std::strtoull(events, nullptr, 10);
+    if (requested > 0) {
+      events_per_thread = requested;
+    }
+  }
+
+  enable(directory, events_per_thread);
+}
+
+void
+EventTrace::enable(const std::string& directory, size_t events_per_thread)
+{
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_directory = directory;
+    m_events_per_thread = std::max<size_t>(events_per_thread, 1);
+  }
+  s_enabled.store(true, std::memory_order_relaxed);
+  TLOG() << "Dataflow event tracing enabled, " << round_up_to_power_of_two(events_per_thread)
+         << " events per thread, dumps written to " << directory;
+}
+
+uint16_t
+EventTrace::register_source(const std::string& name)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto it = std::find(m_sources.begin(), m_sources.end(), name);
+  if (it != m_sources.end()) {
+    return static_cast<uint16_t>(it - m_sources.begin());
+  }
+  m_sources.push_back(name);
+  m_dump_marks.push_back(0);
+  return static_cast<uint16_t>(m_sources.size() - 1);
+}
+
+size_t
+EventTrace::get_retired_bytes()
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  size_t retired_bytes = 0;
+  for (const auto& buffer : m_buffers) {
+    if (buffer->is_retired()) {
+      retired_bytes += buffer->get_memory_size();
+    }
+  }
+  return retired_bytes;
+}
+
+EventTraceBuffer*
+EventTrace::local_buffer() noexcept
+{
+  if (!tl_handle.buffer && !tl_handle.failed) {
+    try {
+      tl_handle.buffer = get().create_buffer();
+    } catch (...) {
+      // without memory for a buffer this thread simply does not trace
+      tl_handle.failed = true;
+    }
+  }
+  return tl_handle.buffer.get();
+}
+
+std::shared_ptr<EventTraceBuffer>
+EventTrace::create_buffer()
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+
+  size_t retired_bytes = 0;
+  for (const auto& buffer : m_buffers) {
+    if (buffer->is_retired()) {
+      retired_bytes += buffer->get_memory_size();
+    }
+  }
+  // m_buffers is in creation order, so the oldest retired buffers go first
+  for (auto it = m_buffers.begin(); it != m_buffers.end() && retired_bytes > s_max_retired_bytes;) {
+    if ((*it)->is_retired()) {
+      retired_bytes -= (*it)->get_memory_size();
+      it = m_buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto buffer = std::make_shared<EventTraceBuffer>(m_events_per_thread, static_cast<uint64_t>(syscall(SYS_gettid)));
+  m_buffers.push_back(buffer);
+  return buffer;
+}
+
+std::string
+EventTrace::dump(uint16_t source, const std::string& label)
+{
+  if (!enabled()) {
+    return "";
+  }
+
+  // the pair of clock readings allows the converter to place the steady clock
+  // timestamps of the events on the wall clock
+  auto steady_now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+  auto system_now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+
+  std::vector<std::shared_ptr<EventTraceBuffer>> buffers;
+  std::string directory;
+  uint64_t dumped_until = 0;
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    buffers = m_buffers;
+    directory = m_directory;
+    if (source < m_dump_marks.size()) {
+      dumped_until = m_dump_marks[source];
+    }
+  }
+
+  std::string safe_label = label;
+  std::replace_if(safe_label.begin(), safe_label.end(), [](char c) { return c == '/' || c == ' '; }, '_');
+  auto filename = directory + "/" + safe_label + "_" + std::to_string(getpid()) + "_" +
+                  std::to_string(m_dump_counter.fetch_add(1)) + ".dftrace";
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    ers::warning(EventTraceDumpFailed(ERS_HERE, label, filename, std::strerror(errno)));
+    return "";
+  }
+
+  out.write(s_file_magic, sizeof(s_file_magic));
+  write_value(out, static_cast<uint32_t>(getpid()));
+  write_value(out, static_cast<uint64_t>(steady_now));
+  write_value(out, static_cast<uint64_t>(system_now));
+  write_string(out, label);
+
+  std::vector<std::pair<std::shared_ptr<EventTraceBuffer>, std::vector<TraceEvent>>> per_thread;
+  size_t total = 0;
+  for (auto& buffer : buffers) {
+    auto events = buffer->snapshot(source, dumped_until, steady_now);
+    if (!events.empty()) {
+      total += events.size();
+      per_thread.emplace_back(buffer, std::move(events));
+    }
+  }
+
+  write_value(out, static_cast<uint32_t>(per_thread.size()));
+  for (auto& [buffer, events] : per_thread) {
+    write_value(out, buffer->get_thread_id());
+    write_string(out, buffer->get_thread_name());
+    write_value(out, static_cast<uint64_t>(events.size()));
+    out.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(TraceEvent)); // NOLINT
+  }
+
+  out.close();
+  if (out.fail()) {
+    ers::warning(EventTraceDumpFailed(ERS_HERE, label, filename, "write error"));
+    return "";
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (source < m_dump_marks.size()) {
+      m_dump_marks[source] = std::max<uint64_t>(m_dump_marks[source], steady_now);
+    }
+    // the buffers of exited threads are no longer needed once every event
+    // they hold has been dumped
+    m_buffers.erase(std::remove_if(m_buffers.begin(),
+                                   m_buffers.end(),
+                                   [this](const auto& b) { return b->is_retired() && b->is_dumped(m_dump_marks); }),
+                    m_buffers.end());
+  }
+
+  TLOG() << "Dumped " << total << " trace events from " << per_thread.size() << " threads to " << filename;
+  return filename;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
@@ -0,0 +1,212 @@
+/**
+ * @file FileImageWriter.cpp FileImageWriter Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/FileImageWriter.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+FileImageWriter::FileImageWriter(size_t queue_depth, bool sync)
+  : m_queue_depth(queue_depth)
+  , m_sync(sync)
+{
+  if (m_queue_depth > 0) {
+    m_thread = std::thread(&FileImageWriter::run, this);
+  }
+}
+
+FileImageWriter::~FileImageWriter()
+{
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    m_stop = true;
+  }
+  m_not_empty.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+std::vector<char>
+FileImageWriter::load(const std::string& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileImageWriteFailed(ERS_HERE, path, std::strerror(errno));
+  }
+  std::vector<char> image;
+  char buffer[1 << 16];
+  while (true) {
+    auto n = ::read(fd, buffer, sizeof(buffer));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      auto error = errno;
+      ::close(fd);
+      throw FileImageWriteFailed(ERS_HERE, path, std::strerror(error));
+    }
+    if (n == 0)
+      break;
+    image.insert(image.end(), buffer, buffer + n);
+  }
+  ::close(fd);
+  return image;
+}
+
+void
+FileImageWriter::write_image(const std::string& destination, const std::vector<char>& image, bool sync)
+{
+  std::string temporary = destination + ".writing";
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw FileImageWriteFailed(ERS_HERE, destination, std::strerror(errno));
+  }
+
+  int error = 0;
+  size_t done = 0;
+  while (done < image.size()) {
+    auto written = ::write(fd, image.data() + done, image.size() - done);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      error = errno;
+      break;
+    }
+    done += written;
+  }
+  if (error == 0 && sync && ::fsync(fd) != 0) {
+    error = errno;
+  }
+  if (::close(fd) != 0 && error == 0) {
+    error = errno;
+  }
+  if (error == 0 && std::rename(temporary.c_str(), destination.c_str()) != 0) {
+    error = errno;
+  }
+  if (error == 0 && sync) {
+    // the rename is only durable once the directory is
+    auto directory = std::filesystem::path(destination).parent_path();
+    int dir_fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+      ::fsync(dir_fd);
+      ::close(dir_fd);
+    }
+  }
+  if (error != 0) {
+    std::remove(temporary.c_str());
+    throw FileImageWriteFailed(ERS_HERE, destination, std::strerror(error));
+  }
+}
+
+void
+FileImageWriter::submit(std::string destination, std::vector<char> image, std::string staged_file)
+{
+  if (m_queue_depth == 0) {
+    write_and_count({ std::move(destination), std::move(image), std::move(staged_file) });
+    return;
+  }
+  {
+    auto lk = std::unique_lock<std::mutex>(m_mutex);
+    m_changed.wait(lk, [this] { return m_images.size() < m_queue_depth; });
+    m_images.push_back({ std::move(destination), std::move(image), std::move(staged_file) });
+  }
+  m_not_empty.notify_one();
+}
+
+void
+FileImageWriter::drain()
+{
+  auto lk = std::unique_lock<std::mutex>(m_mutex);
+  m_changed.wait(lk, [this] { return m_images.empty() && !m_writing; });
+}
+
+size_t
+FileImageWriter::queued() const
+{
+  auto lk = std::lock_guard<std::mutex>(m_mutex);
+  return m_images.size() + (m_writing ? 1 : 0);
+}
+
+void
+FileImageWriter::write_and_count(const Image& image)
+{
+  auto start = std::chrono::steady_clock::now();
+  try {
+    write_image(image.destination, image.bytes, m_sync);
+  } catch (const FileImageWriteFailed&) {
+    ++m_counters.write_failures;
+    if (!image.staged_file.empty()) {
+      // the staged file is the only copy of the data left
+      ++m_counters.staged_files_kept;
+      ers::warning(StagedFileKept(ERS_HERE, image.staged_file, image.destination));
+    }
+    throw;
+  }
+  if (!image.staged_file.empty()) {
+    std::error_code error;
+    std::filesystem::remove(image.staged_file, error);
+  }
+  uint64_t write_time_us = // NOLINT(build/unsigned)
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  ++m_counters.images_written;
+  m_counters.bytes_written += image.bytes.size();
+  if (write_time_us > m_counters.max_write_time_us) {
+    m_counters.max_write_time_us = write_time_us;
+  }
+  TLOG_DEBUG(14) << "Wrote the file image " << image.destination << ", " << image.bytes.size() << " bytes in "
+                 << write_time_us << " us";
+}
+
+void
+FileImageWriter::run()
+{
+  while (true) {
+    Image image;
+    {
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_not_empty.wait(lk, [this] { return m_stop || !m_images.empty(); });
+      if (m_images.empty()) {
+        return;
+      }
+      image = std::move(m_images.front());
+      m_images.pop_front();
+      m_writing = true;
+    }
+    m_changed.notify_all();
+
+    try {
+      write_and_count(image);
+    } catch (const FileImageWriteFailed& excpt) {
+      ers::error(excpt);
+    }
+
+    {
+      auto lk = std::lock_guard<std::mutex>(m_mutex);
+      m_writing = false;
+    }
+    m_changed.notify_all();
+  }
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
@@ -0,0 +1,357 @@
+/**
+ * @file FileMigrator.cpp FileMigrator Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/FileMigrator.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <fcntl.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+uint64_t // NOLINT(build/unsigned)
+elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void
+sync_directory(const std::string& directory)
+{
+  int dir_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd >= 0) {
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+  }
+}
+
+} // namespace
+
+FileMigrator::FileMigrator(std::string staging_directory,
+                           std::string bulk_directory,
+                           uint64_t bandwidth_bytes,        // NOLINT(build/unsigned)
+                           uint64_t staging_min_free_bytes, // NOLINT(build/unsigned)
+                           size_t chunk_bytes)
+  : m_staging_directory(std::move(staging_directory))
+  , m_bulk_directory(std::move(bulk_directory))
+  , m_bandwidth_bytes(bandwidth_bytes)
+  , m_staging_min_free_bytes(staging_min_free_bytes)
+  , m_chunk_bytes(std::max<size_t>(chunk_bytes, 4096))
+{
+  m_thread = std::thread(&FileMigrator::run, this);
+}
+
+FileMigrator::~FileMigrator()
+{
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    m_stop = true;
+  }
+  m_changed.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (!m_entries.empty()) {
+    ers::warning(FilesLeftInStaging(ERS_HERE, m_staging_directory, m_bulk_directory, m_entries.size()));
+  }
+}
+
+void
+FileMigrator::submit(const std::string& path)
+{
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    m_entries.push_back({ path, std::chrono::steady_clock::now(), false });
+  }
+  m_changed.notify_all();
+}
+
+void
+FileMigrator::recover_interrupted(const std::string& name_fragment)
+{
+  static const std::string s_suffix = ".hdf5.migrating";
+  auto interrupted = [&](const std::filesystem::directory_entry& entry) {
+    std::error_code ec;
+    auto name = entry.path().filename().string();
+    return entry.is_regular_file(ec) && name.find(name_fragment) != std::string::npos &&
+           name.size() > s_suffix.size() &&
+           name.compare(name.size() - s_suffix.size(), s_suffix.size(), s_suffix) == 0;
+  };
+  // the file this migrator is moving right now is not interrupted
+  auto in_progress = [&](const std::string& name) {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    return !m_current_path.empty() && std::filesystem::path(m_current_path).filename().string() + ".migrating" == name;
+  };
+
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(m_bulk_directory, ec)) {
+    auto name = entry.path().filename().string();
+    if (interrupted(entry) && !in_progress(name)) {
+      TLOG() << "Removing the partial copy " << entry.path().string() << " of an interrupted migration";
+      std::filesystem::remove(entry.path(), ec);
+    }
+  }
+
+  for (const auto& entry : std::filesystem::directory_iterator(m_staging_directory, ec)) {
+    auto name = entry.path().filename().string();
+    if (!interrupted(entry) || in_progress(name)) {
+      continue;
+    }
+    auto original = name.substr(0, name.size() - std::string(".migrating").size());
+    auto path = (std::filesystem::path(m_staging_directory) / original).string();
+    auto destination = std::filesystem::path(m_bulk_directory) / original;
+    std::error_code size_ec;
+    if (std::filesystem::exists(destination, size_ec) &&
+        std::filesystem::file_size(destination, size_ec) == entry.file_size(size_ec) && !size_ec) {
+      // interrupted after the copy was in place, only the removal was missing
+      TLOG() << "Removing " << entry.path().string() << ", already moved to " << destination.string();
+      std::filesystem::remove(entry.path(), ec);
+    } else {
+      TLOG() << "Giving " << path << " back to the staging directory after an interrupted migration";
+      std::filesystem::rename(entry.path(), path, ec);
+    }
+  }
+}
+
+size_t
+FileMigrator::submit_existing(const std::string& name_fragment)
+{
+  recover_interrupted(name_fragment);
+
+  size_t count = 0;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(m_staging_directory, ec)) {
+    auto name = entry.path().filename().string();
+    if (!entry.is_regular_file(ec) || name.find(name_fragment) == std::string::npos || name.size() <= 5 ||
+        name.compare(name.size() - 5, 5, ".hdf5") != 0) {
+      continue;
+    }
+    auto path = entry.path().string();
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    if (path == m_current_path ||
+        std::any_of(m_entries.begin(), m_entries.end(), [&](const Entry& queued) { return queued.path == path; })) {
+      continue;
+    }
+    m_entries.push_back({ path, std::chrono::steady_clock::now(), true });
+    ++count;
+  }
+  if (count > 0) {
+    m_changed.notify_all();
+  }
+  return count;
+}
+
+bool
+FileMigrator::wait_until_idle(std::chrono::milliseconds timeout)
+{
+  auto lk = std::unique_lock<std::mutex>(m_mutex);
+  return m_changed.wait_for(lk, timeout, [this] { return m_entries.empty() && !m_migrating; });
+}
+
+size_t
+FileMigrator::pending() const
+{
+  auto lk = std::lock_guard<std::mutex>(m_mutex);
+  return m_entries.size() + (m_migrating ? 1 : 0);
+}
+
+uint64_t // NOLINT(build/unsigned)
+FileMigrator::staging_free_bytes() const
+{
+  struct statvfs vfs_results;
+  if (statvfs(m_staging_directory.c_str(), &vfs_results) != 0) {
+    return std::numeric_limits<uint64_t>::max(); // NOLINT(build/unsigned)
+  }
+  return static_cast<uint64_t>(vfs_results.f_bsize) * vfs_results.f_bavail; // NOLINT(build/unsigned)
+}
+
+void
+FileMigrator::copy(const std::string& from, const std::string& to, uint64_t& bytes) // NOLINT(build/unsigned)
+{
+  int in_fd = ::open(from.c_str(), O_RDONLY);
+  if (in_fd < 0) {
+    throw FileMigrationFailed(ERS_HERE, from, m_bulk_directory, std::strerror(errno));
+  }
+  int out_fd = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out_fd < 0) {
+    auto error = errno;
+    ::close(in_fd);
+    throw FileMigrationFailed(ERS_HERE, from, m_bulk_directory, std::strerror(error));
+  }
+
+  std::vector<char> buffer(m_chunk_bytes);
+  auto start = std::chrono::steady_clock::now();
+  bool urgent = false;
+  int error = 0;
+  while (error == 0 && !m_stop) {
+    auto n = ::read(in_fd, buffer.data(), buffer.size());
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      error = errno;
+      break;
+    }
+    if (n == 0)
+      break;
+    ssize_t done = 0;
+    while (done < n) {
+      auto written = ::write(out_fd, buffer.data() + done, n - done);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        error = errno;
+        break;
+      }
+      done += written;
+    }
+    bytes += done;
+
+    // keep to the bandwidth cap, unless the staging tier runs out of space
+    if (m_bandwidth_bytes == 0) {
+      continue;
+    }
+    if (m_staging_min_free_bytes > 0 && staging_free_bytes() < m_staging_min_free_bytes) {
+      urgent = true;
+      continue;
+    }
+    auto due = start + std::chrono::microseconds(bytes * 1000000 / m_bandwidth_bytes);
+    if (due > std::chrono::steady_clock::now()) {
+      auto wait_start = std::chrono::steady_clock::now();
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_changed.wait_until(lk, due, [this] { return m_stop.load(); });
+      m_counters.throttled_time_us += elapsed_us(wait_start);
+    }
+  }
+  if (error == 0 && !m_stop && ::fsync(out_fd) != 0) {
+    error = errno;
+  }
+  ::close(in_fd);
+  if (::close(out_fd) != 0 && error == 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    throw FileMigrationFailed(ERS_HERE, from, m_bulk_directory, std::strerror(error));
+  }
+  if (urgent) {
+    ++m_counters.urgent_files;
+  }
+}
+
+FileMigrator::Outcome
+FileMigrator::migrate(const std::string& path)
+{
+  auto name = std::filesystem::path(path).filename().string();
+  auto claimed = path + ".migrating";
+  auto temporary = (std::filesystem::path(m_bulk_directory) / (name + ".migrating")).string();
+  auto destination = (std::filesystem::path(m_bulk_directory) / name).string();
+
+  // claim the file, so that no other migrator moves it
+  if (std::rename(path.c_str(), claimed.c_str()) != 0) {
+    if (errno == ENOENT) {
+      return Outcome::kMissing;
+    }
+    throw FileMigrationFailed(ERS_HERE, path, m_bulk_directory, std::strerror(errno));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t bytes = 0; // NOLINT(build/unsigned)
+  try {
+    copy(claimed, temporary, bytes);
+    if (!m_stop && std::rename(temporary.c_str(), destination.c_str()) != 0) {
+      throw FileMigrationFailed(ERS_HERE, path, m_bulk_directory, std::strerror(errno));
+    }
+  } catch (const FileMigrationFailed&) {
+    // give the file back to the staging directory, for a later attempt
+    std::remove(temporary.c_str());
+    std::rename(claimed.c_str(), path.c_str());
+    throw;
+  }
+  if (m_stop) {
+    std::remove(temporary.c_str());
+    std::rename(claimed.c_str(), path.c_str());
+    return Outcome::kStopped;
+  }
+  sync_directory(m_bulk_directory);
+  std::remove(claimed.c_str());
+
+  auto time_us = elapsed_us(start);
+  ++m_counters.files_migrated;
+  m_counters.bytes_migrated += bytes;
+  m_counters.migration_time_us += time_us;
+  TLOG_DEBUG(14) << "Moved " << path << " to " << destination << ", " << bytes << " bytes in " << time_us << " us";
+  return Outcome::kDone;
+}
+
+void
+FileMigrator::run()
+{
+  while (true) {
+    Entry entry;
+    {
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_changed.wait(lk, [this] { return m_stop || !m_entries.empty(); });
+      if (m_stop) {
+        return;
+      }
+      entry = std::move(m_entries.front());
+      m_entries.pop_front();
+      m_migrating = true;
+      m_current_path = entry.path;
+    }
+
+    auto outcome = Outcome::kDone;
+    try {
+      outcome = migrate(entry.path);
+    } catch (const FileMigrationFailed& excpt) {
+      ++m_counters.failures;
+      ers::error(excpt);
+    }
+
+    // a file that does not exist yet may still be being written
+    bool retry = false;
+    if (outcome == Outcome::kMissing && !entry.found) {
+      if (std::chrono::steady_clock::now() - entry.submitted < s_missing_file_timeout) {
+        retry = true;
+      } else {
+        ++m_counters.failures;
+        ers::warning(FileMigrationFailed(ERS_HERE, entry.path, m_bulk_directory, "the file never appeared"));
+      }
+    }
+
+    {
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_migrating = false;
+      m_current_path.clear();
+      if (outcome == Outcome::kStopped || retry) {
+        m_entries.push_back(std::move(entry));
+      }
+      m_changed.notify_all();
+      if (retry) {
+        m_changed.wait_for(lk, std::chrono::milliseconds(100), [this] { return m_stop.load(); });
+      }
+    }
+  }
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
@@ -0,0 +1,153 @@
+/**
+ * @file PackedFragments.cpp PackedFragmentWriter and PackedRecordReader Classes Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/PackedFragments.hpp"
+
+#include "highfive/H5DataSet.hpp"
+#include "highfive/H5DataSpace.hpp"
+#include "highfive/H5Group.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+size_t
+aligned(size_t offset)
+{
+  return (offset + PackedFragmentWriter::s_alignment - 1) / PackedFragmentWriter::s_alignment *
+         PackedFragmentWriter::s_alignment;
+}
+
+HighFive::Group
+packed_group(HighFive::File& file)
+{
+  if (file.exist(PackedFragmentWriter::s_group_name)) {
+    return file.getGroup(PackedFragmentWriter::s_group_name);
+  }
+  return file.createGroup(PackedFragmentWriter::s_group_name);
+}
+
+} // namespace
+
+HighFive::CompoundType
+make_packed_fragment_entry_type()
+{
+  return HighFive::CompoundType(
+    { { "subsystem", HighFive::create_datatype<uint32_t>(), offsetof(PackedFragmentEntry, subsystem) },
+      { "id", HighFive::create_datatype<uint32_t>(), offsetof(PackedFragmentEntry, id) },
+      { "offset", HighFive::create_datatype<uint64_t>(), offsetof(PackedFragmentEntry, offset) },
+      { "size", HighFive::create_datatype<uint64_t>(), offsetof(PackedFragmentEntry, size) } },
+    sizeof(PackedFragmentEntry));
+}
+
+std::string
+PackedFragmentWriter::record_name(daqdataformats::trigger_number_t trigger_number,
+                                  daqdataformats::sequence_number_t sequence_number)
+{
+  char name[64];
+  std::snprintf(name,
+                sizeof(name),
+                "Record%010llu.%04u",
+                static_cast<unsigned long long>(trigger_number), // NOLINT(runtime/int)
+                static_cast<unsigned>(sequence_number));
+  return name;
+}
+
+size_t
+PackedFragmentWriter::write(HighFive::File& file,
+                            daqdataformats::trigger_number_t trigger_number,
+                            daqdataformats::sequence_number_t sequence_number,
+                            const std::vector<const daqdataformats::Fragment*>& fragments)
+{
+  std::vector<PackedFragmentEntry> index;
+  index.reserve(fragments.size());
+  size_t total = 0;
+  for (const auto* fragment : fragments) {
+    total = aligned(total);
+    auto source_id = fragment->get_element_id();
+    index.push_back({ static_cast<uint32_t>(source_id.subsystem), // NOLINT(build/unsigned)
+                      source_id.id,
+                      total,
+                      fragment->get_size() });
+    total += fragment->get_size();
+  }
+
+  // one copy in memory, so that the bytes go to the file in one write
+  std::vector<char> data(total, 0);
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    std::memcpy(data.data() + index[i].offset, fragments[i]->get_storage_location(), index[i].size);
+  }
+
+  auto group = packed_group(file);
+  auto name = record_name(trigger_number, sequence_number);
+  auto data_set = group.createDataSet<char>(name, HighFive::DataSpace({ data.size() }));
+  if (!data.empty()) {
+    data_set.write_raw(data.data());
+  }
+  group.createDataSet<PackedFragmentEntry>(name + "_index", HighFive::DataSpace::From(index)).write(index);
+
+  return data.size() + index.size() * sizeof(PackedFragmentEntry);
+}
+
+bool
+PackedRecordReader::has_record(const HighFive::File& file,
+                               daqdataformats::trigger_number_t trigger_number,
+                               daqdataformats::sequence_number_t sequence_number)
+{
+  if (!file.exist(PackedFragmentWriter::s_group_name)) {
+    return false;
+  }
+  return file.getGroup(PackedFragmentWriter::s_group_name)
+    .exist(PackedFragmentWriter::record_name(trigger_number, sequence_number) + "_index");
+}
+
+PackedRecordReader::PackedRecordReader(const HighFive::File& file,
+                                       daqdataformats::trigger_number_t trigger_number,
+                                       daqdataformats::sequence_number_t sequence_number)
+{
+  if (!has_record(file, trigger_number, sequence_number)) {
+    throw PackedRecordNotFound(ERS_HERE, file.getName(), trigger_number, sequence_number);
+  }
+  auto group = file.getGroup(PackedFragmentWriter::s_group_name);
+  auto name = PackedFragmentWriter::record_name(trigger_number, sequence_number);
+  group.getDataSet(name + "_index").read(m_index);
+  group.getDataSet(name).read(m_data);
+}
+
+std::vector<daqdataformats::SourceID>
+PackedRecordReader::get_source_ids() const
+{
+  std::vector<daqdataformats::SourceID> source_ids;
+  source_ids.reserve(m_index.size());
+  for (const auto& entry : m_index) {
+    source_ids.push_back(entry.source_id());
+  }
+  return source_ids;
+}
+
+std::unique_ptr<daqdataformats::Fragment>
+PackedRecordReader::get_fragment(const daqdataformats::SourceID& source_id) const
+{
+  for (const auto& entry : m_index) {
+    if (entry.source_id() == source_id) {
+      return std::make_unique<daqdataformats::Fragment>(const_cast<char*>(m_data.data() + entry.offset), // NOLINT
+                                                        daqdataformats::Fragment::BufferAdoptionMode::kReadOnlyMode);
+    }
+  }
+  return nullptr;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
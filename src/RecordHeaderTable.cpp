@@ -0,0 +1,132 @@
+/**
+ * @file RecordHeaderTable.cpp RecordHeaderTable Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/RecordHeaderTable.hpp"
+
+#include "highfive/H5DataSpace.hpp"
+#include "highfive/H5PropertyList.hpp"
+#include "logging/Logging.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+HighFive::DataSet
+open_or_create(HighFive::File& file, size_t chunk_rows)
+{
+  if (file.exist(RecordHeaderTable::s_dataset_name)) {
+    return file.getDataSet(RecordHeaderTable::s_dataset_name);
+  }
+
+  HighFive::DataSpace space({ 0 }, { HighFive::DataSpace::UNLIMITED });
+  HighFive::DataSetCreateProps props;
+  props.add(HighFive::Chunking(std::vector<hsize_t>{ chunk_rows }));
+  return file.createDataSet(
+    RecordHeaderTable::s_dataset_name, space, HighFive::create_datatype<RecordHeaderRow>(), props);
+}
+
+} // namespace
+
+RecordHeaderRow
+RecordHeaderRow::from_header(const daqdataformats::TriggerRecordHeader& header, size_t num_fragments)
+{
+  auto data = header.get_header();
+  RecordHeaderRow row;
+  row.trigger_number = data.trigger_number;
+  row.trigger_timestamp = data.trigger_timestamp;
+  row.num_requested_components = data.num_requested_components;
+  row.num_fragments = num_fragments;
+  row.run_number = data.run_number;
+  row.error_bits = data.error_bits;
+  row.trigger_type = data.trigger_type;
+  row.sequence_number = data.sequence_number;
+  row.max_sequence_number = data.max_sequence_number;
+  return row;
+}
+
+HighFive::CompoundType
+make_record_header_row_type()
+{
+  // explicit offsets and size, so that the file type is the memory layout of the struct
+  return HighFive::CompoundType(
+    { { "trigger_number", HighFive::create_datatype<uint64_t>(), offsetof(RecordHeaderRow, trigger_number) },
+      { "trigger_timestamp", HighFive::create_datatype<uint64_t>(), offsetof(RecordHeaderRow, trigger_timestamp) },
+      { "num_requested_components",
+        HighFive::create_datatype<uint64_t>(),
+        offsetof(RecordHeaderRow, num_requested_components) },
+      { "num_fragments", HighFive::create_datatype<uint64_t>(), offsetof(RecordHeaderRow, num_fragments) },
+      { "run_number", HighFive::create_datatype<uint32_t>(), offsetof(RecordHeaderRow, run_number) },
+      { "error_bits", HighFive::create_datatype<uint32_t>(), offsetof(RecordHeaderRow, error_bits) },
+      { "trigger_type", HighFive::create_datatype<uint16_t>(), offsetof(RecordHeaderRow, trigger_type) },
+      { "sequence_number", HighFive::create_datatype<uint16_t>(), offsetof(RecordHeaderRow, sequence_number) },
+      { "max_sequence_number",
+        HighFive::create_datatype<uint16_t>(),
+        offsetof(RecordHeaderRow, max_sequence_number) } },
+    sizeof(RecordHeaderRow));
+}
+
+RecordHeaderTable::RecordHeaderTable(HighFive::File& file, size_t rows_per_flush)
+  : m_filename(file.getName())
+  , m_dataset(open_or_create(file, std::max<size_t>(rows_per_flush, 256)))
+  , m_rows_per_flush(std::max<size_t>(rows_per_flush, 1))
+  , m_rows_written(m_dataset.getDimensions().at(0))
+{
+  m_buffer.reserve(m_rows_per_flush);
+}
+
+RecordHeaderTable::~RecordHeaderTable()
+{
+  try {
+    flush();
+  } catch (const std::exception& excpt) {
+    // the destructor runs while the file is being closed, there is no one to rethrow to
+    ers::error(RecordHeaderTableError(
+      ERS_HERE, m_filename, "the last " + std::to_string(m_buffer.size()) + " rows were lost: " + excpt.what()));
+  }
+}
+
+void
+RecordHeaderTable::append(const daqdataformats::TriggerRecordHeader& header, size_t num_fragments)
+{
+  m_buffer.push_back(RecordHeaderRow::from_header(header, num_fragments));
+  if (m_buffer.size() >= m_rows_per_flush) {
+    flush();
+  }
+}
+
+void
+RecordHeaderTable::flush()
+{
+  if (m_buffer.empty()) {
+    return;
+  }
+  m_dataset.resize({ m_rows_written + m_buffer.size() });
+  m_dataset.select({ m_rows_written }, { m_buffer.size() }).write(m_buffer);
+  m_rows_written += m_buffer.size();
+  m_buffer.clear();
+}
+
+std::vector<RecordHeaderRow>
+RecordHeaderTable::read(const HighFive::File& file)
+{
+  std::vector<RecordHeaderRow> rows;
+  if (file.exist(s_dataset_name)) {
+    file.getDataSet(s_dataset_name).read(rows);
+  }
+  return rows;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
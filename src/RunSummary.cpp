@@ -0,0 +1,169 @@
+/**
+ * @file RunSummary.cpp RunSummary Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/RunSummary.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace dunedaq {
+namespace dfmodules {
+
+RunSummary&
+RunSummary::get()
+{
+  static RunSummary s_instance;
+  return s_instance;
+}
+
+void
+RunSummary::set_output_directory(const std::string& directory)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_output_directory = directory;
+}
+
+std::string
+RunSummary::application_name()
+{
+  const char* name = std::getenv("DUNEDAQ_APPLICATION_NAME");
+  if (name != nullptr && std::strlen(name) > 0) {
+    return name;
+  }
+  return "dfmodules_" + std::to_string(getpid());
+}
+
+std::string
+RunSummary::report_filename(daqdataformats::run_number_t run_number) const
+{
+  std::string directory = ".";
+  const char* env_directory = std::getenv("DFMODULES_RUN_SUMMARY_DIR");
+  if (env_directory != nullptr && std::strlen(env_directory) > 0) {
+    directory = env_directory;
+  } else if (!m_output_directory.empty()) {
+    directory = m_output_directory;
+  }
+
+  std::ostringstream filename;
+  filename << directory << "/" << application_name() << "_run" << std::setw(6) << std::setfill('0') << run_number
+           << "_performance.json";
+  return filename.str();
+}
+
+std::string
+RunSummary::add_section(daqdataformats::run_number_t run_number,
+                        const std::string& module_name,
+                        const nlohmann::json& section)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+
+  auto& modules = m_modules.try_emplace(run_number, nlohmann::json::object()).first->second;
+  modules[module_name] = section;
+  for (auto it = m_modules.begin(); m_modules.size() > s_kept_runs;) {
+    it = it->first == run_number ? std::next(it) : m_modules.erase(it);
+  }
+
+  nlohmann::json report;
+  report["application"] = application_name();
+  report["run_number"] = run_number;
+  report["written_at"] = std::time(nullptr);
+  char hostname[256] = { 0 };
+  gethostname(hostname, sizeof(hostname) - 1);
+  report["host"] = hostname;
+  report["process"] = process_statistics();
+  report["modules"] = modules;
+
+  auto filename = report_filename(run_number);
+  auto temp_filename = filename + ".tmp";
+  {
+    std::ofstream out(temp_filename, std::ios::trunc);
+    if (!out.is_open()) {
+      ers::warning(RunSummaryWriteFailed(ERS_HERE, run_number, filename, std::strerror(errno)));
+      return "";
+    }
+    out << std::setw(2) << report << std::endl;
+    if (out.fail()) {
+      ers::warning(RunSummaryWriteFailed(ERS_HERE, run_number, filename, "write error"));
+      std::remove(temp_filename.c_str());
+      return "";
+    }
+  }
+  if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    ers::warning(RunSummaryWriteFailed(ERS_HERE, run_number, filename, std::strerror(errno)));
+    std::remove(temp_filename.c_str());
+    return "";
+  }
+
+  TLOG_DEBUG(5) << "Performance summary of " << module_name << " for run " << run_number << " added to " << filename;
+  return filename;
+}
+
+nlohmann::json
+RunSummary::summarise(const LatencyHistogram& histogram)
+{
+  auto to_us = [](LatencyHistogram::duration_t d) { return static_cast<double>(d.count()) / 1000.; };
+
+  nlohmann::json summary;
+  summary["count"] = histogram.count();
+  summary["mean_us"] = to_us(histogram.mean());
+  summary["min_us"] = to_us(histogram.min());
+  summary["p50_us"] = to_us(histogram.quantile(0.5));
+  summary["p90_us"] = to_us(histogram.quantile(0.9));
+  summary["p99_us"] = to_us(histogram.quantile(0.99));
+  summary["p999_us"] = to_us(histogram.quantile(0.999));
+  summary["max_us"] = to_us(histogram.max());
+  return summary;
+}
+
+double
+RunSummary::rate(double count, std::chrono::steady_clock::duration duration)
+{
+  auto seconds = std::chrono::duration<double>(duration).count();
+  return seconds > 0 ? count / seconds : 0.;
+}
+
+nlohmann::json
+RunSummary::process_statistics()
+{
+  nlohmann::json stats;
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    stats["peak_rss_kB"] = usage.ru_maxrss;
+    stats["user_cpu_s"] = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    stats["system_cpu_s"] = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    stats["major_page_faults"] = usage.ru_majflt;
+    stats["voluntary_context_switches"] = usage.ru_nvcsw;
+    stats["involuntary_context_switches"] = usage.ru_nivcsw;
+  }
+
+  std::ifstream statm("/proc/self/statm");
+  long pages_total = 0;    // NOLINT(runtime/int)
+  long pages_resident = 0; // NOLINT(runtime/int)
+  if (statm >> pages_total >> pages_resident) {
+    stats["current_rss_kB"] = pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+
+  return stats;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
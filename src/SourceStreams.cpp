@@ -0,0 +1,222 @@
+/**
+ * @file SourceStreams.cpp SourceStreamWriter and SourceStreamReader Classes Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/SourceStreams.hpp"
+
+#include "highfive/H5DataSpace.hpp"
+#include "highfive/H5Group.hpp"
+#include "highfive/H5PropertyList.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+size_t
+aligned(size_t offset)
+{
+  return (offset + SourceStreamWriter::s_alignment - 1) / SourceStreamWriter::s_alignment *
+         SourceStreamWriter::s_alignment;
+}
+
+HighFive::Group
+stream_group(HighFive::File& file)
+{
+  if (file.exist(SourceStreamWriter::s_group_name)) {
+    return file.getGroup(SourceStreamWriter::s_group_name);
+  }
+  return file.createGroup(SourceStreamWriter::s_group_name);
+}
+
+template<typename T>
+HighFive::DataSet
+create_extendible(HighFive::Group& group, const std::string& name, size_t chunk_rows)
+{
+  HighFive::DataSetCreateProps props;
+  props.add(HighFive::Chunking(std::vector<hsize_t>{ std::max<hsize_t>(chunk_rows, 1) }));
+  return group.createDataSet<T>(name, HighFive::DataSpace({ 0 }, { HighFive::DataSpace::UNLIMITED }), props);
+}
+
+HighFive::DataSet
+open_stream(const HighFive::File& file, const std::string& name)
+{
+  if (!file.exist(SourceStreamWriter::s_group_name) ||
+      !file.getGroup(SourceStreamWriter::s_group_name).exist(name + "_index")) {
+    throw SourceStreamError(ERS_HERE, file.getName(), name, "no such stream in the file");
+  }
+  return file.getGroup(SourceStreamWriter::s_group_name).getDataSet(name);
+}
+
+} // namespace
+
+HighFive::CompoundType
+make_source_stream_entry_type()
+{
+  return HighFive::CompoundType(
+    { { "trigger_number", HighFive::create_datatype<uint64_t>(), offsetof(SourceStreamEntry, trigger_number) },
+      { "offset", HighFive::create_datatype<uint64_t>(), offsetof(SourceStreamEntry, offset) },
+      { "size", HighFive::create_datatype<uint64_t>(), offsetof(SourceStreamEntry, size) },
+      { "sequence_number", HighFive::create_datatype<uint16_t>(), offsetof(SourceStreamEntry, sequence_number) } },
+    sizeof(SourceStreamEntry));
+}
+
+std::string
+SourceStreamWriter::stream_name(const daqdataformats::SourceID& source_id)
+{
+  char id[16];
+  std::snprintf(id, sizeof(id), "%08u", static_cast<unsigned>(source_id.id));
+  return daqdataformats::SourceID::subsystem_to_string(source_id.subsystem) + "_" + id;
+}
+
+SourceStreamWriter::SourceStreamWriter(HighFive::File& file, size_t chunk_bytes, size_t buffer_bytes)
+  : m_file(file)
+  , m_chunk_bytes(chunk_bytes)
+  , m_buffer_bytes(buffer_bytes)
+{}
+
+SourceStreamWriter::~SourceStreamWriter()
+{
+  try {
+    flush();
+  } catch (const std::exception& excpt) {
+    ers::error(SourceStreamError(ERS_HERE, m_file.getName(), s_group_name, excpt.what()));
+  }
+}
+
+SourceStreamWriter::Stream&
+SourceStreamWriter::get_stream(const daqdataformats::SourceID& source_id)
+{
+  auto it = m_streams.find(source_id);
+  if (it != m_streams.end()) {
+    return it->second;
+  }
+
+  auto group = stream_group(m_file);
+  auto name = stream_name(source_id);
+  // index chunks hold about as many rows as there are fragments in a data chunk
+  auto data = create_extendible<char>(group, name, m_chunk_bytes);
+  auto index = create_extendible<SourceStreamEntry>(group, name + "_index", 256);
+  return m_streams.emplace(source_id, Stream{ std::move(data), std::move(index), 0, 0, {}, {} }).first->second;
+}
+
+size_t
+SourceStreamWriter::append(daqdataformats::trigger_number_t trigger_number,
+                           daqdataformats::sequence_number_t sequence_number,
+                           const daqdataformats::Fragment& fragment)
+{
+  auto& stream = get_stream(fragment.get_element_id());
+
+  auto start = aligned(stream.buffer.size());
+  auto padding = start - stream.buffer.size();
+  auto size = fragment.get_size();
+  stream.buffer.resize(start + size, 0);
+  std::memcpy(stream.buffer.data() + start, fragment.get_storage_location(), size);
+  stream.pending_rows.push_back({ trigger_number, stream.bytes_written + start, size, sequence_number });
+
+  auto bytes = padding + size + sizeof(SourceStreamEntry);
+  m_buffered_bytes += bytes;
+  if (m_buffered_bytes >= m_buffer_bytes) {
+    flush();
+  }
+  return bytes;
+}
+
+void
+SourceStreamWriter::flush()
+{
+  for (auto& [source_id, stream] : m_streams) {
+    flush(stream);
+  }
+  m_buffered_bytes = 0;
+}
+
+void
+SourceStreamWriter::flush(Stream& stream)
+{
+  if (stream.pending_rows.empty()) {
+    return;
+  }
+
+  // the buffer starts aligned, since every flush ends on an aligned size
+  auto data_size = aligned(stream.buffer.size());
+  stream.buffer.resize(data_size, 0);
+  stream.data.resize({ stream.bytes_written + data_size });
+  stream.data.select({ stream.bytes_written }, { data_size }).write_raw(stream.buffer.data());
+  stream.bytes_written += data_size;
+
+  auto n_rows = stream.pending_rows.size();
+  stream.index.resize({ stream.rows_written + n_rows });
+  stream.index.select({ stream.rows_written }, { n_rows }).write(stream.pending_rows);
+  stream.rows_written += n_rows;
+
+  stream.buffer.clear();
+  stream.pending_rows.clear();
+}
+
+SourceStreamReader::SourceStreamReader(const HighFive::File& file, const daqdataformats::SourceID& source_id)
+  : m_data_set(open_stream(file, SourceStreamWriter::stream_name(source_id)))
+{
+  file.getGroup(SourceStreamWriter::s_group_name)
+    .getDataSet(SourceStreamWriter::stream_name(source_id) + "_index")
+    .read(m_index);
+}
+
+std::vector<std::string>
+SourceStreamReader::list_streams(const HighFive::File& file)
+{
+  std::vector<std::string> names;
+  if (!file.exist(SourceStreamWriter::s_group_name)) {
+    return names;
+  }
+  for (auto& name : file.getGroup(SourceStreamWriter::s_group_name).listObjectNames()) {
+    if (name.size() < 6 || name.compare(name.size() - 6, 6, "_index") != 0) {
+      names.push_back(name);
+    }
+  }
+  return names;
+}
+
+void
+SourceStreamReader::load(size_t first_row, size_t n_rows)
+{
+  first_row = std::min(first_row, m_index.size());
+  n_rows = std::min(n_rows, m_index.size() - first_row);
+  m_first_row = first_row;
+  m_n_rows = n_rows;
+  m_data.clear();
+  if (n_rows == 0) {
+    return;
+  }
+
+  const auto& first = m_index[first_row];
+  const auto& last = m_index[first_row + n_rows - 1];
+  m_data.resize(last.offset + last.size - first.offset);
+  m_data_set.select({ first.offset }, { m_data.size() }).read(m_data.data());
+}
+
+std::unique_ptr<daqdataformats::Fragment>
+SourceStreamReader::get_fragment(size_t row) const
+{
+  if (row < m_first_row || row >= m_first_row + m_n_rows) {
+    return nullptr;
+  }
+  auto offset = m_index[row].offset - m_index[m_first_row].offset;
+  return std::make_unique<daqdataformats::Fragment>(const_cast<char*>(m_data.data() + offset), // NOLINT
+                                                    daqdataformats::Fragment::BufferAdoptionMode::kReadOnlyMode);
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
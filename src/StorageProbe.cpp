@@ -0,0 +1,110 @@
+/**
+ * @file StorageProbe.cpp StorageProbe Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/StorageProbe.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+double
+StorageProbeResult::bandwidth() const
+{
+  auto seconds = std::chrono::duration<double>(total_time).count();
+  return seconds > 0. ? bytes_written / seconds : 0.;
+}
+
+std::chrono::nanoseconds
+StorageProbeResult::mean_record_time() const
+{
+  return records_written > 0 ? total_time / static_cast<int64_t>(records_written) : std::chrono::nanoseconds(0);
+}
+
+StorageProbe::StorageProbe(std::string directory, uint64_t total_bytes, uint64_t record_bytes) // NOLINT(build/unsigned)
+  : m_directory(std::move(directory))
+  , m_total_bytes(total_bytes)
+  , m_record_bytes(std::max<uint64_t>(record_bytes, 1)) // NOLINT(build/unsigned)
+{
+  if (m_directory.empty()) {
+    m_directory = ".";
+  }
+  m_file_name =
+    (std::filesystem::path(m_directory) / (".dfmodules_storage_probe_" + std::to_string(getpid()))).string();
+}
+
+StorageProbeResult
+StorageProbe::run() const
+{
+  StorageProbeResult result;
+
+  int fd = ::open(m_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw StorageProbeFailed(ERS_HERE, m_directory, std::strerror(errno));
+  }
+
+  // the content does not matter, but it should not be all zeros in case the
+  // file system compresses
+  std::vector<char> record(m_record_bytes);
+  for (size_t i = 0; i < record.size(); ++i) {
+    record[i] = static_cast<char>(i * 2654435761u); // NOLINT(build/unsigned)
+  }
+
+  int error = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (error == 0 && result.bytes_written < m_total_bytes) {
+    auto record_start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    while (done < record.size()) {
+      auto written = ::write(fd, record.data() + done, record.size() - done);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        error = errno;
+        break;
+      }
+      done += written;
+    }
+    result.max_record_time = std::max(result.max_record_time,
+                                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - record_start));
+    result.bytes_written += done;
+    ++result.records_written;
+  }
+  if (error == 0 && ::fsync(fd) != 0) {
+    error = errno;
+  }
+  result.total_time =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+  ::close(fd);
+  std::error_code ec;
+  std::filesystem::remove(m_file_name, ec);
+
+  if (error != 0) {
+    throw StorageProbeFailed(ERS_HERE, m_directory, std::strerror(error));
+  }
+
+  TLOG_DEBUG(13) << "Storage probe in " << m_directory << ": " << result.bytes_written << " bytes in "
+                 << result.records_written << " writes, " << result.bandwidth() / 1e6 << " MB/s";
+  return result;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
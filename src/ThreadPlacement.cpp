@@ -0,0 +1,169 @@
+/**
+ * @file ThreadPlacement.cpp ThreadPlacement Class Implementation
+ *
+ * The memory policy is set with the set_mempolicy system call directly, so
+ * that the package does not depend on libnuma.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ThreadPlacement.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+const std::string s_numa_sysfs_path = "/sys/devices/system/node/";
+
+} // namespace
+
+ThreadPlacement::ThreadPlacement(const std::string& cpu_list, int numa_node)
+  : m_cpus(parse_cpu_list(cpu_list))
+  , m_numa_node(numa_node < 0 ? -1 : numa_node)
+{
+  if (m_cpus.empty() && m_numa_node >= 0) {
+    m_cpus = get_numa_node_cpus(m_numa_node);
+  }
+}
+
+std::vector<unsigned>
+ThreadPlacement::parse_cpu_list(const std::string& cpu_list)
+{
+  std::vector<unsigned> cpus;
+  std::istringstream stream(cpu_list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    // tolerate blanks and newlines, as found in sysfs files
+    range.erase(std::remove_if(range.begin(), range.end(), [](char c) { return std::isspace(c); }), range.end());
+    if (range.empty()) {
+      continue;
+    }
+    try {
+      size_t pos = 0;
+      auto first = std::stoul(range, &pos);
+      auto last = first;
+      if (pos < range.size()) {
+        if (range[pos] != '-') {
+          throw InvalidCPUList(ERS_HERE, cpu_list, "unexpected character in \"" + range + "\"");
+        }
+        size_t end_pos = 0;
+        last = std::stoul(range.substr(pos + 1), &end_pos);
+        if (pos + 1 + end_pos != range.size() || last < first) {
+          throw InvalidCPUList(ERS_HERE, cpu_list, "malformed range \"" + range + "\"");
+        }
+      }
+      if (last >= CPU_SETSIZE) {
+        throw InvalidCPUList(ERS_HERE, cpu_list, "CPU " + std::to_string(last) + " is out of range");
+      }
+      for (auto cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(static_cast<unsigned>(cpu));
+      }
+    } catch (const std::logic_error&) {
+      throw InvalidCPUList(ERS_HERE, cpu_list, "\"" + range + "\" is not a number or range");
+    }
+  }
+  return cpus;
+}
+
+std::vector<unsigned>
+ThreadPlacement::get_numa_node_cpus(int numa_node)
+{
+  std::ifstream file(s_numa_sysfs_path + "node" + std::to_string(numa_node) + "/cpulist");
+  std::string cpu_list;
+  if (!file.is_open() || !std::getline(file, cpu_list)) {
+    return {};
+  }
+  return parse_cpu_list(cpu_list);
+}
+
+std::vector<int>
+ThreadPlacement::get_online_numa_nodes()
+{
+  std::ifstream file(s_numa_sysfs_path + "online");
+  std::string node_list;
+  if (!file.is_open() || !std::getline(file, node_list)) {
+    return { 0 };
+  }
+  auto nodes = parse_cpu_list(node_list);
+  if (nodes.empty()) {
+    return { 0 };
+  }
+  return std::vector<int>(nodes.begin(), nodes.end());
+}
+
+int
+ThreadPlacement::get_numa_node_count()
+{
+  return static_cast<int>(get_online_numa_nodes().size());
+}
+
+int
+ThreadPlacement::get_current_numa_node()
+{
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return -1;
+  }
+  return static_cast<int>(node);
+}
+
+bool
+ThreadPlacement::apply_to_current_thread(const std::string& thread_name) const
+{
+  bool success = true;
+
+  if (!m_cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : m_cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    auto rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (rc != 0) {
+      ers::warning(ThreadPlacementFailed(ERS_HERE, thread_name, "CPU affinity", std::strerror(rc)));
+      success = false;
+    }
+  }
+
+  if (m_numa_node >= 0) {
+    // MPOL_PREFERRED rather than MPOL_BIND: if the node runs out of memory we
+    // prefer remote allocations to failures
+    constexpr size_t bits_per_word = 8 * sizeof(unsigned long); // NOLINT(runtime/int)
+    std::vector<unsigned long> node_mask(m_numa_node / bits_per_word + 1, 0); // NOLINT(runtime/int)
+    node_mask[m_numa_node / bits_per_word] |= 1UL << (m_numa_node % bits_per_word);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask.data(), node_mask.size() * bits_per_word + 1) != 0) {
+      ers::warning(ThreadPlacementFailed(ERS_HERE, thread_name, "NUMA memory policy", std::strerror(errno)));
+      success = false;
+    }
+  }
+
+  if (success && !is_default()) {
+    TLOG_DEBUG(5) << thread_name << ": thread placed on " << m_cpus.size() << " CPUs, NUMA node " << m_numa_node;
+  }
+  return success;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
@@ -14,10 +14,13 @@
 
 #include "logging/Logging.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 /**
  * @brief Name used by TRACE TLOG calls from this source file
@@ -30,6 +33,8 @@ namespace dfmodules {
 TriggerRecordBuilderData::TriggerRecordBuilderData(std::string connection_name, size_t busy_threshold)
   : m_busy_threshold(busy_threshold)
   , m_free_threshold(busy_threshold)
+  , m_nominal_busy_threshold(busy_threshold)
+  , m_nominal_free_threshold(busy_threshold)
   , m_is_busy(false)
   , m_in_error(false)
   , m_connection_name(connection_name)
@@ -40,6 +45,8 @@ TriggerRecordBuilderData::TriggerRecordBuilderData(std::string connection_name,
                                                    size_t free_threshold)
   : m_busy_threshold(busy_threshold)
   , m_free_threshold(busy_threshold)
+  , m_nominal_busy_threshold(busy_threshold)
+  , m_nominal_free_threshold(busy_threshold)
   , m_is_busy(false)
   , m_in_error(false)
   , m_connection_name(connection_name)
@@ -52,6 +59,9 @@ TriggerRecordBuilderData::TriggerRecordBuilderData(TriggerRecordBuilderData&& ot
 {
   m_busy_threshold = other.m_busy_threshold.load();
   m_free_threshold = other.m_free_threshold.load();
+  m_nominal_busy_threshold = other.m_nominal_busy_threshold;
+  m_nominal_free_threshold = other.m_nominal_free_threshold;
+  m_weight = other.m_weight.load();
   m_is_busy = other.m_is_busy.load();
   m_connection_name = std::move(other.m_connection_name);
 
@@ -62,6 +72,14 @@ TriggerRecordBuilderData::TriggerRecordBuilderData(TriggerRecordBuilderData&& ot
   m_metadata = std::move(other.m_metadata);
   m_in_error = other.m_in_error.load();
 
+  m_busy_bytes = other.m_busy_bytes.load();
+  m_free_bytes = other.m_free_bytes.load();
+  m_pending_bytes = other.m_pending_bytes.load();
+  m_bytes_busy = other.m_bytes_busy.load();
+  m_write_stalled = other.m_write_stalled.load();
+  m_storage_bandwidth = other.m_storage_bandwidth.load();
+  m_load_reports = std::move(other.m_load_reports);
+
   m_complete_counter = other.m_complete_counter.load();
   m_complete_microsecond = other.m_complete_microsecond.load();
 }
@@ -71,6 +89,9 @@ TriggerRecordBuilderData::operator=(TriggerRecordBuilderData&& other)
 {
   m_busy_threshold = other.m_busy_threshold.load();
   m_free_threshold = other.m_free_threshold.load();
+  m_nominal_busy_threshold = other.m_nominal_busy_threshold;
+  m_nominal_free_threshold = other.m_nominal_free_threshold;
+  m_weight = other.m_weight.load();
   m_is_busy = other.m_is_busy.load();
   m_connection_name = std::move(other.m_connection_name);
 
@@ -81,6 +102,14 @@ TriggerRecordBuilderData::operator=(TriggerRecordBuilderData&& other)
   m_metadata = std::move(other.m_metadata);
   m_in_error = other.m_in_error.load();
 
+  m_busy_bytes = other.m_busy_bytes.load();
+  m_free_bytes = other.m_free_bytes.load();
+  m_pending_bytes = other.m_pending_bytes.load();
+  m_bytes_busy = other.m_bytes_busy.load();
+  m_write_stalled = other.m_write_stalled.load();
+  m_storage_bandwidth = other.m_storage_bandwidth.load();
+  m_load_reports = std::move(other.m_load_reports);
+
   m_complete_counter = other.m_complete_counter.load();
   m_complete_microsecond = other.m_complete_microsecond.load();
 
@@ -129,8 +158,65 @@ TriggerRecordBuilderData::complete_assignment(daqdataformats::trigger_number_t t
   if (dec_ptr == nullptr)
     throw AssignedTriggerDecisionNotFound(ERS_HERE, trigger_number, m_connection_name);
 
+  record_completion(*dec_ptr, std::chrono::steady_clock::now());
+
+  if (metadata_fun)
+    metadata_fun(m_metadata);
+
+  return dec_ptr;
+}
+
+std::vector<std::shared_ptr<AssignedTriggerDecision>>
+TriggerRecordBuilderData::complete_assignments(const std::vector<daqdataformats::trigger_number_t>& trigger_numbers,
+                                               std::vector<daqdataformats::trigger_number_t>& missing,
+                                               std::function<void(nlohmann::json&)> metadata_fun)
+{
+  std::vector<daqdataformats::trigger_number_t> wanted(trigger_numbers);
+  std::sort(wanted.begin(), wanted.end());
+
+  std::vector<std::shared_ptr<AssignedTriggerDecision>> completed;
+  completed.reserve(wanted.size());
+  std::vector<bool> found(wanted.size(), false);
+  {
+    auto lk = std::lock_guard<std::mutex>(m_assigned_trigger_decisions_mutex);
+    auto it = m_assigned_trigger_decisions.begin();
+    while (it != m_assigned_trigger_decisions.end() && completed.size() < wanted.size()) {
+      auto pos = std::lower_bound(wanted.begin(), wanted.end(), (*it)->decision.trigger_number);
+      if (pos != wanted.end() && *pos == (*it)->decision.trigger_number) {
+        found[pos - wanted.begin()] = true;
+        completed.push_back(*it);
+        it = m_assigned_trigger_decisions.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (m_assigned_trigger_decisions.size() < m_free_threshold.load())
+      m_is_busy.store(false);
+  }
+
+  missing.clear();
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    if (!found[i])
+      missing.push_back(wanted[i]);
+  }
+
   auto now = std::chrono::steady_clock::now();
-  auto time = std::chrono::duration_cast<std::chrono::microseconds>(now - dec_ptr->assigned_time);
+  for (const auto& dec_ptr : completed) {
+    record_completion(*dec_ptr, now);
+  }
+
+  if (metadata_fun && !completed.empty())
+    metadata_fun(m_metadata);
+
+  return completed;
+}
+
+void
+TriggerRecordBuilderData::record_completion(const AssignedTriggerDecision& decision,
+                                            std::chrono::steady_clock::time_point now)
+{
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(now - decision.assigned_time);
   {
     auto lk = std::lock_guard<std::mutex>(m_latency_info_mutex);
     m_latency_info.emplace_back(now, time);
@@ -139,19 +225,12 @@ TriggerRecordBuilderData::complete_assignment(daqdataformats::trigger_number_t t
       m_latency_info.pop_front();
   }
 
-  if (metadata_fun)
-    metadata_fun(m_metadata);
-
   ++m_complete_counter;
-  auto completion_time =
-    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dec_ptr->assigned_time);
-  m_complete_microsecond += completion_time.count();
-  if (completion_time.count() < m_min_complete_time.load())
-    m_min_complete_time.store(completion_time.count());
-  if (completion_time.count() > m_max_complete_time.load())
-    m_max_complete_time.store(completion_time.count());
-
-  return dec_ptr;
+  m_complete_microsecond += time.count();
+  if (time.count() < m_min_complete_time.load())
+    m_min_complete_time.store(time.count());
+  if (time.count() > m_max_complete_time.load())
+    m_max_complete_time.store(time.count());
 }
 
 std::list<std::shared_ptr<AssignedTriggerDecision>>
@@ -173,9 +252,83 @@ TriggerRecordBuilderData::flush()
   m_in_error = false;
   m_metadata = nlohmann::json();
 
+  auto load_lock = std::lock_guard<std::mutex>(m_load_reports_mutex);
+  m_load_reports.clear();
+  m_pending_bytes = 0;
+  m_bytes_busy = false;
+  m_write_stalled = false;
+
   return ret;
 }
 
+void
+TriggerRecordBuilderData::set_bytes_thresholds(uint64_t busy_bytes, uint64_t free_bytes) // NOLINT(build/unsigned)
+{
+  if (busy_bytes > 0 && busy_bytes < free_bytes)
+    throw dfmodules::DFOThresholdsNotConsistent(ERS_HERE, busy_bytes, free_bytes);
+
+  m_busy_bytes = busy_bytes;
+  m_free_bytes = free_bytes;
+}
+
+void
+TriggerRecordBuilderData::update_load(const DataflowLoadReport& report)
+{
+  auto lk = std::lock_guard<std::mutex>(m_load_reports_mutex);
+  m_load_reports[report.reporter] = report;
+
+  uint64_t pending_bytes = 0;     // NOLINT(build/unsigned)
+  uint64_t storage_bandwidth = 0; // NOLINT(build/unsigned)
+  bool write_stalled = false;
+  for (const auto& [reporter, load] : m_load_reports) {
+    pending_bytes += load.pending_bytes;
+    storage_bandwidth += load.storage_bandwidth;
+    write_stalled |= load.write_stalled;
+  }
+  m_pending_bytes = pending_bytes;
+  m_write_stalled = write_stalled;
+  // the bandwidth is kept across runs, the writers only measure it at configuration
+  if (storage_bandwidth > 0)
+    m_storage_bandwidth = storage_bandwidth;
+
+  auto busy_bytes = m_busy_bytes.load();
+  if (busy_bytes == 0) {
+    m_bytes_busy = false;
+  } else if (pending_bytes >= busy_bytes) {
+    m_bytes_busy = true;
+  } else if (pending_bytes < m_free_bytes.load()) {
+    m_bytes_busy = false;
+  }
+
+  TLOG_DEBUG(13) << "Load of " << m_connection_name << " after report from " << report.reporter << ": "
+                 << pending_bytes << " bytes pending, write " << (write_stalled ? "stalled" : "flowing");
+}
+
+void
+TriggerRecordBuilderData::set_weight(double weight)
+{
+  weight = std::clamp(weight, std::numeric_limits<double>::min(), 1.);
+  m_weight = weight;
+
+  auto scale = [weight](size_t threshold) {
+    return threshold == std::numeric_limits<size_t>::max() ? threshold
+                                                           : static_cast<size_t>(std::llround(threshold * weight));
+  };
+  auto busy = std::max<size_t>(1, scale(m_nominal_busy_threshold));
+  auto free = std::min<size_t>(busy, scale(m_nominal_free_threshold));
+
+  auto lk = std::lock_guard<std::mutex>(m_assigned_trigger_decisions_mutex);
+  m_busy_threshold = busy;
+  m_free_threshold = free;
+  if (m_assigned_trigger_decisions.size() >= busy)
+    m_is_busy.store(true);
+  else if (m_assigned_trigger_decisions.size() < free)
+    m_is_busy.store(false);
+
+  TLOG_DEBUG(13) << "Weight of " << m_connection_name << " set to " << weight << ", busy threshold " << busy
+                 << ", free threshold " << free;
+}
+
 std::shared_ptr<AssignedTriggerDecision>
 TriggerRecordBuilderData::make_assignment(dfmessages::TriggerDecision decision)
 {
@@ -217,6 +370,10 @@ TriggerRecordBuilderData::get_info(opmonlib::InfoCollector& ci, int /*level*/)
   auto lk = std::lock_guard<std::mutex>(m_assigned_trigger_decisions_mutex);
 
   info.outstanding_decisions = m_assigned_trigger_decisions.size();
+  info.pending_bytes = m_pending_bytes.load();
+  info.write_stalled = m_write_stalled.load() ? 1 : 0;
+  info.storage_bandwidth = m_storage_bandwidth.load();
+  info.busy_threshold = m_busy_threshold.load();
   auto current_time = std::chrono::steady_clock::now();
   for (const auto& dec_ptr : m_assigned_trigger_decisions) {
     auto us_since_assignment =
@@ -0,0 +1,183 @@
+/**
+ * @file TriggerRecordSpill.cpp TriggerRecordSpillWriter and TriggerRecordSpillReader Classes Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/TriggerRecordSpill.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+const size_t s_io_buffer_size = 4 << 20;
+} // namespace
+
+std::string
+TriggerRecordSpillWriter::file_name(const std::string& directory,
+                                    const std::string& module_name,
+                                    daqdataformats::run_number_t run_number)
+{
+  std::ostringstream filename;
+  filename << directory << "/" << module_name << "_run" << std::setw(6) << std::setfill('0') << run_number
+           << ".spill";
+  return filename.str();
+}
+
+TriggerRecordSpillWriter::TriggerRecordSpillWriter(const std::string& filename)
+  : m_filename(filename)
+  , m_buffer(s_io_buffer_size)
+{
+  m_file = std::fopen(filename.c_str(), "ab");
+  if (m_file == nullptr) {
+    throw SpillFileError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+  std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+}
+
+TriggerRecordSpillWriter::~TriggerRecordSpillWriter()
+{
+  try {
+    close();
+  } catch (const SpillFileError& excpt) {
+    ers::error(excpt);
+  }
+}
+
+void
+TriggerRecordSpillWriter::write_bytes(const void* data, size_t size)
+{
+  if (std::fwrite(data, 1, size, m_file) != size) {
+    throw SpillFileError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+  m_bytes += size;
+}
+
+void
+TriggerRecordSpillWriter::write(const daqdataformats::TriggerRecord& record)
+{
+  if (m_file == nullptr) {
+    throw SpillFileError(ERS_HERE, m_filename, "the file is closed");
+  }
+
+  const auto& header = record.get_header_ref();
+  const auto& fragments = record.get_fragments_ref();
+
+  uint32_t magic = s_magic;     // NOLINT(build/unsigned)
+  uint32_t version = s_version; // NOLINT(build/unsigned)
+  uint64_t header_size = header.get_total_size_bytes(); // NOLINT(build/unsigned)
+  uint64_t n_fragments = fragments.size();              // NOLINT(build/unsigned)
+  write_bytes(&magic, sizeof(magic));
+  write_bytes(&version, sizeof(version));
+  write_bytes(&header_size, sizeof(header_size));
+  write_bytes(&n_fragments, sizeof(n_fragments));
+  write_bytes(header.get_storage_location(), header_size);
+
+  for (const auto& fragment : fragments) {
+    uint64_t fragment_size = fragment->get_size(); // NOLINT(build/unsigned)
+    write_bytes(&fragment_size, sizeof(fragment_size));
+    write_bytes(fragment->get_storage_location(), fragment_size);
+  }
+
+  ++m_records;
+}
+
+void
+TriggerRecordSpillWriter::close()
+{
+  if (m_file == nullptr) {
+    return;
+  }
+  auto file = std::exchange(m_file, nullptr);
+  bool flushed = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+  auto error = errno;
+  std::fclose(file);
+  if (!flushed) {
+    throw SpillFileError(ERS_HERE, m_filename, std::strerror(error));
+  }
+  TLOG_DEBUG(5) << "Spill file " << m_filename << " closed with " << m_records << " records, " << m_bytes << " bytes";
+}
+
+TriggerRecordSpillReader::TriggerRecordSpillReader(const std::string& filename)
+  : m_filename(filename)
+  , m_buffer(s_io_buffer_size)
+{
+  m_file = std::fopen(filename.c_str(), "rb");
+  if (m_file == nullptr) {
+    throw SpillFileError(ERS_HERE, m_filename, std::strerror(errno));
+  }
+  std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+}
+
+TriggerRecordSpillReader::~TriggerRecordSpillReader()
+{
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+  }
+}
+
+bool
+TriggerRecordSpillReader::read_bytes(void* data, size_t size)
+{
+  return std::fread(data, 1, size, m_file) == size;
+}
+
+std::unique_ptr<daqdataformats::TriggerRecord>
+TriggerRecordSpillReader::next()
+{
+  uint32_t magic = 0; // NOLINT(build/unsigned)
+  auto n_read = std::fread(&magic, 1, sizeof(magic), m_file);
+  if (n_read == 0 && std::feof(m_file)) {
+    return nullptr;
+  }
+  if (n_read != sizeof(magic)) {
+    throw SpillFileError(ERS_HERE, m_filename, "truncated record preamble");
+  }
+
+  uint32_t version = 0;     // NOLINT(build/unsigned)
+  uint64_t header_size = 0; // NOLINT(build/unsigned)
+  uint64_t n_fragments = 0; // NOLINT(build/unsigned)
+  if (magic != TriggerRecordSpillWriter::s_magic || !read_bytes(&version, sizeof(version)) ||
+      version != TriggerRecordSpillWriter::s_version || !read_bytes(&header_size, sizeof(header_size)) ||
+      !read_bytes(&n_fragments, sizeof(n_fragments))) {
+    throw SpillFileError(ERS_HERE, m_filename, "invalid record preamble");
+  }
+
+  m_record_buffer.resize(header_size);
+  if (!read_bytes(m_record_buffer.data(), header_size)) {
+    throw SpillFileError(ERS_HERE, m_filename, "truncated record header");
+  }
+  daqdataformats::TriggerRecordHeader header(m_record_buffer.data(), true);
+  auto record = std::make_unique<daqdataformats::TriggerRecord>(header);
+
+  for (uint64_t i = 0; i < n_fragments; ++i) { // NOLINT(build/unsigned)
+    uint64_t fragment_size = 0;                 // NOLINT(build/unsigned)
+    if (!read_bytes(&fragment_size, sizeof(fragment_size))) {
+      throw SpillFileError(ERS_HERE, m_filename, "truncated fragment size");
+    }
+    m_record_buffer.resize(fragment_size);
+    if (!read_bytes(m_record_buffer.data(), fragment_size)) {
+      throw SpillFileError(ERS_HERE, m_filename, "truncated fragment");
+    }
+    record->add_fragment(std::make_unique<daqdataformats::Fragment>(
+      m_record_buffer.data(), daqdataformats::Fragment::BufferAdoptionMode::kCopyFromBuffer));
+  }
+
+  return record;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
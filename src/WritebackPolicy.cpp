@@ -0,0 +1,211 @@
+/**
+ * @file WritebackPolicy.cpp WritebackPolicy Class Implementation
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/WritebackPolicy.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+namespace dunedaq {
+namespace dfmodules {
+
+namespace {
+
+uint64_t // NOLINT(build/unsigned)
+elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool
+WritebackPolicy::parse_mode(const std::string& name, DurabilityMode& mode)
+{
+  if (name == "none") {
+    mode = DurabilityMode::kNone;
+  } else if (name == "fsync-per-file") {
+    mode = DurabilityMode::kFsyncPerFile;
+  } else if (name == "fsync-every-n-bytes") {
+    mode = DurabilityMode::kFsyncEveryBytes;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+WritebackPolicy::WritebackPolicy(DurabilityMode mode,
+                                 uint64_t fsync_interval_bytes,     // NOLINT(build/unsigned)
+                                 uint64_t writeback_interval_bytes, // NOLINT(build/unsigned)
+                                 bool drop_written_pages)
+  : m_mode(mode)
+  , m_fsync_interval_bytes(fsync_interval_bytes)
+  , m_writeback_interval_bytes(writeback_interval_bytes)
+  , m_drop_written_pages(drop_written_pages)
+{
+  if (m_mode == DurabilityMode::kFsyncEveryBytes && m_fsync_interval_bytes == 0) {
+    m_mode = DurabilityMode::kFsyncPerFile;
+  }
+}
+
+WritebackPolicy::~WritebackPolicy()
+{
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+bool
+WritebackPolicy::active() const
+{
+  return m_mode != DurabilityMode::kNone || m_writeback_interval_bytes > 0 || m_drop_written_pages;
+}
+
+void
+WritebackPolicy::open(const std::string& filename)
+{
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+  m_filename = filename;
+  m_synced = 0;
+  m_written_back = 0;
+  m_dropped = 0;
+  m_fd = ::open(filename.c_str(), O_RDONLY);
+  if (m_fd < 0) {
+    throw WritebackFailed(ERS_HERE, filename, "open", std::strerror(errno));
+  }
+}
+
+uint64_t // NOLINT(build/unsigned)
+WritebackPolicy::file_size() const
+{
+  struct stat file_stat;
+  if (::fstat(m_fd, &file_stat) != 0) {
+    return 0;
+  }
+  return file_stat.st_size;
+}
+
+void
+WritebackPolicy::sync_file()
+{
+  auto start = std::chrono::steady_clock::now();
+  if (::fsync(m_fd) != 0) {
+    throw WritebackFailed(ERS_HERE, m_filename, "fsync", std::strerror(errno));
+  }
+  auto time_us = elapsed_us(start);
+  ++m_counters.fsyncs;
+  m_counters.fsync_time_us += time_us;
+  if (time_us > m_counters.max_fsync_time_us) {
+    m_counters.max_fsync_time_us = time_us;
+  }
+}
+
+void
+WritebackPolicy::write_back(uint64_t size) // NOLINT(build/unsigned)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  // start the writeback of the new range, without waiting for it
+  if (::sync_file_range(m_fd, m_written_back, size - m_written_back, SYNC_FILE_RANGE_WRITE) != 0) {
+    ers::warning(WritebackFailed(ERS_HERE, m_filename, "writeback", std::strerror(errno)));
+  }
+  ++m_counters.writebacks;
+
+  // the ranges started before have had the time of a whole range to reach
+  // the device: wait for them, and drop them from the page cache
+  if (m_drop_written_pages && m_written_back > m_dropped) {
+    auto length = m_written_back - m_dropped;
+    if (::sync_file_range(m_fd,
+                          m_dropped,
+                          length,
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) == 0 &&
+        ::posix_fadvise(m_fd, m_dropped, length, POSIX_FADV_DONTNEED) == 0) {
+      m_counters.bytes_dropped += length;
+    }
+    m_dropped = m_written_back;
+  }
+
+  m_written_back = size;
+  m_counters.writeback_time_us += elapsed_us(start);
+}
+
+bool
+WritebackPolicy::written()
+{
+  if (m_fd < 0) {
+    return false;
+  }
+  auto size = file_size();
+  if (m_writeback_interval_bytes > 0 && size >= m_written_back + m_writeback_interval_bytes) {
+    write_back(size);
+  }
+  return m_mode == DurabilityMode::kFsyncEveryBytes && size >= m_synced + m_fsync_interval_bytes;
+}
+
+void
+WritebackPolicy::sync()
+{
+  if (m_fd < 0) {
+    return;
+  }
+  auto size = file_size();
+  sync_file();
+  m_synced = size;
+}
+
+void
+WritebackPolicy::close()
+{
+  if (m_fd < 0) {
+    return;
+  }
+  auto size = file_size();
+  try {
+    if (m_mode != DurabilityMode::kNone) {
+      sync_file();
+      // the rename of the file is only durable once its directory is
+      auto directory = std::filesystem::path(m_filename).parent_path();
+      int dir_fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+      if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+      }
+    } else if (m_drop_written_pages) {
+      auto start = std::chrono::steady_clock::now();
+      ::sync_file_range(m_fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      m_counters.writeback_time_us += elapsed_us(start);
+    }
+    // the whole file, since HDF5 rewrites its metadata near the start at close
+    if (m_drop_written_pages && ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED) == 0) {
+      m_counters.bytes_dropped += size > m_dropped ? size - m_dropped : 0;
+    }
+  } catch (...) { // NOLINT(runtime/exceptions)
+    // NOLINT here because we *ARE* re-throwing the exception!
+    ::close(m_fd);
+    m_fd = -1;
+    throw;
+  }
+  TLOG_DEBUG(14) << "Closed " << m_filename << ", " << size << " bytes, " << m_counters.fsyncs.load()
+                 << " fsyncs so far";
+  ::close(m_fd);
+  m_fd = -1;
+}
+
+} // namespace dfmodules
+} // namespace dunedaq
@@ -0,0 +1,163 @@
+/**
+ * @file ArrivalTrace.hpp ArrivalTraceWriter and ArrivalTraceReader Classes
+ *
+ * An arrival trace is the sequence of TriggerDecisions and Fragments in the
+ * order, and at the time, they reached a TriggerRecordBuilder.  Only the
+ * timestamps and the headers are kept: the components of the decisions and
+ * the FragmentHeaders, whose size is either the original one or, unless the
+ * payload sizes are recorded, the size of an empty fragment.  A trace can be
+ * replayed into a standalone TriggerRecordBuilder with dfmodules_trb_replay,
+ * to study the builder against the traffic pattern of a real run.
+ *
+ * The file starts with magic(u32) version(u32), followed by the entries:
+ *
+ *   entry    := type(u32) body_size(u32) arrival_time_ns(u64) body
+ *   decision := trigger_number(u64) trigger_timestamp(u64) run_number(u32)
+ *               trigger_type(u16) readout_type(u16) n_components(u64)
+ *               { ComponentRequest }*
+ *   fragment := FragmentHeader
+ *
+ * The arrival times come from the steady clock of the recording host.  All
+ * the integers are in the byte order of the machine that wrote the file.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_ARRIVALTRACE_HPP_
+#define DFMODULES_SRC_DFMODULES_ARRIVALTRACE_HPP_
+
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/FragmentHeader.hpp"
+#include "daqdataformats/Types.hpp"
+#include "dfmessages/TriggerDecision.hpp"
+#include "ers/Issue.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  ArrivalTraceError,
+                  "Arrival trace " << filename << ": " << reason,
+                  ((std::string)filename)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+enum class ArrivalType : uint32_t // NOLINT(build/unsigned)
+{
+  kTriggerDecision = 1,
+  kFragment = 2
+};
+
+/**
+ * @brief One entry of a trace, as read back.  Only the member matching the
+ * type is filled.
+ */
+struct ArrivalTraceEntry
+{
+  ArrivalType type;
+  uint64_t arrival_time_ns; // NOLINT(build/unsigned)
+  dfmessages::TriggerDecision decision;
+  daqdataformats::FragmentHeader fragment;
+};
+
+class ArrivalTraceWriter
+{
+public:
+  static constexpr uint32_t s_magic = 0x54414644; // "DFAT" NOLINT(build/unsigned)
+  static constexpr uint32_t s_version = 1;        // NOLINT(build/unsigned)
+
+  /**
+   * @brief Name of the trace file of a module for a run, in the given directory
+   */
+  static std::string file_name(const std::string& directory,
+                               const std::string& module_name,
+                               daqdataformats::run_number_t run_number);
+
+  /**
+   * @brief Create (truncate) a trace file
+   * @param payload_sizes keep the size of the fragments, otherwise they are
+   * replayed empty
+   * @throws ArrivalTraceError if the file cannot be created
+   */
+  ArrivalTraceWriter(const std::string& filename, bool payload_sizes);
+  ~ArrivalTraceWriter();
+
+  ArrivalTraceWriter(const ArrivalTraceWriter&) = delete;
+  ArrivalTraceWriter& operator=(const ArrivalTraceWriter&) = delete;
+  ArrivalTraceWriter(ArrivalTraceWriter&&) = delete;
+  ArrivalTraceWriter& operator=(ArrivalTraceWriter&&) = delete;
+
+  /**
+   * @throws ArrivalTraceError if the entry cannot be written
+   */
+  void record(const dfmessages::TriggerDecision& decision);
+  void record(const daqdataformats::Fragment& fragment);
+
+  /**
+   * @brief Flush the buffer and close the file
+   * @throws ArrivalTraceError if the data cannot be written
+   */
+  void close();
+
+  const std::string& filename() const { return m_filename; }
+  size_t entries() const { return m_entries; }
+
+private:
+  void write_entry_header(ArrivalType type, size_t body_size);
+  void write_bytes(const void* data, size_t size);
+
+  std::string m_filename;
+  bool m_payload_sizes;
+  std::FILE* m_file = nullptr;
+  std::vector<char> m_buffer;
+  size_t m_entries = 0;
+};
+
+class ArrivalTraceReader
+{
+public:
+  /**
+   * @throws ArrivalTraceError if the file cannot be opened or is not a trace
+   */
+  explicit ArrivalTraceReader(const std::string& filename);
+  ~ArrivalTraceReader();
+
+  ArrivalTraceReader(const ArrivalTraceReader&) = delete;
+  ArrivalTraceReader& operator=(const ArrivalTraceReader&) = delete;
+  ArrivalTraceReader(ArrivalTraceReader&&) = delete;
+  ArrivalTraceReader& operator=(ArrivalTraceReader&&) = delete;
+
+  /**
+   * @brief Read the next entry
+   * @return false at the end of the file
+   * @throws ArrivalTraceError if the file is corrupted or truncated
+   */
+  bool next(ArrivalTraceEntry& entry);
+
+  /**
+   * @brief A fragment with the recorded header and a zeroed payload
+   */
+  static std::unique_ptr<daqdataformats::Fragment> make_fragment(const daqdataformats::FragmentHeader& header);
+
+private:
+  bool read_bytes(void* data, size_t size);
+
+  std::string m_filename;
+  std::FILE* m_file = nullptr;
+  std::vector<char> m_buffer;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_ARRIVALTRACE_HPP_
@@ -0,0 +1,57 @@
+/**
+ * @file DataflowLoadReport.hpp DataflowLoadReport Message
+ *
+ * A DataflowLoadReport is sent to the DataFlowOrchestrator by the
+ * TriggerRecordBuilder and the DataWriter of a dataflow application, next to
+ * the TriggerDecisionTokens, to describe how loaded the application is: the
+ * data it holds in memory, whether its writer keeps up with the storage, and
+ * how fast the storage was found to be at configuration.
+ * The DFO uses it, on top of the number of outstanding decisions, to decide
+ * which applications are busy.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_DATAFLOWLOADREPORT_HPP_
+#define DFMODULES_SRC_DFMODULES_DATAFLOWLOADREPORT_HPP_
+
+#include "daqdataformats/Types.hpp"
+#include "serialization/Serialization.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace dunedaq {
+namespace dfmodules {
+
+struct DataflowLoadReport
+{
+  daqdataformats::run_number_t run_number{ 0 };
+  std::string decision_destination{ "" }; ///< identifies the application, as in the TriggerDecisionTokens
+  std::string reporter{ "" };             ///< name of the reporting module
+  uint64_t pending_records{ 0 };          ///< records held in memory NOLINT(build/unsigned)
+  uint64_t pending_bytes{ 0 };            ///< bytes held in memory NOLINT(build/unsigned)
+  uint64_t write_throughput{ 0 };         ///< bytes per second written since the last report NOLINT(build/unsigned)
+  bool write_stalled{ false };            ///< the writer is retrying a write that the storage refused
+  uint64_t storage_bandwidth{ 0 };        ///< bytes per second measured by the storage probe, 0 if none NOLINT(build/unsigned)
+
+  DUNE_DAQ_SERIALIZE(DataflowLoadReport,
+                     run_number,
+                     decision_destination,
+                     reporter,
+                     pending_records,
+                     pending_bytes,
+                     write_throughput,
+                     write_stalled,
+                     storage_bandwidth);
+};
+
+} // namespace dfmodules
+
+DUNE_DAQ_SERIALIZABLE(dfmodules::DataflowLoadReport, "DataflowLoadReport");
+
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_DATAFLOWLOADREPORT_HPP_
@@ -0,0 +1,221 @@
+/**
+ * @file EventTrace.hpp EventTrace Class
+ *
+ * The EventTrace class keeps a per-thread ring buffer of small, fixed-size
+ * binary records describing dataflow events (receive, send, write begin/end,
+ * retry, timeout).  Recording an event is a handful of stores into memory that
+ * is owned by the calling thread, so the trace can be left compiled in and
+ * switched on in production.  The buffers are dumped to a binary file at stop
+ * (or on request) and converted to the Chrome/Perfetto trace format offline
+ * with the dfmodules_trace_to_json script.  Each dump of a source only holds
+ * the events recorded since its previous dump, so the dump at stop covers the
+ * run.  The buffers of exited threads are kept until all their events have
+ * been dumped, within a memory budget.
+ *
+ * Tracing is disabled unless the DFMODULES_EVENT_TRACE_DIR environment
+ * variable names the directory that dump files should be written to.  The
+ * optional DFMODULES_EVENT_TRACE_EVENTS variable sets the per-thread buffer
+ * depth (rounded up to a power of two, default 65536 events).
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_EVENTTRACE_HPP_
+#define DFMODULES_SRC_DFMODULES_EVENTTRACE_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  EventTraceDumpFailed,
+                  "Unable to write the event trace for " << source << " to " << filename << ": " << reason,
+                  ((std::string)source)((std::string)filename)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+/**
+ * @brief The kinds of events that can be recorded in the trace
+ */
+enum class TraceEventType : uint16_t
+{
+  kReceive = 1,
+  kSend = 2,
+  kWriteBegin = 3,
+  kWriteEnd = 4,
+  kRetry = 5,
+  kTimeout = 6
+};
+
+/**
+ * @brief One entry of the trace, 24 bytes.  The layout is also the on-disk
+ * layout, so changes here must be reflected in the converter script.
+ */
+struct TraceEvent
+{
+  uint64_t timestamp;  ///< steady clock, nanoseconds
+  uint64_t argument;   ///< usually the trigger (or time slice) number
+  uint32_t extra;      ///< event specific, e.g. a sequence number or a size in kB
+  uint16_t type;       ///< a TraceEventType
+  uint16_t source;     ///< the id returned by EventTrace::register_source
+};
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent is part of the dump file format");
+
+/**
+ * @brief Single-writer ring buffer owned by one thread.  Readers (the dump)
+ * may run while the owner keeps recording: every slot is a small seqlock, its
+ * sequence number is cleared while the slot is rewritten and then set to the
+ * position of the event in the stream, so a reader only keeps the entries
+ * that were not touched during its copy.
+ */
+class EventTraceBuffer
+{
+public:
+  EventTraceBuffer(size_t capacity, uint64_t thread_id);
+
+  void record(TraceEventType type, uint16_t source, uint64_t argument, uint32_t extra) noexcept
+  {
+    auto index = m_next.load(std::memory_order_relaxed);
+    auto& slot = m_slots[index & m_mask];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp.store(
+      static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count()),
+      std::memory_order_relaxed);
+    slot.argument.store(argument, std::memory_order_relaxed);
+    slot.extra.store(extra, std::memory_order_relaxed);
+    slot.type.store(static_cast<uint16_t>(type), std::memory_order_relaxed);
+    slot.source.store(source, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+    m_next.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copy the events of the given source still present in the buffer
+   * and recorded in (after, until], oldest first
+   */
+  std::vector<TraceEvent> snapshot(uint16_t source,
+                                   uint64_t after = 0,
+                                   uint64_t until = std::numeric_limits<uint64_t>::max()) const;
+
+  /**
+   * @brief Whether every event left in the buffer is older than the last dump
+   * of its source, given the time of the last dump of each source
+   */
+  bool is_dumped(const std::vector<uint64_t>& dump_marks) const;
+
+  uint64_t get_thread_id() const { return m_thread_id; }
+  std::string get_thread_name() const;
+  void retire(const std::string& thread_name);
+  bool is_retired() const { return m_retired.load(std::memory_order_acquire); }
+  size_t get_memory_size() const { return m_capacity * sizeof(Slot); }
+
+private:
+  // The fields are relaxed atomics so that a concurrent read is not a data
+  // race; on the usual targets their stores are plain stores
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence{ 0 }; ///< position of the event + 1, 0 while being written
+    std::atomic<uint64_t> timestamp{ 0 };
+    std::atomic<uint64_t> argument{ 0 };
+    std::atomic<uint32_t> extra{ 0 };
+    std::atomic<uint16_t> type{ 0 };
+    std::atomic<uint16_t> source{ 0 };
+  };
+
+  std::unique_ptr<Slot[]> m_slots; // NOLINT(modernize-avoid-c-arrays)
+  size_t m_capacity;
+  uint64_t m_mask;
+  std::atomic<uint64_t> m_next{ 0 };
+  uint64_t m_thread_id;
+
+  mutable std::mutex m_name_mutex;
+  std::string m_thread_name;
+  std::atomic<bool> m_retired{ false };
+};
+
+/**
+ * @brief Process-wide registry of the per-thread buffers
+ */
+class EventTrace
+{
+public:
+  static EventTrace& get();
+
+  static bool enabled() noexcept { return s_enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Record an event on the calling thread's buffer.  This is a no-op
+   * when tracing is disabled.
+   */
+  static void record(TraceEventType type, uint16_t source, uint64_t argument = 0, uint32_t extra = 0) noexcept
+  {
+    if (!enabled()) {
+      return;
+    }
+    auto buffer = local_buffer();
+    if (buffer != nullptr) {
+      buffer->record(type, source, argument, extra);
+    }
+  }
+
+  /**
+   * @brief Obtain the source id under which a module records its events.
+   * Registering the same name twice returns the same id.
+   */
+  uint16_t register_source(const std::string& name);
+
+  /**
+   * @brief Write the events recorded by the given source since its previous
+   * dump into a dump file in the trace directory.  Returns the name of the
+   * file, or an empty string if tracing is disabled or the file could not be
+   * written.
+   */
+  std::string dump(uint16_t source, const std::string& label);
+
+  /**
+   * @brief Memory held by the buffers of the threads that have exited
+   */
+  size_t get_retired_bytes();
+
+  /**
+   * @brief Enable tracing programmatically (mostly for tests and benchmarks)
+   */
+  void enable(const std::string& directory, size_t events_per_thread);
+
+private:
+  EventTrace();
+
+  static EventTraceBuffer* local_buffer() noexcept;
+  std::shared_ptr<EventTraceBuffer> create_buffer();
+
+  static std::atomic<bool> s_enabled;
+
+  std::mutex m_mutex;
+  std::string m_directory;
+  size_t m_events_per_thread;
+  std::vector<std::string> m_sources;
+  std::vector<uint64_t> m_dump_marks; ///< per source, the time up to which its events were dumped
+  std::vector<std::shared_ptr<EventTraceBuffer>> m_buffers;
+  std::atomic<uint32_t> m_dump_counter{ 0 };
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_EVENTTRACE_HPP_
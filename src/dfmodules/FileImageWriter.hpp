@@ -0,0 +1,136 @@
+/**
+ * @file FileImageWriter.hpp FileImageWriter Class
+ *
+ * The FileImageWriter puts complete file images on the output storage: the
+ * bytes of a file are written to `<destination>.writing` with one sequential
+ * write, and the file is then renamed to its destination, so that readers
+ * never see a partial file and the storage sees one create, one write and
+ * one rename per file.  The images may be made durable with fsync before
+ * they are renamed.  An image may come from a staged file, which is only
+ * removed once the image is in place: if the image cannot be written, the
+ * staged file stays, is reported and counted.
+ *
+ * With a queue depth of 0 the images are written by the caller, which gets
+ * the errors as exceptions.  Otherwise a thread of the writer takes them from
+ * a queue of that depth, the caller blocking while the queue is full, and
+ * the errors are reported with ers::error and counted.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_FILEIMAGEWRITER_HPP_
+#define DFMODULES_SRC_DFMODULES_FILEIMAGEWRITER_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  FileImageWriteFailed,
+                  "Writing the file image " << filename << " failed: " << reason,
+                  ((std::string)filename)((std::string)reason))
+
+ERS_DECLARE_ISSUE(dfmodules,
+                  StagedFileKept,
+                  "The image of " << staged_file << " could not be written to " << destination
+                                  << ", the staged file is kept",
+                  ((std::string)staged_file)((std::string)destination))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+class FileImageWriter
+{
+public:
+  struct Counters
+  {
+    std::atomic<uint64_t> images_written{ 0 };  // NOLINT(build/unsigned)
+    std::atomic<uint64_t> bytes_written{ 0 };   // NOLINT(build/unsigned)
+    std::atomic<uint64_t> write_failures{ 0 };  // NOLINT(build/unsigned)
+    std::atomic<uint64_t> staged_files_kept{ 0 }; // NOLINT(build/unsigned)
+    std::atomic<uint64_t> max_write_time_us{ 0 }; ///< write and rename of one image NOLINT(build/unsigned)
+  };
+
+  /**
+   * @param queue_depth images waiting for the writer thread, 0 writes them in the caller
+   * @param sync fsync each image and its directory
+   */
+  explicit FileImageWriter(size_t queue_depth = 0, bool sync = false);
+
+  /**
+   * @brief Writes the images still queued before returning
+   */
+  ~FileImageWriter();
+
+  FileImageWriter(const FileImageWriter&) = delete;
+  FileImageWriter& operator=(const FileImageWriter&) = delete;
+
+  /**
+   * @brief Read a whole file into memory
+   * @throws FileImageWriteFailed if the file cannot be read
+   */
+  static std::vector<char> load(const std::string& path);
+
+  /**
+   * @brief Write an image to its destination and rename it
+   * @throws FileImageWriteFailed on any error, the partial file is then removed
+   */
+  static void write_image(const std::string& destination, const std::vector<char>& image, bool sync = false);
+
+  /**
+   * @brief Write the image now, or queue it for the writer thread
+   * @param staged_file the file the image was loaded from, if any, removed
+   * once the image is renamed to its destination and kept otherwise
+   * @throws FileImageWriteFailed without a writer thread
+   */
+  void submit(std::string destination, std::vector<char> image, std::string staged_file = "");
+
+  /**
+   * @brief Wait until the queued images are written
+   */
+  void drain();
+
+  bool background() const { return m_queue_depth > 0; }
+  size_t queued() const;
+  const Counters& get_counters() const { return m_counters; }
+
+private:
+  struct Image
+  {
+    std::string destination;
+    std::vector<char> bytes;
+    std::string staged_file;
+  };
+
+  void write_and_count(const Image& image);
+  void run();
+
+  size_t m_queue_depth;
+  bool m_sync;
+  std::deque<Image> m_images;
+  bool m_writing = false; ///< the thread holds an image out of the queue
+  bool m_stop = false;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_changed;
+  Counters m_counters;
+  std::thread m_thread;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_FILEIMAGEWRITER_HPP_
@@ -0,0 +1,156 @@
+/**
+ * @file FileMigrator.hpp FileMigrator Class
+ *
+ * The FileMigrator moves finished output files from a fast staging
+ * directory to a bulk directory, from a thread of its own, so that bursts
+ * are written at the speed of the staging tier while the bulk tier sees a
+ * steady stream.  A file is claimed by renaming it to `<name>.migrating` in
+ * the staging directory, copied to `<name>.migrating` in the bulk directory,
+ * synced, renamed to its name there, and then removed from the staging
+ * directory.  Readers of the bulk directory never see partial files, and
+ * two migrators never move the same file.
+ *
+ * The copy is capped to a bandwidth, unless the free space of the staging
+ * directory falls below a minimum, in which case the files are moved as fast
+ * as the bulk tier allows.
+ *
+ * A file submitted before it exists, as a file image still being written,
+ * is retried until it appears.  wait_until_idle() lets the owner give the
+ * queued files the time to be moved.  When the migrator is destroyed, the
+ * file in progress is abandoned and stays in the staging directory, as do
+ * the files still queued, which is reported; submit_existing() queues them
+ * again, and the files that another migrator moves first are skipped.
+ * It also recovers the migrations interrupted by a crash: the claimed files
+ * left in the staging directory are given back, or removed if their copy is
+ * already in place, and the partial copies in the bulk directory are removed.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_FILEMIGRATOR_HPP_
+#define DFMODULES_SRC_DFMODULES_FILEMIGRATOR_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  FileMigrationFailed,
+                  "Moving " << filename << " to " << bulk_directory << " failed: " << reason,
+                  ((std::string)filename)((std::string)bulk_directory)((std::string)reason))
+
+ERS_DECLARE_ISSUE(dfmodules,
+                  FilesLeftInStaging,
+                  count << " files of " << staging_directory << " were not moved to " << bulk_directory
+                        << " yet, they are moved at the start of the next run",
+                  ((std::string)staging_directory)((std::string)bulk_directory)((size_t)count))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+class FileMigrator
+{
+public:
+  struct Counters
+  {
+    std::atomic<uint64_t> files_migrated{ 0 };    // NOLINT(build/unsigned)
+    std::atomic<uint64_t> bytes_migrated{ 0 };    // NOLINT(build/unsigned)
+    std::atomic<uint64_t> failures{ 0 };          // NOLINT(build/unsigned)
+    std::atomic<uint64_t> migration_time_us{ 0 }; ///< copies, syncs and renames NOLINT(build/unsigned)
+    std::atomic<uint64_t> throttled_time_us{ 0 }; ///< waits for the bandwidth cap NOLINT(build/unsigned)
+    std::atomic<uint64_t> urgent_files{ 0 };      ///< moved uncapped, the staging tier being short of space NOLINT(build/unsigned)
+  };
+
+  static constexpr std::chrono::seconds s_missing_file_timeout{ 60 };
+
+  /**
+   * @param bandwidth_bytes bytes per second the copies are capped to, 0 for no cap
+   * @param staging_min_free_bytes below this free space in the staging directory, the cap is lifted
+   * @param chunk_bytes size of the reads and writes of the copies
+   */
+  FileMigrator(std::string staging_directory,
+               std::string bulk_directory,
+               uint64_t bandwidth_bytes,        // NOLINT(build/unsigned)
+               uint64_t staging_min_free_bytes, // NOLINT(build/unsigned)
+               size_t chunk_bytes = 8 * 1024 * 1024);
+  ~FileMigrator();
+
+  FileMigrator(const FileMigrator&) = delete;
+  FileMigrator& operator=(const FileMigrator&) = delete;
+
+  /**
+   * @brief Queue a finished file of the staging directory
+   */
+  void submit(const std::string& path);
+
+  /**
+   * @brief Queue the finished files of the staging directory whose name
+   * contains name_fragment and ends with .hdf5, unless they are queued already.
+   * The migrations of such files that were interrupted, by a crash for
+   * instance, are recovered first
+   * @return the number of files queued
+   */
+  size_t submit_existing(const std::string& name_fragment);
+
+  /**
+   * @brief Wait until the queue is empty, or until the timeout
+   * @return true if the queue is empty
+   */
+  bool wait_until_idle(std::chrono::milliseconds timeout);
+
+  size_t pending() const;
+  uint64_t staging_free_bytes() const; // NOLINT(build/unsigned)
+  const Counters& get_counters() const { return m_counters; }
+
+private:
+  struct Entry
+  {
+    std::string path;
+    std::chrono::steady_clock::time_point submitted;
+    bool found = false; ///< by submit_existing, the file may have gone since
+  };
+
+  enum class Outcome
+  {
+    kDone,
+    kMissing,
+    kStopped
+  };
+
+  Outcome migrate(const std::string& path);
+  void recover_interrupted(const std::string& name_fragment);
+  void copy(const std::string& from, const std::string& to, uint64_t& bytes); // NOLINT(build/unsigned)
+  void run();
+
+  std::string m_staging_directory;
+  std::string m_bulk_directory;
+  uint64_t m_bandwidth_bytes;        // NOLINT(build/unsigned)
+  uint64_t m_staging_min_free_bytes; // NOLINT(build/unsigned)
+  size_t m_chunk_bytes;
+
+  std::deque<Entry> m_entries;
+  bool m_migrating = false; ///< the thread holds an entry out of the queue
+  std::string m_current_path;
+  std::atomic<bool> m_stop{ false };
+  mutable std::mutex m_mutex;
+  std::condition_variable m_changed;
+  Counters m_counters;
+  std::thread m_thread;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_FILEMIGRATOR_HPP_
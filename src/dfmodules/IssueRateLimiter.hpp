@@ -0,0 +1,87 @@
+/**
+ * @file IssueRateLimiter.hpp IssueRateLimiter Class
+ *
+ * The IssueRateLimiter class decides which occurrences of a repetitive error
+ * condition are reported as individual ERS issues: within every reporting
+ * interval the first occurrences are reported, the following ones are only
+ * counted and reported as a single summary when the interval is over.  This
+ * keeps a storm of identical errors from slowing down the module that reports
+ * them; the exact number of occurrences stays available in the counters of
+ * the module.
+ *
+ * An IssueRateLimiter is meant to be used by a single thread.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_ISSUERATELIMITER_HPP_
+#define DFMODULES_SRC_DFMODULES_ISSUERATELIMITER_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+namespace dunedaq {
+namespace dfmodules {
+
+class IssueRateLimiter
+{
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  IssueRateLimiter(size_t reports_per_interval = 10, clock_type::duration interval = std::chrono::seconds(10))
+    : m_reports_per_interval(reports_per_interval)
+    , m_interval(interval)
+    , m_interval_start(clock_type::now())
+  {}
+
+  /**
+   * @brief Count an occurrence
+   * @return true if the occurrence should be reported individually
+   */
+  bool count()
+  {
+    if (m_reported < m_reports_per_interval) {
+      ++m_reported;
+      return true;
+    }
+    ++m_suppressed;
+    return false;
+  }
+
+  /**
+   * @brief Close the reporting interval if it is over (or if forced)
+   * @return the number of occurrences that were not reported during the
+   * interval, to be reported as a summary; 0 if the interval is not over
+   */
+  size_t take_suppressed(clock_type::time_point now = clock_type::now(), bool force = false)
+  {
+    if (!force && now - m_interval_start < m_interval) {
+      return 0;
+    }
+    m_interval_start = now;
+    m_reported = 0;
+    return std::exchange(m_suppressed, 0);
+  }
+
+  void reset()
+  {
+    m_interval_start = clock_type::now();
+    m_reported = 0;
+    m_suppressed = 0;
+  }
+
+private:
+  size_t m_reports_per_interval;
+  clock_type::duration m_interval;
+  clock_type::time_point m_interval_start;
+  size_t m_reported = 0;
+  size_t m_suppressed = 0;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_ISSUERATELIMITER_HPP_
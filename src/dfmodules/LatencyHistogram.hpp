@@ -0,0 +1,130 @@
+/**
+ * @file LatencyHistogram.hpp LatencyHistogram Class
+ *
+ * The LatencyHistogram class accumulates durations into log-linear buckets
+ * (eight linear sub-buckets per power of two, i.e. a relative resolution
+ * better than 12.5%) so that quantiles can be estimated at the end of a run
+ * with a fixed, small memory footprint and O(1) cost per measurement.
+ *
+ * A histogram is meant to be filled by a single thread; it may be read once
+ * that thread has stopped.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_LATENCYHISTOGRAM_HPP_
+#define DFMODULES_SRC_DFMODULES_LATENCYHISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace dunedaq {
+namespace dfmodules {
+
+class LatencyHistogram
+{
+public:
+  using duration_t = std::chrono::nanoseconds;
+
+  void record(duration_t duration) noexcept
+  {
+    auto value = static_cast<uint64_t>(std::max<duration_t::rep>(duration.count(), 0)); // NOLINT(build/unsigned)
+    ++m_buckets[bucket_index(value)];
+    ++m_count;
+    m_sum += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+  }
+
+  template<typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> duration) noexcept
+  {
+    record(std::chrono::duration_cast<duration_t>(duration));
+  }
+
+  void reset() noexcept { *this = LatencyHistogram(); }
+
+  uint64_t count() const noexcept { return m_count; } // NOLINT(build/unsigned)
+  duration_t min() const noexcept { return duration_t(m_count > 0 ? m_min : 0); }
+  duration_t max() const noexcept { return duration_t(m_max); }
+  duration_t mean() const noexcept { return duration_t(m_count > 0 ? m_sum / m_count : 0); }
+  duration_t total() const noexcept { return duration_t(m_sum); }
+
+  /**
+   * @brief Estimate of the q-quantile (0 <= q <= 1): the midpoint of the
+   * bucket that holds it, clamped to the observed range
+   */
+  duration_t quantile(double q) const noexcept
+  {
+    if (m_count == 0) {
+      return duration_t(0);
+    }
+    q = std::clamp(q, 0., 1.);
+    auto rank = static_cast<uint64_t>(q * (m_count - 1)) + 1; // NOLINT(build/unsigned)
+    uint64_t cumulative = 0;                                  // NOLINT(build/unsigned)
+    for (size_t i = 0; i < s_n_buckets; ++i) {
+      cumulative += m_buckets[i];
+      if (cumulative >= rank) {
+        auto low = bucket_lower_bound(i);
+        auto high = i + 1 < s_n_buckets ? bucket_lower_bound(i + 1) - 1 : std::numeric_limits<uint64_t>::max();
+        auto mid = low + (high - low) / 2;
+        return duration_t(std::clamp(mid, m_min, m_max));
+      }
+    }
+    return duration_t(m_max);
+  }
+
+  /**
+   * @brief Add the content of another histogram to this one
+   */
+  LatencyHistogram& operator+=(const LatencyHistogram& other) noexcept
+  {
+    for (size_t i = 0; i < s_n_buckets; ++i) {
+      m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+    return *this;
+  }
+
+private:
+  static constexpr unsigned s_sub_bucket_bits = 3;
+  static constexpr uint64_t s_sub_buckets = 1 << s_sub_bucket_bits; // NOLINT(build/unsigned)
+  static constexpr size_t s_n_buckets = (64 - s_sub_bucket_bits + 1) * s_sub_buckets;
+
+  static size_t bucket_index(uint64_t value) noexcept // NOLINT(build/unsigned)
+  {
+    if (value < s_sub_buckets) {
+      return value;
+    }
+    unsigned exponent = 63 - __builtin_clzll(value) - s_sub_bucket_bits;
+    return (exponent + 1) * s_sub_buckets + ((value >> exponent) & (s_sub_buckets - 1));
+  }
+
+  static uint64_t bucket_lower_bound(size_t index) noexcept // NOLINT(build/unsigned)
+  {
+    if (index < s_sub_buckets) {
+      return index;
+    }
+    unsigned exponent = index / s_sub_buckets - 1;
+    return (s_sub_buckets + index % s_sub_buckets) << exponent;
+  }
+
+  std::array<uint64_t, s_n_buckets> m_buckets{}; // NOLINT(build/unsigned)
+  uint64_t m_count = 0;                          // NOLINT(build/unsigned)
+  uint64_t m_sum = 0;                            // NOLINT(build/unsigned)
+  uint64_t m_min = std::numeric_limits<uint64_t>::max(); // NOLINT(build/unsigned)
+  uint64_t m_max = 0;                                    // NOLINT(build/unsigned)
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_LATENCYHISTOGRAM_HPP_
@@ -0,0 +1,140 @@
+/**
+ * @file LoadSheddingPolicy.hpp LoadSheddingPolicy Class
+ *
+ * The LoadSheddingPolicy decides, while the DataWriter is behind, what to do
+ * with the records of each trigger type.  The types without a rule are never
+ * shed.  For a type with a rule, one record out of every `prescale` is kept
+ * whole, and the others are either dropped or reduced to their header.  The
+ * tokens are sent for shed records as for the others, so the shed records
+ * do not hold back the trigger.
+ *
+ * The rules are set at configuration; afterwards a single thread decides,
+ * while the counters may be read from any thread.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_LOADSHEDDINGPOLICY_HPP_
+#define DFMODULES_SRC_DFMODULES_LOADSHEDDINGPOLICY_HPP_
+
+#include "daqdataformats/Types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace dunedaq {
+namespace dfmodules {
+
+enum class SheddingAction
+{
+  kKeep,
+  kDrop,
+  kHeaderOnly
+};
+
+class LoadSheddingPolicy
+{
+public:
+  struct Counters
+  {
+    std::atomic<uint64_t> dropped{ 0 };           // NOLINT(build/unsigned)
+    std::atomic<uint64_t> header_only{ 0 };       // NOLINT(build/unsigned)
+    std::atomic<uint64_t> abandoned_retries{ 0 }; // NOLINT(build/unsigned)
+  };
+
+  void clear() { m_rules.clear(); }
+
+  /**
+   * @param prescale one record out of this many is kept whole, 0 keeps none
+   * @param header_only the other records are written without fragments instead of being dropped
+   */
+  void add_rule(daqdataformats::trigger_type_t trigger_type, uint32_t prescale, bool header_only) // NOLINT(build/unsigned)
+  {
+    auto& rule = m_rules[trigger_type];
+    rule.prescale = prescale;
+    rule.header_only = header_only;
+    rule.seen = 0;
+    if (!rule.counters) {
+      rule.counters = std::make_unique<Counters>();
+    }
+  }
+
+  /**
+   * @brief Restart the prescales and the counters, at the start of a run
+   */
+  void reset()
+  {
+    for (auto& [trigger_type, rule] : m_rules) {
+      rule.seen = 0;
+      rule.counters->dropped = 0;
+      rule.counters->header_only = 0;
+      rule.counters->abandoned_retries = 0;
+    }
+  }
+
+  bool empty() const { return m_rules.empty(); }
+  bool sheddable(daqdataformats::trigger_type_t trigger_type) const { return m_rules.count(trigger_type) != 0; }
+
+  /**
+   * @brief Decide the fate of a record received while the writer is behind,
+   * and count it
+   */
+  SheddingAction decide(daqdataformats::trigger_type_t trigger_type)
+  {
+    auto it = m_rules.find(trigger_type);
+    if (it == m_rules.end()) {
+      return SheddingAction::kKeep;
+    }
+    auto& rule = it->second;
+    if (rule.prescale > 0 && rule.seen++ % rule.prescale == 0) {
+      return SheddingAction::kKeep;
+    }
+    if (rule.header_only) {
+      ++rule.counters->header_only;
+      return SheddingAction::kHeaderOnly;
+    }
+    ++rule.counters->dropped;
+    return SheddingAction::kDrop;
+  }
+
+  /**
+   * @brief Count a record whose write was given up instead of being retried
+   */
+  void count_abandoned_retry(daqdataformats::trigger_type_t trigger_type)
+  {
+    auto it = m_rules.find(trigger_type);
+    if (it != m_rules.end()) {
+      ++it->second.counters->abandoned_retries;
+    }
+  }
+
+  /**
+   * @brief Call f(trigger_type, counters) for each rule
+   */
+  template<typename F>
+  void for_each(F&& f) const
+  {
+    for (const auto& [trigger_type, rule] : m_rules) {
+      f(trigger_type, *rule.counters);
+    }
+  }
+
+private:
+  struct Rule
+  {
+    uint32_t prescale = 0; // NOLINT(build/unsigned)
+    bool header_only = false;
+    uint64_t seen = 0; // NOLINT(build/unsigned)
+    std::unique_ptr<Counters> counters;
+  };
+  std::map<daqdataformats::trigger_type_t, Rule> m_rules;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_LOADSHEDDINGPOLICY_HPP_
@@ -0,0 +1,181 @@
+/**
+ * @file MonitoringRequestBook.hpp MonitoringRequestBook Class
+ *
+ * The MonitoringRequestBook keeps the pending TRMonRequests of the
+ * TriggerRecordBuilder, indexed by trigger type, together with the
+ * monitoring selections configured for their destinations.  A selection
+ * restricts the fragments sent to a destination to a set of SourceIDs and
+ * serves only a fraction of the matching trigger records.
+ *
+ * Requests are added by the receiver callback and taken by the working
+ * thread.  The number of pending requests is kept in an atomic, so that a
+ * trigger record can be checked without locking when there is nothing to
+ * serve, which is the common case.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_MONITORINGREQUESTBOOK_HPP_
+#define DFMODULES_SRC_DFMODULES_MONITORINGREQUESTBOOK_HPP_
+
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/TriggerRecord.hpp"
+#include "daqdataformats/Types.hpp"
+#include "dfmessages/TRMonRequest.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+/**
+ * @brief What is sent to a monitoring destination
+ */
+struct MonitoringSelection
+{
+  std::set<daqdataformats::SourceID> source_ids; ///< SourceIDs sent, empty for all
+  double sampling_fraction = 1.;                 ///< fraction of the matching trigger records served
+
+  bool selects(const daqdataformats::SourceID& source_id) const
+  {
+    return source_ids.empty() || source_ids.count(source_id) != 0;
+  }
+};
+
+class MonitoringRequestBook
+{
+public:
+  struct ServedRequest
+  {
+    dfmessages::TRMonRequest request;
+    MonitoringSelection selection;
+  };
+
+  /**
+   * @brief Set the selection applied to the requests for a destination.
+   * Destinations without a selection get every fragment of every matching
+   * trigger record.
+   */
+  void set_selection(const std::string& destination, MonitoringSelection selection)
+  {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    selection.sampling_fraction = std::clamp(selection.sampling_fraction, 0., 1.);
+    m_selections[destination] = std::move(selection);
+  }
+
+  void clear_selections()
+  {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_selections.clear();
+  }
+
+  void add(const dfmessages::TRMonRequest& request)
+  {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests[request.trigger_type].push_back(request);
+    ++m_pending;
+  }
+
+  /**
+   * @brief Drop the pending requests and restart the sampling
+   */
+  void clear()
+  {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests.clear();
+    m_credits.clear();
+    m_pending = 0;
+  }
+
+  bool empty() const { return m_pending.load(std::memory_order_relaxed) == 0; }
+  size_t pending() const { return m_pending.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Take the requests served by a trigger record of the given type.
+   * A request whose destination samples a fraction f of the records is
+   * served once every 1/f matching records on average, and stays pending
+   * until then.
+   * @param served filled with the served requests, cleared first
+   */
+  void take(daqdataformats::trigger_type_t trigger_type, std::vector<ServedRequest>& served)
+  {
+    served.clear();
+    if (empty()) {
+      return;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    auto requests = m_requests.find(trigger_type);
+    if (requests == m_requests.end()) {
+      return;
+    }
+
+    // the sampling credit of a destination grows once per record, however
+    // many requests it has pending
+    std::set<std::string> credited;
+    auto it = requests->second.begin();
+    while (it != requests->second.end()) {
+      auto selection = m_selections.find(it->data_destination);
+      if (selection != m_selections.end() && selection->second.sampling_fraction < 1.) {
+        auto& credit = m_credits[it->data_destination];
+        if (credited.insert(it->data_destination).second) {
+          credit += selection->second.sampling_fraction;
+        }
+        if (credit < 1.) {
+          ++it;
+          continue;
+        }
+        credit -= 1.;
+      }
+
+      served.push_back(
+        ServedRequest{ *it, selection != m_selections.end() ? selection->second : MonitoringSelection() });
+      it = requests->second.erase(it);
+      --m_pending;
+    }
+
+    if (requests->second.empty()) {
+      m_requests.erase(requests);
+    }
+  }
+
+  /**
+   * @brief Copy of a trigger record holding only the selected fragments
+   */
+  static std::unique_ptr<daqdataformats::TriggerRecord> select_fragments(const daqdataformats::TriggerRecord& record,
+                                                                         const MonitoringSelection& selection)
+  {
+    auto copy = std::make_unique<daqdataformats::TriggerRecord>(record.get_header_ref());
+    for (const auto& fragment : record.get_fragments_ref()) {
+      if (selection.selects(fragment->get_element_id())) {
+        copy->add_fragment(std::make_unique<daqdataformats::Fragment>(
+          fragment->get_storage_location(), daqdataformats::Fragment::BufferAdoptionMode::kCopyFromBuffer));
+      }
+    }
+    return copy;
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::map<daqdataformats::trigger_type_t, std::list<dfmessages::TRMonRequest>> m_requests;
+  std::atomic<size_t> m_pending = { 0 };
+  std::map<std::string, MonitoringSelection> m_selections;
+  std::map<std::string, double> m_credits;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_MONITORINGREQUESTBOOK_HPP_
@@ -0,0 +1,128 @@
+/**
+ * @file PackedFragments.hpp PackedFragmentWriter and PackedRecordReader Classes
+ *
+ * In the packed layout, the fragments of a trigger record that come from
+ * the packed subsystems are not written as one HDF5 dataset each, but
+ * concatenated into a single byte dataset per record, next to an index
+ * dataset of (subsystem, id, offset, size) rows.  A record then costs two
+ * HDF5 objects whatever the number of its fragments.  Both datasets are in
+ * the PackedFragments group at the top of the file:
+ *
+ *   /PackedFragments/Record<trigger number>.<sequence number>        bytes
+ *   /PackedFragments/Record<trigger number>.<sequence number>_index  rows
+ *
+ * Each fragment starts at an offset aligned to 8 bytes, so that a reader
+ * can use the fragments in place in the buffer it read the record into.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_PACKEDFRAGMENTS_HPP_
+#define DFMODULES_SRC_DFMODULES_PACKEDFRAGMENTS_HPP_
+
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/Types.hpp"
+#include "ers/Issue.hpp"
+
+#include "highfive/H5DataType.hpp"
+#include "highfive/H5File.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  PackedRecordNotFound,
+                  "No packed fragments for record " << trigger_number << '.' << sequence_number << " in "
+                                                    << filename,
+                  ((std::string)filename)((daqdataformats::trigger_number_t)trigger_number)(
+                    (daqdataformats::sequence_number_t)sequence_number))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+/**
+ * @brief One row of the index of a packed record
+ */
+struct PackedFragmentEntry
+{
+  uint32_t subsystem; // NOLINT(build/unsigned)
+  uint32_t id;        // NOLINT(build/unsigned)
+  uint64_t offset;    ///< from the start of the byte dataset NOLINT(build/unsigned)
+  uint64_t size;      ///< size of the fragment, header included NOLINT(build/unsigned)
+
+  daqdataformats::SourceID source_id() const
+  {
+    return daqdataformats::SourceID(static_cast<daqdataformats::SourceID::Subsystem>(subsystem), id);
+  }
+};
+
+HighFive::CompoundType
+make_packed_fragment_entry_type();
+
+class PackedFragmentWriter
+{
+public:
+  static constexpr const char* s_group_name = "PackedFragments";
+  static constexpr size_t s_alignment = 8;
+
+  static std::string record_name(daqdataformats::trigger_number_t trigger_number,
+                                 daqdataformats::sequence_number_t sequence_number);
+
+  /**
+   * @brief Write the fragments of a record as a byte dataset and its index
+   * @return the number of bytes written, padding and index included
+   */
+  static size_t write(HighFive::File& file,
+                      daqdataformats::trigger_number_t trigger_number,
+                      daqdataformats::sequence_number_t sequence_number,
+                      const std::vector<const daqdataformats::Fragment*>& fragments);
+};
+
+/**
+ * @brief Read the packed fragments of a record with one read of the bytes
+ * and one of the index.  The fragments it returns are views into its
+ * buffer: nothing is copied, and they are only valid while the reader
+ * exists.
+ */
+class PackedRecordReader
+{
+public:
+  /**
+   * @throws PackedRecordNotFound if the record has no packed fragments in the file
+   */
+  PackedRecordReader(const HighFive::File& file,
+                     daqdataformats::trigger_number_t trigger_number,
+                     daqdataformats::sequence_number_t sequence_number);
+
+  static bool has_record(const HighFive::File& file,
+                         daqdataformats::trigger_number_t trigger_number,
+                         daqdataformats::sequence_number_t sequence_number);
+
+  const std::vector<PackedFragmentEntry>& get_index() const { return m_index; }
+  std::vector<daqdataformats::SourceID> get_source_ids() const;
+
+  /**
+   * @return a read-only fragment over the buffer of the reader, nullptr if
+   * the record has no fragment from that source
+   */
+  std::unique_ptr<daqdataformats::Fragment> get_fragment(const daqdataformats::SourceID& source_id) const;
+
+private:
+  std::vector<char> m_data;
+  std::vector<PackedFragmentEntry> m_index;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+HIGHFIVE_REGISTER_TYPE(dunedaq::dfmodules::PackedFragmentEntry, dunedaq::dfmodules::make_packed_fragment_entry_type)
+
+#endif // DFMODULES_SRC_DFMODULES_PACKEDFRAGMENTS_HPP_
@@ -0,0 +1,75 @@
+/**
+ * @file RecentTriggerIds.hpp RecentTriggerIds Class
+ *
+ * The RecentTriggerIds class remembers the identifiers of the last trigger
+ * records that left the TriggerRecordBuilder book (sent complete, timed out or
+ * abandoned), so that fragments arriving after their record is gone can be
+ * recognised as late and dropped without further processing.  The set is
+ * bounded: once full, the oldest identifier is forgotten for every new one.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_RECENTTRIGGERIDS_HPP_
+#define DFMODULES_SRC_DFMODULES_RECENTTRIGGERIDS_HPP_
+
+#include "dfmodules/TriggerId.hpp"
+
+#include <deque>
+#include <set>
+
+namespace dunedaq {
+namespace dfmodules {
+
+class RecentTriggerIds
+{
+public:
+  explicit RecentTriggerIds(size_t capacity = 0)
+    : m_capacity(capacity)
+  {}
+
+  void set_capacity(size_t capacity)
+  {
+    m_capacity = capacity;
+    trim();
+  }
+  size_t capacity() const { return m_capacity; }
+  size_t size() const { return m_order.size(); }
+
+  void insert(const TriggerId& id)
+  {
+    if (m_capacity == 0 || !m_ids.insert(id).second) {
+      return;
+    }
+    m_order.push_back(id);
+    trim();
+  }
+
+  bool contains(const TriggerId& id) const { return m_ids.count(id) != 0; }
+
+  void clear()
+  {
+    m_ids.clear();
+    m_order.clear();
+  }
+
+private:
+  void trim()
+  {
+    while (m_order.size() > m_capacity) {
+      m_ids.erase(m_order.front());
+      m_order.pop_front();
+    }
+  }
+
+  size_t m_capacity;
+  std::set<TriggerId> m_ids;
+  std::deque<TriggerId> m_order;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_RECENTTRIGGERIDS_HPP_
@@ -0,0 +1,107 @@
+/**
+ * @file RecordHeaderTable.hpp RecordHeaderTable Class
+ *
+ * The RecordHeaderTable keeps the headers of the trigger records of an HDF5
+ * file as the rows of a single extendible dataset of a compound type, at the
+ * top of the file, instead of a header dataset in the group of each record.
+ * The rows are buffered and appended a batch at a time, so that a record
+ * costs no HDF5 object of its own beyond its fragments, and a reader gets
+ * all the headers of a file with a single read.
+ *
+ * The buffered rows are written when the table is destroyed, which must
+ * happen before the file is closed.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_RECORDHEADERTABLE_HPP_
+#define DFMODULES_SRC_DFMODULES_RECORDHEADERTABLE_HPP_
+
+#include "daqdataformats/TriggerRecordHeader.hpp"
+#include "ers/Issue.hpp"
+
+#include "highfive/H5DataSet.hpp"
+#include "highfive/H5DataType.hpp"
+#include "highfive/H5File.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  RecordHeaderTableError,
+                  "Record header table of " << filename << ": " << reason,
+                  ((std::string)filename)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+/**
+ * @brief One row of the table, the header fields of a record
+ */
+struct RecordHeaderRow
+{
+  uint64_t trigger_number;           // NOLINT(build/unsigned)
+  uint64_t trigger_timestamp;        // NOLINT(build/unsigned)
+  uint64_t num_requested_components; // NOLINT(build/unsigned)
+  uint64_t num_fragments;            ///< fragments written for the record NOLINT(build/unsigned)
+  uint32_t run_number;               // NOLINT(build/unsigned)
+  uint32_t error_bits;               // NOLINT(build/unsigned)
+  uint16_t trigger_type;             // NOLINT(build/unsigned)
+  uint16_t sequence_number;          // NOLINT(build/unsigned)
+  uint16_t max_sequence_number;      // NOLINT(build/unsigned)
+
+  static RecordHeaderRow from_header(const daqdataformats::TriggerRecordHeader& header, size_t num_fragments);
+};
+
+HighFive::CompoundType
+make_record_header_row_type();
+
+class RecordHeaderTable
+{
+public:
+  static constexpr const char* s_dataset_name = "TriggerRecordHeaders";
+
+  /**
+   * @brief Open the table of the file, creating it if needed
+   * @param rows_per_flush number of rows buffered before they are appended
+   */
+  RecordHeaderTable(HighFive::File& file, size_t rows_per_flush);
+  ~RecordHeaderTable();
+
+  RecordHeaderTable(const RecordHeaderTable&) = delete;
+  RecordHeaderTable& operator=(const RecordHeaderTable&) = delete;
+
+  void append(const daqdataformats::TriggerRecordHeader& header, size_t num_fragments);
+
+  /**
+   * @brief Append the buffered rows to the dataset
+   */
+  void flush();
+
+  size_t rows() const { return m_rows_written + m_buffer.size(); }
+
+  /**
+   * @brief Read all the rows of the table of a file, empty if it has none
+   */
+  static std::vector<RecordHeaderRow> read(const HighFive::File& file);
+
+private:
+  std::string m_filename;
+  HighFive::DataSet m_dataset;
+  size_t m_rows_per_flush;
+  size_t m_rows_written;
+  std::vector<RecordHeaderRow> m_buffer;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+HIGHFIVE_REGISTER_TYPE(dunedaq::dfmodules::RecordHeaderRow, dunedaq::dfmodules::make_record_header_row_type)
+
+#endif // DFMODULES_SRC_DFMODULES_RECORDHEADERTABLE_HPP_
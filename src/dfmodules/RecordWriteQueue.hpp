@@ -0,0 +1,177 @@
+/**
+ * @file RecordWriteQueue.hpp RecordWriteQueue Class
+ *
+ * The RecordWriteQueue hands the trigger records accepted by the DataWriter
+ * over to its write thread, when the tokens are released before the records
+ * are written.  The queue is bounded in number of records, so that the
+ * records whose token has already been sent, and which would be lost if the
+ * application died, stay within a known limit.  It also keeps track of the
+ * bytes it holds and of the durability checkpoint: the trigger number of the
+ * last record of the unbroken run of written records, in queue order.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_RECORDWRITEQUEUE_HPP_
+#define DFMODULES_SRC_DFMODULES_RECORDWRITEQUEUE_HPP_
+
+#include "daqdataformats/TriggerRecord.hpp"
+#include "daqdataformats/Types.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace dunedaq {
+namespace dfmodules {
+
+class RecordWriteQueue
+{
+public:
+  using record_ptr_t = std::unique_ptr<daqdataformats::TriggerRecord>;
+
+  explicit RecordWriteQueue(size_t capacity = 1)
+    : m_capacity(capacity > 0 ? capacity : 1)
+  {}
+
+  /**
+   * @brief Empty the queue and open it for a new run
+   */
+  void open(size_t capacity)
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    m_capacity = capacity > 0 ? capacity : 1;
+    m_records.clear();
+    m_bytes = 0;
+    m_size = 0;
+    m_closed = false;
+    m_has_checkpoint = false;
+    m_checkpoint_broken = false;
+    m_checkpoint = 0;
+  }
+
+  /**
+   * @brief No more records are pushed; pop returns false once the queue is empty
+   */
+  void close()
+  {
+    {
+      auto lk = std::lock_guard<std::mutex>(m_mutex);
+      m_closed = true;
+    }
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+  }
+
+  /**
+   * @brief Add a record, waiting for room if the queue is full
+   * @return false if the queue was closed meanwhile, the record is then left untouched
+   */
+  bool push(record_ptr_t& record)
+  {
+    auto bytes = record->get_total_size_bytes();
+    {
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_not_full.wait(lk, [this] { return m_closed || m_records.size() < m_capacity; });
+      if (m_closed) {
+        return false;
+      }
+      m_records.push_back(std::move(record));
+      m_bytes += bytes;
+      m_size = m_records.size();
+    }
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Take the oldest record, waiting for one if the queue is empty
+   * @return false once the queue is closed and empty
+   */
+  bool pop(record_ptr_t& record)
+  {
+    {
+      auto lk = std::unique_lock<std::mutex>(m_mutex);
+      m_not_empty.wait(lk, [this] { return m_closed || !m_records.empty(); });
+      if (m_records.empty()) {
+        return false;
+      }
+      record = std::move(m_records.front());
+      m_records.pop_front();
+      m_bytes -= record->get_total_size_bytes();
+      m_size = m_records.size();
+    }
+    m_not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Called by the write thread once a popped record is written
+   */
+  void checkpoint(daqdataformats::trigger_number_t trigger_number)
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    if (!m_checkpoint_broken) {
+      m_checkpoint = trigger_number;
+      m_has_checkpoint = true;
+    }
+  }
+
+  /**
+   * @brief Called by the write thread when a popped record could not be
+   * written: the checkpoint stays at the record before it for the rest of the run
+   */
+  void break_checkpoint()
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    m_checkpoint_broken = true;
+  }
+
+  /**
+   * @brief Trigger number of the last record written such that all the
+   * records queued before it were written too
+   * @return false if there is no such record in this run
+   */
+  bool last_checkpoint(daqdataformats::trigger_number_t& trigger_number) const
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    trigger_number = m_checkpoint;
+    return m_has_checkpoint;
+  }
+
+  size_t capacity() const
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    return m_capacity;
+  }
+  size_t size() const { return m_size.load(); }
+  uint64_t bytes() const // NOLINT(build/unsigned)
+  {
+    auto lk = std::lock_guard<std::mutex>(m_mutex);
+    return m_bytes;
+  }
+
+private:
+  size_t m_capacity;
+  std::deque<record_ptr_t> m_records;
+  uint64_t m_bytes = 0; // NOLINT(build/unsigned)
+  std::atomic<size_t> m_size{ 0 };
+  bool m_closed = false;
+  bool m_has_checkpoint = false;
+  bool m_checkpoint_broken = false;
+  daqdataformats::trigger_number_t m_checkpoint = 0;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_RECORDWRITEQUEUE_HPP_
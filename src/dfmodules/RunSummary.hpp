@@ -0,0 +1,101 @@
+/**
+ * @file RunSummary.hpp RunSummary Class
+ *
+ * The RunSummary class collects the end-of-run statistics of all the
+ * dfmodules plugins of an application into a single JSON report.  Each module
+ * contributes one section when it stops; the report is rewritten (atomically,
+ * through a temporary file) every time a section is added, so the file on disk
+ * always holds everything that is known about the run so far.  The sections of
+ * the last few runs are kept, so that work that completes in the background
+ * after the next run has started (e.g. the finalisation of the files) can
+ * still be added to the report of its own run.
+ *
+ * The report is written to <directory>/<application>_run<run>_performance.json,
+ * where the directory is, in order of preference, the value of the
+ * DFMODULES_RUN_SUMMARY_DIR environment variable, the output directory
+ * announced by a writing module, or the current working directory.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_RUNSUMMARY_HPP_
+#define DFMODULES_SRC_DFMODULES_RUNSUMMARY_HPP_
+
+#include "dfmodules/LatencyHistogram.hpp"
+
+#include "daqdataformats/Types.hpp"
+#include "ers/Issue.hpp"
+#include "nlohmann/json.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  RunSummaryWriteFailed,
+                  "Unable to write the performance summary of run " << run_number << " to " << filename << ": "
+                                                                     << reason,
+                  ((daqdataformats::run_number_t)run_number)((std::string)filename)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+class RunSummary
+{
+public:
+  static RunSummary& get();
+
+  /**
+   * @brief Announce the directory where the data files of this application
+   * go; the report is written next to them
+   */
+  void set_output_directory(const std::string& directory);
+
+  /**
+   * @brief Add (or replace) the section of a module and rewrite the report
+   * of its run.  Only the sections of the last s_kept_runs runs are kept.
+   * @return the name of the report file, empty if it could not be written
+   */
+  std::string add_section(daqdataformats::run_number_t run_number,
+                          const std::string& module_name,
+                          const nlohmann::json& section);
+
+  /**
+   * @brief Quantiles and moments of a histogram, in microseconds
+   */
+  static nlohmann::json summarise(const LatencyHistogram& histogram);
+
+  /**
+   * @brief Rate of count over the given duration, 0 if the duration is empty
+   */
+  static double rate(double count, std::chrono::steady_clock::duration duration);
+
+  /**
+   * @brief Process-level figures: peak and current resident memory, CPU time
+   */
+  static nlohmann::json process_statistics();
+
+  static std::string application_name();
+
+private:
+  RunSummary() = default;
+
+  std::string report_filename(daqdataformats::run_number_t run_number) const;
+
+  static constexpr size_t s_kept_runs = 4;
+
+  std::mutex m_mutex;
+  std::string m_output_directory;
+  std::map<daqdataformats::run_number_t, nlohmann::json> m_modules; ///< sections, per run
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_RUNSUMMARY_HPP_
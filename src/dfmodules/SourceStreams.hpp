@@ -0,0 +1,162 @@
+/**
+ * @file SourceStreams.hpp SourceStreamWriter and SourceStreamReader Classes
+ *
+ * In the source stream layout, the fragments of each SourceID are appended
+ * to a single extendible byte dataset of the file, with an index dataset of
+ * (trigger number, sequence number, offset, size) rows next to it:
+ *
+ *   /SourceStreams/<subsystem>_<id>        bytes, chunked
+ *   /SourceStreams/<subsystem>_<id>_index  rows, chunked
+ *
+ * The writes are appends to a few datasets, and a reader of one source gets
+ * the fragments of consecutive triggers with one contiguous read.  Each
+ * fragment starts at an offset aligned to 8 bytes, so that it can be used
+ * in place in the buffer it was read into.
+ *
+ * The writer buffers the fragments and appends them once the buffer holds
+ * enough bytes, and when it is destroyed, which must happen before the file
+ * is closed.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_SOURCESTREAMS_HPP_
+#define DFMODULES_SRC_DFMODULES_SOURCESTREAMS_HPP_
+
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/Types.hpp"
+#include "ers/Issue.hpp"
+
+#include "highfive/H5DataSet.hpp"
+#include "highfive/H5DataType.hpp"
+#include "highfive/H5File.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  SourceStreamError,
+                  "Source stream " << stream << " of " << filename << ": " << reason,
+                  ((std::string)filename)((std::string)stream)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+/**
+ * @brief One row of the index of a source stream
+ */
+struct SourceStreamEntry
+{
+  uint64_t trigger_number;  // NOLINT(build/unsigned)
+  uint64_t offset;          ///< from the start of the byte dataset NOLINT(build/unsigned)
+  uint64_t size;            ///< size of the fragment, header included NOLINT(build/unsigned)
+  uint16_t sequence_number; // NOLINT(build/unsigned)
+};
+
+HighFive::CompoundType
+make_source_stream_entry_type();
+
+class SourceStreamWriter
+{
+public:
+  static constexpr const char* s_group_name = "SourceStreams";
+  static constexpr size_t s_alignment = 8;
+
+  static std::string stream_name(const daqdataformats::SourceID& source_id);
+
+  /**
+   * @param chunk_bytes chunk size of the byte datasets
+   * @param buffer_bytes the buffered fragments are appended once they reach this size
+   */
+  SourceStreamWriter(HighFive::File& file, size_t chunk_bytes, size_t buffer_bytes);
+  ~SourceStreamWriter();
+
+  SourceStreamWriter(const SourceStreamWriter&) = delete;
+  SourceStreamWriter& operator=(const SourceStreamWriter&) = delete;
+
+  /**
+   * @return the bytes the fragment takes in the stream, padding included
+   */
+  size_t append(daqdataformats::trigger_number_t trigger_number,
+                daqdataformats::sequence_number_t sequence_number,
+                const daqdataformats::Fragment& fragment);
+
+  /**
+   * @brief Append the buffered fragments of all the streams to their datasets
+   */
+  void flush();
+
+  size_t streams() const { return m_streams.size(); }
+
+private:
+  struct Stream
+  {
+    HighFive::DataSet data;
+    HighFive::DataSet index;
+    uint64_t bytes_written; // NOLINT(build/unsigned)
+    uint64_t rows_written;  // NOLINT(build/unsigned)
+    std::vector<char> buffer;
+    std::vector<SourceStreamEntry> pending_rows;
+  };
+
+  Stream& get_stream(const daqdataformats::SourceID& source_id);
+  void flush(Stream& stream);
+
+  HighFive::File& m_file;
+  size_t m_chunk_bytes;
+  size_t m_buffer_bytes;
+  size_t m_buffered_bytes = 0;
+  std::map<daqdataformats::SourceID, Stream> m_streams;
+};
+
+/**
+ * @brief Read the fragments of one source of a file.  The index is read at
+ * construction; load() reads the bytes of a range of consecutive rows with
+ * one read, and get_fragment() returns views into them: nothing is copied,
+ * and the views are only valid until the next load.
+ */
+class SourceStreamReader
+{
+public:
+  /**
+   * @throws SourceStreamError if the file has no stream for that source
+   */
+  SourceStreamReader(const HighFive::File& file, const daqdataformats::SourceID& source_id);
+
+  static std::vector<std::string> list_streams(const HighFive::File& file);
+
+  const std::vector<SourceStreamEntry>& get_index() const { return m_index; }
+
+  /**
+   * @brief Read the bytes of rows [first_row, first_row + n_rows) of the index
+   */
+  void load(size_t first_row, size_t n_rows);
+
+  /**
+   * @return a read-only fragment over the loaded bytes, nullptr if the row is not loaded
+   */
+  std::unique_ptr<daqdataformats::Fragment> get_fragment(size_t row) const;
+
+private:
+  HighFive::DataSet m_data_set;
+  std::vector<SourceStreamEntry> m_index;
+  std::vector<char> m_data;
+  size_t m_first_row = 0;
+  size_t m_n_rows = 0;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+HIGHFIVE_REGISTER_TYPE(dunedaq::dfmodules::SourceStreamEntry, dunedaq::dfmodules::make_source_stream_entry_type)
+
+#endif // DFMODULES_SRC_DFMODULES_SOURCESTREAMS_HPP_
@@ -0,0 +1,75 @@
+/**
+ * @file StorageProbe.hpp StorageProbe Class
+ *
+ * The StorageProbe measures how fast a directory takes sequential writes, as
+ * the DataWriter would do them: a file is written with records of a given
+ * size, flushed to the device, and removed.  The bandwidth includes the
+ * final flush, so that it reflects the device rather than the page cache.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_STORAGEPROBE_HPP_
+#define DFMODULES_SRC_DFMODULES_STORAGEPROBE_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  StorageProbeFailed,
+                  "Storage bandwidth probe in " << directory << " failed: " << reason,
+                  ((std::string)directory)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+struct StorageProbeResult
+{
+  uint64_t bytes_written = 0;            // NOLINT(build/unsigned)
+  uint64_t records_written = 0;          // NOLINT(build/unsigned)
+  std::chrono::nanoseconds total_time{ 0 };    ///< writes and final flush
+  std::chrono::nanoseconds max_record_time{ 0 };
+
+  /**
+   * @brief Bytes per second, final flush included
+   */
+  double bandwidth() const;
+  std::chrono::nanoseconds mean_record_time() const;
+};
+
+class StorageProbe
+{
+public:
+  /**
+   * @param total_bytes bytes written by the probe, rounded up to whole records
+   * @param record_bytes size of each write
+   */
+  StorageProbe(std::string directory, uint64_t total_bytes, uint64_t record_bytes); // NOLINT(build/unsigned)
+
+  /**
+   * @brief Run the probe; the file is removed whatever the outcome
+   * @throws StorageProbeFailed if the file cannot be created or written
+   */
+  StorageProbeResult run() const;
+
+  const std::string& file_name() const { return m_file_name; }
+
+private:
+  std::string m_directory;
+  std::string m_file_name;
+  uint64_t m_total_bytes;  // NOLINT(build/unsigned)
+  uint64_t m_record_bytes; // NOLINT(build/unsigned)
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_STORAGEPROBE_HPP_
@@ -0,0 +1,161 @@
+/**
+ * @file StorageSelection.hpp StorageSelection Class
+ *
+ * The StorageSelection decides which trigger records the DataWriter stores,
+ * and which of their fragments.  For each trigger type with a rule, one
+ * record out of every `prescale` is stored, starting with the first one, and
+ * the record may be thinned to the fragments of an allowlist of subsystems
+ * and SourceIDs.  The trigger types without a rule follow the global
+ * data-storage prescale of the DataWriter and are stored whole.
+ *
+ * Thinning removes the fragments from the record in place, nothing is
+ * copied.  The record header still lists all the components requested by
+ * the trigger decision.
+ *
+ * The rules are set at configuration; afterwards a single thread selects,
+ * while the counters may be read from any thread.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_STORAGESELECTION_HPP_
+#define DFMODULES_SRC_DFMODULES_STORAGESELECTION_HPP_
+
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/TriggerRecord.hpp"
+#include "daqdataformats/Types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+
+namespace dunedaq {
+namespace dfmodules {
+
+struct StorageRule
+{
+  uint32_t prescale = 1; // NOLINT(build/unsigned)
+  std::set<daqdataformats::SourceID::Subsystem> subsystems;
+  std::set<daqdataformats::SourceID> source_ids;
+
+  /**
+   * @brief Without an allowlist, all the fragments are kept
+   */
+  bool keeps_all() const { return subsystems.empty() && source_ids.empty(); }
+
+  bool keeps(const daqdataformats::SourceID& source_id) const
+  {
+    return keeps_all() || subsystems.count(source_id.subsystem) != 0 || source_ids.count(source_id) != 0;
+  }
+};
+
+class StorageSelection
+{
+public:
+  struct Counters
+  {
+    std::atomic<uint64_t> records_stored{ 0 };     // NOLINT(build/unsigned)
+    std::atomic<uint64_t> records_prescaled{ 0 };  // NOLINT(build/unsigned)
+    std::atomic<uint64_t> fragments_removed{ 0 };  // NOLINT(build/unsigned)
+    std::atomic<uint64_t> bytes_removed{ 0 };      // NOLINT(build/unsigned)
+  };
+
+  void clear() { m_rules.clear(); }
+
+  /**
+   * @param rule a prescale of 0 stores no record of this type
+   */
+  void add_rule(daqdataformats::trigger_type_t trigger_type, StorageRule rule)
+  {
+    auto& entry = m_rules[trigger_type];
+    entry.rule = std::move(rule);
+    entry.seen = 0;
+    if (!entry.counters) {
+      entry.counters = std::make_unique<Counters>();
+    }
+  }
+
+  /**
+   * @brief Restart the prescales and the counters, at the start of a run
+   */
+  void reset()
+  {
+    for (auto& [trigger_type, entry] : m_rules) {
+      entry.seen = 0;
+      entry.counters->records_stored = 0;
+      entry.counters->records_prescaled = 0;
+      entry.counters->fragments_removed = 0;
+      entry.counters->bytes_removed = 0;
+    }
+  }
+
+  bool empty() const { return m_rules.empty(); }
+  bool has_rule(daqdataformats::trigger_type_t trigger_type) const { return m_rules.count(trigger_type) != 0; }
+
+  /**
+   * @brief Apply the prescale of the rule of this trigger type, and thin the
+   * record to its allowlist if it is to be stored
+   * @return false if the record is prescaled away, or if the type has no rule
+   */
+  bool select(daqdataformats::trigger_type_t trigger_type, daqdataformats::TriggerRecord& record)
+  {
+    auto it = m_rules.find(trigger_type);
+    if (it == m_rules.end()) {
+      return false;
+    }
+    auto& entry = it->second;
+    if (entry.rule.prescale == 0 || entry.seen++ % entry.rule.prescale != 0) {
+      ++entry.counters->records_prescaled;
+      return false;
+    }
+    ++entry.counters->records_stored;
+    if (entry.rule.keeps_all()) {
+      return true;
+    }
+
+    auto& fragments = record.get_fragments_ref();
+    uint64_t removed_bytes = 0; // NOLINT(build/unsigned)
+    auto kept_end = std::remove_if(fragments.begin(), fragments.end(), [&](const auto& fragment) {
+      if (entry.rule.keeps(fragment->get_element_id())) {
+        return false;
+      }
+      removed_bytes += fragment->get_size();
+      return true;
+    });
+    entry.counters->fragments_removed += std::distance(kept_end, fragments.end());
+    entry.counters->bytes_removed += removed_bytes;
+    fragments.erase(kept_end, fragments.end());
+    return true;
+  }
+
+  /**
+   * @brief Call f(trigger_type, counters) for each rule
+   */
+  template<typename F>
+  void for_each(F&& f) const
+  {
+    for (const auto& [trigger_type, entry] : m_rules) {
+      f(trigger_type, *entry.counters);
+    }
+  }
+
+private:
+  struct Entry
+  {
+    StorageRule rule;
+    uint64_t seen = 0; // NOLINT(build/unsigned)
+    std::unique_ptr<Counters> counters;
+  };
+  std::map<daqdataformats::trigger_type_t, Entry> m_rules;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_STORAGESELECTION_HPP_
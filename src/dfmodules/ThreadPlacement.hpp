@@ -0,0 +1,104 @@
+/**
+ * @file ThreadPlacement.hpp ThreadPlacement Class
+ *
+ * The ThreadPlacement class describes on which CPUs a dataflow worker thread
+ * may run and from which NUMA node its memory should preferentially be
+ * allocated.  The placement is applied by the worker thread itself, at the
+ * start of its work function, so that buffers allocated later on that thread
+ * (trigger records, fragments received from the network, HDF5 write buffers)
+ * are first touched on the chosen node.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_THREADPLACEMENT_HPP_
+#define DFMODULES_SRC_DFMODULES_THREADPLACEMENT_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  InvalidCPUList,
+                  "Invalid CPU list \"" << cpu_list << "\": " << reason,
+                  ((std::string)cpu_list)((std::string)reason))
+
+ERS_DECLARE_ISSUE(dfmodules,
+                  ThreadPlacementFailed,
+                  "Unable to apply the requested " << what << " to the " << thread_name << " thread: " << reason,
+                  ((std::string)thread_name)((std::string)what)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+class ThreadPlacement
+{
+public:
+  /**
+   * @brief The default placement leaves the thread unrestricted
+   */
+  ThreadPlacement() = default;
+
+  /**
+   * @brief Build a placement from the module configuration
+   * @param cpu_list CPUs in the usual Linux list syntax, e.g. "0-7,16-23".
+   * An empty list means all the CPUs of numa_node, or no restriction if no
+   * node is given.
+   * @param numa_node Node that memory should be allocated from, -1 for the
+   * system default policy.
+   */
+  ThreadPlacement(const std::string& cpu_list, int numa_node);
+
+  bool is_default() const { return m_cpus.empty() && m_numa_node < 0; }
+  const std::vector<unsigned>& get_cpus() const { return m_cpus; }
+  int get_numa_node() const { return m_numa_node; }
+
+  /**
+   * @brief Apply the placement to the calling thread.  Failures are reported
+   * as warnings, the thread then keeps running with the default placement.
+   * @return true if the whole placement could be applied
+   */
+  bool apply_to_current_thread(const std::string& thread_name) const;
+
+  /**
+   * @brief Parse a Linux CPU list ("0-3,8,10-11").  Throws InvalidCPUList.
+   */
+  static std::vector<unsigned> parse_cpu_list(const std::string& cpu_list);
+
+  /**
+   * @brief The CPUs of a NUMA node, as reported by sysfs.  Empty if the node
+   * does not exist.
+   */
+  static std::vector<unsigned> get_numa_node_cpus(int numa_node);
+
+  /**
+   * @brief The ids of the online NUMA nodes of this host, which need not be
+   * consecutive.  Node 0 alone without NUMA support.
+   */
+  static std::vector<int> get_online_numa_nodes();
+
+  /**
+   * @brief Number of NUMA nodes with CPUs or memory in this host
+   */
+  static int get_numa_node_count();
+
+  /**
+   * @brief The NUMA node of the CPU the calling thread currently runs on
+   */
+  static int get_current_numa_node();
+
+private:
+  std::vector<unsigned> m_cpus;
+  int m_numa_node = -1;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_THREADPLACEMENT_HPP_
@@ -0,0 +1,42 @@
+/**
+ * @file TriggerDecisionTokenBatch.hpp TriggerDecisionTokenBatch Message
+ *
+ * A TriggerDecisionTokenBatch stands for one TriggerDecisionToken per trigger
+ * number it lists, all for the same run and dataflow application.  The
+ * DataWriter can send it instead of the single tokens to lower the message
+ * rate at high trigger rates; the DataFlowOrchestrator completes the listed
+ * decisions in one pass.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_TRIGGERDECISIONTOKENBATCH_HPP_
+#define DFMODULES_SRC_DFMODULES_TRIGGERDECISIONTOKENBATCH_HPP_
+
+#include "daqdataformats/Types.hpp"
+#include "serialization/Serialization.hpp"
+
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+struct TriggerDecisionTokenBatch
+{
+  daqdataformats::run_number_t run_number{ 0 };
+  std::string decision_destination{ "" }; ///< identifies the application, as in the TriggerDecisionTokens
+  std::vector<daqdataformats::trigger_number_t> trigger_numbers;
+
+  DUNE_DAQ_SERIALIZE(TriggerDecisionTokenBatch, run_number, decision_destination, trigger_numbers);
+};
+
+} // namespace dfmodules
+
+DUNE_DAQ_SERIALIZABLE(dfmodules::TriggerDecisionTokenBatch, "TriggerDecisionTokenBatch");
+
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_TRIGGERDECISIONTOKENBATCH_HPP_
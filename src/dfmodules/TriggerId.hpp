@@ -0,0 +1,86 @@
+/**
+ * @file TriggerId.hpp TriggerId struct
+ *
+ * TriggerId is the key of the TriggerRecordBuilder book of pending trigger
+ * records.  It lives in its own header so that it can be used (and measured)
+ * without the rest of the module.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_TRIGGERID_HPP_
+#define DFMODULES_SRC_DFMODULES_TRIGGERID_HPP_
+
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/Types.hpp"
+#include "dfmessages/TriggerDecision.hpp"
+#include "logging/Logging.hpp"
+
+#include <istream>
+#include <ostream>
+#include <tuple>
+
+namespace dunedaq {
+namespace dfmodules {
+
+/**
+ * @brief TriggerId is a little class that defines a unique identifier for a
+ * trigger decision/record It also provides an operator < to be used by map to
+ * optimise bookkeeping
+ */
+struct TriggerId
+{
+
+  TriggerId() = default;
+
+  explicit TriggerId(const dfmessages::TriggerDecision& td,
+                     daqdataformats::sequence_number_t s = daqdataformats::TypeDefaults::s_invalid_sequence_number)
+    : trigger_number(td.trigger_number)
+    , sequence_number(s)
+    , run_number(td.run_number)
+  {
+    ;
+  }
+  explicit TriggerId(daqdataformats::Fragment& f)
+    : trigger_number(f.get_trigger_number())
+    , sequence_number(f.get_sequence_number())
+    , run_number(f.get_run_number())
+  {
+    ;
+  }
+
+  daqdataformats::trigger_number_t trigger_number;
+  daqdataformats::sequence_number_t sequence_number;
+  daqdataformats::run_number_t run_number;
+
+  bool operator<(const TriggerId& other) const noexcept
+  {
+    return std::tuple(trigger_number, sequence_number, run_number) <
+           std::tuple(other.trigger_number, other.sequence_number, other.run_number);
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const TriggerId& id) noexcept
+  {
+    out << id.trigger_number << '-' << id.sequence_number << '/' << id.run_number;
+    return out;
+  }
+
+  friend TraceStreamer& operator<<(TraceStreamer& out, const TriggerId& id) noexcept
+  {
+    return out << id.trigger_number << '.' << id.sequence_number << "/" << id.run_number;
+  }
+
+  friend std::istream& operator>>(std::istream& in, TriggerId& id)
+  {
+    char t1, t2;
+    in >> id.trigger_number >> t1 >> id.sequence_number >> t2 >> id.run_number;
+    return in;
+  }
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_TRIGGERID_HPP_
@@ -12,6 +12,8 @@
 #ifndef DFMODULES_SRC_DFMODULES_TRIGGERRECORDBUILDERDATA_HPP_
 #define DFMODULES_SRC_DFMODULES_TRIGGERRECORDBUILDERDATA_HPP_
 
+#include "dfmodules/DataflowLoadReport.hpp"
+
 #include "daqdataformats/Types.hpp"
 #include "dfmessages/TriggerDecision.hpp"
 
@@ -24,10 +26,12 @@
 #include <functional>
 #include <limits>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace dunedaq {
 // Disable coverage checking LCOV_EXCL_START
@@ -74,12 +78,39 @@ public:
   TriggerRecordBuilderData& operator=(TriggerRecordBuilderData const&) = delete;
   TriggerRecordBuilderData& operator=(TriggerRecordBuilderData&&);
 
-  bool is_busy() const { return m_in_error || m_is_busy; }
+  bool is_busy() const { return m_in_error || m_is_busy || m_bytes_busy || m_write_stalled; }
   size_t used_slots() const { return m_assigned_trigger_decisions.size(); }
 
   size_t busy_threshold() const { return m_busy_threshold.load(); }
   size_t free_threshold() const { return m_free_threshold.load(); }
 
+  /**
+   * @brief Thresholds on the bytes held in memory by the application, as
+   * given by its load reports.  The application is busy from busy_bytes
+   * until it goes below free_bytes; 0 disables the check.
+   */
+  void set_bytes_thresholds(uint64_t busy_bytes, uint64_t free_bytes); // NOLINT(build/unsigned)
+
+  /**
+   * @brief Take into account the latest load report of one of the modules of the application
+   */
+  void update_load(const DataflowLoadReport& report);
+  uint64_t pending_bytes() const { return m_pending_bytes.load(); } // NOLINT(build/unsigned)
+  bool is_write_stalled() const { return m_write_stalled.load(); }
+  /**
+   * @brief Write bandwidth of the storage of the application, in bytes per
+   * second, as measured by the probes of its writers; 0 if unknown
+   */
+  uint64_t storage_bandwidth() const { return m_storage_bandwidth.load(); } // NOLINT(build/unsigned)
+
+  /**
+   * @brief Scale the busy and free thresholds given at construction by a
+   * weight in (0, 1], so that a slower application gets fewer slots.  The
+   * busy threshold stays at least 1.
+   */
+  void set_weight(double weight);
+  double weight() const { return m_weight.load(); }
+
   std::shared_ptr<AssignedTriggerDecision> get_assignment(daqdataformats::trigger_number_t trigger_number) const;
   std::shared_ptr<AssignedTriggerDecision> extract_assignment(daqdataformats::trigger_number_t trigger_number);
   std::shared_ptr<AssignedTriggerDecision> make_assignment(dfmessages::TriggerDecision decision);
@@ -87,6 +118,14 @@ public:
   std::shared_ptr<AssignedTriggerDecision> complete_assignment(
     daqdataformats::trigger_number_t trigger_number,
     std::function<void(nlohmann::json&)> metadata_fun = nullptr);
+  /**
+   * @brief Complete several assignments with a single pass over the assigned decisions
+   * @param missing filled with the trigger numbers that had no assignment
+   */
+  std::vector<std::shared_ptr<AssignedTriggerDecision>> complete_assignments(
+    const std::vector<daqdataformats::trigger_number_t>& trigger_numbers,
+    std::vector<daqdataformats::trigger_number_t>& missing,
+    std::function<void(nlohmann::json&)> metadata_fun = nullptr);
   std::list<std::shared_ptr<AssignedTriggerDecision>> flush();
 
   void get_info(opmonlib::InfoCollector& ci, int level);
@@ -97,8 +136,13 @@ public:
   void set_in_error(bool err) { m_in_error = err; }
 
 private:
+  void record_completion(const AssignedTriggerDecision& decision, std::chrono::steady_clock::time_point now);
+
   std::atomic<size_t> m_busy_threshold{ 0 };
   std::atomic<size_t> m_free_threshold{ std::numeric_limits<size_t>::max() };
+  size_t m_nominal_busy_threshold{ 0 };
+  size_t m_nominal_free_threshold{ std::numeric_limits<size_t>::max() };
+  std::atomic<double> m_weight{ 1. };
   std::atomic<bool> m_is_busy{ false };
   std::list<std::shared_ptr<AssignedTriggerDecision>> m_assigned_trigger_decisions;
   mutable std::mutex m_assigned_trigger_decisions_mutex;
@@ -109,6 +153,16 @@ private:
 
   std::atomic<bool> m_in_error{ true };
 
+  // load reports, by reporter
+  std::atomic<uint64_t> m_busy_bytes{ 0 };      // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_free_bytes{ 0 };      // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_pending_bytes{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<bool> m_bytes_busy{ false };
+  std::atomic<bool> m_write_stalled{ false };
+  std::atomic<uint64_t> m_storage_bandwidth{ 0 }; // NOLINT(build/unsigned)
+  std::map<std::string, DataflowLoadReport> m_load_reports;
+  mutable std::mutex m_load_reports_mutex;
+
   nlohmann::json m_metadata;
   std::string m_connection_name{ "" };
 
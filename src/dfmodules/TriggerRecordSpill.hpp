@@ -0,0 +1,130 @@
+/**
+ * @file TriggerRecordSpill.hpp TriggerRecordSpillWriter and TriggerRecordSpillReader Classes
+ *
+ * A spill file holds TriggerRecords that could not be handed over to a
+ * writing module, typically because its input was full when a run stopped, so
+ * that they can be ingested into the raw data files later instead of being
+ * lost.  The format is a plain sequence of records, written sequentially
+ * through a large buffer:
+ *
+ *   record   := magic(u32) version(u32) header_size(u64) n_fragments(u64)
+ *               header_bytes { fragment_size(u64) fragment_bytes }*
+ *
+ * where the header and fragment bytes are the in-memory images of the
+ * TriggerRecordHeader and of the Fragments.  All the integers are in the
+ * byte order of the machine that wrote the file.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_TRIGGERRECORDSPILL_HPP_
+#define DFMODULES_SRC_DFMODULES_TRIGGERRECORDSPILL_HPP_
+
+#include "daqdataformats/TriggerRecord.hpp"
+#include "daqdataformats/Types.hpp"
+#include "ers/Issue.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  SpillFileError,
+                  "Spill file " << filename << ": " << reason,
+                  ((std::string)filename)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+class TriggerRecordSpillWriter
+{
+public:
+  static constexpr uint32_t s_magic = 0x50534644; // "DFSP" NOLINT(build/unsigned)
+  static constexpr uint32_t s_version = 1;        // NOLINT(build/unsigned)
+
+  /**
+   * @brief Name of the spill file of a module for a run, in the given directory
+   */
+  static std::string file_name(const std::string& directory,
+                               const std::string& module_name,
+                               daqdataformats::run_number_t run_number);
+
+  /**
+   * @brief Open (append to) a spill file
+   * @throws SpillFileError if the file cannot be opened
+   */
+  explicit TriggerRecordSpillWriter(const std::string& filename);
+  ~TriggerRecordSpillWriter();
+
+  TriggerRecordSpillWriter(const TriggerRecordSpillWriter&) = delete;
+  TriggerRecordSpillWriter& operator=(const TriggerRecordSpillWriter&) = delete;
+  TriggerRecordSpillWriter(TriggerRecordSpillWriter&&) = delete;
+  TriggerRecordSpillWriter& operator=(TriggerRecordSpillWriter&&) = delete;
+
+  /**
+   * @brief Append a record
+   * @throws SpillFileError if the record cannot be written
+   */
+  void write(const daqdataformats::TriggerRecord& record);
+
+  /**
+   * @brief Flush the buffer and close the file, the data is synced to disk
+   * @throws SpillFileError if the data cannot be written
+   */
+  void close();
+
+  const std::string& filename() const { return m_filename; }
+  size_t records() const { return m_records; }
+  size_t bytes() const { return m_bytes; }
+
+private:
+  void write_bytes(const void* data, size_t size);
+
+  std::string m_filename;
+  std::FILE* m_file = nullptr;
+  std::vector<char> m_buffer;
+  size_t m_records = 0;
+  size_t m_bytes = 0;
+};
+
+class TriggerRecordSpillReader
+{
+public:
+  /**
+   * @throws SpillFileError if the file cannot be opened
+   */
+  explicit TriggerRecordSpillReader(const std::string& filename);
+  ~TriggerRecordSpillReader();
+
+  TriggerRecordSpillReader(const TriggerRecordSpillReader&) = delete;
+  TriggerRecordSpillReader& operator=(const TriggerRecordSpillReader&) = delete;
+  TriggerRecordSpillReader(TriggerRecordSpillReader&&) = delete;
+  TriggerRecordSpillReader& operator=(TriggerRecordSpillReader&&) = delete;
+
+  /**
+   * @brief Read the next record
+   * @return the record, or nullptr at the end of the file
+   * @throws SpillFileError if the file is corrupted or truncated
+   */
+  std::unique_ptr<daqdataformats::TriggerRecord> next();
+
+private:
+  bool read_bytes(void* data, size_t size);
+
+  std::string m_filename;
+  std::FILE* m_file = nullptr;
+  std::vector<char> m_buffer;
+  std::vector<char> m_record_buffer;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_TRIGGERRECORDSPILL_HPP_
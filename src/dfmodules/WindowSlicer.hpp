@@ -0,0 +1,148 @@
+/**
+ * @file WindowSlicer.hpp WindowSlicer Class
+ *
+ * The WindowSlicer class splits the components of a trigger decision into
+ * the time slices (sequences) of at most max_time_window ticks used by the
+ * TriggerRecordBuilder.  The slices are produced in order by a sweep over the
+ * components sorted by window start: a component enters the active set when
+ * the sweep reaches its window_begin and leaves it once the sweep is past its
+ * window_end, so each slice only touches the components that overlap it.
+ *
+ * Within a slice, the components keep the order they have in the trigger
+ * decision.  All the buffers are kept between decisions, so that slicing does
+ * not allocate once the slicer has seen a decision of the largest size.
+ *
+ * A WindowSlicer is meant to be used by a single thread.
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_WINDOWSLICER_HPP_
+#define DFMODULES_SRC_DFMODULES_WINDOWSLICER_HPP_
+
+#include "daqdataformats/ComponentRequest.hpp"
+#include "daqdataformats/Types.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace dunedaq {
+namespace dfmodules {
+
+class WindowSlicer
+{
+public:
+  using component_t = daqdataformats::ComponentRequest;
+
+  /**
+   * @brief Prepare the slicing of a set of components.  The components are
+   * referenced, not copied, so they must outlive the slicing.
+   * @param max_time_window maximum width of a slice, 0 means no slicing
+   */
+  void reset(const std::vector<component_t>& components, daqdataformats::timestamp_diff_t max_time_window)
+  {
+    m_components = &components;
+    m_max_time_window = max_time_window;
+
+    m_begin = std::numeric_limits<daqdataformats::timestamp_t>::max();
+    m_end = 0;
+    for (const auto& component : components) {
+      m_begin = std::min(m_begin, component.window_begin);
+      m_end = std::max(m_end, component.window_end);
+    }
+
+    daqdataformats::timestamp_diff_t tot_width = m_end - m_begin;
+    m_max_sequence_number = (m_max_time_window > 0 && tot_width > 0) ? ((tot_width - 1) / m_max_time_window) : 0;
+
+    m_by_begin.resize(components.size());
+    for (size_t i = 0; i < components.size(); ++i) {
+      m_by_begin[i] = i;
+    }
+    std::stable_sort(m_by_begin.begin(), m_by_begin.end(), [&components](size_t a, size_t b) {
+      return components[a].window_begin < components[b].window_begin;
+    });
+
+    m_next_to_activate = 0;
+    m_active.clear();
+    m_next_sequence = 0;
+  }
+
+  daqdataformats::timestamp_t begin() const { return m_begin; }
+  daqdataformats::timestamp_t end() const { return m_end; }
+  daqdataformats::timestamp_diff_t total_width() const { return m_end - m_begin; }
+  daqdataformats::sequence_number_t max_sequence_number() const { return m_max_sequence_number; }
+
+  /**
+   * @brief Components of the next slice, cropped to the slice window.  The
+   * returned vector is reused by the following call.  Slices are produced in
+   * order, from 0 to max_sequence_number(); a slice may be empty.
+   */
+  const std::vector<component_t>& next_slice()
+  {
+    const auto& components = *m_components;
+
+    daqdataformats::timestamp_t slice_begin = m_begin + m_next_sequence * m_max_time_window;
+    daqdataformats::timestamp_t slice_end =
+      m_max_time_window > 0 ? std::min(slice_begin + m_max_time_window, m_end) : m_end;
+    ++m_next_sequence;
+
+    // components starting before the end of the slice join the active set,
+    // which is kept in decision order
+    auto first_new = m_active.size();
+    while (m_next_to_activate < m_by_begin.size() &&
+           components[m_by_begin[m_next_to_activate]].window_begin < slice_end) {
+      m_active.push_back(m_by_begin[m_next_to_activate]);
+      ++m_next_to_activate;
+    }
+    if (first_new != m_active.size()) {
+      // std::inplace_merge may allocate a temporary buffer, the merge goes
+      // through a buffer of our own instead
+      std::sort(m_active.begin() + first_new, m_active.end());
+      m_merged.resize(m_active.size());
+      std::merge(m_active.begin(),
+                 m_active.begin() + first_new,
+                 m_active.begin() + first_new,
+                 m_active.end(),
+                 m_merged.begin());
+      m_active.swap(m_merged);
+    }
+
+    // components ending before the slice leave it for good
+    m_active.erase(std::remove_if(m_active.begin(),
+                                  m_active.end(),
+                                  [&](size_t i) { return components[i].window_end <= slice_begin; }),
+                   m_active.end());
+
+    m_slice.clear();
+    for (auto i : m_active) {
+      const auto& component = components[i];
+      m_slice.emplace_back(component.component,
+                           std::max(slice_begin, component.window_begin),
+                           std::min(slice_end, component.window_end));
+    }
+    return m_slice;
+  }
+
+private:
+  const std::vector<component_t>* m_components = nullptr;
+  daqdataformats::timestamp_diff_t m_max_time_window = 0;
+  daqdataformats::timestamp_t m_begin = 0;
+  daqdataformats::timestamp_t m_end = 0;
+  daqdataformats::sequence_number_t m_max_sequence_number = 0;
+  daqdataformats::sequence_number_t m_next_sequence = 0;
+
+  // reusable buffers
+  std::vector<size_t> m_by_begin;
+  size_t m_next_to_activate = 0;
+  std::vector<size_t> m_active;
+  std::vector<size_t> m_merged;
+  std::vector<component_t> m_slice;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_WINDOWSLICER_HPP_
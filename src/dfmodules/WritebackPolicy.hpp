@@ -0,0 +1,144 @@
+/**
+ * @file WritebackPolicy.hpp WritebackPolicy Class
+ *
+ * The WritebackPolicy controls when the data written to an output file
+ * leaves the page cache, instead of leaving it to the kernel, which lets
+ * dirty pages pile up and then flushes them in bursts:
+ *
+ *  - the durability mode makes the file durable with fsync, once when it is
+ *    closed ("fsync-per-file"), or also every given number of bytes
+ *    ("fsync-every-n-bytes");
+ *  - the incremental writeback starts the writeback of every new range of
+ *    the file as soon as it reaches a given size, with sync_file_range, and
+ *    may drop each range from the page cache once it is on the device, with
+ *    posix_fadvise(POSIX_FADV_DONTNEED).
+ *
+ * The policy works on a descriptor of its own to the file, so that it does
+ * not depend on how the file is written.  The page cache and fsync are per
+ * file, whatever the descriptor.  An fsync only makes durable what reached
+ * the file, so the policy tells when one is due and the writer of the file
+ * flushes what it buffers before calling sync().
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef DFMODULES_SRC_DFMODULES_WRITEBACKPOLICY_HPP_
+#define DFMODULES_SRC_DFMODULES_WRITEBACKPOLICY_HPP_
+
+#include "ers/Issue.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dunedaq {
+
+// Disable coverage checking LCOV_EXCL_START
+ERS_DECLARE_ISSUE(dfmodules,
+                  WritebackFailed,
+                  "The " << operation << " of " << filename << " failed: " << reason,
+                  ((std::string)filename)((std::string)operation)((std::string)reason))
+// Re-enable coverage checking LCOV_EXCL_STOP
+
+namespace dfmodules {
+
+enum class DurabilityMode
+{
+  kNone,
+  kFsyncPerFile,
+  kFsyncEveryBytes
+};
+
+class WritebackPolicy
+{
+public:
+  struct Counters
+  {
+    std::atomic<uint64_t> fsyncs{ 0 };             // NOLINT(build/unsigned)
+    std::atomic<uint64_t> fsync_time_us{ 0 };      // NOLINT(build/unsigned)
+    std::atomic<uint64_t> max_fsync_time_us{ 0 };  // NOLINT(build/unsigned)
+    std::atomic<uint64_t> writebacks{ 0 };         ///< ranges whose writeback was started NOLINT(build/unsigned)
+    std::atomic<uint64_t> writeback_time_us{ 0 };  ///< starting and waiting for writebacks NOLINT(build/unsigned)
+    std::atomic<uint64_t> bytes_dropped{ 0 };      ///< dropped from the page cache NOLINT(build/unsigned)
+  };
+
+  /**
+   * @return false if the name is not one of "none", "fsync-per-file" and "fsync-every-n-bytes"
+   */
+  static bool parse_mode(const std::string& name, DurabilityMode& mode);
+
+  /**
+   * @param fsync_interval_bytes with kFsyncEveryBytes, bytes between two fsyncs
+   * @param writeback_interval_bytes size of the ranges of incremental writeback, 0 disables it
+   * @param drop_written_pages drop the ranges from the page cache once written back
+   */
+  WritebackPolicy(DurabilityMode mode,
+                  uint64_t fsync_interval_bytes,     // NOLINT(build/unsigned)
+                  uint64_t writeback_interval_bytes, // NOLINT(build/unsigned)
+                  bool drop_written_pages);
+  ~WritebackPolicy();
+
+  WritebackPolicy(const WritebackPolicy&) = delete;
+  WritebackPolicy& operator=(const WritebackPolicy&) = delete;
+
+  /**
+   * @brief Whether the policy does anything beyond the default writeback
+   */
+  bool active() const;
+  DurabilityMode mode() const { return m_mode; }
+  bool following() const { return m_fd >= 0; }
+
+  /**
+   * @brief Start following a file that was just created
+   * @throws WritebackFailed if the file cannot be opened
+   */
+  void open(const std::string& filename);
+
+  /**
+   * @brief Called after each write to the file; starts the writeback that
+   * is due.  The failures of the writeback are only reported as warnings.
+   * @return true if an fsync is due, with the fsync-every-n-bytes mode
+   */
+  bool written();
+
+  /**
+   * @brief fsync the file now, once its writer has flushed it
+   * @throws WritebackFailed if the fsync fails
+   */
+  void sync();
+
+  /**
+   * @brief Called once the file is closed: the last fsync, that of its
+   * directory, and the last pages dropped from the page cache; the file may
+   * have been renamed
+   * @throws WritebackFailed if the fsync fails
+   */
+  void close();
+
+  const Counters& get_counters() const { return m_counters; }
+
+private:
+  uint64_t file_size() const; // NOLINT(build/unsigned)
+  void sync_file();
+  void write_back(uint64_t size); // NOLINT(build/unsigned)
+
+  DurabilityMode m_mode;
+  uint64_t m_fsync_interval_bytes;     // NOLINT(build/unsigned)
+  uint64_t m_writeback_interval_bytes; // NOLINT(build/unsigned)
+  bool m_drop_written_pages;
+
+  int m_fd = -1;
+  std::string m_filename;
+  uint64_t m_synced = 0;       ///< size of the file at the last fsync NOLINT(build/unsigned)
+  uint64_t m_written_back = 0; ///< end of the ranges whose writeback was started NOLINT(build/unsigned)
+  uint64_t m_dropped = 0;      ///< end of the ranges dropped from the page cache NOLINT(build/unsigned)
+
+  Counters m_counters;
+};
+
+} // namespace dfmodules
+} // namespace dunedaq
+
+#endif // DFMODULES_SRC_DFMODULES_WRITEBACKPOLICY_HPP_
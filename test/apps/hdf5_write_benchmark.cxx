@@ -0,0 +1,290 @@
+/**
+ * @file hdf5_write_benchmark.cxx
+ *
+ * Measures the write throughput of the HDF5DataStore, in the same way as
+ * HDF5Write_test writes its synthetic TriggerRecords, for a sweep of record
+ * shapes and data store configurations:
+ *  - number of fragments per record
+ *  - fragment size
+ *  - max_file_size_bytes
+ *  - mode (all-per-file and one-event-per-file)
+ *
+ * For every point of the sweep, the throughput (MB/s and records/s), the
+ * quantiles of the per-record write latency and the time spent opening and
+ * closing files are printed as one JSON object per line.  The files are
+ * opened and closed inside the writes, so their cost is measured against a
+ * reference run of the same records into a single file, made once per record
+ * shape: the open/close time is the excess of the total time of the point,
+ * last close included, over the same number of records written at the
+ * reference pace.  The number of files is counted once the point is written.
+ *
+ * Usage: dfmodules_hdf5_write_benchmark [output_directory [megabytes_per_point [max_records_per_point]]]
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/DataStore.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/RunSummary.hpp"
+#include "dfmodules/hdf5datastore/Nljs.hpp"
+#include "dfmodules/hdf5datastore/Structs.hpp"
+
+#include "daqdataformats/TriggerRecord.hpp"
+#include "detdataformats/DetID.hpp"
+#include "hdf5libs/hdf5filelayout/Nljs.hpp"
+#include "hdf5libs/hdf5filelayout/Structs.hpp"
+#include "nlohmann/json.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+const daqdataformats::run_number_t s_run_number = 53;
+
+struct SweepPoint
+{
+  size_t fragments;
+  size_t fragment_size;
+  size_t max_file_size;
+  std::string mode;
+};
+
+hdf5libs::hdf5filelayout::FileLayoutParams
+create_file_layout_params()
+{
+  hdf5libs::hdf5filelayout::PathParams params;
+  params.detector_group_type = "TPC";
+  params.detector_group_name = "TPC";
+  params.element_name_prefix = "Link";
+  params.digits_for_element_number = 10;
+
+  hdf5libs::hdf5filelayout::FileLayoutParams layout_params;
+  layout_params.path_param_list.push_back(params);
+  return layout_params;
+}
+
+std::unique_ptr<daqdataformats::TriggerRecord>
+create_trigger_record(daqdataformats::trigger_number_t trigger_number, size_t fragment_count, std::vector<char>& payload)
+{
+  uint64_t ts = std::chrono::duration_cast<std::chrono::milliseconds>( // NOLINT(build/unsigned)
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count();
+
+  daqdataformats::TriggerRecordHeaderData trh_data;
+  trh_data.trigger_number = trigger_number;
+  trh_data.trigger_timestamp = ts;
+  trh_data.num_requested_components = fragment_count;
+  trh_data.run_number = s_run_number;
+  trh_data.sequence_number = 0;
+  trh_data.max_sequence_number = 1;
+  daqdataformats::TriggerRecordHeader trh(&trh_data);
+
+  auto record = std::make_unique<daqdataformats::TriggerRecord>(trh);
+  for (size_t element = 0; element < fragment_count; ++element) {
+    daqdataformats::FragmentHeader fh;
+    fh.trigger_number = trigger_number;
+    fh.trigger_timestamp = ts;
+    fh.window_begin = ts - 10;
+    fh.window_end = ts;
+    fh.run_number = s_run_number;
+    fh.fragment_type = static_cast<daqdataformats::fragment_type_t>(daqdataformats::FragmentType::kWIB);
+    fh.detector_id = static_cast<uint16_t>(detdataformats::DetID::Subdetector::kHD_TPC);
+    fh.element_id = daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kDetectorReadout, element);
+    auto fragment = std::make_unique<daqdataformats::Fragment>(payload.data(), payload.size());
+    fragment->set_header_fields(fh);
+    record->add_fragment(std::move(fragment));
+  }
+  return record;
+}
+
+size_t
+count_files(const std::string& directory)
+{
+  return std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator());
+}
+
+void
+remove_files(const std::string& directory)
+{
+  for (auto& entry : std::filesystem::directory_iterator(directory)) {
+    std::filesystem::remove(entry.path());
+  }
+}
+
+struct PointTimes
+{
+  size_t bytes = 0;
+  size_t files = 0;
+  LatencyHistogram write_latency;
+  std::chrono::steady_clock::duration first_write{ 0 }; ///< the write that opens the first file
+  std::chrono::steady_clock::duration write_time{ 0 };  ///< the writes, without the last close
+  std::chrono::steady_clock::duration close_time{ 0 };  ///< finish_with_run, closing the last file
+};
+
+void
+write_point(const SweepPoint& point, const std::string& directory, size_t n_records, PointTimes& times)
+{
+  std::vector<char> payload(point.fragment_size);
+
+  hdf5datastore::ConfParams config_params;
+  config_params.name = "benchmarkWriter";
+  config_params.directory_path = directory;
+  config_params.mode = point.mode;
+  config_params.max_file_size_bytes = point.max_file_size;
+  config_params.filename_parameters.overall_prefix = "hdf5bench";
+  config_params.file_layout_parameters = create_file_layout_params();
+  hdf5datastore::data_t config_json;
+  hdf5datastore::to_json(config_json, config_params);
+
+  auto data_store = make_data_store(config_json);
+  data_store->prepare_for_run(s_run_number);
+
+  // a single record is built in advance, and reused with a new trigger number,
+  // so that only the write is timed and the memory usage stays bounded
+  auto record = create_trigger_record(1, point.fragments, payload);
+
+  for (size_t i = 0; i < n_records; ++i) {
+    record->get_header_ref().set_trigger_number(i + 1);
+    for (auto& fragment : record->get_fragments_ref()) {
+      fragment->set_trigger_number(i + 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    data_store->write(*record);
+    auto latency = std::chrono::steady_clock::now() - start;
+
+    if (i == 0) {
+      times.first_write = latency;
+    }
+    times.write_time += latency;
+    times.bytes += record->get_total_size_bytes();
+    times.write_latency.record(latency);
+  }
+
+  auto close_start = std::chrono::steady_clock::now();
+  data_store->finish_with_run(s_run_number);
+  data_store.reset();
+  times.close_time = std::chrono::steady_clock::now() - close_start;
+
+  times.files = count_files(directory);
+  remove_files(directory);
+}
+
+// the write time of one record of a given shape (fragments, fragment size)
+// into an already open file
+using ReferencePaces = std::map<std::pair<size_t, size_t>, std::chrono::steady_clock::duration>;
+
+nlohmann::json
+run_point(const SweepPoint& point,
+          const std::string& directory,
+          size_t bytes_per_point,
+          size_t max_records,
+          ReferencePaces& reference_paces)
+{
+  size_t record_size = point.fragments * (point.fragment_size + sizeof(daqdataformats::FragmentHeader));
+  size_t n_records = std::clamp<size_t>(bytes_per_point / record_size, 1, max_records);
+
+  // the reference run: the same records in a single file, without the first
+  // write, which opens the file, and without the close
+  auto shape = std::make_pair(point.fragments, point.fragment_size);
+  if (reference_paces.count(shape) == 0) {
+    PointTimes reference;
+    write_point({ point.fragments, point.fragment_size, SIZE_MAX, "all-per-file" }, directory, n_records, reference);
+    auto reference_time = reference.write_time - reference.first_write;
+    reference_paces[shape] =
+      n_records > 1 ? reference_time / static_cast<int64_t>(n_records - 1) : reference_time;
+  }
+  auto reference_pace = reference_paces[shape];
+
+  PointTimes times;
+  write_point(point, directory, n_records, times);
+  auto total_time = times.write_time + times.close_time;
+
+  auto open_close_time = total_time - reference_pace * static_cast<int64_t>(n_records);
+  open_close_time = std::max(open_close_time, std::chrono::steady_clock::duration(0));
+
+  nlohmann::json result;
+  result["benchmark"] = "HDF5DataStore_write_throughput";
+  result["mode"] = point.mode;
+  result["fragments"] = point.fragments;
+  result["fragment_size"] = point.fragment_size;
+  result["max_file_size_bytes"] = point.max_file_size;
+  result["records"] = n_records;
+  result["bytes"] = times.bytes;
+  result["files"] = times.files;
+  result["elapsed_s"] = std::chrono::duration<double>(total_time).count();
+  result["throughput_MB_s"] = RunSummary::rate(times.bytes, total_time) / 1.e6;
+  result["records_per_s"] = RunSummary::rate(n_records, total_time);
+  result["write_latency"] = RunSummary::summarise(times.write_latency);
+  result["reference_write_s"] = std::chrono::duration<double>(reference_pace).count();
+  result["file_open_close_s"] = std::chrono::duration<double>(open_close_time).count();
+  result["file_open_close_per_file_s"] =
+    times.files > 0 ? std::chrono::duration<double>(open_close_time).count() / times.files : 0.;
+  result["last_file_close_s"] = std::chrono::duration<double>(times.close_time).count();
+  return result;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  std::string base_directory = std::filesystem::temp_directory_path();
+  size_t megabytes_per_point = 256;
+  size_t max_records = 10000;
+  if (argc > 1) {
+    base_directory = argv[1];
+  }
+  if (argc > 2) {
+    megabytes_per_point = std::strtoul(argv[2], nullptr, 10);
+  }
+  if (argc > 3) {
+    max_records = std::strtoul(argv[3], nullptr, 10);
+  }
+
+  std::string directory = base_directory + "/dfmodules_hdf5_write_benchmark_" + std::to_string(getpid());
+  std::filesystem::create_directories(directory);
+
+  std::vector<SweepPoint> points;
+  for (size_t fragments : { 1, 10, 100 }) {
+    for (size_t fragment_size : { 1024, 65536, 1048576 }) {
+      for (size_t max_file_size : { 100000000, 4000000000 }) {
+        points.push_back({ fragments, fragment_size, max_file_size, "all-per-file" });
+      }
+      // the maximum file size does not matter when every record goes to its own file
+      points.push_back({ fragments, fragment_size, 4000000000, "one-event-per-file" });
+    }
+  }
+
+  ReferencePaces reference_paces;
+  for (auto& point : points) {
+    try {
+      std::cout << run_point(point, directory, megabytes_per_point * 1000000, max_records, reference_paces).dump()
+                << std::endl;
+    } catch (const std::exception& excpt) {
+      std::cerr << "Point " << point.mode << "/" << point.fragments << "x" << point.fragment_size
+                << " failed: " << excpt.what() << std::endl;
+    }
+    remove_files(directory);
+  }
+
+  std::filesystem::remove_all(directory);
+  return 0;
+}
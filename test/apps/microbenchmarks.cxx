@@ -0,0 +1,469 @@
+/**
+ * @file microbenchmarks.cxx
+ *
+ * Microbenchmarks of the data structures and operations that dominate the CPU
+ * usage of the dataflow modules:
+ *  - TriggerId ordering and lookup in a book of pending trigger records
+ *  - insertion, fragment filling and extraction of TriggerRecords in a book
+ *    shaped like the one of the TriggerRecordBuilder
+ *  - slicing of long trigger decisions into sequences, with the WindowSlicer
+ *    and with the per-slice scan of all the components it replaced
+ *  - TriggerRecordBuilderData assignment and completion, as done by the DFO
+ *  - TPBundleHandler::add_tpset and the assembly of TimeSlices
+ *  - HDF5DataStore::write for a few trigger record shapes
+ *  - generation of the HDF5 file names
+ *
+ * Every benchmark is repeated until it has run for at least the minimum time,
+ * and the results are printed as one JSON object per line so that they can be
+ * collected and compared from one release to the next.
+ *
+ * Usage: dfmodules_microbenchmarks [name_filter [min_time_ms]]
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "HDF5FileUtils.hpp"
+#include "dfmodules/DataStore.hpp"
+#include "dfmodules/TPBundleHandler.hpp"
+#include "dfmodules/TriggerId.hpp"
+#include "dfmodules/TriggerRecordBuilderData.hpp"
+#include "dfmodules/WindowSlicer.hpp"
+#include "dfmodules/hdf5datastore/Nljs.hpp"
+#include "dfmodules/hdf5datastore/Structs.hpp"
+
+#include "daqdataformats/TriggerRecord.hpp"
+#include "detdataformats/DetID.hpp"
+#include "hdf5libs/hdf5filelayout/Nljs.hpp"
+#include "hdf5libs/hdf5filelayout/Structs.hpp"
+#include "nlohmann/json.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+std::string s_filter; // NOLINT(runtime/string)
+std::chrono::milliseconds s_min_time(200);
+
+// results are accumulated here so that the compiler cannot drop the measured code
+volatile uint64_t s_sink = 0; // NOLINT(build/unsigned)
+
+/**
+ * @brief Run body (which performs ops_per_call operations) until the minimum
+ * time has elapsed, then print the time per operation.
+ */
+void
+run_benchmark(const std::string& name, const nlohmann::json& parameters, size_t ops_per_call, std::function<void()> body)
+{
+  if (!s_filter.empty() && name.find(s_filter) == std::string::npos) {
+    return;
+  }
+
+  body(); // warm up caches and allocators
+
+  size_t calls = 0;
+  std::chrono::steady_clock::duration elapsed{ 0 };
+  while (elapsed < s_min_time) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    elapsed += std::chrono::steady_clock::now() - start;
+    ++calls;
+  }
+
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  double ops = static_cast<double>(calls) * ops_per_call;
+  nlohmann::json result;
+  result["benchmark"] = name;
+  result["parameters"] = parameters;
+  result["operations"] = static_cast<uint64_t>(ops); // NOLINT(build/unsigned)
+  result["ns_per_op"] = seconds * 1e9 / ops;
+  result["ops_per_s"] = ops / seconds;
+  std::cout << result.dump() << std::endl;
+}
+
+dfmessages::TriggerDecision
+make_decision(daqdataformats::trigger_number_t trigger_number, size_t n_components)
+{
+  dfmessages::TriggerDecision td;
+  td.trigger_number = trigger_number;
+  td.run_number = 1;
+  td.trigger_timestamp = 1000000 + trigger_number * 1000;
+  td.trigger_type = 1;
+  td.readout_type = dfmessages::ReadoutType::kLocalized;
+  for (size_t i = 0; i < n_components; ++i) {
+    daqdataformats::ComponentRequest request;
+    request.component = daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kDetectorReadout, i);
+    request.window_begin = td.trigger_timestamp - 100;
+    request.window_end = td.trigger_timestamp + 100;
+    td.components.push_back(request);
+  }
+  return td;
+}
+
+std::unique_ptr<daqdataformats::Fragment>
+make_fragment(const TriggerId& id, const daqdataformats::SourceID& source_id, std::vector<char>& payload)
+{
+  auto fragment = std::make_unique<daqdataformats::Fragment>(payload.data(), payload.size());
+  fragment->set_trigger_number(id.trigger_number);
+  fragment->set_sequence_number(id.sequence_number);
+  fragment->set_run_number(id.run_number);
+  fragment->set_element_id(source_id);
+  fragment->set_type(daqdataformats::FragmentType::kWIB);
+  fragment->set_detector_id(static_cast<uint16_t>(detdataformats::DetID::Subdetector::kHD_TPC));
+  return fragment;
+}
+
+void
+benchmark_trigger_id()
+{
+  for (size_t book_size : { 16, 256, 4096 }) {
+    std::map<TriggerId, int> book;
+    std::vector<TriggerId> keys;
+    for (size_t i = 0; i < book_size; ++i) {
+      TriggerId id(make_decision(i, 0), i % 3);
+      keys.push_back(id);
+      book[id] = static_cast<int>(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+    run_benchmark("TriggerId_less", { { "keys", book_size } }, keys.size() - 1, [&]() {
+      uint64_t count = 0; // NOLINT(build/unsigned)
+      for (size_t i = 1; i < keys.size(); ++i) {
+        count += keys[i - 1] < keys[i];
+      }
+      s_sink = s_sink + count;
+    });
+
+    run_benchmark("TriggerId_book_find", { { "book_size", book_size } }, keys.size(), [&]() {
+      uint64_t sum = 0; // NOLINT(build/unsigned)
+      for (auto& key : keys) {
+        sum += book.find(key)->second;
+      }
+      s_sink = s_sink + sum;
+    });
+  }
+}
+
+void
+benchmark_trigger_record_book()
+{
+  using clock_type = std::chrono::high_resolution_clock;
+  using book_t = std::map<TriggerId, std::pair<clock_type::time_point, std::unique_ptr<daqdataformats::TriggerRecord>>>;
+
+  const size_t records_per_call = 64;
+  for (size_t n_components : { 1, 10, 150 }) {
+    std::vector<dfmessages::TriggerDecision> decisions;
+    for (size_t i = 0; i < records_per_call; ++i) {
+      decisions.push_back(make_decision(i + 1, n_components));
+    }
+    std::vector<char> payload(1024);
+
+    run_benchmark(
+      "TriggerRecordBuilder_book_insert_extract", { { "components", n_components } }, records_per_call, [&]() {
+        book_t book;
+        for (auto& td : decisions) {
+          TriggerId id(td, 0);
+          auto& entry = book[id] = std::make_pair(clock_type::now(), std::unique_ptr<daqdataformats::TriggerRecord>());
+          entry.second.reset(new daqdataformats::TriggerRecord(td.components));
+          entry.second->get_header_ref().set_trigger_number(td.trigger_number);
+          entry.second->get_header_ref().set_run_number(td.run_number);
+        }
+        for (auto& td : decisions) {
+          auto it = book.find(TriggerId(td, 0));
+          s_sink = s_sink + it->second.second->get_header_ref().get_num_requested_components();
+          book.erase(it);
+        }
+      });
+
+    run_benchmark("TriggerRecordBuilder_book_fill", { { "components", n_components } }, records_per_call, [&]() {
+      book_t book;
+      for (auto& td : decisions) {
+        TriggerId id(td, 0);
+        auto& entry = book[id] = std::make_pair(clock_type::now(), std::unique_ptr<daqdataformats::TriggerRecord>());
+        entry.second.reset(new daqdataformats::TriggerRecord(td.components));
+      }
+      // fragments arrive interleaved across the records, as they do from the readout
+      for (size_t c = 0; c < n_components; ++c) {
+        for (auto& td : decisions) {
+          TriggerId id(td, 0);
+          auto it = book.find(id);
+          it->second.second->add_fragment(make_fragment(id, td.components[c].component, payload));
+        }
+      }
+      for (auto& td : decisions) {
+        auto it = book.find(TriggerId(td, 0));
+        s_sink = s_sink + it->second.second->get_fragments_ref().size();
+        book.erase(it);
+      }
+    });
+  }
+}
+
+void
+benchmark_window_slicing()
+{
+  const size_t n_components = 1000;
+  const size_t n_slices = 10000;
+  const daqdataformats::timestamp_diff_t max_time_window = 64;
+  const daqdataformats::timestamp_t begin = 1000000;
+  const daqdataformats::timestamp_t end = begin + n_slices * max_time_window;
+
+  // "staggered": every component covers 10 slices, the starts are spread over the window
+  // "full": every component covers the whole window
+  for (std::string layout : { "staggered", "full" }) {
+    std::vector<daqdataformats::ComponentRequest> components;
+    for (size_t i = 0; i < n_components; ++i) {
+      daqdataformats::SourceID source_id(daqdataformats::SourceID::Subsystem::kDetectorReadout, i);
+      if (layout == "full") {
+        components.emplace_back(source_id, begin, end);
+      } else {
+        auto start = begin + (i * (n_slices - 10) / n_components) * max_time_window;
+        components.emplace_back(source_id, start, start + 10 * max_time_window);
+      }
+    }
+    nlohmann::json parameters = {
+      { "components", n_components }, { "slices", n_slices }, { "layout", layout }
+    };
+
+    WindowSlicer slicer;
+    run_benchmark("WindowSlicer_sweep", parameters, n_slices, [&]() {
+      size_t total = 0;
+      slicer.reset(components, max_time_window);
+      for (size_t sequence = 0; sequence <= slicer.max_sequence_number(); ++sequence) {
+        total += slicer.next_slice().size();
+      }
+      s_sink = s_sink + total;
+    });
+
+    run_benchmark("WindowSlicer_per_slice_scan", parameters, n_slices, [&]() {
+      size_t total = 0;
+      for (size_t sequence = 0; sequence < n_slices; ++sequence) {
+        daqdataformats::timestamp_t slice_begin = begin + sequence * max_time_window;
+        daqdataformats::timestamp_t slice_end = std::min(slice_begin + max_time_window, end);
+        std::vector<daqdataformats::ComponentRequest> slice_components;
+        for (const auto& component : components) {
+          if (component.window_begin >= slice_end || component.window_end <= slice_begin)
+            continue;
+          slice_components.emplace_back(component.component,
+                                        std::max(slice_begin, component.window_begin),
+                                        std::min(slice_end, component.window_end));
+        }
+        total += slice_components.size();
+      }
+      s_sink = s_sink + total;
+    });
+  }
+}
+
+void
+benchmark_trigger_record_builder_data()
+{
+  for (size_t in_flight : { 1, 10, 100 }) {
+    TriggerRecordBuilderData data("benchmark", in_flight + 1);
+    std::vector<dfmessages::TriggerDecision> decisions;
+    for (size_t i = 0; i < in_flight; ++i) {
+      decisions.push_back(make_decision(i + 1, 0));
+    }
+
+    run_benchmark("TriggerRecordBuilderData_assign_complete", { { "in_flight", in_flight } }, in_flight, [&]() {
+      for (auto& td : decisions) {
+        data.add_assignment(data.make_assignment(td));
+      }
+      for (auto& td : decisions) {
+        s_sink = s_sink + data.complete_assignment(td.trigger_number)->decision.trigger_number;
+      }
+    });
+  }
+}
+
+trigger::TPSet
+make_tpset(size_t sequence, uint32_t source, daqdataformats::timestamp_t start, size_t n_tps) // NOLINT(build/unsigned)
+{
+  trigger::TPSet tpset;
+  tpset.type = trigger::TPSet::Type::kPayload;
+  tpset.seqno = sequence;
+  tpset.origin = daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kTrigger, source);
+  tpset.start_time = start;
+  tpset.end_time = start + n_tps * 10;
+  for (size_t i = 0; i < n_tps; ++i) {
+    detdataformats::trigger::TriggerPrimitive tp;
+    tp.time_start = start + i * 10;
+    tp.channel = i;
+    tpset.objects.push_back(tp);
+  }
+  return tpset;
+}
+
+void
+benchmark_tp_bundle_handler()
+{
+  const daqdataformats::timestamp_t slice_interval = 100000;
+  const size_t sets_per_call = 256;
+
+  for (size_t n_sources : { 1, 10 }) {
+    for (size_t n_tps : { 10, 100 }) {
+      // TPSets of all the sources cover consecutive windows; a few of them
+      // straddle the boundary between time slices
+      std::vector<trigger::TPSet> tpsets;
+      daqdataformats::timestamp_t start = 10 * slice_interval;
+      for (size_t i = 0; tpsets.size() < sets_per_call; ++i) {
+        for (size_t s = 0; s < n_sources && tpsets.size() < sets_per_call; ++s) {
+          tpsets.push_back(make_tpset(i, s, start, n_tps));
+        }
+        start += n_tps * 10;
+      }
+
+      run_benchmark("TPBundleHandler_add_tpset_get_timeslices",
+                    { { "sources", n_sources }, { "tps_per_set", n_tps } },
+                    sets_per_call,
+                    [&]() {
+                      TPBundleHandler handler(slice_interval, 1, std::chrono::steady_clock::duration(0));
+                      for (auto& tpset : tpsets) {
+                        auto copy = tpset;
+                        handler.add_tpset(std::move(copy));
+                      }
+                      for (auto& slice : handler.get_properly_aged_timeslices()) {
+                        s_sink = s_sink + slice->get_fragments_ref().size();
+                      }
+                    });
+    }
+  }
+}
+
+hdf5libs::hdf5filelayout::FileLayoutParams
+create_file_layout_params()
+{
+  hdf5libs::hdf5filelayout::PathParams params;
+  params.detector_group_type = "TPC";
+  params.detector_group_name = "TPC";
+  params.element_name_prefix = "Link";
+  params.digits_for_element_number = 10;
+
+  hdf5libs::hdf5filelayout::FileLayoutParams layout_params;
+  layout_params.path_param_list.push_back(params);
+  return layout_params;
+}
+
+daqdataformats::TriggerRecord
+create_trigger_record(daqdataformats::trigger_number_t trigger_number, size_t n_fragments, std::vector<char>& payload)
+{
+  auto td = make_decision(trigger_number, n_fragments);
+  daqdataformats::TriggerRecord record(td.components);
+  record.get_header_ref().set_trigger_number(trigger_number);
+  record.get_header_ref().set_run_number(td.run_number);
+  record.get_header_ref().set_trigger_timestamp(td.trigger_timestamp);
+  TriggerId id(td, 0);
+  for (auto& component : td.components) {
+    record.add_fragment(make_fragment(id, component.component, payload));
+  }
+  return record;
+}
+
+void
+benchmark_hdf5_data_store()
+{
+  std::string directory = std::filesystem::temp_directory_path() / ("dfmodules_microbenchmarks_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+
+  const size_t records_per_call = 8;
+  for (size_t n_fragments : { 1, 10, 100 }) {
+    for (size_t fragment_size : { 1024, 65536 }) {
+      std::vector<char> payload(fragment_size);
+      std::vector<daqdataformats::TriggerRecord> records;
+      for (size_t i = 0; i < records_per_call; ++i) {
+        records.push_back(create_trigger_record(i + 1, n_fragments, payload));
+      }
+
+      hdf5datastore::ConfParams config_params;
+      config_params.name = "benchmarkWriter";
+      config_params.directory_path = directory;
+      config_params.mode = "all-per-file";
+      config_params.max_file_size_bytes = 1000000000;
+      config_params.filename_parameters.overall_prefix = "bench";
+      config_params.file_layout_parameters = create_file_layout_params();
+      hdf5datastore::data_t config_json;
+      hdf5datastore::to_json(config_json, config_params);
+      auto data_store = make_data_store(config_json);
+
+      daqdataformats::trigger_number_t trigger_number = 0;
+      run_benchmark("HDF5DataStore_write",
+                    { { "fragments", n_fragments }, { "fragment_size", fragment_size } },
+                    records_per_call,
+                    [&]() {
+                      // every record must have a new trigger number, or the write is rejected
+                      for (auto& record : records) {
+                        record.get_header_ref().set_trigger_number(++trigger_number);
+                        data_store->write(record);
+                      }
+                    });
+
+      data_store.reset();
+      for (auto& entry : std::filesystem::directory_iterator(directory)) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
+  std::filesystem::remove_all(directory);
+}
+
+void
+benchmark_file_names()
+{
+  hdf5datastore::ConfParams config_params;
+  config_params.directory_path = "/data/run";
+  config_params.filename_parameters.overall_prefix = "swtest";
+  config_params.filename_parameters.writer_identifier = "dataflow0_datawriter_0";
+
+  const size_t names_per_call = 1000;
+  for (std::string mode : { "all-per-file", "one-event-per-file" }) {
+    config_params.mode = mode;
+    run_benchmark("HDF5FileUtils_get_file_name", { { "mode", mode } }, names_per_call, [&]() {
+      size_t total_length = 0;
+      for (size_t i = 0; i < names_per_call; ++i) {
+        total_length += HDF5FileUtils::get_file_name(config_params, i, 12345, i / 100).size();
+      }
+      s_sink = s_sink + total_length;
+    });
+  }
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  if (argc > 1) {
+    s_filter = argv[1];
+  }
+  if (argc > 2) {
+    s_min_time = std::chrono::milliseconds(std::atoi(argv[2]));
+  }
+
+  benchmark_trigger_id();
+  benchmark_trigger_record_book();
+  benchmark_window_slicing();
+  benchmark_trigger_record_builder_data();
+  benchmark_tp_bundle_handler();
+  benchmark_hdf5_data_store();
+  benchmark_file_names();
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file numa_placement_benchmark.cxx
+ *
+ * Measures how fast a "writer" thread can gather fragment payloads that were
+ * allocated and filled by a "receiver" thread, for every combination of NUMA
+ * nodes the two threads can be placed on.  This is the access pattern of the
+ * TriggerRecordBuilder (fragments received and stored in the book) followed by
+ * the DataWriter (fragments copied into HDF5 buffers), and shows what the
+ * thread_cpu_list/thread_numa_node configuration parameters buy on a
+ * multi-socket host.  On a single-node host only the local combination and the
+ * unplaced baseline are measured.
+ *
+ * Results are printed as one JSON object per line.
+ *
+ * Usage: dfmodules_numa_placement_benchmark [total_megabytes [fragment_kilobytes [passes]]]
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ThreadPlacement.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+struct Result
+{
+  double seconds = 0.;
+  uint64_t bytes = 0; // NOLINT(build/unsigned)
+  uint64_t checksum = 0; // NOLINT(build/unsigned)
+};
+
+Result
+run_combination(int data_node, int writer_node, size_t total_bytes, size_t fragment_bytes, int passes)
+{
+  std::vector<std::unique_ptr<char[]>> fragments; // NOLINT(modernize-avoid-c-arrays)
+  size_t n_fragments = total_bytes / fragment_bytes;
+
+  // the receiver side: allocate and first-touch the fragments
+  std::thread receiver([&]() {
+    if (data_node >= 0) {
+      ThreadPlacement("", data_node).apply_to_current_thread("receiver");
+    }
+    fragments.reserve(n_fragments);
+    for (size_t i = 0; i < n_fragments; ++i) {
+      fragments.emplace_back(new char[fragment_bytes]); // NOLINT(modernize-avoid-c-arrays)
+      std::memset(fragments.back().get(), static_cast<int>(i & 0xff), fragment_bytes);
+    }
+  });
+  receiver.join();
+
+  // the writer side: gather the fragments into a write buffer, as a data
+  // store does when it serialises a record
+  Result result;
+  std::thread writer([&]() {
+    if (writer_node >= 0) {
+      ThreadPlacement("", writer_node).apply_to_current_thread("writer");
+    }
+    const size_t buffer_fragments = 64;
+    std::vector<char> write_buffer(buffer_fragments * fragment_bytes);
+    std::memset(write_buffer.data(), 0, write_buffer.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+      for (size_t i = 0; i < n_fragments; ++i) {
+        auto slot = (i % buffer_fragments) * fragment_bytes;
+        std::memcpy(write_buffer.data() + slot, fragments[i].get(), fragment_bytes);
+        result.checksum += static_cast<unsigned char>(write_buffer[slot]);
+      }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(stop - start).count();
+    result.bytes = static_cast<uint64_t>(passes) * n_fragments * fragment_bytes; // NOLINT(build/unsigned)
+  });
+  writer.join();
+
+  return result;
+}
+
+void
+print_result(const std::string& placement, int data_node, int writer_node, const Result& result)
+{
+  std::cout << "{\"benchmark\": \"numa_placement\", \"placement\": \"" << placement << "\", \"data_node\": " << data_node
+            << ", \"writer_node\": " << writer_node << ", \"bytes\": " << result.bytes
+            << ", \"seconds\": " << result.seconds
+            << ", \"GB_per_s\": " << (result.seconds > 0 ? result.bytes / result.seconds / 1e9 : 0.)
+            << ", \"checksum\": " << result.checksum << "}" << std::endl;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  size_t total_megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+  size_t fragment_kilobytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 128;
+  int passes = argc > 3 ? std::atoi(argv[3]) : 5;
+  if (total_megabytes == 0 || fragment_kilobytes == 0 || passes <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [total_megabytes [fragment_kilobytes [passes]]]" << std::endl;
+    return 1;
+  }
+
+  size_t total_bytes = total_megabytes << 20;
+  size_t fragment_bytes = fragment_kilobytes << 10;
+  // the node ids are those of the online nodes, which may have gaps
+  auto nodes = ThreadPlacement::get_online_numa_nodes();
+  if (nodes.size() < 2) {
+    std::cerr << "Only one NUMA node found: the remote combinations cannot be measured on this host" << std::endl;
+  }
+
+  print_result("none", -1, -1, run_combination(-1, -1, total_bytes, fragment_bytes, passes));
+  for (int data_node : nodes) {
+    for (int writer_node : nodes) {
+      auto result = run_combination(data_node, writer_node, total_bytes, fragment_bytes, passes);
+      print_result(data_node == writer_node ? "local" : "remote", data_node, writer_node, result);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,331 @@
+/**
+ * @file trb_replay.cxx
+ *
+ * Replays an arrival trace, recorded by a TriggerRecordBuilder with
+ * arrival_trace_directory set, into a standalone TriggerRecordBuilder.  The
+ * trigger decisions and the fragments are pushed into the builder queues in
+ * the recorded order, either with the recorded spacing (scaled by the speed
+ * factor) or as fast as possible.  The data requests produced by the builder
+ * are counted and discarded, since the fragments come from the trace.
+ *
+ * While the replay runs, the book depth (pending trigger decisions and
+ * fragments) is sampled from the operational monitoring of the builder, and
+ * the time from the injection of a decision to the reception of its trigger
+ * records is measured.  At the end, these figures are added to the run
+ * performance summary, next to the section of the builder itself (completion
+ * latency, worker CPU time, ...), and the summary is printed.
+ *
+ * Usage: dfmodules_trb_replay <arrival_trace> [speed [trb_configuration.json]]
+ *
+ *   speed: 1 replays at the original speed, 2 twice as fast, 0 (default) as
+ *          fast as possible
+ *   trb_configuration.json: ConfParams of the builder; its map is replaced by
+ *          the SourceIDs of the trace
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ArrivalTrace.hpp"
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/RunSummary.hpp"
+#include "dfmodules/triggerrecordbuilderinfo/InfoNljs.hpp"
+
+#include "appfwk/DAQModule.hpp"
+#include "appfwk/app/Nljs.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/TriggerRecord.hpp"
+#include "dfmessages/DataRequest.hpp"
+#include "dfmessages/Fragment_serialization.hpp"
+#include "dfmessages/TriggerDecision.hpp"
+#include "dfmessages/TriggerRecord_serialization.hpp"
+#include "iomanager/IOManager.hpp"
+#include "logging/Logging.hpp"
+#include "nlohmann/json.hpp"
+#include "opmonlib/InfoCollector.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+const std::string s_decision_queue = "replay.trigger_decisions";   // NOLINT(runtime/string)
+const std::string s_fragment_queue = "replay.fragments";           // NOLINT(runtime/string)
+const std::string s_request_queue = "replay.data_requests";        // NOLINT(runtime/string)
+const std::string s_record_queue = "replay.trigger_records";       // NOLINT(runtime/string)
+
+triggerrecordbuilderinfo::Info
+get_trb_info(appfwk::DAQModule& trb)
+{
+  opmonlib::InfoCollector ci;
+  trb.get_info(ci, 99);
+
+  auto json = ci.get_collected_infos();
+  auto info_json = json[opmonlib::JSONTags::properties][triggerrecordbuilderinfo::Info::info_type];
+  triggerrecordbuilderinfo::Info info;
+  triggerrecordbuilderinfo::from_json(info_json[opmonlib::JSONTags::data], info);
+  return info;
+}
+
+/**
+ * @brief Time between the injection of a decision and the reception of its
+ * last trigger record
+ */
+class InjectionLatency
+{
+public:
+  void injected(daqdataformats::trigger_number_t trigger_number)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_injection_times.emplace(trigger_number, std::chrono::steady_clock::now());
+  }
+
+  void received(const daqdataformats::TriggerRecordHeader& header)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    ++m_records;
+    auto it = m_injection_times.find(header.get_trigger_number());
+    if (it == m_injection_times.end()) {
+      return;
+    }
+    if (header.get_sequence_number() == header.get_max_sequence_number()) {
+      m_latency.record(std::chrono::steady_clock::now() - it->second);
+      m_injection_times.erase(it);
+    }
+  }
+
+  size_t records() const
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_records;
+  }
+
+  nlohmann::json summarise() const
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return RunSummary::summarise(m_latency);
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::map<daqdataformats::trigger_number_t, std::chrono::steady_clock::time_point> m_injection_times;
+  LatencyHistogram m_latency;
+  size_t m_records = 0;
+};
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <arrival_trace> [speed [trb_configuration.json]]" << std::endl;
+    return 1;
+  }
+  double speed = argc > 2 ? std::atof(argv[2]) : 0.;
+
+  nlohmann::json conf = nlohmann::json::object();
+  if (argc > 3) {
+    std::ifstream conf_file(argv[3]);
+    if (!conf_file.is_open()) {
+      std::cerr << "Unable to open " << argv[3] << std::endl;
+      return 1;
+    }
+    conf_file >> conf;
+  }
+
+  // the whole trace is loaded first, so that reading it does not slow the replay down
+  std::vector<ArrivalTraceEntry> entries;
+  std::set<daqdataformats::SourceID> source_ids;
+  size_t n_decisions = 0;
+  try {
+    ArrivalTraceReader reader(argv[1]);
+    ArrivalTraceEntry entry;
+    while (reader.next(entry)) {
+      if (entry.type == ArrivalType::kTriggerDecision) {
+        ++n_decisions;
+        for (const auto& component : entry.decision.components) {
+          source_ids.insert(component.component);
+        }
+      }
+      entries.push_back(entry);
+    }
+  } catch (const ArrivalTraceError& excpt) {
+    ers::fatal(excpt);
+    return 2;
+  }
+
+  auto first_decision = std::find_if(
+    entries.begin(), entries.end(), [](const auto& e) { return e.type == ArrivalType::kTriggerDecision; });
+  if (first_decision == entries.end()) {
+    std::cerr << argv[1] << " holds no trigger decision" << std::endl;
+    return 2;
+  }
+  daqdataformats::run_number_t run_number = first_decision->decision.run_number;
+
+  TLOG() << "Replaying " << entries.size() << " arrivals (" << n_decisions << " trigger decisions, "
+         << source_ids.size() << " SourceIDs) of run " << run_number << " at "
+         << (speed > 0 ? std::to_string(speed) + "x" : std::string("maximum")) << " speed";
+
+  // queues in the place of the network connections of the builder
+  iomanager::ConnectionIds_t connections;
+  connections.emplace_back(iomanager::ConnectionId{ s_decision_queue,
+                                                    iomanager::ServiceType::kQueue,
+                                                    datatype_to_string<dfmessages::TriggerDecision>(),
+                                                    "queue://FollySPSCQueue:100000" });
+  connections.emplace_back(iomanager::ConnectionId{ s_fragment_queue,
+                                                    iomanager::ServiceType::kQueue,
+                                                    datatype_to_string<std::unique_ptr<daqdataformats::Fragment>>(),
+                                                    "queue://FollySPSCQueue:100000" });
+  connections.emplace_back(iomanager::ConnectionId{ s_request_queue,
+                                                    iomanager::ServiceType::kQueue,
+                                                    datatype_to_string<dfmessages::DataRequest>(),
+                                                    "queue://FollyMPMCQueue:100000" });
+  connections.emplace_back(
+    iomanager::ConnectionId{ s_record_queue,
+                             iomanager::ServiceType::kQueue,
+                             datatype_to_string<std::unique_ptr<daqdataformats::TriggerRecord>>(),
+                             "queue://FollySPSCQueue:1000" });
+  get_iomanager()->configure(connections);
+  auto iom = iomanager::IOManager::get();
+
+  appfwk::app::ModInit init;
+  init.conn_refs.emplace_back(iomanager::ConnectionRef{ "trigger_decision_input", s_decision_queue });
+  init.conn_refs.emplace_back(iomanager::ConnectionRef{ "trigger_record_output", s_record_queue });
+  init.conn_refs.emplace_back(iomanager::ConnectionRef{ "data_fragment_0", s_fragment_queue });
+  nlohmann::json init_json;
+  appfwk::app::to_json(init_json, init);
+
+  // every SourceID is served by the request sink
+  conf["map"] = nlohmann::json::array();
+  for (const auto& source_id : source_ids) {
+    conf["map"].push_back({ { "source_id", source_id.id },
+                            { "system", daqdataformats::SourceID::subsystem_to_string(source_id.subsystem) },
+                            { "connection_uid", s_request_queue } });
+  }
+  if (!conf.contains("source_id")) {
+    conf["source_id"] = 0;
+  }
+  conf["reply_connection_name"] = s_fragment_queue;
+
+  auto trb = appfwk::make_module("TriggerRecordBuilder", "trb_replay");
+  trb->init(init_json);
+  trb->execute_command("conf", "INITIAL", conf);
+
+  std::atomic<size_t> data_requests{ 0 };
+  InjectionLatency latency;
+  iom->get_receiver<dfmessages::DataRequest>(s_request_queue)->add_callback([&](dfmessages::DataRequest&) {
+    ++data_requests;
+  });
+  iom->get_receiver<std::unique_ptr<daqdataformats::TriggerRecord>>(s_record_queue)
+    ->add_callback([&](std::unique_ptr<daqdataformats::TriggerRecord>& record) {
+      latency.received(record->get_header_ref());
+    });
+
+  trb->execute_command("start", "CONFIGURED", nlohmann::json{ { "run", run_number } });
+
+  // book depth, sampled while the replay runs
+  std::atomic<bool> sampling{ true };
+  size_t samples = 0;
+  double sum_pending_decisions = 0;
+  double sum_pending_fragments = 0;
+  uint64_t max_pending_decisions = 0; // NOLINT(build/unsigned)
+  uint64_t max_pending_fragments = 0; // NOLINT(build/unsigned)
+  uint64_t loops = 0;                 // NOLINT(build/unsigned)
+  uint64_t sleeps = 0;                // NOLINT(build/unsigned)
+  std::thread sampler([&]() {
+    while (sampling.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      auto info = get_trb_info(*trb);
+      ++samples;
+      sum_pending_decisions += info.pending_trigger_decisions;
+      sum_pending_fragments += info.pending_fragments;
+      max_pending_decisions = std::max<uint64_t>(max_pending_decisions, info.pending_trigger_decisions);
+      max_pending_fragments = std::max<uint64_t>(max_pending_fragments, info.pending_fragments);
+      loops += info.loop_counter;
+      sleeps += info.sleep_counter;
+    }
+  });
+
+  auto decision_sender = iom->get_sender<dfmessages::TriggerDecision>(s_decision_queue);
+  auto fragment_sender = iom->get_sender<std::unique_ptr<daqdataformats::Fragment>>(s_fragment_queue);
+
+  auto replay_start = std::chrono::steady_clock::now();
+  auto trace_start = entries.front().arrival_time_ns;
+  for (auto& entry : entries) {
+    if (speed > 0) {
+      auto offset = std::chrono::nanoseconds(static_cast<int64_t>((entry.arrival_time_ns - trace_start) / speed));
+      std::this_thread::sleep_until(replay_start + offset);
+    }
+    if (entry.type == ArrivalType::kTriggerDecision) {
+      latency.injected(entry.decision.trigger_number);
+      decision_sender->send(std::move(entry.decision), iomanager::Sender::s_block);
+    } else {
+      fragment_sender->send(ArrivalTraceReader::make_fragment(entry.fragment), iomanager::Sender::s_block);
+    }
+  }
+  auto injection_time = std::chrono::steady_clock::now() - replay_start;
+
+  // wait for the builder to go quiet before stopping it
+  size_t received = latency.records();
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    auto now_received = latency.records();
+    if (now_received == received) {
+      break;
+    }
+    received = now_received;
+  }
+
+  trb->execute_command("stop", "RUNNING", nlohmann::json::object());
+  sampling = false;
+  sampler.join();
+  trb->execute_command("scrap", "CONFIGURED", nlohmann::json::object());
+
+  nlohmann::json replay;
+  replay["trace"] = argv[1];
+  replay["speed"] = speed;
+  replay["arrivals"] = entries.size();
+  replay["trigger_decisions"] = n_decisions;
+  replay["received_trigger_records"] = latency.records();
+  replay["data_requests"] = data_requests.load();
+  replay["injection_time_s"] = std::chrono::duration<double>(injection_time).count();
+  replay["injection_to_record_latency"] = latency.summarise();
+  replay["mean_pending_trigger_decisions"] = samples > 0 ? sum_pending_decisions / samples : 0.;
+  replay["mean_pending_fragments"] = samples > 0 ? sum_pending_fragments / samples : 0.;
+  replay["max_pending_trigger_decisions"] = max_pending_decisions;
+  replay["max_pending_fragments"] = max_pending_fragments;
+  replay["loop_counter"] = loops;
+  replay["sleep_counter"] = sleeps;
+
+  auto report = RunSummary::get().add_section(run_number, "replay", replay);
+  std::ifstream report_file(report);
+  if (report_file.is_open()) {
+    std::cout << report_file.rdbuf() << std::endl;
+  } else {
+    std::cout << std::setw(2) << replay << std::endl;
+  }
+
+  iom->get_receiver<dfmessages::DataRequest>(s_request_queue)->remove_callback();
+  iom->get_receiver<std::unique_ptr<daqdataformats::TriggerRecord>>(s_record_queue)->remove_callback();
+  trb.reset();
+  get_iomanager()->reset();
+  return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file ArrivalTrace_test.cxx Test application that tests and demonstrates
+ * the functionality of the ArrivalTraceWriter and ArrivalTraceReader classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ArrivalTrace.hpp"
+
+#define BOOST_TEST_MODULE ArrivalTrace_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+using dunedaq::dfmessages::TriggerDecision;
+
+namespace {
+
+TriggerDecision
+create_decision(trigger_number_t trigger_number, size_t n_components)
+{
+  TriggerDecision decision;
+  decision.trigger_number = trigger_number;
+  decision.run_number = 3;
+  decision.trigger_timestamp = 1000 * trigger_number;
+  decision.trigger_type = 1;
+  decision.readout_type = dunedaq::dfmessages::ReadoutType::kLocalized;
+  for (size_t i = 0; i < n_components; ++i) {
+    decision.components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, i),
+                                     decision.trigger_timestamp - 10,
+                                     decision.trigger_timestamp + 10);
+  }
+  return decision;
+}
+
+std::unique_ptr<Fragment>
+create_fragment(trigger_number_t trigger_number, uint32_t element_id, size_t payload_size) // NOLINT(build/unsigned)
+{
+  std::vector<char> payload(payload_size, 'x');
+  auto fragment = std::make_unique<Fragment>(payload.data(), payload.size());
+  fragment->set_trigger_number(trigger_number);
+  fragment->set_run_number(3);
+  fragment->set_element_id(SourceID(SourceID::Subsystem::kDetectorReadout, element_id));
+  return fragment;
+}
+
+std::string
+trace_filename(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()) + ".arrivals")).string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ArrivalTrace_test)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+  auto filename = trace_filename("roundtrip");
+  BOOST_REQUIRE(ArrivalTraceWriter::file_name("/tmp", "trb", 3).find("trb_run000003.arrivals") != std::string::npos);
+
+  {
+    ArrivalTraceWriter writer(filename, true);
+    writer.record(create_decision(1, 2));
+    writer.record(*create_fragment(1, 0, 100));
+    writer.record(create_decision(2, 0));
+    writer.record(*create_fragment(1, 1, 200));
+    BOOST_REQUIRE_EQUAL(writer.entries(), 4);
+  }
+
+  ArrivalTraceReader reader(filename);
+  ArrivalTraceEntry entry;
+
+  BOOST_REQUIRE(reader.next(entry));
+  BOOST_REQUIRE(entry.type == ArrivalType::kTriggerDecision);
+  BOOST_REQUIRE_EQUAL(entry.decision.trigger_number, 1);
+  BOOST_REQUIRE_EQUAL(entry.decision.run_number, 3);
+  BOOST_REQUIRE_EQUAL(entry.decision.components.size(), 2);
+  BOOST_REQUIRE(entry.decision.components[1].component == SourceID(SourceID::Subsystem::kDetectorReadout, 1));
+  BOOST_REQUIRE_EQUAL(entry.decision.components[1].window_end, 1010);
+  auto first_time = entry.arrival_time_ns;
+
+  BOOST_REQUIRE(reader.next(entry));
+  BOOST_REQUIRE(entry.type == ArrivalType::kFragment);
+  BOOST_REQUIRE(entry.arrival_time_ns >= first_time);
+  auto fragment = ArrivalTraceReader::make_fragment(entry.fragment);
+  BOOST_REQUIRE_EQUAL(fragment->get_trigger_number(), 1);
+  BOOST_REQUIRE_EQUAL(fragment->get_size(), create_fragment(1, 0, 100)->get_size());
+  BOOST_REQUIRE(fragment->get_element_id() == SourceID(SourceID::Subsystem::kDetectorReadout, 0));
+
+  BOOST_REQUIRE(reader.next(entry));
+  BOOST_REQUIRE(entry.type == ArrivalType::kTriggerDecision);
+  BOOST_REQUIRE(entry.decision.components.empty());
+
+  BOOST_REQUIRE(reader.next(entry));
+  BOOST_REQUIRE_EQUAL(entry.fragment.size, create_fragment(1, 1, 200)->get_size());
+
+  BOOST_REQUIRE(!reader.next(entry));
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(WithoutPayloadSizes)
+{
+  auto filename = trace_filename("headers");
+  {
+    ArrivalTraceWriter writer(filename, false);
+    writer.record(*create_fragment(5, 2, 1000));
+  }
+
+  ArrivalTraceReader reader(filename);
+  ArrivalTraceEntry entry;
+  BOOST_REQUIRE(reader.next(entry));
+  auto fragment = ArrivalTraceReader::make_fragment(entry.fragment);
+  BOOST_REQUIRE_EQUAL(fragment->get_size(), sizeof(FragmentHeader));
+  BOOST_REQUIRE_EQUAL(fragment->get_trigger_number(), 5);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(Corrupted)
+{
+  auto filename = trace_filename("truncated");
+  {
+    ArrivalTraceWriter writer(filename, false);
+    writer.record(create_decision(1, 4));
+  }
+  std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 8);
+
+  ArrivalTraceReader reader(filename);
+  ArrivalTraceEntry entry;
+  BOOST_REQUIRE_THROW(reader.next(entry), dunedaq::dfmodules::ArrivalTraceError);
+  std::filesystem::remove(filename);
+
+  BOOST_REQUIRE_THROW(ArrivalTraceReader("/nonexistent/directory/file.arrivals"), dunedaq::dfmodules::ArrivalTraceError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
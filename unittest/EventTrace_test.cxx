@@ -0,0 +1,156 @@
+/**
+ * @file EventTrace_test.cxx Test application that tests and demonstrates
+ * the functionality of the EventTrace class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/EventTrace.hpp"
+
+#define BOOST_TEST_MODULE EventTrace_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+// size of the file header for a given label, followed by the per-thread headers
+size_t
+expected_file_size(const std::string& label, const std::vector<std::pair<std::string, size_t>>& threads)
+{
+  size_t size = 8 + 4 + 8 + 8 + 4 + label.size() + 4;
+  for (auto& [name, events] : threads) {
+    size += 8 + 4 + name.size() + 8 + events * sizeof(TraceEvent);
+  }
+  return size;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(EventTrace_test)
+
+BOOST_AUTO_TEST_CASE(SourceRegistration)
+{
+  auto& trace = EventTrace::get();
+  auto first = trace.register_source("first_module");
+  auto second = trace.register_source("second_module");
+  BOOST_REQUIRE_NE(first, second);
+  BOOST_REQUIRE_EQUAL(first, trace.register_source("first_module"));
+}
+
+BOOST_AUTO_TEST_CASE(RingBuffer)
+{
+  EventTraceBuffer buffer(10, 1234);
+  for (uint64_t i = 0; i < 40; ++i) { // NOLINT(build/unsigned)
+    buffer.record(TraceEventType::kReceive, i % 2, i, 0);
+  }
+
+  // the capacity is rounded up to 16, so only the last 16 events survive
+  auto events = buffer.snapshot(1);
+  BOOST_REQUIRE_EQUAL(events.size(), 8);
+  BOOST_REQUIRE_EQUAL(events.front().argument, 25);
+  BOOST_REQUIRE_EQUAL(events.back().argument, 39);
+  for (size_t i = 1; i < events.size(); ++i) {
+    BOOST_REQUIRE(events[i - 1].timestamp <= events[i].timestamp);
+  }
+  BOOST_REQUIRE_EQUAL(buffer.get_thread_id(), 1234);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentSnapshot)
+{
+  EventTraceBuffer buffer(64, 1234);
+  std::atomic<bool> running{ true };
+  std::thread writer([&]() {
+    for (uint64_t i = 0; running.load(); ++i) { // NOLINT(build/unsigned)
+      buffer.record(TraceEventType::kSend, 1, i, static_cast<uint32_t>(i));
+    }
+  });
+
+  // every entry kept while the buffer wraps around must be intact and the
+  // entries must stay in order
+  bool intact = true;
+  for (int snapshot = 0; snapshot < 1000; ++snapshot) {
+    auto events = buffer.snapshot(1);
+    for (size_t i = 0; i < events.size(); ++i) {
+      intact &= (static_cast<uint32_t>(events[i].argument) == events[i].extra);
+      intact &= (i == 0 || events[i - 1].argument < events[i].argument);
+    }
+  }
+  running = false;
+  writer.join();
+  BOOST_REQUIRE(intact);
+}
+
+BOOST_AUTO_TEST_CASE(Dump)
+{
+  auto directory = std::filesystem::temp_directory_path() / ("EventTrace_test_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+
+  auto& trace = EventTrace::get();
+  BOOST_REQUIRE_EQUAL(trace.dump(0, "disabled"), "");
+
+  trace.enable(directory.string(), 100);
+  BOOST_REQUIRE(EventTrace::enabled());
+
+  auto source = trace.register_source("dump_test");
+  auto other = trace.register_source("other_source");
+  std::thread worker([&]() {
+    for (int i = 0; i < 50; ++i) {
+      EventTrace::record(TraceEventType::kWriteBegin, source, i);
+      EventTrace::record(TraceEventType::kWriteEnd, source, i, 1);
+      EventTrace::record(TraceEventType::kSend, other, i);
+    }
+  });
+  worker.join();
+  EventTrace::record(TraceEventType::kTimeout, source, 7);
+
+  auto filename = trace.dump(source, "dump_test");
+  BOOST_REQUIRE(!filename.empty());
+  BOOST_REQUIRE(std::filesystem::exists(filename));
+
+  std::ifstream in(filename, std::ios::binary);
+  char magic[8];
+  in.read(magic, sizeof(magic));
+  BOOST_REQUIRE_EQUAL(std::string(magic, sizeof(magic)), "DFTRACE1");
+
+  // the worker buffer holds 128 events, 85 of them from this source, and the
+  // test thread contributed one.  Thread names are whatever the system uses,
+  // so only check that the size is consistent with some name lengths.
+  auto size = std::filesystem::file_size(filename);
+  auto minimum = expected_file_size("dump_test", { { "", 85 }, { "", 1 } });
+  BOOST_REQUIRE_GE(size, minimum);
+  BOOST_REQUIRE_LE(size, minimum + 2 * 16);
+
+  // the buffer of the exited worker is kept until the events of the other
+  // source have been dumped as well
+  BOOST_REQUIRE_GT(trace.get_retired_bytes(), 0);
+  BOOST_REQUIRE(!trace.dump(other, "other_source").empty());
+  BOOST_REQUIRE_EQUAL(trace.get_retired_bytes(), 0);
+
+  // a new dump only holds the events recorded since the previous one
+  EventTrace::record(TraceEventType::kRetry, source, 8);
+  EventTrace::record(TraceEventType::kRetry, source, 9);
+  filename = trace.dump(source, "second_dump");
+  BOOST_REQUIRE(!filename.empty());
+  size = std::filesystem::file_size(filename);
+  minimum = expected_file_size("second_dump", { { "", 2 } });
+  BOOST_REQUIRE_GE(size, minimum);
+  BOOST_REQUIRE_LE(size, minimum + 16);
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
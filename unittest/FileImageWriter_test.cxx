@@ -0,0 +1,123 @@
+/**
+ * @file FileImageWriter_test.cxx Test application that tests and demonstrates
+ * the functionality of the FileImageWriter class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/FileImageWriter.hpp"
+
+#define BOOST_TEST_MODULE FileImageWriter_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+std::filesystem::path
+image_directory(const std::string& name)
+{
+  auto directory = std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+
+std::vector<char>
+make_image(size_t size, char fill)
+{
+  return std::vector<char>(size, fill);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FileImageWriter_test)
+
+BOOST_AUTO_TEST_CASE(WriteInCaller)
+{
+  auto directory = image_directory("file_image_sync");
+  auto destination = (directory / "record.hdf5").string();
+
+  FileImageWriter writer;
+  BOOST_REQUIRE(!writer.background());
+  writer.submit(destination, make_image(100000, 'x'));
+  BOOST_REQUIRE(std::filesystem::exists(destination));
+  BOOST_REQUIRE(!std::filesystem::exists(destination + ".writing"));
+  BOOST_REQUIRE(FileImageWriter::load(destination) == make_image(100000, 'x'));
+  BOOST_REQUIRE_EQUAL(writer.get_counters().images_written.load(), 1);
+  BOOST_REQUIRE_EQUAL(writer.get_counters().bytes_written.load(), 100000);
+
+  auto synced = (directory / "synced.hdf5").string();
+  FileImageWriter::write_image(synced, make_image(1000, 's'), true);
+  BOOST_REQUIRE(FileImageWriter::load(synced) == make_image(1000, 's'));
+
+  BOOST_REQUIRE_THROW(writer.submit((directory / "missing" / "record.hdf5").string(), make_image(10, 'y')),
+                      FileImageWriteFailed);
+  BOOST_REQUIRE_EQUAL(writer.get_counters().write_failures.load(), 1);
+  BOOST_REQUIRE_THROW(FileImageWriter::load((directory / "missing.hdf5").string()), FileImageWriteFailed);
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(StagedFile)
+{
+  auto directory = image_directory("file_image_staged");
+  auto staged = (directory / "staged.hdf5").string();
+  FileImageWriter::write_image(staged, make_image(100, 'a'));
+
+  // the staged file stays while its image is not in place
+  FileImageWriter writer;
+  BOOST_REQUIRE_THROW(
+    writer.submit((directory / "missing" / "record.hdf5").string(), FileImageWriter::load(staged), staged),
+    FileImageWriteFailed);
+  BOOST_REQUIRE(std::filesystem::exists(staged));
+  BOOST_REQUIRE_EQUAL(writer.get_counters().staged_files_kept.load(), 1);
+
+  auto destination = (directory / "record.hdf5").string();
+  writer.submit(destination, FileImageWriter::load(staged), staged);
+  BOOST_REQUIRE(!std::filesystem::exists(staged));
+  BOOST_REQUIRE(FileImageWriter::load(destination) == make_image(100, 'a'));
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(WriteInBackground)
+{
+  auto directory = image_directory("file_image_async");
+  {
+    FileImageWriter writer(2);
+    BOOST_REQUIRE(writer.background());
+    for (int i = 0; i < 10; ++i) {
+      writer.submit((directory / ("record_" + std::to_string(i) + ".hdf5")).string(),
+                    make_image(1000 + i, static_cast<char>('a' + i)));
+    }
+    writer.drain();
+    BOOST_REQUIRE_EQUAL(writer.queued(), 0);
+    BOOST_REQUIRE_EQUAL(writer.get_counters().images_written.load(), 10);
+
+    // errors are counted, not thrown
+    writer.submit((directory / "missing" / "record.hdf5").string(), make_image(10, 'y'));
+    writer.drain();
+    BOOST_REQUIRE_EQUAL(writer.get_counters().write_failures.load(), 1);
+
+    // the queued images are written before the writer is destroyed
+    writer.submit((directory / "last.hdf5").string(), make_image(10, 'z'));
+  }
+  for (int i = 0; i < 10; ++i) {
+    BOOST_REQUIRE(FileImageWriter::load((directory / ("record_" + std::to_string(i) + ".hdf5")).string()) ==
+                  make_image(1000 + i, static_cast<char>('a' + i)));
+  }
+  BOOST_REQUIRE(std::filesystem::exists(directory / "last.hdf5"));
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
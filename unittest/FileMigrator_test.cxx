@@ -0,0 +1,176 @@
+/**
+ * @file FileMigrator_test.cxx Test application that tests and demonstrates
+ * the functionality of the FileMigrator class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/FileMigrator.hpp"
+
+#define BOOST_TEST_MODULE FileMigrator_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+struct Tiers
+{
+  std::filesystem::path staging;
+  std::filesystem::path bulk;
+
+  explicit Tiers(const std::string& name)
+  {
+    auto base = std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()));
+    staging = base / "staging";
+    bulk = base / "bulk";
+    std::filesystem::create_directories(staging);
+    std::filesystem::create_directories(bulk);
+  }
+  ~Tiers() { std::filesystem::remove_all(staging.parent_path()); }
+};
+
+std::string
+write_file(const std::filesystem::path& path, size_t bytes)
+{
+  std::ofstream file(path, std::ios::binary);
+  std::vector<char> data(bytes, 'm');
+  file.write(data.data(), data.size());
+  return path.string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FileMigrator_test)
+
+BOOST_AUTO_TEST_CASE(Migrate)
+{
+  Tiers tiers("migrate");
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 0, 0, 4096);
+
+  migrator.submit(write_file(tiers.staging / "run1_0.hdf5", 10000));
+  migrator.submit(write_file(tiers.staging / "run1_1.hdf5", 20000));
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.staging / "run1_0.hdf5"));
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.staging / "run1_0.hdf5.migrating"));
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(tiers.bulk / "run1_0.hdf5"), 10000);
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(tiers.bulk / "run1_1.hdf5"), 20000);
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().files_migrated.load(), 2);
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().bytes_migrated.load(), 30000);
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().failures.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(LateFile)
+{
+  Tiers tiers("migrate_late");
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 0, 0);
+
+  // submitted while its image is still being written
+  auto path = tiers.staging / "run2_0.hdf5";
+  migrator.submit(path.string());
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  BOOST_REQUIRE_EQUAL(migrator.pending(), 1);
+  write_file(path, 1000);
+
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+  BOOST_REQUIRE(std::filesystem::exists(tiers.bulk / "run2_0.hdf5"));
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().failures.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BandwidthCap)
+{
+  Tiers tiers("migrate_capped");
+  // 2 MB at 10 MB/s
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 10000000, 0, 100000);
+
+  auto start = std::chrono::steady_clock::now();
+  migrator.submit(write_file(tiers.staging / "run3_0.hdf5", 2000000));
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(180));
+  BOOST_REQUIRE(migrator.get_counters().throttled_time_us.load() > 0);
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().urgent_files.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShortOfSpace)
+{
+  Tiers tiers("migrate_urgent");
+  // a minimum free space that cannot be met lifts the cap
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 1000, UINT64_MAX, 100000);
+
+  migrator.submit(write_file(tiers.staging / "run4_0.hdf5", 1000000));
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().urgent_files.load(), 1);
+  BOOST_REQUIRE(std::filesystem::exists(tiers.bulk / "run4_0.hdf5"));
+}
+
+BOOST_AUTO_TEST_CASE(StopAndResume)
+{
+  Tiers tiers("migrate_stop");
+  write_file(tiers.staging / "run5_writer1_0.hdf5", 1000000);
+  write_file(tiers.staging / "run5_writer1_1.hdf5", 1000);
+  write_file(tiers.staging / "run5_writer2_0.hdf5", 1000);
+  write_file(tiers.staging / "run5_writer1_2.hdf5.writing", 1000);
+
+  {
+    // 1 MB at 100 kB/s: stopped long before the end
+    FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 100000, 0, 10000);
+    BOOST_REQUIRE_EQUAL(migrator.submit_existing("writer1"), 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  // the abandoned file is back in the staging directory, nothing partial in the bulk one
+  BOOST_REQUIRE(std::filesystem::exists(tiers.staging / "run5_writer1_0.hdf5"));
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.bulk / "run5_writer1_0.hdf5.migrating"));
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.bulk / "run5_writer1_0.hdf5"));
+
+  // the small file may or may not have been moved before the stop
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 0, 0);
+  auto found = migrator.submit_existing("writer1");
+  BOOST_REQUIRE(found >= 1);
+  // the files found again while still queued are not queued twice
+  BOOST_REQUIRE(migrator.submit_existing("writer1") <= found);
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().failures.load(), 0);
+  BOOST_REQUIRE(std::filesystem::exists(tiers.bulk / "run5_writer1_0.hdf5"));
+  BOOST_REQUIRE(std::filesystem::exists(tiers.bulk / "run5_writer1_1.hdf5"));
+  BOOST_REQUIRE(std::filesystem::exists(tiers.staging / "run5_writer2_0.hdf5"));
+  BOOST_REQUIRE(std::filesystem::exists(tiers.staging / "run5_writer1_2.hdf5.writing"));
+}
+
+BOOST_AUTO_TEST_CASE(InterruptedMigration)
+{
+  Tiers tiers("migrate_crash");
+  // a crash in the middle of a copy, and one after the copy was in place
+  write_file(tiers.staging / "run6_writer1_0.hdf5.migrating", 1000);
+  write_file(tiers.bulk / "run6_writer1_0.hdf5.migrating", 300);
+  write_file(tiers.staging / "run6_writer1_1.hdf5.migrating", 1000);
+  write_file(tiers.bulk / "run6_writer1_1.hdf5", 1000);
+  // another writer's files are left alone
+  write_file(tiers.staging / "run6_writer2_0.hdf5.migrating", 1000);
+
+  FileMigrator migrator(tiers.staging.string(), tiers.bulk.string(), 0, 0);
+  BOOST_REQUIRE_EQUAL(migrator.submit_existing("writer1"), 1);
+  BOOST_REQUIRE(migrator.wait_until_idle(std::chrono::seconds(10)));
+  BOOST_REQUIRE_EQUAL(migrator.get_counters().failures.load(), 0);
+
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(tiers.bulk / "run6_writer1_0.hdf5"), 1000);
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.bulk / "run6_writer1_0.hdf5.migrating"));
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.staging / "run6_writer1_0.hdf5.migrating"));
+  BOOST_REQUIRE(!std::filesystem::exists(tiers.staging / "run6_writer1_1.hdf5.migrating"));
+  BOOST_REQUIRE_EQUAL(std::filesystem::file_size(tiers.bulk / "run6_writer1_1.hdf5"), 1000);
+  BOOST_REQUIRE(std::filesystem::exists(tiers.staging / "run6_writer2_0.hdf5.migrating"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,48 @@
+/**
+ * @file IssueRateLimiter_test.cxx Test application that tests and demonstrates
+ * the functionality of the IssueRateLimiter class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/IssueRateLimiter.hpp"
+
+#define BOOST_TEST_MODULE IssueRateLimiter_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+
+using namespace dunedaq::dfmodules;
+
+BOOST_AUTO_TEST_SUITE(IssueRateLimiter_test)
+
+BOOST_AUTO_TEST_CASE(RateLimiting)
+{
+  IssueRateLimiter limiter(2, std::chrono::seconds(10));
+  auto start = IssueRateLimiter::clock_type::now();
+
+  size_t reported = 0;
+  for (size_t i = 0; i < 100; ++i) {
+    reported += limiter.count() ? 1 : 0;
+  }
+  BOOST_REQUIRE_EQUAL(reported, 2);
+
+  // nothing is summarised before the end of the interval
+  BOOST_REQUIRE_EQUAL(limiter.take_suppressed(start), 0);
+  BOOST_REQUIRE_EQUAL(limiter.take_suppressed(start + std::chrono::seconds(11)), 98);
+  BOOST_REQUIRE_EQUAL(limiter.take_suppressed(start + std::chrono::seconds(12), true), 0);
+
+  // a new interval reports individually again
+  BOOST_REQUIRE(limiter.count());
+  BOOST_REQUIRE(limiter.count());
+  BOOST_REQUIRE(!limiter.count());
+  BOOST_REQUIRE_EQUAL(limiter.take_suppressed(start, true), 1);
+
+  limiter.reset();
+  BOOST_REQUIRE(limiter.count());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
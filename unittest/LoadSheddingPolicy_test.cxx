@@ -0,0 +1,71 @@
+/**
+ * @file LoadSheddingPolicy_test.cxx Test application that tests and demonstrates
+ * the functionality of the LoadSheddingPolicy class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/LoadSheddingPolicy.hpp"
+
+#define BOOST_TEST_MODULE LoadSheddingPolicy_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <map>
+
+using namespace dunedaq::dfmodules;
+
+BOOST_AUTO_TEST_SUITE(LoadSheddingPolicy_test)
+
+BOOST_AUTO_TEST_CASE(Rules)
+{
+  LoadSheddingPolicy policy;
+  BOOST_REQUIRE(policy.empty());
+
+  policy.add_rule(1, 3, false);
+  policy.add_rule(2, 0, true);
+  BOOST_REQUIRE(!policy.empty());
+  BOOST_REQUIRE(policy.sheddable(1));
+  BOOST_REQUIRE(!policy.sheddable(4));
+
+  // types without a rule are never shed
+  for (int i = 0; i < 5; ++i) {
+    BOOST_REQUIRE(policy.decide(4) == SheddingAction::kKeep);
+  }
+
+  // one record in three is kept, the others dropped
+  BOOST_REQUIRE(policy.decide(1) == SheddingAction::kKeep);
+  BOOST_REQUIRE(policy.decide(1) == SheddingAction::kDrop);
+  BOOST_REQUIRE(policy.decide(1) == SheddingAction::kDrop);
+  BOOST_REQUIRE(policy.decide(1) == SheddingAction::kKeep);
+
+  // none is kept whole, all are reduced to their header
+  BOOST_REQUIRE(policy.decide(2) == SheddingAction::kHeaderOnly);
+  BOOST_REQUIRE(policy.decide(2) == SheddingAction::kHeaderOnly);
+  policy.count_abandoned_retry(2);
+  policy.count_abandoned_retry(4);
+
+  std::map<dunedaq::daqdataformats::trigger_type_t, uint64_t> dropped, header_only, abandoned; // NOLINT(build/unsigned)
+  policy.for_each([&](auto trigger_type, const LoadSheddingPolicy::Counters& counters) {
+    dropped[trigger_type] = counters.dropped;
+    header_only[trigger_type] = counters.header_only;
+    abandoned[trigger_type] = counters.abandoned_retries;
+  });
+  BOOST_REQUIRE_EQUAL(dropped.size(), 2);
+  BOOST_REQUIRE_EQUAL(dropped[1], 2);
+  BOOST_REQUIRE_EQUAL(header_only[1], 0);
+  BOOST_REQUIRE_EQUAL(header_only[2], 2);
+  BOOST_REQUIRE_EQUAL(abandoned[2], 1);
+
+  // a new run restarts the prescales and the counters
+  policy.reset();
+  BOOST_REQUIRE(policy.decide(1) == SheddingAction::kKeep);
+  policy.for_each([](auto, const LoadSheddingPolicy::Counters& counters) {
+    BOOST_REQUIRE_EQUAL(counters.dropped, 0);
+    BOOST_REQUIRE_EQUAL(counters.header_only, 0);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
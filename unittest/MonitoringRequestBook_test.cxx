@@ -0,0 +1,130 @@
+/**
+ * @file MonitoringRequestBook_test.cxx Test application that tests and demonstrates
+ * the functionality of the MonitoringRequestBook class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/MonitoringRequestBook.hpp"
+
+#define BOOST_TEST_MODULE MonitoringRequestBook_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+using dunedaq::dfmessages::TRMonRequest;
+
+namespace {
+
+TRMonRequest
+make_request(trigger_type_t trigger_type, const std::string& destination)
+{
+  TRMonRequest request;
+  request.trigger_type = trigger_type;
+  request.run_number = 1;
+  request.data_destination = destination;
+  return request;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(MonitoringRequestBook_test)
+
+BOOST_AUTO_TEST_CASE(IndexedByTriggerType)
+{
+  MonitoringRequestBook book;
+  std::vector<MonitoringRequestBook::ServedRequest> served;
+
+  BOOST_REQUIRE(book.empty());
+  book.add(make_request(1, "dqm_a"));
+  book.add(make_request(2, "dqm_b"));
+  book.add(make_request(1, "dqm_c"));
+  BOOST_REQUIRE_EQUAL(book.pending(), 3);
+
+  book.take(3, served);
+  BOOST_REQUIRE(served.empty());
+
+  book.take(1, served);
+  BOOST_REQUIRE_EQUAL(served.size(), 2);
+  BOOST_REQUIRE_EQUAL(served[0].request.data_destination, "dqm_a");
+  BOOST_REQUIRE_EQUAL(served[1].request.data_destination, "dqm_c");
+  BOOST_REQUIRE(served[0].selection.source_ids.empty());
+  BOOST_REQUIRE_EQUAL(book.pending(), 1);
+
+  book.take(1, served);
+  BOOST_REQUIRE(served.empty());
+
+  book.clear();
+  BOOST_REQUIRE(book.empty());
+  book.take(2, served);
+  BOOST_REQUIRE(served.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Sampling)
+{
+  MonitoringRequestBook book;
+  MonitoringSelection selection;
+  selection.sampling_fraction = 0.25;
+  book.set_selection("dqm", selection);
+
+  std::vector<MonitoringRequestBook::ServedRequest> served;
+  book.add(make_request(1, "dqm"));
+  size_t records = 0;
+  while (!book.empty()) {
+    ++records;
+    book.take(1, served);
+  }
+  BOOST_REQUIRE_EQUAL(records, 4);
+  BOOST_REQUIRE_EQUAL(served.size(), 1);
+
+  // records of other trigger types do not count
+  book.add(make_request(1, "dqm"));
+  for (size_t i = 0; i < 10; ++i) {
+    book.take(2, served);
+  }
+  BOOST_REQUIRE_EQUAL(book.pending(), 1);
+
+  // a destination without selection is always served
+  book.add(make_request(1, "other"));
+  book.take(1, served);
+  BOOST_REQUIRE_EQUAL(served.size(), 1);
+  BOOST_REQUIRE_EQUAL(served[0].request.data_destination, "other");
+}
+
+BOOST_AUTO_TEST_CASE(FragmentSubset)
+{
+  TriggerRecordHeaderData trh_data;
+  trh_data.trigger_number = 5;
+  trh_data.num_requested_components = 3;
+  trh_data.run_number = 1;
+  TriggerRecordHeader trh(&trh_data);
+
+  TriggerRecord record(trh);
+  for (uint32_t id = 0; id < 3; ++id) { // NOLINT(build/unsigned)
+    std::vector<char> payload(10 * (id + 1), 'x');
+    auto fragment = std::make_unique<Fragment>(payload.data(), payload.size());
+    fragment->set_element_id(SourceID(SourceID::Subsystem::kDetectorReadout, id));
+    record.add_fragment(std::move(fragment));
+  }
+
+  MonitoringSelection selection;
+  selection.source_ids.insert(SourceID(SourceID::Subsystem::kDetectorReadout, 1));
+  auto copy = MonitoringRequestBook::select_fragments(record, selection);
+  BOOST_REQUIRE_EQUAL(copy->get_header_ref().get_trigger_number(), 5);
+  BOOST_REQUIRE_EQUAL(copy->get_fragments_ref().size(), 1);
+  BOOST_REQUIRE_EQUAL(copy->get_fragments_ref()[0]->get_size(), record.get_fragments_ref()[1]->get_size());
+  BOOST_REQUIRE(copy->get_fragments_ref()[0]->get_storage_location() !=
+                record.get_fragments_ref()[1]->get_storage_location());
+
+  auto full_copy = MonitoringRequestBook::select_fragments(record, MonitoringSelection());
+  BOOST_REQUIRE_EQUAL(full_copy->get_fragments_ref().size(), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+/**
+ * @file PackedFragments_test.cxx Test application that tests and demonstrates
+ * the functionality of the PackedFragmentWriter and PackedRecordReader classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/PackedFragments.hpp"
+
+#define BOOST_TEST_MODULE PackedFragments_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+std::unique_ptr<Fragment>
+create_fragment(trigger_number_t trigger_number, SourceID source_id, size_t payload_size)
+{
+  std::vector<char> payload(payload_size, static_cast<char>('a' + source_id.id));
+  auto fragment = std::make_unique<Fragment>(payload.data(), payload.size());
+  fragment->set_trigger_number(trigger_number);
+  fragment->set_element_id(source_id);
+  return fragment;
+}
+
+std::string
+packed_filename(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()) + ".hdf5")).string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(PackedFragments_test)
+
+BOOST_AUTO_TEST_CASE(WriteAndView)
+{
+  auto filename = packed_filename("packed");
+  std::vector<std::unique_ptr<Fragment>> fragments;
+  // odd sizes, to exercise the alignment
+  fragments.push_back(create_fragment(12, SourceID(SourceID::Subsystem::kDetectorReadout, 0), 13));
+  fragments.push_back(create_fragment(12, SourceID(SourceID::Subsystem::kDetectorReadout, 1), 101));
+  fragments.push_back(create_fragment(12, SourceID(SourceID::Subsystem::kTrigger, 2), 7));
+  std::vector<const Fragment*> fragment_ptrs;
+  for (const auto& fragment : fragments) {
+    fragment_ptrs.push_back(fragment.get());
+  }
+
+  {
+    HighFive::File file(filename, HighFive::File::Overwrite);
+    auto bytes = PackedFragmentWriter::write(file, 12, 0, fragment_ptrs);
+    BOOST_REQUIRE(bytes >= fragments[0]->get_size() + fragments[1]->get_size() + fragments[2]->get_size());
+  }
+
+  HighFive::File file(filename, HighFive::File::ReadOnly);
+  BOOST_REQUIRE(PackedRecordReader::has_record(file, 12, 0));
+  BOOST_REQUIRE(!PackedRecordReader::has_record(file, 12, 1));
+  BOOST_REQUIRE_THROW(PackedRecordReader(file, 13, 0), PackedRecordNotFound);
+
+  PackedRecordReader reader(file, 12, 0);
+  BOOST_REQUIRE_EQUAL(reader.get_index().size(), 3);
+  for (const auto& entry : reader.get_index()) {
+    BOOST_REQUIRE_EQUAL(entry.offset % PackedFragmentWriter::s_alignment, 0);
+  }
+  BOOST_REQUIRE(reader.get_source_ids()[2] == SourceID(SourceID::Subsystem::kTrigger, 2));
+
+  for (const auto& original : fragments) {
+    auto view = reader.get_fragment(original->get_element_id());
+    BOOST_REQUIRE(view != nullptr);
+    BOOST_REQUIRE_EQUAL(view->get_size(), original->get_size());
+    BOOST_REQUIRE_EQUAL(view->get_trigger_number(), 12);
+    BOOST_REQUIRE_EQUAL(std::memcmp(view->get_storage_location(), original->get_storage_location(), view->get_size()),
+                        0);
+    // the views point into the buffer of the reader, nothing is copied
+    BOOST_REQUIRE_EQUAL(view->get_storage_location(),
+                        reader.get_fragment(original->get_element_id())->get_storage_location());
+  }
+  BOOST_REQUIRE(reader.get_fragment(SourceID(SourceID::Subsystem::kTrigger, 5)) == nullptr);
+
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(RecordName)
+{
+  BOOST_REQUIRE_EQUAL(PackedFragmentWriter::record_name(42, 3), "Record0000000042.0003");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
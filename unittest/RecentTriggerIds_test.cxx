@@ -0,0 +1,67 @@
+/**
+ * @file RecentTriggerIds_test.cxx Test application that tests and demonstrates
+ * the functionality of the RecentTriggerIds class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/RecentTriggerIds.hpp"
+
+#define BOOST_TEST_MODULE RecentTriggerIds_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+TriggerId
+make_id(dunedaq::daqdataformats::trigger_number_t trigger_number)
+{
+  TriggerId id;
+  id.trigger_number = trigger_number;
+  id.sequence_number = 0;
+  id.run_number = 1;
+  return id;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(RecentTriggerIds_test)
+
+BOOST_AUTO_TEST_CASE(BoundedMemory)
+{
+  RecentTriggerIds ids(3);
+  for (size_t i = 1; i <= 5; ++i) {
+    ids.insert(make_id(i));
+  }
+  BOOST_REQUIRE_EQUAL(ids.size(), 3);
+  BOOST_REQUIRE(!ids.contains(make_id(1)));
+  BOOST_REQUIRE(!ids.contains(make_id(2)));
+  BOOST_REQUIRE(ids.contains(make_id(3)));
+  BOOST_REQUIRE(ids.contains(make_id(5)));
+
+  // duplicates do not push out older entries
+  ids.insert(make_id(5));
+  BOOST_REQUIRE(ids.contains(make_id(3)));
+
+  ids.set_capacity(1);
+  BOOST_REQUIRE_EQUAL(ids.size(), 1);
+  BOOST_REQUIRE(ids.contains(make_id(5)));
+
+  ids.clear();
+  BOOST_REQUIRE_EQUAL(ids.size(), 0);
+  BOOST_REQUIRE(!ids.contains(make_id(5)));
+}
+
+BOOST_AUTO_TEST_CASE(Disabled)
+{
+  RecentTriggerIds ids;
+  ids.insert(make_id(1));
+  BOOST_REQUIRE_EQUAL(ids.size(), 0);
+  BOOST_REQUIRE(!ids.contains(make_id(1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+/**
+ * @file RecordHeaderTable_test.cxx Test application that tests and demonstrates
+ * the functionality of the RecordHeaderTable class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/RecordHeaderTable.hpp"
+
+#define BOOST_TEST_MODULE RecordHeaderTable_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+TriggerRecordHeader
+create_header(trigger_number_t trigger_number)
+{
+  std::vector<ComponentRequest> components(3);
+  TriggerRecordHeader header(components);
+  header.set_trigger_number(trigger_number);
+  header.set_trigger_timestamp(1000 * trigger_number);
+  header.set_run_number(7);
+  header.set_trigger_type(trigger_number % 4);
+  header.set_error_bit(TriggerRecordErrorBits::kIncomplete, trigger_number == 3);
+  return header;
+}
+
+std::string
+table_filename(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()) + ".hdf5")).string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(RecordHeaderTable_test)
+
+BOOST_AUTO_TEST_CASE(AppendAndRead)
+{
+  auto filename = table_filename("header_table");
+  {
+    HighFive::File file(filename, HighFive::File::Overwrite);
+    RecordHeaderTable table(file, 2);
+    for (trigger_number_t i = 1; i <= 5; ++i) {
+      table.append(create_header(i), i % 3);
+    }
+    BOOST_REQUIRE_EQUAL(table.rows(), 5);
+    // two batches of two are in the file, the last row is still buffered
+    BOOST_REQUIRE_EQUAL(RecordHeaderTable::read(file).size(), 4);
+  }
+
+  {
+    HighFive::File file(filename, HighFive::File::ReadWrite);
+    auto rows = RecordHeaderTable::read(file);
+    BOOST_REQUIRE_EQUAL(rows.size(), 5);
+    BOOST_REQUIRE_EQUAL(rows[2].trigger_number, 3);
+    BOOST_REQUIRE_EQUAL(rows[2].trigger_timestamp, 3000);
+    BOOST_REQUIRE_EQUAL(rows[2].run_number, 7);
+    BOOST_REQUIRE_EQUAL(rows[2].trigger_type, 3);
+    BOOST_REQUIRE_EQUAL(rows[2].num_requested_components, 3);
+    BOOST_REQUIRE_EQUAL(rows[2].num_fragments, 0);
+    BOOST_REQUIRE_EQUAL(rows[2].error_bits, create_header(3).get_header().error_bits);
+    BOOST_REQUIRE_EQUAL(rows[4].num_fragments, 2);
+
+    // a table reopened in an existing file is appended to
+    RecordHeaderTable table(file, 10);
+    BOOST_REQUIRE_EQUAL(table.rows(), 5);
+    table.append(create_header(6), 1);
+  }
+
+  HighFive::File file(filename, HighFive::File::ReadOnly);
+  BOOST_REQUIRE_EQUAL(RecordHeaderTable::read(file).size(), 6);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(NoTable)
+{
+  auto filename = table_filename("no_header_table");
+  {
+    HighFive::File file(filename, HighFive::File::Overwrite);
+    BOOST_REQUIRE(RecordHeaderTable::read(file).empty());
+  }
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
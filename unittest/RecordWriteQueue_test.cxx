@@ -0,0 +1,140 @@
+/**
+ * @file RecordWriteQueue_test.cxx Test application that tests and demonstrates
+ * the functionality of the RecordWriteQueue class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/RecordWriteQueue.hpp"
+
+#define BOOST_TEST_MODULE RecordWriteQueue_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+RecordWriteQueue::record_ptr_t
+create_record(trigger_number_t trigger_number)
+{
+  TriggerRecordHeaderData trh_data;
+  trh_data.trigger_number = trigger_number;
+  trh_data.trigger_timestamp = 1000 + trigger_number;
+  trh_data.num_requested_components = 0;
+  trh_data.run_number = 1;
+  trh_data.sequence_number = 0;
+  trh_data.max_sequence_number = 0;
+  TriggerRecordHeader trh(&trh_data);
+  return std::make_unique<TriggerRecord>(trh);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(RecordWriteQueue_test)
+
+BOOST_AUTO_TEST_CASE(FifoAndBytes)
+{
+  RecordWriteQueue queue;
+  queue.open(4);
+  BOOST_REQUIRE_EQUAL(queue.capacity(), 4);
+
+  auto record = create_record(1);
+  auto record_size = record->get_total_size_bytes();
+  BOOST_REQUIRE(queue.push(record));
+  BOOST_REQUIRE(!record);
+  record = create_record(2);
+  BOOST_REQUIRE(queue.push(record));
+  BOOST_REQUIRE_EQUAL(queue.size(), 2);
+  BOOST_REQUIRE_EQUAL(queue.bytes(), 2 * record_size);
+
+  trigger_number_t checkpoint = 0;
+  BOOST_REQUIRE(!queue.last_checkpoint(checkpoint));
+
+  BOOST_REQUIRE(queue.pop(record));
+  BOOST_REQUIRE_EQUAL(record->get_header_ref().get_trigger_number(), 1);
+  queue.checkpoint(1);
+  BOOST_REQUIRE(queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(checkpoint, 1);
+  BOOST_REQUIRE_EQUAL(queue.bytes(), record_size);
+
+  // the queue is drained after it is closed
+  queue.close();
+  BOOST_REQUIRE(queue.pop(record));
+  BOOST_REQUIRE_EQUAL(record->get_header_ref().get_trigger_number(), 2);
+  BOOST_REQUIRE(!queue.pop(record));
+  BOOST_REQUIRE(!queue.push(record));
+  BOOST_REQUIRE(record);
+
+  // reopening empties the queue and forgets the checkpoint
+  queue.open(2);
+  BOOST_REQUIRE(!queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CheckpointAfterLoss)
+{
+  RecordWriteQueue queue;
+  queue.open(4);
+
+  // the checkpoint follows the queue order, not the trigger numbers, and
+  // stops at the last record before one that could not be written
+  queue.checkpoint(3);
+  queue.checkpoint(2);
+  trigger_number_t checkpoint = 0;
+  BOOST_REQUIRE(queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(checkpoint, 2);
+
+  queue.break_checkpoint();
+  queue.checkpoint(4);
+  BOOST_REQUIRE(queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(checkpoint, 2);
+
+  queue.open(4);
+  queue.checkpoint(5);
+  BOOST_REQUIRE(queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(checkpoint, 5);
+}
+
+BOOST_AUTO_TEST_CASE(Bounded)
+{
+  RecordWriteQueue queue;
+  queue.open(2);
+
+  std::atomic<size_t> pushed{ 0 };
+  std::thread producer([&]() {
+    for (trigger_number_t i = 1; i <= 5; ++i) {
+      auto record = create_record(i);
+      queue.push(record);
+      ++pushed;
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_REQUIRE_EQUAL(pushed.load(), 2);
+  BOOST_REQUIRE_EQUAL(queue.size(), 2);
+
+  RecordWriteQueue::record_ptr_t record;
+  for (trigger_number_t i = 1; i <= 5; ++i) {
+    BOOST_REQUIRE(queue.pop(record));
+    BOOST_REQUIRE_EQUAL(record->get_header_ref().get_trigger_number(), i);
+    queue.checkpoint(i);
+  }
+  producer.join();
+  BOOST_REQUIRE_EQUAL(pushed.load(), 5);
+
+  trigger_number_t checkpoint = 0;
+  BOOST_REQUIRE(queue.last_checkpoint(checkpoint));
+  BOOST_REQUIRE_EQUAL(checkpoint, 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+/**
+ * @file RunSummary_test.cxx Test application that tests and demonstrates
+ * the functionality of the LatencyHistogram and RunSummary classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/LatencyHistogram.hpp"
+#include "dfmodules/RunSummary.hpp"
+
+#define BOOST_TEST_MODULE RunSummary_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace dunedaq::dfmodules;
+
+BOOST_AUTO_TEST_SUITE(RunSummary_test)
+
+BOOST_AUTO_TEST_CASE(EmptyHistogram)
+{
+  LatencyHistogram histogram;
+  BOOST_REQUIRE_EQUAL(histogram.count(), 0);
+  BOOST_REQUIRE_EQUAL(histogram.min().count(), 0);
+  BOOST_REQUIRE_EQUAL(histogram.max().count(), 0);
+  BOOST_REQUIRE_EQUAL(histogram.quantile(0.5).count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Quantiles)
+{
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(std::chrono::microseconds(i));
+  }
+  BOOST_REQUIRE_EQUAL(histogram.count(), 1000);
+  BOOST_REQUIRE(histogram.min() == std::chrono::microseconds(1));
+  BOOST_REQUIRE(histogram.max() == std::chrono::microseconds(1000));
+  BOOST_REQUIRE_EQUAL(histogram.mean().count(), 500500);
+
+  // the bucket resolution is 12.5%
+  auto median = std::chrono::duration<double, std::micro>(histogram.quantile(0.5)).count();
+  BOOST_REQUIRE_CLOSE(median, 500., 12.5);
+  auto p99 = std::chrono::duration<double, std::micro>(histogram.quantile(0.99)).count();
+  BOOST_REQUIRE_CLOSE(p99, 990., 12.5);
+  BOOST_REQUIRE(histogram.quantile(1.) == std::chrono::microseconds(1000));
+
+  LatencyHistogram other;
+  other.record(std::chrono::seconds(1));
+  histogram += other;
+  BOOST_REQUIRE_EQUAL(histogram.count(), 1001);
+  BOOST_REQUIRE(histogram.max() == std::chrono::seconds(1));
+
+  histogram.reset();
+  BOOST_REQUIRE_EQUAL(histogram.count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(WriteReport)
+{
+  auto directory = std::filesystem::temp_directory_path() / ("RunSummary_test_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+  unsetenv("DFMODULES_RUN_SUMMARY_DIR");
+  setenv("DUNEDAQ_APPLICATION_NAME", "testapp", 1);
+  RunSummary::get().set_output_directory(directory.string());
+
+  nlohmann::json first;
+  first["records"] = 10;
+  RunSummary::get().add_section(42, "writer", first);
+
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::milliseconds(3));
+  nlohmann::json second;
+  second["latency"] = RunSummary::summarise(histogram);
+  auto filename = RunSummary::get().add_section(42, "builder", second);
+  BOOST_REQUIRE_EQUAL(filename, (directory / "testapp_run000042_performance.json").string());
+
+  std::ifstream file(filename);
+  nlohmann::json report;
+  file >> report;
+  BOOST_REQUIRE_EQUAL(report["run_number"].get<int>(), 42);
+  BOOST_REQUIRE_EQUAL(report["modules"]["writer"]["records"].get<int>(), 10);
+  BOOST_REQUIRE_EQUAL(report["modules"]["builder"]["latency"]["count"].get<int>(), 1);
+  BOOST_REQUIRE(report["process"].contains("peak_rss_kB"));
+
+  // a new run starts a new report
+  filename = RunSummary::get().add_section(43, "writer", first);
+  std::ifstream new_file(filename);
+  new_file >> report;
+  BOOST_REQUIRE(!report["modules"].contains("builder"));
+
+  // a section added late to the previous run completes its report
+  nlohmann::json late;
+  late["finish_time_s"] = 1.5;
+  filename = RunSummary::get().add_section(42, "writer_finalisation", late);
+  std::ifstream late_file(filename);
+  late_file >> report;
+  BOOST_REQUIRE(report["modules"].contains("builder"));
+  BOOST_REQUIRE(report["modules"].contains("writer_finalisation"));
+
+  std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(Rate)
+{
+  BOOST_REQUIRE_EQUAL(RunSummary::rate(10, std::chrono::seconds(2)), 5.);
+  BOOST_REQUIRE_EQUAL(RunSummary::rate(10, std::chrono::seconds(0)), 0.);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
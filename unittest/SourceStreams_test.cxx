@@ -0,0 +1,105 @@
+/**
+ * @file SourceStreams_test.cxx Test application that tests and demonstrates
+ * the functionality of the SourceStreamWriter and SourceStreamReader classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/SourceStreams.hpp"
+
+#define BOOST_TEST_MODULE SourceStreams_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+std::unique_ptr<Fragment>
+create_fragment(trigger_number_t trigger_number, SourceID source_id, size_t payload_size)
+{
+  std::vector<char> payload(payload_size, static_cast<char>('a' + trigger_number % 26));
+  auto fragment = std::make_unique<Fragment>(payload.data(), payload.size());
+  fragment->set_trigger_number(trigger_number);
+  fragment->set_element_id(source_id);
+  return fragment;
+}
+
+std::string
+stream_filename(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()) + ".hdf5")).string();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(SourceStreams_test)
+
+BOOST_AUTO_TEST_CASE(AppendAndRead)
+{
+  auto filename = stream_filename("streams");
+  SourceID link0(SourceID::Subsystem::kDetectorReadout, 0);
+  SourceID link1(SourceID::Subsystem::kDetectorReadout, 1);
+  std::vector<std::unique_ptr<Fragment>> fragments0;
+
+  {
+    HighFive::File file(filename, HighFive::File::Overwrite);
+    // a small buffer, so that the streams are appended to several times
+    SourceStreamWriter writer(file, 1024, 300);
+    for (trigger_number_t trigger_number = 1; trigger_number <= 10; ++trigger_number) {
+      // odd sizes, to exercise the alignment
+      fragments0.push_back(create_fragment(trigger_number, link0, 10 + 3 * trigger_number));
+      auto fragment1 = create_fragment(trigger_number, link1, 5);
+      BOOST_REQUIRE(writer.append(trigger_number, 0, *fragments0.back()) >= fragments0.back()->get_size());
+      writer.append(trigger_number, 0, *fragment1);
+    }
+    BOOST_REQUIRE_EQUAL(writer.streams(), 2);
+  }
+
+  HighFive::File file(filename, HighFive::File::ReadOnly);
+  BOOST_REQUIRE_EQUAL(SourceStreamReader::list_streams(file).size(), 2);
+  BOOST_REQUIRE_THROW(SourceStreamReader(file, SourceID(SourceID::Subsystem::kTrigger, 0)), SourceStreamError);
+
+  SourceStreamReader reader(file, link0);
+  const auto& index = reader.get_index();
+  BOOST_REQUIRE_EQUAL(index.size(), 10);
+  for (size_t row = 0; row < index.size(); ++row) {
+    BOOST_REQUIRE_EQUAL(index[row].trigger_number, row + 1);
+    BOOST_REQUIRE_EQUAL(index[row].offset % SourceStreamWriter::s_alignment, 0);
+    BOOST_REQUIRE_EQUAL(index[row].size, fragments0[row]->get_size());
+  }
+
+  // the fragments of triggers 3 to 7 in one read
+  reader.load(2, 5);
+  BOOST_REQUIRE(reader.get_fragment(1) == nullptr);
+  BOOST_REQUIRE(reader.get_fragment(7) == nullptr);
+  for (size_t row = 2; row < 7; ++row) {
+    auto view = reader.get_fragment(row);
+    BOOST_REQUIRE(view != nullptr);
+    BOOST_REQUIRE_EQUAL(view->get_trigger_number(), row + 1);
+    BOOST_REQUIRE_EQUAL(view->get_size(), fragments0[row]->get_size());
+    BOOST_REQUIRE_EQUAL(
+      std::memcmp(view->get_storage_location(), fragments0[row]->get_storage_location(), view->get_size()), 0);
+  }
+
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(StreamName)
+{
+  BOOST_REQUIRE_EQUAL(SourceStreamWriter::stream_name(SourceID(SourceID::Subsystem::kDetectorReadout, 42)),
+                      "Detector_Readout_00000042");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
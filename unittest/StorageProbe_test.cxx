@@ -0,0 +1,47 @@
+/**
+ * @file StorageProbe_test.cxx Test application that tests and demonstrates
+ * the functionality of the StorageProbe class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/StorageProbe.hpp"
+
+#define BOOST_TEST_MODULE StorageProbe_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <filesystem>
+#include <string>
+
+using namespace dunedaq::dfmodules;
+
+BOOST_AUTO_TEST_SUITE(StorageProbe_test)
+
+BOOST_AUTO_TEST_CASE(Measure)
+{
+  StorageProbe probe(std::filesystem::temp_directory_path().string(), 1000000, 65536);
+  auto result = probe.run();
+
+  // rounded up to whole records
+  BOOST_REQUIRE_EQUAL(result.records_written, 16);
+  BOOST_REQUIRE_EQUAL(result.bytes_written, 16 * 65536);
+  BOOST_REQUIRE(result.bandwidth() > 0.);
+  BOOST_REQUIRE(result.mean_record_time().count() > 0);
+  BOOST_REQUIRE(result.max_record_time <= result.total_time);
+  BOOST_REQUIRE(!std::filesystem::exists(probe.file_name()));
+}
+
+BOOST_AUTO_TEST_CASE(Failure)
+{
+  StorageProbe probe("/nonexistent/directory", 1000, 100);
+  BOOST_REQUIRE_THROW(probe.run(), StorageProbeFailed);
+
+  StorageProbeResult none;
+  BOOST_REQUIRE_EQUAL(none.bandwidth(), 0.);
+  BOOST_REQUIRE_EQUAL(none.mean_record_time().count(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+/**
+ * @file StorageSelection_test.cxx Test application that tests and demonstrates
+ * the functionality of the StorageSelection class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/StorageSelection.hpp"
+
+#define BOOST_TEST_MODULE StorageSelection_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+std::unique_ptr<TriggerRecord>
+create_record(const std::vector<SourceID>& source_ids)
+{
+  TriggerRecordHeaderData trh_data;
+  trh_data.trigger_number = 1;
+  trh_data.trigger_timestamp = 1000;
+  trh_data.num_requested_components = 0;
+  trh_data.run_number = 1;
+  trh_data.sequence_number = 0;
+  trh_data.max_sequence_number = 0;
+  TriggerRecordHeader trh(&trh_data);
+  auto record = std::make_unique<TriggerRecord>(trh);
+
+  std::vector<char> payload(100, 'x');
+  for (const auto& source_id : source_ids) {
+    auto fragment = std::make_unique<Fragment>(payload.data(), payload.size());
+    fragment->set_element_id(source_id);
+    record->add_fragment(std::move(fragment));
+  }
+  return record;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(StorageSelection_test)
+
+BOOST_AUTO_TEST_CASE(Prescales)
+{
+  StorageSelection selection;
+  BOOST_REQUIRE(selection.empty());
+
+  StorageRule every_third;
+  every_third.prescale = 3;
+  selection.add_rule(1, every_third);
+  StorageRule none;
+  none.prescale = 0;
+  selection.add_rule(2, none);
+  BOOST_REQUIRE(selection.has_rule(1));
+  BOOST_REQUIRE(!selection.has_rule(4));
+
+  auto record = create_record({ SourceID(SourceID::Subsystem::kDetectorReadout, 0) });
+  std::vector<bool> selected;
+  for (int i = 0; i < 7; ++i) {
+    selected.push_back(selection.select(1, *record));
+  }
+  BOOST_REQUIRE(selected == std::vector<bool>({ true, false, false, true, false, false, true }));
+  BOOST_REQUIRE(!selection.select(2, *record));
+  BOOST_REQUIRE(!selection.select(4, *record));
+  BOOST_REQUIRE_EQUAL(record->get_fragments_ref().size(), 1);
+
+  std::map<trigger_type_t, std::pair<uint64_t, uint64_t>> counts; // NOLINT(build/unsigned)
+  selection.for_each([&](trigger_type_t trigger_type, const StorageSelection::Counters& counters) {
+    counts[trigger_type] = { counters.records_stored.load(), counters.records_prescaled.load() };
+  });
+  BOOST_REQUIRE_EQUAL(counts[1].first, 3);
+  BOOST_REQUIRE_EQUAL(counts[1].second, 4);
+  BOOST_REQUIRE_EQUAL(counts[2].first, 0);
+  BOOST_REQUIRE_EQUAL(counts[2].second, 1);
+
+  selection.reset();
+  BOOST_REQUIRE(selection.select(1, *record));
+}
+
+BOOST_AUTO_TEST_CASE(Allowlist)
+{
+  StorageSelection selection;
+  StorageRule rule;
+  rule.subsystems.insert(SourceID::Subsystem::kTrigger);
+  rule.source_ids.insert(SourceID(SourceID::Subsystem::kDetectorReadout, 2));
+  selection.add_rule(8, rule);
+
+  auto record = create_record({ SourceID(SourceID::Subsystem::kDetectorReadout, 1),
+                                SourceID(SourceID::Subsystem::kDetectorReadout, 2),
+                                SourceID(SourceID::Subsystem::kTrigger, 3),
+                                SourceID(SourceID::Subsystem::kDetectorReadout, 4) });
+  const auto* kept_fragment = record->get_fragments_ref()[1].get();
+  auto fragment_size = kept_fragment->get_size();
+  auto total_size = record->get_total_size_bytes();
+
+  BOOST_REQUIRE(selection.select(8, *record));
+  auto& fragments = record->get_fragments_ref();
+  BOOST_REQUIRE_EQUAL(fragments.size(), 2);
+  // the fragments are not copied
+  BOOST_REQUIRE_EQUAL(fragments[0].get(), kept_fragment);
+  BOOST_REQUIRE(fragments[1]->get_element_id() == SourceID(SourceID::Subsystem::kTrigger, 3));
+  BOOST_REQUIRE_EQUAL(record->get_total_size_bytes(), total_size - 2 * fragment_size);
+
+  selection.for_each([&](trigger_type_t, const StorageSelection::Counters& counters) {
+    BOOST_REQUIRE_EQUAL(counters.fragments_removed.load(), 2);
+    BOOST_REQUIRE_EQUAL(counters.bytes_removed.load(), 2 * fragment_size);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
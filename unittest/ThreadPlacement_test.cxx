@@ -0,0 +1,81 @@
+/**
+ * @file ThreadPlacement_test.cxx Test application that tests and demonstrates
+ * the functionality of the ThreadPlacement class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/ThreadPlacement.hpp"
+
+#define BOOST_TEST_MODULE ThreadPlacement_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <sched.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+BOOST_AUTO_TEST_SUITE(ThreadPlacement_test)
+
+BOOST_AUTO_TEST_CASE(ParseCPUList)
+{
+  BOOST_REQUIRE(ThreadPlacement::parse_cpu_list("").empty());
+
+  std::vector<unsigned> expected{ 0, 1, 2, 3, 8, 10, 11 };
+  auto cpus = ThreadPlacement::parse_cpu_list("0-3, 8,10-11\n");
+  BOOST_REQUIRE_EQUAL_COLLECTIONS(cpus.begin(), cpus.end(), expected.begin(), expected.end());
+
+  BOOST_REQUIRE_THROW(ThreadPlacement::parse_cpu_list("3-1"), dunedaq::dfmodules::InvalidCPUList);
+  BOOST_REQUIRE_THROW(ThreadPlacement::parse_cpu_list("1:2"), dunedaq::dfmodules::InvalidCPUList);
+  BOOST_REQUIRE_THROW(ThreadPlacement::parse_cpu_list("a"), dunedaq::dfmodules::InvalidCPUList);
+  BOOST_REQUIRE_THROW(ThreadPlacement::parse_cpu_list("100000"), dunedaq::dfmodules::InvalidCPUList);
+}
+
+BOOST_AUTO_TEST_CASE(DefaultPlacement)
+{
+  ThreadPlacement placement;
+  BOOST_REQUIRE(placement.is_default());
+  BOOST_REQUIRE(placement.apply_to_current_thread("test"));
+
+  ThreadPlacement from_conf("", -1);
+  BOOST_REQUIRE(from_conf.is_default());
+}
+
+BOOST_AUTO_TEST_CASE(ApplyAffinity)
+{
+  auto nodes = ThreadPlacement::get_online_numa_nodes();
+  BOOST_REQUIRE(!nodes.empty());
+  BOOST_REQUIRE_EQUAL(ThreadPlacement::get_numa_node_count(), static_cast<int>(nodes.size()));
+
+  ThreadPlacement placement("", nodes.front());
+  BOOST_REQUIRE_EQUAL(placement.get_numa_node(), nodes.front());
+
+  // Boost.Test assertions are not thread safe, the worker only collects what
+  // the main thread checks
+  int cpu = -1;
+  bool applied = false;
+  int affinity_status = -1;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  std::thread worker([&]() {
+    cpu = sched_getcpu();
+    ThreadPlacement single(std::to_string(cpu), -1);
+    applied = single.apply_to_current_thread("test");
+    affinity_status = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  });
+  worker.join();
+
+  BOOST_REQUIRE_GE(cpu, 0);
+  BOOST_REQUIRE(applied);
+  BOOST_REQUIRE_EQUAL(affinity_status, 0);
+  BOOST_REQUIRE_EQUAL(CPU_COUNT(&cpu_set), 1);
+  BOOST_REQUIRE(CPU_ISSET(cpu, &cpu_set));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,7 @@
 #include <chrono>
 #include <thread>
 #include <utility>
+#include <vector>
 
 using namespace dunedaq::dfmodules;
 
@@ -187,6 +188,115 @@ BOOST_AUTO_TEST_CASE(Exceptions)
     trbd.add_assignment(err_assignment), NoSlotsAvailable, [](NoSlotsAvailable const&) { return true; });
 }
 
+BOOST_AUTO_TEST_CASE(CompleteInBatch)
+{
+  TriggerRecordBuilderData trbd("test", 4, 2);
+  for (dunedaq::daqdataformats::trigger_number_t i = 1; i <= 5; ++i) {
+    dunedaq::dfmessages::TriggerDecision td;
+    td.trigger_number = i;
+    td.run_number = 2;
+    td.trigger_timestamp = i;
+    td.trigger_type = 1;
+    td.readout_type = dunedaq::dfmessages::ReadoutType::kLocalized;
+    trbd.add_assignment(trbd.make_assignment(td));
+  }
+  BOOST_REQUIRE(trbd.is_busy());
+
+  size_t metadata_calls = 0;
+  std::vector<dunedaq::daqdataformats::trigger_number_t> missing;
+  auto completed = trbd.complete_assignments(
+    { 4, 1, 7, 2 }, missing, [&metadata_calls](nlohmann::json&) { ++metadata_calls; });
+
+  BOOST_REQUIRE_EQUAL(completed.size(), 3);
+  BOOST_REQUIRE_EQUAL(missing.size(), 1);
+  BOOST_REQUIRE_EQUAL(missing[0], 7);
+  BOOST_REQUIRE_EQUAL(metadata_calls, 1);
+  BOOST_REQUIRE_EQUAL(trbd.used_slots(), 2);
+  BOOST_REQUIRE(trbd.get_assignment(3) != nullptr);
+  BOOST_REQUIRE(trbd.get_assignment(5) != nullptr);
+  BOOST_REQUIRE(!trbd.is_busy());
+}
+
+BOOST_AUTO_TEST_CASE(LoadReports)
+{
+  TriggerRecordBuilderData trbd("test", 10);
+  BOOST_REQUIRE_EXCEPTION(trbd.set_bytes_thresholds(100, 200),
+                          DFOThresholdsNotConsistent,
+                          [](DFOThresholdsNotConsistent const&) { return true; });
+  trbd.set_bytes_thresholds(1000, 500);
+  trbd.set_in_error(false);
+
+  DataflowLoadReport builder;
+  builder.run_number = 2;
+  builder.decision_destination = "test";
+  builder.reporter = "trb";
+  builder.pending_bytes = 600;
+  trbd.update_load(builder);
+  BOOST_REQUIRE_EQUAL(trbd.pending_bytes(), 600);
+  BOOST_REQUIRE(!trbd.is_busy());
+
+  // the reports of the different modules add up
+  DataflowLoadReport writer = builder;
+  writer.reporter = "datawriter";
+  writer.pending_bytes = 400;
+  trbd.update_load(writer);
+  BOOST_REQUIRE_EQUAL(trbd.pending_bytes(), 1000);
+  BOOST_REQUIRE(trbd.is_busy());
+
+  // hysteresis: busy until below the free threshold
+  writer.pending_bytes = 0;
+  trbd.update_load(writer);
+  BOOST_REQUIRE(trbd.is_busy());
+  builder.pending_bytes = 400;
+  trbd.update_load(builder);
+  BOOST_REQUIRE(!trbd.is_busy());
+
+  // a stalled writer makes the application busy whatever its memory
+  writer.write_stalled = true;
+  trbd.update_load(writer);
+  BOOST_REQUIRE(trbd.is_write_stalled());
+  BOOST_REQUIRE(trbd.is_busy());
 
+  trbd.flush();
+  BOOST_REQUIRE_EQUAL(trbd.pending_bytes(), 0);
+  BOOST_REQUIRE(!trbd.is_write_stalled());
+}
+
+BOOST_AUTO_TEST_CASE(BandwidthWeight)
+{
+  TriggerRecordBuilderData trbd("test", 10, 5);
+  trbd.set_in_error(false);
+
+  DataflowLoadReport writer;
+  writer.decision_destination = "test";
+  writer.reporter = "datawriter";
+  writer.storage_bandwidth = 500000000;
+  trbd.update_load(writer);
+  BOOST_REQUIRE_EQUAL(trbd.storage_bandwidth(), 500000000);
+
+  for (dunedaq::daqdataformats::trigger_number_t i = 1; i <= 3; ++i) {
+    dunedaq::dfmessages::TriggerDecision decision;
+    decision.trigger_number = i;
+    trbd.add_assignment(trbd.make_assignment(decision));
+  }
+  BOOST_REQUIRE(!trbd.is_busy());
+
+  // a slower storage gets proportionally fewer slots
+  trbd.set_weight(0.3);
+  BOOST_REQUIRE_EQUAL(trbd.busy_threshold(), 3);
+  BOOST_REQUIRE(trbd.is_busy());
+
+  // the busy threshold stays at least 1
+  trbd.set_weight(0.01);
+  BOOST_REQUIRE_EQUAL(trbd.busy_threshold(), 1);
+
+  trbd.set_weight(1.);
+  BOOST_REQUIRE_EQUAL(trbd.busy_threshold(), 10);
+  BOOST_REQUIRE(!trbd.is_busy());
+
+  // the bandwidth measured at configuration outlives the run
+  trbd.flush();
+  BOOST_REQUIRE_EQUAL(trbd.storage_bandwidth(), 500000000);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
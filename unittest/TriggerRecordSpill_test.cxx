@@ -0,0 +1,116 @@
+/**
+ * @file TriggerRecordSpill_test.cxx Test application that tests and demonstrates
+ * the functionality of the TriggerRecordSpillWriter and TriggerRecordSpillReader classes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/TriggerRecordSpill.hpp"
+
+#define BOOST_TEST_MODULE TriggerRecordSpill_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using namespace dunedaq::daqdataformats;
+
+namespace {
+
+std::unique_ptr<TriggerRecord>
+create_trigger_record(trigger_number_t trigger_number, size_t n_fragments)
+{
+  TriggerRecordHeaderData trh_data;
+  trh_data.trigger_number = trigger_number;
+  trh_data.trigger_timestamp = 1000 + trigger_number;
+  trh_data.num_requested_components = n_fragments;
+  trh_data.run_number = 7;
+  trh_data.sequence_number = 0;
+  trh_data.max_sequence_number = 0;
+  TriggerRecordHeader trh(&trh_data);
+
+  auto record = std::make_unique<TriggerRecord>(trh);
+  for (size_t i = 0; i < n_fragments; ++i) {
+    std::vector<char> payload(100 * (i + 1), static_cast<char>(trigger_number + i));
+    record->add_fragment(std::make_unique<Fragment>(payload.data(), payload.size()));
+  }
+  return record;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TriggerRecordSpill_test)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+  auto directory = std::filesystem::temp_directory_path();
+  auto filename = TriggerRecordSpillWriter::file_name(directory.string(), "trb_" + std::to_string(getpid()), 7);
+  BOOST_REQUIRE(filename.find("_run000007.spill") != std::string::npos);
+
+  {
+    TriggerRecordSpillWriter writer(filename);
+    writer.write(*create_trigger_record(1, 3));
+    writer.write(*create_trigger_record(2, 0));
+    BOOST_REQUIRE_EQUAL(writer.records(), 2);
+    writer.close();
+  }
+  {
+    // a later spill appends to the same file
+    TriggerRecordSpillWriter writer(filename);
+    writer.write(*create_trigger_record(3, 1));
+  }
+
+  TriggerRecordSpillReader reader(filename);
+  for (trigger_number_t trigger_number : { 1, 2, 3 }) {
+    auto record = reader.next();
+    BOOST_REQUIRE(record != nullptr);
+    auto expected = create_trigger_record(trigger_number, trigger_number == 1 ? 3 : trigger_number == 2 ? 0 : 1);
+    BOOST_REQUIRE_EQUAL(record->get_header_ref().get_trigger_number(), trigger_number);
+    BOOST_REQUIRE_EQUAL(record->get_header_ref().get_run_number(), 7);
+    BOOST_REQUIRE_EQUAL(record->get_fragments_ref().size(), expected->get_fragments_ref().size());
+    for (size_t i = 0; i < record->get_fragments_ref().size(); ++i) {
+      const auto& fragment = record->get_fragments_ref()[i];
+      const auto& expected_fragment = expected->get_fragments_ref()[i];
+      BOOST_REQUIRE_EQUAL(fragment->get_size(), expected_fragment->get_size());
+      BOOST_REQUIRE(std::memcmp(fragment->get_storage_location(),
+                                expected_fragment->get_storage_location(),
+                                fragment->get_size()) == 0);
+    }
+  }
+  BOOST_REQUIRE(reader.next() == nullptr);
+
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(Truncated)
+{
+  auto filename = (std::filesystem::temp_directory_path() / ("truncated_" + std::to_string(getpid()) + ".spill")).string();
+  {
+    TriggerRecordSpillWriter writer(filename);
+    writer.write(*create_trigger_record(1, 2));
+  }
+  std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 10);
+
+  TriggerRecordSpillReader reader(filename);
+  BOOST_REQUIRE_THROW(reader.next(), dunedaq::dfmodules::SpillFileError);
+
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(BadDirectory)
+{
+  BOOST_REQUIRE_THROW(TriggerRecordSpillWriter("/nonexistent/directory/file.spill"), dunedaq::dfmodules::SpillFileError);
+  BOOST_REQUIRE_THROW(TriggerRecordSpillReader("/nonexistent/directory/file.spill"), dunedaq::dfmodules::SpillFileError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
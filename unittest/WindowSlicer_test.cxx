@@ -0,0 +1,148 @@
+/**
+ * @file WindowSlicer_test.cxx Test application that tests and demonstrates
+ * the functionality of the WindowSlicer class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/WindowSlicer.hpp"
+
+#define BOOST_TEST_MODULE WindowSlicer_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+using dunedaq::daqdataformats::ComponentRequest;
+using dunedaq::daqdataformats::SourceID;
+using dunedaq::daqdataformats::timestamp_diff_t;
+using dunedaq::daqdataformats::timestamp_t;
+
+namespace {
+
+// the slicing as it was done by the TriggerRecordBuilder, component by component
+std::vector<std::vector<ComponentRequest>>
+reference_slices(const std::vector<ComponentRequest>& components, timestamp_diff_t max_time_window)
+{
+  timestamp_t begin = std::numeric_limits<timestamp_t>::max();
+  timestamp_t end = 0;
+  for (const auto& component : components) {
+    begin = std::min(begin, component.window_begin);
+    end = std::max(end, component.window_end);
+  }
+  timestamp_diff_t tot_width = end - begin;
+  size_t max_sequence_number = (max_time_window > 0 && tot_width > 0) ? ((tot_width - 1) / max_time_window) : 0;
+
+  std::vector<std::vector<ComponentRequest>> slices;
+  for (size_t sequence = 0; sequence <= max_sequence_number; ++sequence) {
+    timestamp_t slice_begin = begin + sequence * max_time_window;
+    timestamp_t slice_end = max_time_window > 0 ? std::min(slice_begin + max_time_window, end) : end;
+    auto& slice = slices.emplace_back();
+    for (const auto& component : components) {
+      if (component.window_begin >= slice_end || component.window_end <= slice_begin)
+        continue;
+      slice.emplace_back(component.component,
+                         std::max(slice_begin, component.window_begin),
+                         std::min(slice_end, component.window_end));
+    }
+  }
+  return slices;
+}
+
+void
+check_against_reference(WindowSlicer& slicer,
+                        const std::vector<ComponentRequest>& components,
+                        timestamp_diff_t max_time_window)
+{
+  auto expected = reference_slices(components, max_time_window);
+  slicer.reset(components, max_time_window);
+  BOOST_REQUIRE_EQUAL(slicer.max_sequence_number() + 1, expected.size());
+  for (const auto& expected_slice : expected) {
+    const auto& slice = slicer.next_slice();
+    BOOST_REQUIRE_EQUAL(slice.size(), expected_slice.size());
+    for (size_t i = 0; i < slice.size(); ++i) {
+      BOOST_REQUIRE(slice[i].component == expected_slice[i].component);
+      BOOST_REQUIRE_EQUAL(slice[i].window_begin, expected_slice[i].window_begin);
+      BOOST_REQUIRE_EQUAL(slice[i].window_end, expected_slice[i].window_end);
+    }
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(WindowSlicer_test)
+
+BOOST_AUTO_TEST_CASE(NoSlicing)
+{
+  std::vector<ComponentRequest> components;
+  components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, 1), 100, 200);
+  components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, 2), 150, 300);
+
+  WindowSlicer slicer;
+  slicer.reset(components, 0);
+  BOOST_REQUIRE_EQUAL(slicer.begin(), 100);
+  BOOST_REQUIRE_EQUAL(slicer.end(), 300);
+  BOOST_REQUIRE_EQUAL(slicer.max_sequence_number(), 0);
+
+  const auto& slice = slicer.next_slice();
+  BOOST_REQUIRE_EQUAL(slice.size(), 2);
+  BOOST_REQUIRE_EQUAL(slice[0].window_begin, 100);
+  BOOST_REQUIRE_EQUAL(slice[1].window_end, 300);
+}
+
+BOOST_AUTO_TEST_CASE(DecisionOrderIsKept)
+{
+  std::vector<ComponentRequest> components;
+  components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, 1), 250, 400);
+  components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, 2), 0, 400);
+  components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, 3), 0, 120);
+
+  WindowSlicer slicer;
+  slicer.reset(components, 100);
+  BOOST_REQUIRE_EQUAL(slicer.max_sequence_number(), 3);
+
+  BOOST_REQUIRE_EQUAL(slicer.next_slice().size(), 2); // [0, 100): 2, 3
+  const auto& second = slicer.next_slice();           // [100, 200): 2, 3
+  BOOST_REQUIRE_EQUAL(second.size(), 2);
+  BOOST_REQUIRE_EQUAL(second[1].window_end, 120);
+  const auto& third = slicer.next_slice(); // [200, 300): 1, 2
+  BOOST_REQUIRE_EQUAL(third.size(), 2);
+  BOOST_REQUIRE(third[0].component == components[0].component);
+  BOOST_REQUIRE_EQUAL(third[0].window_begin, 250);
+}
+
+BOOST_AUTO_TEST_CASE(EmptyDecision)
+{
+  std::vector<ComponentRequest> components;
+  WindowSlicer slicer;
+  slicer.reset(components, 100);
+  BOOST_REQUIRE_EQUAL(slicer.max_sequence_number(), 0);
+  BOOST_REQUIRE(slicer.next_slice().empty());
+}
+
+BOOST_AUTO_TEST_CASE(RandomDecisions)
+{
+  std::mt19937 generator(1234);
+  std::uniform_int_distribution<timestamp_t> start(1000, 5000);
+  std::uniform_int_distribution<timestamp_t> width(0, 2000);
+
+  WindowSlicer slicer;
+  for (size_t n_components : { 1, 7, 50 }) {
+    for (timestamp_diff_t max_time_window : { 0, 1, 33, 500, 10000 }) {
+      std::vector<ComponentRequest> components;
+      for (size_t i = 0; i < n_components; ++i) {
+        auto begin = start(generator);
+        components.emplace_back(SourceID(SourceID::Subsystem::kDetectorReadout, i), begin, begin + width(generator));
+      }
+      check_against_reference(slicer, components, max_time_window);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+/**
+ * @file WritebackPolicy_test.cxx Test application that tests and demonstrates
+ * the functionality of the WritebackPolicy class.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "dfmodules/WritebackPolicy.hpp"
+
+#define BOOST_TEST_MODULE WritebackPolicy_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::dfmodules;
+
+namespace {
+
+std::string
+writeback_filename(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / (name + "_" + std::to_string(getpid()) + ".hdf5")).string();
+}
+
+void
+append(std::ofstream& file, size_t bytes)
+{
+  std::vector<char> data(bytes, 'w');
+  file.write(data.data(), data.size());
+  file.flush();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(WritebackPolicy_test)
+
+BOOST_AUTO_TEST_CASE(ParseMode)
+{
+  DurabilityMode mode = DurabilityMode::kNone;
+  BOOST_REQUIRE(WritebackPolicy::parse_mode("fsync-per-file", mode));
+  BOOST_REQUIRE(mode == DurabilityMode::kFsyncPerFile);
+  BOOST_REQUIRE(WritebackPolicy::parse_mode("fsync-every-n-bytes", mode));
+  BOOST_REQUIRE(mode == DurabilityMode::kFsyncEveryBytes);
+  BOOST_REQUIRE(WritebackPolicy::parse_mode("none", mode));
+  BOOST_REQUIRE(mode == DurabilityMode::kNone);
+  BOOST_REQUIRE(!WritebackPolicy::parse_mode("always", mode));
+
+  BOOST_REQUIRE(!WritebackPolicy(DurabilityMode::kNone, 0, 0, false).active());
+  BOOST_REQUIRE(WritebackPolicy(DurabilityMode::kNone, 0, 1000, false).active());
+  // without an interval, fsync every n bytes becomes fsync per file
+  BOOST_REQUIRE(WritebackPolicy(DurabilityMode::kFsyncEveryBytes, 0, 0, false).mode() == DurabilityMode::kFsyncPerFile);
+}
+
+BOOST_AUTO_TEST_CASE(FsyncEveryBytes)
+{
+  auto filename = writeback_filename("writeback_fsync");
+  std::ofstream file(filename, std::ios::binary);
+  WritebackPolicy policy(DurabilityMode::kFsyncEveryBytes, 10000, 0, false);
+  policy.open(filename);
+
+  // the fsyncs are left to the writer of the file, which flushes it first
+  int due = 0;
+  for (int i = 0; i < 10; ++i) {
+    append(file, 4000);
+    if (policy.written()) {
+      ++due;
+      policy.sync();
+    }
+  }
+  // at 12000, 24000 and 36000 bytes
+  BOOST_REQUIRE_EQUAL(due, 3);
+  BOOST_REQUIRE_EQUAL(policy.get_counters().fsyncs.load(), 3);
+  BOOST_REQUIRE_EQUAL(policy.get_counters().writebacks.load(), 0);
+
+  file.close();
+  policy.close();
+  BOOST_REQUIRE_EQUAL(policy.get_counters().fsyncs.load(), 4);
+  // nothing is followed once the file is closed
+  BOOST_REQUIRE(!policy.written());
+  policy.sync();
+  BOOST_REQUIRE_EQUAL(policy.get_counters().fsyncs.load(), 4);
+
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalWriteback)
+{
+  auto filename = writeback_filename("writeback_ranges");
+  std::ofstream file(filename, std::ios::binary);
+  WritebackPolicy policy(DurabilityMode::kNone, 0, 8192, true);
+  policy.open(filename);
+
+  for (int i = 0; i < 8; ++i) {
+    append(file, 4096);
+    BOOST_REQUIRE(!policy.written());
+  }
+  BOOST_REQUIRE_EQUAL(policy.get_counters().writebacks.load(), 4);
+  BOOST_REQUIRE_EQUAL(policy.get_counters().fsyncs.load(), 0);
+
+  file.close();
+  policy.close();
+  BOOST_REQUIRE_EQUAL(policy.get_counters().fsyncs.load(), 0);
+
+  BOOST_REQUIRE_THROW(policy.open(filename + ".missing"), WritebackFailed);
+  std::filesystem::remove(filename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()